@@ -0,0 +1,43 @@
+#include "Benchmark.hpp"
+#include "Utils.hpp"
+
+#include <alpm.h>
+
+#include <format>
+#include <string>
+#include <vector>
+
+// Walks the same list of strings the way the wrappers used to, with
+// `alpm_list_nth` for every element, and with `Utils::ALPMListView`.
+auto main() -> int {
+    for (std::size_t size : {16, 256, 4096}) {
+        std::vector<std::string> names;
+        alpm_list_t *list = nullptr;
+        for (std::size_t i = 0; i < size; i++) {
+            names.push_back(std::format("provide-{}", i));
+        }
+        for (std::string &name : names) {
+            list = alpm_list_add(list, name.data());
+        }
+
+        std::size_t iterations = 4096 * 16 / size;
+
+        Benchmark::Run(std::format("alpm_list_nth, {} elements", size), iterations, [list]() -> void {
+            std::size_t total = 0;
+            for (std::size_t i = 0; i < alpm_list_count(list); i++) {
+                total += std::string_view(static_cast<const char*>(alpm_list_nth(list, i)->data)).size();
+            }
+            Benchmark::DoNotOptimize(total);
+        });
+
+        Benchmark::Run(std::format("ALPMListView, {} elements", size), iterations, [list]() -> void {
+            std::size_t total = 0;
+            for (std::string_view element : Utils::ALPMListView<std::string_view>(list)) {
+                total += element.size();
+            }
+            Benchmark::DoNotOptimize(total);
+        });
+
+        alpm_list_free(list);
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <format>
+#include <iostream>
+#include <string_view>
+
+namespace Benchmark {
+    // Keeps the compiler from throwing away a result nothing else reads.
+    template <typename T>
+    inline auto DoNotOptimize(const T &value) -> void {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    // Runs `function` once to warm up, then `iterations` more times, and prints
+    // the mean time each run took.
+    template <typename F>
+    inline auto Run(std::string_view name, std::size_t iterations, F &&function) -> std::chrono::duration<double> {
+        function();
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < iterations; i++) {
+            function();
+        }
+        std::chrono::duration<double> mean = (std::chrono::steady_clock::now() - start) / iterations;
+
+        std::cout << std::format("{:<48} {:>12.3f} us", name, mean.count() * 1'000'000.0) << std::endl;
+        return mean;
+    }
+}  // namespace Benchmark
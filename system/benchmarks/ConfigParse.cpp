@@ -0,0 +1,63 @@
+#include "Benchmark.hpp"
+
+#include "Config.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+// Parses a pacman.conf whose repositories all include the same mirrorlist,
+// for mirrorlists of a growing number of Server lines, and looks sections
+// and servers up in the result.
+auto main() -> int {
+    std::string directory = (std::filesystem::temp_directory_path() / "system-benchmark-XXXXXX").string();
+    if (mkdtemp(directory.data()) == nullptr) {
+        std::cerr << "Could not create a temporary directory." << std::endl;
+        return 1;
+    }
+
+    constexpr std::string_view REPOSITORIES[] = {"core", "extra", "multilib", "testing"};
+
+    for (std::size_t servers : {1'000, 5'000, 20'000}) {
+        std::filesystem::path mirrorlist = std::filesystem::path(directory) / std::format("mirrorlist-{}", servers);
+        {
+            std::ofstream file(mirrorlist, std::ios::trunc);
+            file << "## Generated mirrorlist\n\n";
+            for (std::size_t i = 0; i < servers; i++) {
+                file << std::format("## Mirror {}\nServer = https://mirror{}.example.org/archlinux/$repo/os/$arch\n", i, i);
+            }
+        }
+
+        std::filesystem::path config = std::filesystem::path(directory) / std::format("pacman-{}.conf", servers);
+        {
+            std::ofstream file(config, std::ios::trunc);
+            file << "[options]\nHoldPkg = pacman glibc\nArchitecture = auto\nParallelDownloads = 5\nSigLevel = Required DatabaseOptional\n";
+            for (std::string_view repository : REPOSITORIES) {
+                file << std::format("\n[{}]\nInclude = {}\n", repository, mirrorlist.string());
+            }
+        }
+
+        Benchmark::Run(std::format("parse, {} servers per repository", servers), 20, [&config]() -> void {
+            ALPM::Config parsed(config);
+            Benchmark::DoNotOptimize(parsed.GetSections().size());
+        });
+
+        const ALPM::Config parsed(config);
+        Benchmark::Run(std::format("section lookup, {} servers per repository", servers), 100'000, [&parsed]() -> void {
+            Benchmark::DoNotOptimize(parsed.GetSection("testing"));
+        });
+
+        Benchmark::Run(std::format("all servers, {} servers per repository", servers), 100'000, [&parsed]() -> void {
+            Benchmark::DoNotOptimize(parsed.GetSection("extra")->GetOptions("Server").size());
+        });
+    }
+
+    std::error_code error;
+    std::filesystem::remove_all(directory, error);
+
+    return 0;
+}
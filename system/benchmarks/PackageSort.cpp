@@ -0,0 +1,65 @@
+#include "Benchmark.hpp"
+
+#include "ALPM.hpp"
+#include "Package.hpp"
+#include "VersionKey.hpp"
+
+#include <alpm.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Sorts every package of a sync database (extra unless another one is
+// given) by name and version, comparing with alpm_pkg_vercmp and with
+// VersionKeys parsed once per sort.
+auto main(int argc, char **argv) -> int {
+    std::string name = argc > 1 ? argv[1] : "extra";
+
+    ALPM::ALPM::Initialize();
+    std::optional<ALPM::Database> database = ALPM::ALPM::GetSyncDatabase(name);
+    if (!database) {
+        std::cerr << name << " isn't a sync database." << std::endl;
+        return 1;
+    }
+
+    std::vector<ALPM::Package> packages = database->GetPackageCache();
+    std::cout << packages.size() << " packages in " << name << std::endl;
+
+    // Sorting by version alone compares far more versions with each other than
+    // sorting by name does.
+    std::vector<std::string> versions;
+    for (const ALPM::Package &package : packages) {
+        versions.push_back(package.GetVersion());
+    }
+
+    std::ranges::reverse(packages);
+    std::ranges::reverse(versions);
+
+    Benchmark::Run("by name and version, alpm_pkg_vercmp", 20, [&packages]() -> void {
+        std::vector<ALPM::Package> sorted = packages;
+        std::ranges::sort(sorted, ALPM::Package::NameVersionLess());
+        Benchmark::DoNotOptimize(sorted.data());
+    });
+
+    Benchmark::Run("by name and version, VersionKey", 20, [&packages]() -> void {
+        std::vector<ALPM::Package> sorted = packages;
+        ALPM::Package::SortByNameVersion(sorted);
+        Benchmark::DoNotOptimize(sorted.data());
+    });
+
+    Benchmark::Run("by version, alpm_pkg_vercmp", 20, [&versions]() -> void {
+        std::vector<std::string> sorted = versions;
+        std::ranges::sort(sorted, [](const std::string &lhs, const std::string &rhs) -> bool {
+            return alpm_pkg_vercmp(lhs.c_str(), rhs.c_str()) < 0;
+        });
+        Benchmark::DoNotOptimize(sorted.data());
+    });
+
+    Benchmark::Run("by version, VersionKey", 20, [&versions]() -> void {
+        std::vector<ALPM::VersionKey> sorted(versions.begin(), versions.end());
+        std::ranges::sort(sorted);
+        Benchmark::DoNotOptimize(sorted.data());
+    });
+}
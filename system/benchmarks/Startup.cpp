@@ -0,0 +1,100 @@
+#include "Benchmark.hpp"
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+extern char **environ;
+
+namespace {
+    // Runs the executable to completion with its output thrown away. A run that
+    // fails would otherwise be timed as a fast one, so it stops the benchmark.
+    auto Execute(const std::vector<std::string> &arguments) -> void {
+        std::vector<char*> argv;
+        argv.push_back(const_cast<char*>(SYSTEM_EXECUTABLE));
+        for (const std::string &argument : arguments) {
+            argv.push_back(const_cast<char*>(argument.c_str()));
+        }
+        argv.push_back(nullptr);
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+        posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+        pid_t pid = 0;
+        int error = posix_spawn(&pid, SYSTEM_EXECUTABLE, &actions, nullptr, argv.data(), environ);
+        posix_spawn_file_actions_destroy(&actions);
+        if (error != 0) {
+            throw std::runtime_error(std::format("Could not run {}.", SYSTEM_EXECUTABLE));
+        }
+
+        int status = 0;
+        if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            throw std::runtime_error(std::format("{} failed with status {}.", SYSTEM_EXECUTABLE, status));
+        }
+    }
+}  // namespace
+
+// Times the executable from start to exit for `--version`, a query against the
+// local database and one against the sync databases. Cold runs remove the
+// compiled config and the indexes each run, so they're rebuilt from scratch,
+// warm runs reuse what the run before left behind. The root has to be given
+// and can't be "/", since cold runs delete its caches.
+//
+// Usage: system_benchmarks_Startup <root> [owned file] [search term]
+auto main(int argc, char **argv) -> int {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <root> [owned file] [search term]" << std::endl;
+        return 1;
+    }
+
+    std::filesystem::path root = std::filesystem::weakly_canonical(argv[1]);
+    if (root == root.root_path()) {
+        std::cerr << "Refusing to benchmark against the live system, use a copy of its root." << std::endl;
+        return 1;
+    }
+
+    std::string file = argc > 2 ? argv[2] : "usr/bin/pacman";
+    std::string term = argc > 3 ? argv[3] : "pacman";
+
+    std::vector<std::filesystem::path> caches = {
+        root / "var/cache/system/pacman.conf.bin",
+        root / "var/lib/pacman/sync/system.idx",
+        root / "var/lib/pacman/system-files.idx"
+    };
+
+    auto clear = [&caches]() -> void {
+        for (const std::filesystem::path &cache : caches) {
+            std::error_code error;
+            std::filesystem::remove(cache, error);
+        }
+    };
+
+    std::vector<std::pair<std::string, std::vector<std::string>>> commands = {
+        {"--version", {"--version"}},
+        {"local query", {"--root", root.string(), "owns", file}},
+        {"sync query", {"--root", root.string(), "search", term}}
+    };
+
+    for (const auto &[name, arguments] : commands) {
+        Benchmark::Run(std::format("{}, cold", name), 10, [&clear, &arguments]() -> void {
+            clear();
+            Execute(arguments);
+        });
+
+        Benchmark::Run(std::format("{}, warm", name), 10, [&arguments]() -> void {
+            Execute(arguments);
+        });
+    }
+
+    return 0;
+}
@@ -1,12 +1,17 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include <filesystem>
 #include <memory>
+#include <mutex>
 #include <optional>
 
 #include "Transaction.hpp"
 #include "Config.hpp"
+#include "Handle.hpp"
+#include "Utils.hpp"
 
 struct _alpm_handle_t;
 typedef struct _alpm_handle_t alpm_handle_t;
@@ -14,10 +19,15 @@ struct _alpm_db_t;
 typedef struct _alpm_db_t alpm_db_t;
 
 namespace ALPM {
+    // Works on the handle bound to the calling thread, see `Handle`.
     class ALPM {
         public:
+            // Creates the default handle, used by threads without a handle of
+            // their own. Returns false if it already exists.
             static auto Initialize(const std::filesystem::path &root = "/") -> bool;
 
+            static auto GetCurrentHandle() -> Handle&;
+
             static auto GetCurrentTransaction() -> std::shared_ptr<Transaction>;
 
             static auto SetCurrentTransaction(std::shared_ptr<Transaction> transaction) -> void;
@@ -28,20 +38,27 @@ namespace ALPM {
 
             static auto GetLocalDatabase() -> Database;
 
+            // The first of these registers the sync databases, so commands that
+            // only look at the local database never read their config.
             static auto GetSyncDatabases() -> std::vector<Database>;
+            static auto GetSyncDatabasesView() -> Utils::ALPMListView<Database>;
 
             static auto GetSyncDatabase(const std::string &name) -> std::optional<Database>;
 
-            static auto GetConfig() -> Config;
+            static auto GetConfig() -> std::shared_ptr<const Config>;
+
+            // Incremented whenever the set or contents of the sync databases
+            // change, so caches built from them know when to rebuild.
+            static auto GetDatabaseGeneration() -> uint64_t;
+            static auto InvalidateDatabases() -> void;
 
 
             static auto GetHandle() -> alpm_handle_t*;
 
         private:
-            static alpm_handle_t *s_alpmHandle;
-
-            static std::shared_ptr<Transaction> s_currentTransaction;
-            static Config s_config;
+            static std::mutex s_mutex;
+            // Never destroyed, so it outlives anything using it during exit.
+            static Handle *s_defaultHandle;
 
     };
 }  // namespace ALPM
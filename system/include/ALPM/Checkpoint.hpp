@@ -0,0 +1,103 @@
+#pragma once
+
+#include "Transaction.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ALPM {
+    // What an interrupted transaction had already done, so running it again
+    // can pick up where it stopped: the operations and database updates it
+    // was asked for, the phases it completed, the packages its plan needed
+    // and the cache files that passed verification.
+    //
+    // The checkpoint is a journal that every change is appended and flushed
+    // to right away, so nothing has to be written when the process is
+    // interrupted, or killed.
+    class Checkpoint {
+        public:
+            enum class Phase {
+                Databases,
+                Downloads
+            };
+
+            struct Target {
+                // Empty for removals, which always come from the local database.
+                std::string Database;
+                std::string Name;
+                Transaction::PackageOperation Operation{Transaction::PackageOperation::Install};
+            };
+
+            // Starts a new checkpoint, replacing any previous one. `databases`
+            // are the names of the sync databases the transaction updates.
+            static auto Begin(unsigned long flags, bool systemUpgrade, bool pipelined, const std::vector<Target> &targets, const std::vector<std::string> &databases) -> std::shared_ptr<Checkpoint>;
+
+            // Returns the checkpoint of an interrupted transaction, if there is
+            // one. Further changes are appended to it.
+            static auto Load() -> std::shared_ptr<Checkpoint>;
+
+            // Called once a transaction is committed, had nothing to do or failed
+            // for any reason but an interruption, or when it is given up on.
+            static auto Discard() -> void;
+
+            static auto GetPath() -> std::filesystem::path;
+
+            auto GetFlags() const -> unsigned long;
+            auto IsSystemUpgrade() const -> bool;
+            auto IsPipelined() const -> bool;
+            auto GetTargets() const -> const std::vector<Target>&;
+            auto GetDatabases() const -> const std::vector<std::string>&;
+
+            auto Complete(Phase phase) -> void;
+            auto IsComplete(Phase phase) const -> bool;
+
+            // Records the package files the resolved transaction needs. A plan
+            // that differs from the recorded one means the downloads have to be
+            // checked again.
+            auto SetPlan(const std::vector<std::string> &filenames) -> void;
+            auto GetPlan() const -> std::vector<std::string>;
+
+            // A verified file counts as verified until its size or modification
+            // time changes.
+            auto MarkVerified(const std::filesystem::path &file) -> void;
+            auto IsVerified(const std::filesystem::path &file) const -> bool;
+
+        private:
+            struct FileState {
+                std::uintmax_t Size{0};
+                int64_t ModificationTime{0};
+
+                auto operator==(const FileState &other) const -> bool = default;
+            };
+
+            static constexpr std::string_view HEADER = "system-checkpoint 2";
+
+            static auto GetFileState(const std::filesystem::path &file) -> std::optional<FileState>;
+
+            // Applies one journal line, returning false if it's malformed.
+            auto Replay(const std::string &line) -> bool;
+            auto Append(const std::string &line) -> void;
+
+            mutable std::mutex m_mutex;
+            std::ofstream m_journal;
+
+            unsigned long m_flags{0};
+            bool m_systemUpgrade{false};
+            bool m_pipelined{false};
+            std::vector<Target> m_targets;
+            std::vector<std::string> m_databases;
+
+            std::set<Phase> m_phases;
+            std::vector<std::string> m_plan;
+            std::map<std::string, FileState> m_verified;
+    };
+}  // namespace ALPM
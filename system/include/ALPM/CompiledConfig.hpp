@@ -0,0 +1,104 @@
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ALPM {
+    // A pacman.conf with its includes resolved, stored in a binary file that
+    // can be mapped and read in place. Server URLs have `$repo` and `$arch`
+    // substituted and SigLevels are parsed into libalpm's bits, so loading a
+    // compiled config doesn't parse any text.
+    //
+    // The mtime, size and inode of every file the config was read from are
+    // stored with it, and it's compiled again as soon as any of them change.
+    class CompiledConfig {
+            struct Private { inline explicit Private() {} };
+        public:
+            struct Header;
+
+            struct FileRecord {
+                uint32_t Path;
+                uint32_t Exists;
+                int64_t ModifiedTime;
+                int64_t Size;
+                uint64_t Inode;
+            };
+
+            struct OptionRecord {
+                uint32_t Key;
+                uint32_t Value;
+            };
+
+            struct RepositoryRecord {
+                uint32_t Name;
+                uint32_t SigLevel;
+                uint32_t FirstServer;
+                uint32_t ServerCount;
+            };
+
+            class Repository {
+                public:
+                    Repository(const CompiledConfig *config, const RepositoryRecord *record);
+
+                    auto GetName() const -> std::string_view;
+                    auto GetSigLevel() const -> std::bitset<32>;
+                    // In the order they appear in the config.
+                    auto GetServers() const -> std::vector<std::string>;
+
+                private:
+                    const CompiledConfig *m_config;
+                    const RepositoryRecord *m_record;
+            };
+
+            CompiledConfig(Private, void *mapping, std::size_t size);
+            CompiledConfig(Private, std::string buffer);
+            CompiledConfig(const CompiledConfig&) = delete;
+            auto operator=(const CompiledConfig&) -> CompiledConfig& = delete;
+            ~CompiledConfig();
+
+            // Opens the compiled form of `configFile` at `path`, compiling it
+            // again if that's missing or out of date.
+            static auto Load(const std::filesystem::path &configFile, const std::filesystem::path &path) -> std::shared_ptr<const CompiledConfig>;
+
+            // Parses `configFile` and writes the result to `path`. The file is
+            // written to a temporary path and renamed into place so readers never
+            // see a partially written config. Failing to write it isn't an error,
+            // the compiled config is still returned.
+            static auto Compile(const std::filesystem::path &configFile, const std::filesystem::path &path) -> std::shared_ptr<const CompiledConfig>;
+
+            // Maps the compiled config at `path`. Returns nullptr if it's missing,
+            // malformed, compiled from a different file or for a different
+            // architecture, or older than any of the files it was compiled from.
+            static auto Open(const std::filesystem::path &configFile, const std::filesystem::path &path) -> std::shared_ptr<const CompiledConfig>;
+
+            static auto GetDefaultPath(const std::filesystem::path &root) -> std::filesystem::path;
+
+            auto IsStale() const -> bool;
+
+            // The first value of `key` in the `[options]` section.
+            auto GetOption(std::string_view key) const -> std::optional<std::string_view>;
+            // Every value of `key` in the `[options]` section, in order.
+            auto GetOptions(std::string_view key) const -> std::vector<std::string_view>;
+            // Every section other than `[options]`, in the order they appear.
+            auto GetRepositories() const -> std::vector<Repository>;
+
+            auto GetString(uint32_t offset) const -> std::string_view;
+
+        private:
+            template <typename T>
+            auto GetColumn(std::size_t column) const -> const T*;
+
+            auto IsValid() const -> bool;
+
+            void *m_mapping{nullptr};
+            std::string m_buffer;
+            std::size_t m_size;
+            const Header *m_header;
+    };
+}  // namespace ALPM
@@ -1,11 +1,20 @@
 #pragma once
 
 #include <string>
-#include <map>
+#include <string_view>
+#include <charconv>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <span>
+#include <system_error>
+#include <unordered_map>
 #include <vector>
 #include <optional>
 #include <filesystem>
 #include <type_traits>
+#include <typeinfo>
 #include <utility>
 #include <bitset>
 
@@ -28,6 +37,10 @@ concept SequenceContainer = requires (T container, typename T::value_type value)
 
 
 namespace ALPM {
+    // A pacman.conf style ini file. Each file is read into one buffer that
+    // values point into, and keys and section names are interned, so parsing
+    // doesn't copy a single string. Sections keep the buffers their values
+    // point into alive, and can be passed around on their own.
     class Config {
         public:
             class Section {
@@ -35,57 +48,22 @@ namespace ALPM {
                 public:
                     class Value {
                         public:
-                            inline explicit Value(const std::string &value) : m_value(value) {}
-                            inline explicit Value(const Value &other) {
-                                m_value = other.m_value;
-                            }
-
-                            inline explicit Value(Value &&other) {
-                                m_value = std::exchange(other.m_value, "");
-                            }
-
-                            inline Value& operator=(const Value &other) {
-                                if (this == &other) {
-                                    return *this;
-                                }
-
-                                m_value = other.m_value;
-
-                                return *this;
-                            }
-
-                            inline Value& operator=(const std::string &value) {
-                                if (m_value == value) {
-                                    return *this;
-                                }
-
-                                m_value = value;
-
-                                return *this;
-                            }
-
-                            inline Value& operator=(Value &&other) {
-                                if (this == &other) {
-                                    return *this;
-                                }
-
-                                m_value = std::exchange(other.m_value, "");
+                            inline explicit Value(std::string_view value) : m_value(value) {}
 
-                                return *this;
-                            }
-
-                            inline Value& operator=(std::string&& value) {
-                                if (m_value == value) {
-                                    return *this;
-                                }
-
-                                m_value = std::exchange(value, "");
+                            inline Value& operator=(std::string value) {
+                                m_owned = std::make_shared<const std::string>(std::move(value));
+                                m_value = *m_owned;
 
                                 return *this;
                             }
 
                             template <typename T> requires std::is_same_v<T, std::string>
                             inline auto As() const -> std::string {
+                                return std::string(m_value);
+                            }
+
+                            template <typename T> requires std::is_same_v<T, std::string_view>
+                            inline auto As() const -> std::string_view {
                                 return m_value;
                             }
 
@@ -103,11 +81,8 @@ namespace ALPM {
                             template <typename T> requires SequenceContainer<T, std::string>
                             inline auto As() const -> T {
                                 T container{};
-                                std::stringstream ss(m_value);
-                                std::string word;
-
-                                while (ss >> word) {
-                                    container.push_back(word);
+                                for (std::string_view word : GetWords()) {
+                                    container.push_back(std::string(word));
                                 }
 
                                 return container;
@@ -116,129 +91,97 @@ namespace ALPM {
                             template <typename T> requires SequenceContainer<T, Value>
                             inline auto As() const -> T {
                                 T container{};
-                                std::stringstream ss(m_value);
-                                std::string word;
-                                while (ss >> word) {
-                                    container.push_back(Value(word));
+                                for (std::string_view word : GetWords()) {
+                                    Value value(word);
+                                    value.m_owned = m_owned;
+                                    container.push_back(std::move(value));
                                 }
+
+                                return container;
                             }
 
+                            // Parses a SigLevel the way pacman does, into the bits of
+                            // libalpm's `alpm_siglevel_t`. Like pacman, the words change
+                            // `base`, which is the `[options]` level for repositories.
                             template <typename T> requires std::is_same_v<T, Signature::Level>
-                            inline auto As() const -> std::bitset<32> {
-                                std::bitset<32> flags;
-                                std::stringstream ss;
-                                std::string word;
-                                while (ss >> word) {
-                                    if (word == "Never") {
-                                        flags.reset();
-                                    } else if (word == "Optional") {
-                                        flags.reset(std::to_underlying(Signature::Level::PackageRequires));
-                                        flags.reset(std::to_underlying(Signature::Level::DatabaseRequires));
-                                        flags.set(std::to_underlying(Signature::Level::PackageOptional));
-                                        flags.set(std::to_underlying(Signature::Level::DatabaseOptional));
-                                    } else if (word == "Required") {
-                                        flags.reset(std::to_underlying(Signature::Level::PackageOptional));
-                                        flags.reset(std::to_underlying(Signature::Level::DatabaseOptional));
-                                        flags.set(std::to_underlying(Signature::Level::PackageRequires));
-                                        flags.set(std::to_underlying(Signature::Level::DatabaseRequires));
-                                    } else if (word == "TrustedOnly") {
-                                        flags.reset(std::to_underlying(Signature::Level::PackageUnknownOk));
-                                        flags.reset(std::to_underlying(Signature::Level::PackageMarginalOk));
-                                        flags.reset(std::to_underlying(Signature::Level::DatabaseUnknownOk));
-                                        flags.reset(std::to_underlying(Signature::Level::DatabaseMarginalOk));
-                                    } else if (word == "TrustAll") {
-                                        flags.set(std::to_underlying(Signature::Level::PackageUnknownOk));
-                                        flags.set(std::to_underlying(Signature::Level::PackageMarginalOk));
-                                        flags.set(std::to_underlying(Signature::Level::DatabaseUnknownOk));
-                                        flags.set(std::to_underlying(Signature::Level::DatabaseMarginalOk));
-                                    } else if (word == "PackageNever") {
-                                        flags.reset(std::to_underlying(Signature::Level::PackageUnknownOk));
-                                        flags.reset(std::to_underlying(Signature::Level::PackageOptional));
-                                        flags.reset(std::to_underlying(Signature::Level::PackageUnknownOk));
-                                        flags.reset(std::to_underlying(Signature::Level::PackageMarginalOk));
-                                    } else if (word == "PackageOptional") {
-                                        flags.reset(std::to_underlying(Signature::Level::PackageRequires));
-                                        flags.set(std::to_underlying(Signature::Level::PackageOptional));
-                                    } else if (word == "PackageRequired") {
-                                        flags.reset(std::to_underlying(Signature::Level::PackageOptional));
-                                        flags.set(std::to_underlying(Signature::Level::PackageRequires));
-                                    } else if (word == "PackageTrustedOnly") {
-                                        flags.reset(std::to_underlying(Signature::Level::PackageUnknownOk));
-                                        flags.reset(std::to_underlying(Signature::Level::PackageMarginalOk));
-                                    } else if (word == "PackageTrustAll") {
-                                        flags.set(std::to_underlying(Signature::Level::PackageUnknownOk));
-                                        flags.set(std::to_underlying(Signature::Level::PackageMarginalOk));
-                                    } else if (word == "DatabaseNever") {
-                                        flags.reset(std::to_underlying(Signature::Level::DatabaseUnknownOk));
-                                        flags.reset(std::to_underlying(Signature::Level::DatabaseOptional));
-                                        flags.reset(std::to_underlying(Signature::Level::DatabaseUnknownOk));
-                                        flags.reset(std::to_underlying(Signature::Level::DatabaseMarginalOk));
-                                    } else if (word == "DatabaseOptional") {
-                                        flags.reset(std::to_underlying(Signature::Level::DatabaseRequires));
-                                        flags.set(std::to_underlying(Signature::Level::DatabaseOptional));
-                                    } else if (word == "DatabaseRequired") {
-                                        flags.reset(std::to_underlying(Signature::Level::DatabaseOptional));
-                                        flags.set(std::to_underlying(Signature::Level::DatabaseRequires));
-                                    } else if (word == "DatabaseTrustedOnly") {
-                                        flags.reset(std::to_underlying(Signature::Level::DatabaseUnknownOk));
-                                        flags.reset(std::to_underlying(Signature::Level::DatabaseMarginalOk));
-                                    } else if (word == "DatabaseTrustAll") {
-                                        flags.set(std::to_underlying(Signature::Level::DatabaseUnknownOk));
-                                        flags.set(std::to_underlying(Signature::Level::DatabaseMarginalOk));
-                                    } else {
-                                        throw std::runtime_error("Unknown configuration entry: " + word);
-                                    }
-                                }
-
-                                return flags;
+                            inline auto As(std::bitset<32> base = Signature::DEFAULT_LEVEL) const -> std::bitset<32> {
+                                return ParseSignatureLevel(m_value, base);
                             }
 
                         private:
-                            std::string m_value;
+                            // Words separated by spaces or tabs.
+                            auto GetWords() const -> std::vector<std::string_view>;
+
+                            static auto ParseSignatureLevel(std::string_view value, std::bitset<32> base) -> std::bitset<32>;
+
+                            // Only set for values assigned after parsing.
+                            std::shared_ptr<const std::string> m_owned;
+                            std::string_view m_value;
                     };
 
-                    Section(const std::string &name);
+                    explicit Section(std::string_view name);
 
-                    auto operator[](const std::string &option) const -> std::optional<const Value>;
-                    auto operator[](const std::string &option) -> Value&;
+                    auto operator[](std::string_view option) const -> const Value*;
+                    auto operator[](std::string_view option) -> Value&;
 
-                    auto GetName() const -> std::string;
+                    auto GetName() const -> std::string_view;
 
-                    auto GetOptions() const -> std::multimap<std::string, Value>;
-                    auto GetOptions() -> std::multimap<std::string, Value>&;
-                    auto GetOptions(const std::string &option) -> std::vector<std::reference_wrapper<Value>>;
-                    auto GetOptions(const std::string &option) const -> std::vector<Value>;
+                    // Every value of every option, by interned key.
+                    auto GetOptions() const -> const std::unordered_map<std::string_view, std::vector<Value>>&;
+                    // Every value of `option`, in the order they were read.
+                    auto GetOptions(std::string_view option) -> std::span<Value>;
+                    auto GetOptions(std::string_view option) const -> std::span<const Value>;
 
-                    // Use of these getters with a key that has multiple values can return
-                    // any of the values for the key. For a key that has multiple values, use
+                    // Use of these getters with a key that has multiple values returns
+                    // the first of them. For a key that has multiple values, use
                     // `GetOptions(key)`.
-                    auto GetOption(const std::string &option) const -> std::optional<const Value>;
-                    auto GetOption(const std::string &option) -> Value&;
+                    auto GetOption(std::string_view option) const -> const Value*;
+                    auto GetOption(std::string_view option) -> Value&;
 
-                    auto HasOption(const std::string &option) const -> bool;
+                    auto HasOption(std::string_view option) const -> bool;
 
                 private:
+                    auto AddOption(std::string_view key, std::string_view value, const std::shared_ptr<const std::string> &buffer) -> void;
 
-                    std::string m_name;
-                    std::multimap<std::string, Value> m_options;
+                    std::string_view m_name;
+                    std::unordered_map<std::string_view, std::vector<Value>> m_options;
+                    std::vector<std::shared_ptr<const std::string>> m_buffers;
             };
 
             explicit Config(const std::filesystem::path &configFile);
             explicit Config() = default;
 
-            auto operator[](const std::string &sectionName) const -> std::optional<const Section>;
-            auto operator[](const std::string &sectionName) -> Section;
+            auto operator[](std::string_view sectionName) const -> const Section*;
+            auto operator[](std::string_view sectionName) -> Section&;
 
-            auto LoadFile(const std::filesystem::path &configGFile) -> void;
+            auto LoadFile(const std::filesystem::path &configFile) -> void;
 
-            auto GetSections() const -> std::vector<Section>;
-            auto GetSections() -> std::vector<Section>&;
+            // In the order they appear in the file.
+            auto GetSections() const -> const std::vector<Section>&;
 
-            auto GetSection(const std::string &sectionName) const -> std::optional<const Section>;
-            auto GetSection(const std::string &sectionName) -> Section&;
+            // Returns the first section named `sectionName`.
+            auto GetSection(std::string_view sectionName) const -> const Section*;
+            auto GetSection(std::string_view sectionName) -> Section&;
+
+            // Returns a view of `name` that stays valid for the rest of the
+            // program, and is the same for equal names.
+            static auto Intern(std::string_view name) -> std::string_view;
+
+            // Every file the config was read from, including files named by an
+            // `Include` that didn't exist.
+            auto GetFiles() const -> const std::vector<std::filesystem::path>&;
 
         private:
+            auto Parse(const std::shared_ptr<const std::string> &buffer, std::optional<std::size_t> &current) -> void;
+            auto AddSection(std::string_view name) -> std::size_t;
+
+            static auto ReadFile(const std::filesystem::path &file) -> std::shared_ptr<const std::string>;
+
+            inline static std::mutex s_mutex{};
+            inline static std::set<std::string, std::less<>> s_names{};
 
             std::vector<Section> m_sections;
+            std::unordered_map<std::string_view, std::size_t> m_index;
+            std::vector<std::filesystem::path> m_files;
     };
 }
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+
+namespace ALPM {
+    class Package;
+
+    // A package cache shared by every root on the machine, keyed by the
+    // SHA-256 of each file instead of its name:
+    //     <directory>/blobs/<first two digits>/<sha256>
+    //     <directory>/verified/<sha256>       the blob passed verification
+    //     <directory>/refs/<revision>         the blobs a revision uses
+    //     <directory>/lock                    flocked while collecting
+    // Blobs are materialized into a root's own cache directory as hardlinks,
+    // or reflinks across subvolumes, so a package that was downloaded and
+    // verified once never has to be again.
+    class ContentCache {
+        public:
+            static constexpr std::string_view DEFAULT_DIRECTORY = "/var/cache/system";
+
+            explicit ContentCache(std::filesystem::path directory = DEFAULT_DIRECTORY);
+
+            auto Contains(const std::string &sha256) const -> bool;
+            auto GetBlobPath(const std::string &sha256) const -> std::filesystem::path;
+
+            // Adds a file to the cache unless a blob with its hash is already
+            // there. The file is hashed first, unless `verified` says the caller
+            // already checked it against `sha256`, which is then recorded.
+            auto Import(const std::filesystem::path &file, const std::string &sha256, bool verified = false) -> bool;
+            auto Import(const Package &package, const std::filesystem::path &file, bool verified = false) -> bool;
+
+            // Links the blob to `destination`, replacing whatever is there unless
+            // it already is the blob.
+            auto Materialize(const std::string &sha256, const std::filesystem::path &destination) const -> bool;
+
+            // Materializes a sync package into `directory` under its filename.
+            auto Materialize(const Package &package, const std::filesystem::path &directory) const -> bool;
+
+            auto IsVerified(const std::string &sha256) const -> bool;
+            auto MarkVerified(const std::string &sha256) -> void;
+
+            // Revisions keep the blobs they reference from being collected.
+            auto Reference(const std::string &revision, const std::string &sha256) -> void;
+            auto Release(const std::string &revision) -> void;
+            auto GetReferenceCount(const std::string &sha256) const -> std::size_t;
+
+            // Removes every blob no revision references, returning how many.
+            // The references are read again first, with every other process
+            // locked out of changing them until the blobs are removed.
+            auto Collect() -> std::size_t;
+
+        private:
+            static auto ReadReferences(const std::filesystem::path &directory) -> std::map<std::string, std::set<std::string>>;
+            static auto IsValidHash(std::string_view sha256) -> bool;
+            static auto IsValidRevision(std::string_view revision) -> bool;
+
+            // Hardlinks `source` to `destination`, falling back to a reflink and
+            // then to a copy when they're on different filesystems.
+            static auto Link(const std::filesystem::path &source, const std::filesystem::path &destination) -> bool;
+
+            std::filesystem::path m_directory;
+
+            mutable std::mutex m_mutex;
+            std::map<std::string, std::set<std::string>> m_references;
+    };
+}  // namespace ALPM
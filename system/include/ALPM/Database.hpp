@@ -6,14 +6,18 @@
 #include <bitset>
 
 #include "Signature.hpp"
+#include "Utils.hpp"
 
 struct _alpm_db_t;
 typedef struct _alpm_db_t alpm_db_t;
 
 namespace ALPM {
+    class Handle;
     class Package;
     class Database {
         public:
+            using UnderlyingType = alpm_db_t;
+
             explicit Database(alpm_db_t *db);
             ~Database() = default;
 
@@ -26,13 +30,17 @@ namespace ALPM {
             auto Search(const std::string &expression) const -> std::vector<Package>;
 
             auto GetPackageCache() const -> std::vector<Package>;
+            auto GetPackageCacheView() const -> Utils::ALPMListView<Package>;
 
             auto GetServers() const -> std::vector<std::string>;
+            auto GetServersView() const -> Utils::ALPMListView<std::string_view>;
             auto SetServers(const std::vector<std::string> &urls) -> bool;
             auto AddServer(const std::string &url) -> bool;
             auto RemoveServer(const std::string &url) -> int;
 
             auto GetHandle() const -> alpm_db_t*;
+            // The handle the database is registered with.
+            auto GetOwner() const -> Handle&;
 
             /* Transactional functions */
             auto MarkUpdate() const -> void;
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "Database.hpp"
+
+namespace ALPM {
+    // Refreshes a sync database by applying only the entries that changed,
+    // instead of downloading the whole `.db` again.
+    //
+    // A mirror that supports this publishes, next to `<repo>.db`:
+    //     <repo>.manifest            one `<name>-<version>` entry per line
+    //     <repo>.db.d/<entry>/desc   the desc file of every entry
+    // `Publish` generates both from a database file. The local database is
+    // diffed against the manifest, the desc files of new entries are fetched,
+    // and the local `.db` is rewritten without the removed ones.
+    class DeltaRefresh {
+        public:
+            // Above this fraction of new entries a full download is cheaper.
+            static constexpr double MAX_CHANGED_FRACTION = 0.5;
+
+            explicit DeltaRefresh(const Database &database);
+
+            // Returns false when the database has to be refreshed with a full
+            // download instead: the mirror has no manifest, there's no local
+            // database yet, too much changed, or the database requires a
+            // signature, which a rewritten file can't match.
+            auto Apply() -> bool;
+
+            auto GetAdded() const -> const std::vector<std::string>&;
+            auto GetRemoved() const -> const std::vector<std::string>&;
+
+            // Writes the manifest and entry tree for `database` into `directory`,
+            // which can then be served as (or next to) a mirror.
+            static auto Publish(const std::filesystem::path &database, const std::filesystem::path &directory) -> void;
+
+        private:
+            static auto ReadEntries(const std::filesystem::path &database) -> std::optional<std::set<std::string>>;
+            static auto IsValidEntry(const std::string &entry) -> bool;
+
+            auto ReadManifest(const std::filesystem::path &manifest) const -> std::optional<std::set<std::string>>;
+            auto Rewrite(const std::filesystem::path &entries, const std::filesystem::path &output) const -> bool;
+
+            Database m_database;
+            std::string m_name;
+            std::filesystem::path m_path;
+
+            std::vector<std::string> m_added;
+            std::vector<std::string> m_removed;
+    };
+}  // namespace ALPM
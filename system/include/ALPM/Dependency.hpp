@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <filesystem>
 #include <optional>
@@ -43,6 +44,27 @@ namespace ALPM {
             UnderlyingType *m_alpmDepend;
     };
 
+    // Non-owning, allocation free counterpart to `Dependency`. The returned
+    // strings point into libalpm's storage and are valid for as long as the
+    // package the dependency belongs to.
+    class DependencyView {
+        public:
+            using UnderlyingType = alpm_depend_t;
+
+            explicit DependencyView(alpm_depend_t *depend);
+
+            auto GetDescription() const -> std::string_view;
+            auto GetMatchMode() const -> Dependency::MatchMode;
+            auto GetName() const -> std::string_view;
+            auto GetNameHash() const -> unsigned long;
+            auto GetVersion() const -> std::string_view;
+
+            auto GetHandle() const -> UnderlyingType*;
+
+        private:
+            UnderlyingType *m_alpmDepend;
+    };
+
     class MissingDependency {
         public:
             using UnderlyingType = alpm_depmissing_t;
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Package.hpp"
+
+namespace ALPM {
+    class Database;
+
+    // Dependency edges between the packages of one or more databases, resolved
+    // once and stored in compressed (CSR) adjacency arrays. Every edge points at
+    // every package that satisfies the dependency, the same as
+    // `alpm_pkg_compute_requiredby`, so reverse edges answer "who needs X"
+    // without scanning the database again.
+    //
+    // Nodes only keep the package's name, version and install reason, so a
+    // graph stays usable after a transaction frees the packages it was built
+    // from.
+    class DependencyGraph {
+        public:
+            using Node = uint32_t;
+
+            enum class Direction {
+                Dependencies,
+                Dependents
+            };
+
+            explicit DependencyGraph(const std::vector<Database> &databases);
+
+            // Returns the graph of the current handle's local database. It is
+            // built the first time it's used and updated after every applied
+            // transaction.
+            static auto Get() -> std::shared_ptr<const DependencyGraph>;
+
+            static auto Local() -> DependencyGraph;
+            static auto Sync() -> DependencyGraph;
+
+            auto GetNodeCount() const -> std::size_t;
+            auto GetName(Node node) const -> std::string_view;
+            auto GetVersion(Node node) const -> std::string_view;
+            auto Find(std::string_view name) const -> std::optional<Node>;
+
+            auto GetDependencies(Node node) const -> std::span<const Node>;
+            auto GetDependents(Node node) const -> std::span<const Node>;
+            auto GetOptionalDependencies(Node node) const -> std::span<const Node>;
+            auto GetOptionalDependents(Node node) const -> std::span<const Node>;
+
+            // Packages installed as a dependency that nothing depends on anymore.
+            auto GetOrphans() const -> std::vector<Node>;
+
+            // Every package reachable from `node`, not including `node` itself,
+            // in breadth-first order.
+            auto GetClosure(Node node, Direction direction = Direction::Dependencies, bool optional = false) const -> std::vector<Node>;
+
+            // Re-reads the databases after a transaction, resolving dependencies
+            // again only for the packages that changed and the packages whose
+            // dependencies could have resolved to them.
+            auto Update(const std::vector<std::string> &removed, const std::vector<std::string> &added) -> void;
+
+        private:
+            // Adjacency in CSR form: the edges of node n are
+            // Edges[Offsets[n]] to Edges[Offsets[n + 1]].
+            struct Adjacency {
+                std::vector<uint32_t> Offsets;
+                std::vector<Node> Edges;
+
+                auto Get(Node node) const -> std::span<const Node>;
+            };
+
+            DependencyGraph() = default;
+
+            // Returns the packages of every node, only valid until the databases
+            // change.
+            auto Load() -> std::vector<alpm_pkg_t*>;
+            auto Resolve(std::span<alpm_pkg_t* const> packages, Node node, bool optional) -> std::vector<Node>;
+            auto Link() -> void;
+
+            static auto Invert(const Adjacency &adjacency, std::size_t nodeCount) -> Adjacency;
+
+            inline static std::mutex s_mutex{};
+            inline static std::map<uint64_t, std::shared_ptr<const DependencyGraph>> s_instances{};
+
+            std::vector<Database> m_databases;
+
+            std::vector<std::string> m_names;
+            std::vector<std::string> m_versions;
+            std::vector<bool> m_installedAsDependency;
+            std::unordered_map<std::string, Node> m_nameIndex;
+
+            // Keyed by the sdbm hash of every name and provided name.
+            std::unordered_map<unsigned long, std::vector<Node>> m_providers;
+
+            // Packages with at least one dependency nothing satisfies.
+            std::vector<Node> m_unresolved;
+            // Packages by the hash of every optional dependency nothing
+            // satisfies. Those don't make a package unresolved, it only has to
+            // be resolved again once something with that name shows up.
+            std::unordered_map<unsigned long, std::vector<Node>> m_missingOptional;
+
+            Adjacency m_dependencies;
+            Adjacency m_dependents;
+            Adjacency m_optionalDependencies;
+            Adjacency m_optionalDependents;
+    };
+}  // namespace ALPM
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace ALPM {
+    class Handle;
+    class MirrorRanking;
+    class Package;
+
+    // Downloads a batch of files concurrently. The largest files are started
+    // first so a big download never ends up alone at the end of the batch, no
+    // mirror serves more than a fixed number of files at once, and a failed
+    // download moves on to the next mirror of its database. Each file reports
+    // its progress through its own `Task`, and every transfer is recorded in
+    // the `MirrorRanking`.
+    //
+    // Anything libcurl can fetch works as a server, including file:// URLs.
+    class Downloader {
+        public:
+            static constexpr std::size_t DEFAULT_MIRROR_LIMIT = 2;
+
+            struct Job {
+                std::string Filename;
+                // Base URLs, tried in order. `Filename` is appended to each.
+                std::vector<std::string> Servers;
+                std::filesystem::path Directory;
+                off_t Size{0};
+                bool Optional{false};
+                // Small metadata files aren't worth a progress bar each.
+                bool ShowProgress{true};
+            };
+
+            struct Result {
+                std::string Filename;
+                std::filesystem::path Path;
+                std::string Server;
+                std::optional<std::string> Error;
+                bool Optional;
+            };
+
+            // A `parallelDownloads` of 0 uses the ParallelDownloads option from
+            // pacman.conf.
+            explicit Downloader(std::size_t parallelDownloads = 0, std::size_t mirrorLimit = DEFAULT_MIRROR_LIMIT);
+
+            static auto GetCacheDirectory() -> std::filesystem::path;
+
+            // `Task` and `Status` aren't thread safe. Anything updating progress
+            // while downloads may be running has to hold this.
+            static auto GetTaskMutex() -> std::mutex&;
+
+            // Called from the worker thread as soon as each file has either
+            // finished downloading or failed on every mirror.
+            auto SetCompletionCallback(std::function<void(const Result&)> callback) -> void;
+
+            // Once `stop` is requested, running transfers are aborted, keeping
+            // their partial files, and the rest fail as cancelled.
+            auto SetStopToken(std::stop_token stop) -> void;
+
+            auto Add(Job job) -> void;
+
+            // Queues a sync package, downloading it into the cache directory from
+            // the servers of its database.
+            auto Add(const Package &package) -> void;
+
+            // Downloads everything that was added and returns one result per job,
+            // largest first. Jobs are cleared afterwards.
+            auto Run() -> std::vector<Result>;
+
+        private:
+            struct State {
+                Job Entry;
+                std::size_t Server{0};
+                bool Active{false};
+                bool Done{false};
+            };
+
+            auto Transfer(const Job &job, const std::string &server) -> std::optional<std::string>;
+
+            std::size_t m_parallelDownloads;
+            std::size_t m_mirrorLimit;
+
+            std::function<void(const Result&)> m_completionCallback;
+            std::stop_token m_stopToken;
+            Handle *m_handle{nullptr};
+            std::shared_ptr<MirrorRanking> m_ranking;
+
+            std::vector<Job> m_jobs;
+    };
+}  // namespace ALPM
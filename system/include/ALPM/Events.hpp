@@ -1,7 +1,10 @@
 #pragma once
 
+#include <mutex>
+#include <optional>
 #include <string>
 
+#include "Event.hpp"
 #include "Package.hpp"
 #include "Transaction.hpp"
 #include "Dependency.hpp"
@@ -9,6 +12,7 @@
 struct test;
 
 namespace ALPM {
+    class Handle;
 
     /* ALPM Callbacks */
     struct DownloadEvent {
@@ -19,6 +23,7 @@ namespace ALPM {
             Completed
         };
 
+        // The `Handle` the download is for.
         void *Context;
         std::string Filename;
         DownloadType Type;
@@ -59,7 +64,46 @@ namespace ALPM {
     };
 
     struct HookRunEvent {
-        // TODO: alpm_hook_run_t
+        std::string Name;
+        std::string Description;
+        std::size_t Position;
+        std::size_t Total;
+    };
+
+    // Emitted after a transaction has been committed, with the names of the
+    // packages it installed or upgraded and the packages it removed.
+    struct TransactionCompletedEvent {
+        std::vector<std::string> Added;
+        std::vector<std::string> Removed;
+    };
+
+    // Emitted when a handle is destroyed, so caches kept per handle can drop
+    // what they kept for it.
+    struct HandleReleasedEvent {
+        uint64_t Handle;
+    };
+
+    // How far libalpm is through each step of a commit. `Package` is empty for
+    // steps that cover the whole transaction.
+    struct TransactionProgressEvent {
+        enum class ProgressType {
+            Install,
+            Upgrade,
+            Downgrade,
+            Reinstall,
+            Remove,
+            Conflicts,
+            DiskSpace,
+            Integrity,
+            Load,
+            Keyring
+        };
+
+        ProgressType Type;
+        std::string Package;
+        int Percent;
+        std::size_t Current;
+        std::size_t Total;
     };
 
     struct PackageRetrieveEvent {
@@ -117,6 +161,18 @@ namespace ALPM {
 
     class Events {
         public:
-            static auto RegisterEvents() -> void;
+            // Forwards the handle's libalpm callbacks to the C++ events, which are
+            // emitted with the handle bound to the thread.
+            static auto RegisterEvents(Handle &handle) -> void;
+
+            // Questions are asked on the terminal unless this is turned off, in
+            // which case libalpm's default answers are used unless another
+            // callback for `GenericQuestionEvent*` answers them, e.g. a service
+            // relaying them to its client.
+            static auto SetInteractive(bool interactive) -> void;
+
+        private:
+            inline static std::mutex s_mutex{};
+            inline static std::optional<Event::Event::CallbackId_t> s_consoleQuestions{};
     };
 }  // namespace ALPM
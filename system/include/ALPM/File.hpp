@@ -3,6 +3,7 @@
 #include <sys/types.h>
 
 #include <string>
+#include <string_view>
 
 struct _alpm_file_t;
 typedef _alpm_file_t alpm_file_t;
@@ -22,6 +23,24 @@ namespace ALPM {
             alpm_file_t *m_alpmFile;
     };
 
+    // Non-owning counterpart to `File`, valid for the lifetime of the package
+    // the file list belongs to.
+    class FileView {
+        public:
+            using UnderlyingType = alpm_file_t;
+
+            explicit FileView(alpm_file_t *file);
+
+            auto GetMode() const -> mode_t;
+            auto GetName() const -> std::string_view;
+            auto GetSize() const -> off_t;
+
+            auto GetHandle() const -> UnderlyingType*;
+
+        private:
+            alpm_file_t *m_alpmFile;
+    };
+
     class Backup {
         public:
 
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ALPM {
+    // A persisted, memory-mapped index from every file in the local database
+    // to the packages that own it. Paths are sorted and front coded in blocks
+    // of `BLOCK_SIZE`: the first path of a block is stored whole and every
+    // other one only stores what differs from the path before it. A lookup is
+    // a binary search over the blocks and a short scan through one of them,
+    // without libalpm reading a single file list.
+    //
+    // Directories are shared by many packages and never conflict, so only
+    // files are indexed.
+    class FileOwnershipIndex {
+            struct Private { inline explicit Private() {} };
+        public:
+            static constexpr std::size_t BLOCK_SIZE = 16;
+
+            struct Header;
+
+            struct Conflict {
+                std::string Path;
+                std::string Package;
+                // The installed package that owns the file, or the other package
+                // in the transaction. Empty when the file exists on disk without
+                // an owner.
+                std::string Owner;
+            };
+
+            FileOwnershipIndex(Private, void *mapping, std::size_t size);
+            FileOwnershipIndex(const FileOwnershipIndex&) = delete;
+            auto operator=(const FileOwnershipIndex&) -> FileOwnershipIndex& = delete;
+            ~FileOwnershipIndex();
+
+            // Returns the index of the current handle's local database, building
+            // it if it's missing or stale. It's kept up to date after every
+            // transaction, and rebuilt when anything else changed the local
+            // database since it was last returned.
+            static auto Get() -> std::shared_ptr<const FileOwnershipIndex>;
+
+            // Writes a fresh index of the local database to `path`.
+            static auto Build(const std::filesystem::path &path = GetDefaultPath()) -> bool;
+
+            // Maps the index at `path`. Returns nullptr if the index is missing,
+            // malformed or older than the local database. Every entry is checked
+            // once here, so lookups never read outside the mapping.
+            static auto Open(const std::filesystem::path &path = GetDefaultPath()) -> std::shared_ptr<const FileOwnershipIndex>;
+
+            static auto GetDefaultPath() -> std::filesystem::path;
+
+            // Writes a new index to `path` that only differs from this one in the
+            // files of `changed`, which are read again from the local database.
+            auto Update(const std::vector<std::string> &changed, const std::filesystem::path &path = GetDefaultPath()) const -> bool;
+
+            auto IsStale() const -> bool;
+
+            auto GetFileCount() const -> std::size_t;
+
+            // Accepts absolute paths and paths relative to the root.
+            auto FindOwners(std::string_view path) const -> std::vector<std::string_view>;
+
+            // Checks the files a transaction would install, by package name.
+            // Files owned by a package in `replaced`, which the transaction
+            // upgrades or removes, don't conflict.
+            auto FindConflicts(const std::map<std::string, std::vector<std::string>> &files, const std::set<std::string> &replaced) const -> std::vector<Conflict>;
+
+        private:
+            // Calls `callback` with every path and owner in order. The path is
+            // only valid during the call.
+            template <typename Callback>
+            auto ForEach(std::size_t block, Callback &&callback) const -> void;
+
+            auto IsValid() const -> bool;
+
+            auto GetBlockCount() const -> std::size_t;
+            auto GetOwner(uint32_t owner) const -> std::string_view;
+
+            inline static std::mutex s_mutex{};
+            inline static std::map<std::filesystem::path, std::shared_ptr<const FileOwnershipIndex>> s_instances{};
+
+            void *m_mapping;
+            std::size_t m_size;
+            const Header *m_header;
+    };
+}  // namespace ALPM
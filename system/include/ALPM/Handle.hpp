@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "CompiledConfig.hpp"
+#include "Config.hpp"
+#include "Database.hpp"
+#include "Event.hpp"
+
+struct _alpm_handle_t;
+typedef struct _alpm_handle_t alpm_handle_t;
+
+namespace ALPM {
+    class Transaction;
+
+    // Everything libalpm keeps for one root: the libalpm handle, the root's
+    // pacman.conf and sync databases, and the transaction being built for it.
+    // Handles for different roots are independent, so each can be worked on
+    // from its own thread.
+    //
+    // The static functions of `ALPM` work on the handle bound to the calling
+    // thread with a `Scope`, or on the default handle for `/` when none is.
+    // Packages, databases and transactions belong to the handle that was
+    // current when they were created and must not outlive it.
+    class Handle {
+        public:
+            // Binds a handle to the current thread for as long as it's alive.
+            // Scopes nest, restoring the previous handle when they end.
+            class Scope {
+                public:
+                    explicit Scope(Handle &handle);
+                    ~Scope();
+
+                    Scope(const Scope&) = delete;
+                    auto operator=(const Scope&) -> Scope& = delete;
+
+                private:
+                    Handle *m_previous;
+            };
+
+            // Loads `<root>/etc/pacman.conf`, compiling it if it changed since it
+            // was last compiled. Throws if libalpm can't be set up for `root`.
+            // Sync databases aren't registered until they're first needed.
+            explicit Handle(const std::filesystem::path &root);
+            ~Handle();
+
+            Handle(const Handle&) = delete;
+            auto operator=(const Handle&) -> Handle& = delete;
+
+            // The handle bound to the current thread, or nullptr.
+            static auto GetCurrent() -> Handle*;
+
+            // The handle wrapping a libalpm handle, e.g. the one a package or
+            // database came from, or nullptr.
+            static auto Find(alpm_handle_t *handle) -> Handle*;
+
+            // Unique for the life of the process, unlike the handle's address, so
+            // caches can be kept per handle.
+            auto GetId() const -> uint64_t;
+
+            auto GetRoot() const -> std::filesystem::path;
+            auto GetDatabasePath() const -> std::filesystem::path;
+            // Only parses pacman.conf the first time it's called.
+            auto GetConfig() const -> std::shared_ptr<const Config>;
+            auto GetCompiledConfig() const -> std::shared_ptr<const CompiledConfig>;
+
+            auto GetCurrentTransaction() -> std::shared_ptr<Transaction>;
+            auto SetCurrentTransaction(std::shared_ptr<Transaction> transaction) -> void;
+
+            auto GetError() const -> std::string;
+
+            auto GetLocalDatabase() const -> Database;
+            auto GetSyncDatabases() -> std::vector<Database>;
+            auto GetSyncDatabasesView() -> Utils::ALPMListView<Database>;
+
+            // Registers the sync databases from pacman.conf with libalpm unless
+            // they already are. Getting the sync databases does this, anything
+            // that makes libalpm use them on its own has to do it first.
+            auto RegisterSyncDatabases() -> void;
+
+            auto GetDatabaseGeneration() const -> uint64_t;
+            auto InvalidateDatabases() -> void;
+
+            auto GetHandle() const -> alpm_handle_t*;
+
+        private:
+            uint64_t m_id;
+            std::filesystem::path m_root;
+            alpm_handle_t *m_alpmHandle{nullptr};
+            std::shared_ptr<const CompiledConfig> m_compiledConfig;
+
+            mutable std::once_flag m_configOnce;
+            mutable std::shared_ptr<const Config> m_config;
+
+            // Creating the current transaction is serialized, reading it isn't so
+            // an interrupt never waits on the lock.
+            mutable std::mutex m_mutex;
+            std::atomic<std::shared_ptr<Transaction>> m_currentTransaction;
+            std::atomic<uint64_t> m_databaseGeneration{0};
+            std::once_flag m_syncDatabasesOnce;
+
+            Event::Event::CallbackId_t m_interruptCallback{};
+
+            inline static thread_local Handle *s_current{nullptr};
+
+            inline static std::atomic<uint64_t> s_lastId{0};
+
+            inline static std::mutex s_mutex{};
+            inline static std::map<alpm_handle_t*, Handle*> s_handles{};
+    };
+}  // namespace ALPM
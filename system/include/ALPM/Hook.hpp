@@ -0,0 +1,79 @@
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace ALPM {
+    // A libalpm hook, read from a .hook file in one of the hook directories.
+    // Deciding whether a transaction triggers it and running it works the same
+    // as in libalpm, so hooks can be run outside of a libalpm transaction.
+    class Hook {
+        public:
+            enum class When {
+                PreTransaction,
+                PostTransaction
+            };
+
+            enum class Operation {
+                Install,
+                Upgrade,
+                Remove
+            };
+
+            struct Trigger {
+                std::set<Operation> Operations;
+                // Targets are package names instead of paths.
+                bool Package{false};
+                // Globs, where a leading '!' excludes what an earlier glob matched.
+                std::vector<std::string> Targets;
+            };
+
+            // What a transaction did, by package name and by path relative to
+            // the root. Files carry the operation of the package they belong to.
+            struct Changes {
+                std::map<std::string, Operation> Packages;
+                std::map<std::string, Operation> Files;
+            };
+
+            // Returns nullopt if the file isn't a valid hook.
+            static auto FromFile(const std::filesystem::path &path) -> std::optional<Hook>;
+
+            // Every hook in libalpm's hook directories, sorted by name. A hook in a
+            // later directory replaces one with the same name in an earlier
+            // directory, and a hook linked to /dev/null is disabled.
+            static auto LoadAll() -> std::vector<Hook>;
+
+            auto GetName() const -> std::string;
+            auto GetDescription() const -> std::string;
+            auto GetWhen() const -> When;
+            auto GetExec() const -> std::vector<std::string>;
+            auto GetDepends() const -> std::vector<std::string>;
+            auto IsAbortOnFail() const -> bool;
+            auto NeedsTargets() const -> bool;
+
+            // Returns the matched targets if any trigger matches `changes`.
+            auto Match(const Changes &changes) const -> std::optional<std::set<std::string>>;
+
+            // Runs the hook inside the root, with the targets on its standard input
+            // if it needs them. Returns whether it exited successfully.
+            auto Run(const std::set<std::string> &targets) const -> bool;
+
+        private:
+            Hook() = default;
+
+            static auto MatchTargets(const std::vector<std::string> &patterns, const std::string &target) -> bool;
+
+            std::string m_name;
+            std::string m_description;
+            When m_when{When::PostTransaction};
+            std::vector<std::string> m_exec;
+            std::vector<std::string> m_depends;
+            std::vector<Trigger> m_triggers;
+            bool m_abortOnFail{false};
+            bool m_needsTargets{false};
+    };
+}  // namespace ALPM
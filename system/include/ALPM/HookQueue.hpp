@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Hook.hpp"
+
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace ALPM {
+    class Handle;
+
+    // Collects the post-transaction hooks that a series of transactions
+    // triggered, so a build that commits several transactions in a row runs
+    // each of them once at the end instead of after every commit.
+    //
+    // Transactions given a queue commit with `OperationFlags::NoHooks`. Their
+    // pre-transaction hooks can't wait, since they have to run while the old
+    // files are still there, and run right before each commit instead.
+    class HookQueue {
+        public:
+            // Remembers every post-transaction hook triggered by `changes`, along
+            // with its targets, which are merged with earlier ones. The hooks run
+            // on the root of the current handle.
+            auto Collect(const Hook::Changes &changes) -> void;
+
+            // Lets the hook run side by side with the other independent hooks
+            // next to it in name order.
+            auto MarkIndependent(const std::string &name) -> void;
+
+            // Runs the pre-transaction hooks triggered by `changes` right away.
+            // Returns the name of the first failed hook that aborts the
+            // transaction.
+            static auto RunPreTransaction(const Hook::Changes &changes) -> std::optional<std::string>;
+
+            // Runs every collected hook once and empties the queue, returning the
+            // names of the hooks that failed.
+            //
+            // Hooks run one after the other in name order, like libalpm runs
+            // them. Consecutive hooks marked independent run side by side.
+            auto Run() -> std::vector<std::string>;
+
+            auto GetPending() const -> std::vector<std::string>;
+            auto IsEmpty() const -> bool;
+
+        private:
+            struct Pending {
+                Hook Action;
+                std::set<std::string> Targets;
+            };
+
+            // Makes sure everything in the hook's `Depends` is installed. Reads
+            // the local database, so it must not run on two threads at once.
+            static auto CanRun(const Hook &hook) -> bool;
+
+            // Checks and announces the hook. Returns false if it can't run.
+            static auto Start(const Hook &hook) -> bool;
+            static auto Exec(const Hook &hook, const std::set<std::string> &targets) -> bool;
+            static auto RunHook(const Hook &hook, const std::set<std::string> &targets) -> bool;
+
+            mutable std::mutex m_mutex;
+            Handle *m_handle{nullptr};
+            std::map<std::string, Pending> m_pending;
+            std::set<std::string> m_independent;
+    };
+}  // namespace ALPM
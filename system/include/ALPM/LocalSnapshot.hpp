@@ -0,0 +1,93 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Package.hpp"
+
+namespace ALPM {
+    // An immutable copy of what's installed in a handle's local database:
+    // the name, version, install reason and size of every package. File lists
+    // are left out, since reading them means reading every package's `files`
+    // entry; `FileOwnershipIndex` has them.
+    // Everything is copied out of libalpm, so a snapshot can be read from any
+    // thread while a transaction commits and libalpm's own view of the
+    // database is changing underneath it.
+    //
+    // Transactions capture one when they start and another once they've
+    // committed, so `Get` always has something to return.
+    class LocalSnapshot {
+            struct Private { inline explicit Private() {} };
+        public:
+            struct Entry {
+                std::string_view Name;
+                std::string_view Version;
+                Package::Reason Reason;
+                off_t InstallSize;
+            };
+
+            explicit LocalSnapshot(Private);
+            LocalSnapshot(const LocalSnapshot&) = delete;
+            auto operator=(const LocalSnapshot&) -> LocalSnapshot& = delete;
+
+            // The latest snapshot of the current handle's local database. Only
+            // reads libalpm the first time, so it's safe to call during a commit
+            // once anything has been captured. A stale snapshot is read again
+            // from disk, unless a transaction holds the database lock.
+            static auto Get() -> std::shared_ptr<const LocalSnapshot>;
+
+            // Reads the current handle's local database again unless it hasn't
+            // changed since the last snapshot, and makes the result the one `Get`
+            // returns. libalpm must not be in the middle of a commit.
+            static auto Capture() -> std::shared_ptr<const LocalSnapshot>;
+
+            // Like `Capture`, but only reads the packages in `changed` again and
+            // carries every other entry over from the last snapshot.
+            static auto Update(const std::vector<std::string> &changed) -> std::shared_ptr<const LocalSnapshot>;
+
+            // Sorted by name.
+            auto GetEntries() const -> std::span<const Entry>;
+            auto Find(std::string_view name) const -> std::optional<Entry>;
+
+            auto GetPackageCount() const -> std::size_t;
+            auto GetCapturedAt() const -> std::chrono::system_clock::time_point;
+
+            // Whether the local database changed since the snapshot was taken.
+            auto IsStale() const -> bool;
+
+        private:
+            struct Record {
+                std::string Name;
+                std::string Version;
+                Package::Reason Reason;
+                off_t InstallSize;
+            };
+
+            static auto Read(alpm_pkg_t *pkg) -> Record;
+            static auto Load(const std::filesystem::path &description) -> std::optional<Record>;
+            static auto Refresh(const LocalSnapshot &previous) -> std::shared_ptr<const LocalSnapshot>;
+            static auto Build(std::vector<Record> records) -> std::shared_ptr<LocalSnapshot>;
+            static auto Publish(std::shared_ptr<LocalSnapshot> snapshot) -> std::shared_ptr<const LocalSnapshot>;
+
+            inline static std::mutex s_mutex{};
+            inline static std::map<uint64_t, std::shared_ptr<const LocalSnapshot>> s_instances{};
+
+            // Entries point into the strings, which never change once built.
+            std::string m_strings;
+            std::vector<Entry> m_entries;
+
+            std::chrono::system_clock::time_point m_capturedAt;
+            std::filesystem::path m_database;
+            int64_t m_modifiedTime{0};
+            uint64_t m_inode{0};
+    };
+}  // namespace ALPM
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ALPM {
+    // Where the time of a run went and how much it did, measured on the
+    // monotonic clock. Phases are recorded as spans, both from our own code
+    // and from libalpm's events during the commit, and the same phase can
+    // have overlapping spans when stages run side by side.
+    //
+    // Every run is appended to `GetDefaultPath()` as one JSON object per line,
+    // so runs can be compared across machines.
+    //
+    // Each handle measures its own run, so roots upgraded side by side don't
+    // mix their numbers. The static functions work on the run of the current
+    // handle, and `Scope` and `Run` keep the one that was current when they
+    // were created.
+    class Metrics {
+            struct State;
+
+        public:
+            using Clock = std::chrono::steady_clock;
+
+            enum class Phase {
+                Refresh,
+                Resolve,
+                Download,
+                Verify,
+                Decompress,
+                Extract,
+                Hooks
+            };
+
+            enum class Counter {
+                Databases,
+                Bytes,
+                Packages,
+                Files,
+                Hooks
+            };
+
+            struct Span {
+                Phase Kind;
+                Clock::time_point Start;
+                Clock::time_point End;
+            };
+
+            // Records a span from its construction until `End` is called or it's
+            // destroyed.
+            class Scope {
+                public:
+                    explicit Scope(Phase phase);
+                    Scope(const Scope&) = delete;
+                    auto operator=(const Scope&) -> Scope& = delete;
+                    ~Scope();
+
+                    auto End() -> void;
+
+                private:
+                    std::shared_ptr<State> m_state;
+                    Phase m_phase;
+                    Clock::time_point m_start;
+                    bool m_ended{false};
+            };
+
+            // Starts measuring a new run and writes it out once destroyed, along
+            // with whether it was left by an exception.
+            class Run {
+                public:
+                    explicit Run(std::filesystem::path path = GetDefaultPath());
+                    Run(const Run&) = delete;
+                    auto operator=(const Run&) -> Run& = delete;
+                    ~Run();
+
+                private:
+                    std::shared_ptr<State> m_state;
+                    std::filesystem::path m_path;
+                    int m_exceptions;
+            };
+
+            // For phases that are only known from a start and a done event. A
+            // phase that's begun again before it ended keeps its first start.
+            static auto Begin(Phase phase) -> void;
+            static auto End(Phase phase) -> void;
+
+            static auto Record(Phase phase, Clock::time_point start, Clock::time_point end) -> void;
+            static auto Add(Counter counter, uint64_t amount = 1) -> void;
+
+            // The time covered by the phase's spans, without counting overlapping
+            // spans twice.
+            static auto GetDuration(Phase phase) -> Clock::duration;
+            static auto GetCount(Counter counter) -> uint64_t;
+            static auto GetSpans() -> std::vector<Span>;
+            static auto GetElapsed() -> Clock::duration;
+
+            static auto Reset() -> void;
+
+            static auto ToJSON(bool succeeded = true) -> std::string;
+
+            // Appends the current run as a single line.
+            static auto Write(const std::filesystem::path &path = GetDefaultPath(), bool succeeded = true) -> bool;
+
+            static auto GetDefaultPath() -> std::filesystem::path;
+
+            static auto GetName(Phase phase) -> std::string_view;
+            static auto GetName(Counter counter) -> std::string_view;
+
+        private:
+            static constexpr std::size_t PHASE_COUNT = 7;
+            static constexpr std::size_t COUNTER_COUNT = 5;
+
+            struct State {
+                std::mutex Mutex;
+                Clock::time_point Start{Clock::now()};
+                std::chrono::system_clock::time_point Started{std::chrono::system_clock::now()};
+                std::vector<Span> Spans;
+                std::array<std::optional<Clock::time_point>, PHASE_COUNT> Open{};
+                std::array<uint64_t, COUNTER_COUNT> Counters{};
+            };
+
+            // The run of the current handle, created on first use.
+            static auto GetState() -> std::shared_ptr<State>;
+
+            static auto Record(State &state, Phase phase, Clock::time_point start, Clock::time_point end) -> void;
+            static auto Reset(State &state) -> void;
+            static auto Write(State &state, const std::filesystem::path &path, bool succeeded) -> bool;
+            static auto ToJSONLocked(const State &state, bool succeeded) -> std::string;
+            static auto GetDurationLocked(const State &state, Phase phase) -> Clock::duration;
+
+            // Keyed by `Handle::GetId()`.
+            inline static std::mutex s_mutex{};
+            inline static std::map<uint64_t, std::shared_ptr<State>> s_states{};
+    };
+}  // namespace ALPM
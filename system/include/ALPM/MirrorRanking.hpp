@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ALPM {
+    // How fast each mirror has been, from every transfer the `Downloader` makes
+    // and from small probe fetches: how long it takes to start sending, and
+    // how fast it sends once it has. Both are exponentially weighted averages,
+    // so a mirror that gets slow falls behind within a few transfers.
+    //
+    // A mirror that fails is demoted behind every other mirror for a while,
+    // twice as long each time it fails again, until it succeeds once more.
+    //
+    // Scores are kept per handle in `GetDefaultPath()`, and sync databases get
+    // their servers in ranked order when they're registered.
+    class MirrorRanking {
+        public:
+            struct Score {
+                // Seconds.
+                double TimeToFirstByte{0.0};
+                // Bytes per second, only measured on transfers big enough to tell.
+                double Throughput{0.0};
+                uint32_t Samples{0};
+                // Since the last success.
+                uint32_t Failures{0};
+                // Seconds since the epoch.
+                int64_t DemotedUntil{0};
+            };
+
+            static constexpr std::size_t PROBE_SIZE = 256 * 1024;
+
+            explicit MirrorRanking(std::filesystem::path path);
+
+            // The ranking of the current handle, loaded the first time.
+            static auto Get() -> std::shared_ptr<MirrorRanking>;
+
+            static auto GetDefaultPath() -> std::filesystem::path;
+
+            // Mirrors are told apart by scheme and host, so every repository on a
+            // mirror shares its score.
+            static auto GetMirror(std::string_view url) -> std::string;
+
+            auto Record(std::string_view server, std::chrono::duration<double> timeToFirstByte, uint64_t bytes, std::chrono::duration<double> transferTime) -> void;
+            auto RecordFailure(std::string_view server) -> void;
+
+            // Fetches the first `PROBE_SIZE` bytes of `filename` from every server
+            // at once and records how each of them did.
+            auto Probe(const std::vector<std::string> &servers, std::string_view filename) -> void;
+
+            // Healthy mirrors that have been measured come first, fastest first,
+            // then the ones that haven't been, then demoted ones. Servers keep
+            // their relative order otherwise.
+            auto Rank(std::vector<std::string> servers) const -> std::vector<std::string>;
+
+            auto GetScore(std::string_view server) const -> std::optional<Score>;
+            auto IsDemoted(std::string_view server) const -> bool;
+
+            // Writes the scores out if anything was recorded since they were read.
+            auto Save() -> bool;
+
+        private:
+            auto Load() -> void;
+
+            inline static std::mutex s_mutex{};
+            inline static std::map<uint64_t, std::shared_ptr<MirrorRanking>> s_instances{};
+
+            std::filesystem::path m_path;
+
+            mutable std::mutex m_mutex;
+            std::map<std::string, Score, std::less<>> m_scores;
+            bool m_changed{false};
+    };
+}  // namespace ALPM
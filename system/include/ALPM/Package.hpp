@@ -4,15 +4,21 @@
 #include <vector>
 #include <optional>
 #include <chrono>
+#include <string_view>
 
 #include "Dependency.hpp"
 #include "Database.hpp"
 #include "File.hpp"
+#include "Utils.hpp"
+#include "VersionKey.hpp"
 
 struct _alpm_pkg_t;
 typedef struct _alpm_pkg_t alpm_pkg_t;
 
 namespace ALPM {
+    class Handle;
+    class PackageView;
+
     class Package {
         public:
             using UnderlyingType = alpm_pkg_t;
@@ -35,6 +41,12 @@ namespace ALPM {
                 Signature
             };
 
+            // Orders by name first and version second, for deduplicating package
+            // sets. The comparison operators only compare versions.
+            struct NameVersionLess {
+                auto operator()(const Package &lhs, const Package &rhs) const -> bool;
+            };
+
             explicit Package(alpm_pkg_t *pkg, bool canFree = false);
             ~Package();
 
@@ -47,7 +59,13 @@ namespace ALPM {
             friend auto operator==(const Package &lhs, const Package &rhs) -> bool;
             friend auto operator!=(const Package &lhs, const Package &rhs) -> bool;
 
+            // Same order as `NameVersionLess`, but every version is parsed into a
+            // `VersionKey` once instead of on every comparison.
+            static auto SortByNameVersion(std::vector<Package> &packages) -> void;
+
             static auto FromFile(const std::filesystem::path &file, int verificationLevel) -> Package;
+
+            // Returns one path per package, in the order the packages were given.
             static auto Download(const std::vector<Package> &packages) -> std::vector<std::filesystem::path>;
             auto Download() const -> std::filesystem::path;
 
@@ -76,16 +94,21 @@ namespace ALPM {
             auto GetBuildDate() const -> std::chrono::system_clock::time_point;
 
             auto GetCheckDepends() const -> std::vector<Dependency>;
+            auto GetCheckDependsView() const -> Utils::ALPMListView<Dependency>;
 
             auto GetMakeDepends() const -> std::vector<Dependency>;
+            auto GetMakeDependsView() const -> Utils::ALPMListView<Dependency>;
 
             auto GetOptionalDepends() const -> std::vector<Dependency>;
+            auto GetOptionalDependsView() const -> Utils::ALPMListView<Dependency>;
 
             auto GetConflicts() const -> std::vector<Dependency>;
+            auto GetConflictsView() const -> Utils::ALPMListView<Dependency>;
 
             auto GetDatabase() const -> std::optional<Database>;
 
             auto GetDepends() const -> std::vector<Dependency>;
+            auto GetDependsView() const -> Utils::ALPMListView<Dependency>;
 
             auto GetDescription() const -> std::string;
 
@@ -94,12 +117,14 @@ namespace ALPM {
             auto GetFiles() const -> std::vector<File>;
 
             auto GetGroups() const -> std::vector<std::string>;
+            auto GetGroupsView() const -> Utils::ALPMListView<std::string_view>;
 
             auto GetInstallDate() const -> std::chrono::system_clock::time_point;
 
             auto GetInstallSize() const -> off_t;
 
             auto GetLicenses() const -> std::vector<std::string>;
+            auto GetLicensesView() const -> Utils::ALPMListView<std::string_view>;
 
             auto GetName() const -> std::string;
 
@@ -108,10 +133,12 @@ namespace ALPM {
             auto GetPackager() const -> std::string;
 
             auto GetProvides() const -> std::vector<Dependency>;
+            auto GetProvidesView() const -> Utils::ALPMListView<Dependency>;
 
             auto GetReason() const -> Reason;
 
             auto GetReplaces() const -> std::vector<Dependency>;
+            auto GetReplacesView() const -> Utils::ALPMListView<Dependency>;
 
             auto GetURL() const -> std::string;
 
@@ -119,6 +146,10 @@ namespace ALPM {
 
             auto GetVersion() const -> std::string;
 
+            // Parses the version every time, keep the key when comparing the same
+            // package more than once.
+            auto GetVersionKey() const -> VersionKey;
+
             auto HasScriptlet() const -> bool;
 
             auto SetReason(Reason reason) -> void;
@@ -127,6 +158,9 @@ namespace ALPM {
 
 
             auto GetHandle() const -> alpm_pkg_t*;
+            // The handle the package was loaded with.
+            auto GetOwner() const -> Handle&;
+            auto GetView() const -> PackageView;
 
             /* Transactional functions */
             auto MarkInstall() const -> void;
@@ -138,4 +172,56 @@ namespace ALPM {
 
             alpm_pkg_t *m_alpmPkg;
     };
+
+    // Non-owning, allocation free accessors for scanning package caches. Every
+    // string, list and file returned points into libalpm's storage, which stays
+    // valid for as long as the database the package came from is registered.
+    // Use `Package` when the data has to outlive that.
+    class PackageView {
+        public:
+            using UnderlyingType = alpm_pkg_t;
+
+            explicit PackageView(alpm_pkg_t *pkg);
+
+            auto GetArch() const -> std::string_view;
+            auto GetBaseName() const -> std::string_view;
+            auto GetBase64Signature() const -> std::string_view;
+            auto GetDescription() const -> std::string_view;
+            auto GetFilename() const -> std::string_view;
+            auto GetMD5Sum() const -> std::string_view;
+            auto GetName() const -> std::string_view;
+            auto GetPackager() const -> std::string_view;
+            auto GetSHA256Sum() const -> std::string_view;
+            auto GetURL() const -> std::string_view;
+            auto GetVersion() const -> std::string_view;
+
+            auto GetBuildDate() const -> std::chrono::system_clock::time_point;
+            auto GetInstallDate() const -> std::chrono::system_clock::time_point;
+
+            auto GetDownloadSize() const -> off_t;
+            auto GetInstallSize() const -> off_t;
+            auto GetSize() const -> off_t;
+
+            auto GetCheckDepends() const -> Utils::ALPMListView<DependencyView>;
+            auto GetConflicts() const -> Utils::ALPMListView<DependencyView>;
+            auto GetDepends() const -> Utils::ALPMListView<DependencyView>;
+            auto GetMakeDepends() const -> Utils::ALPMListView<DependencyView>;
+            auto GetOptionalDepends() const -> Utils::ALPMListView<DependencyView>;
+            auto GetProvides() const -> Utils::ALPMListView<DependencyView>;
+            auto GetReplaces() const -> Utils::ALPMListView<DependencyView>;
+
+            auto GetGroups() const -> Utils::ALPMListView<std::string_view>;
+            auto GetLicenses() const -> Utils::ALPMListView<std::string_view>;
+
+            auto GetFiles() const -> Utils::ALPMArrayView<FileView, alpm_file_t>;
+
+            auto GetOrigin() const -> Package::From;
+            auto GetReason() const -> Package::Reason;
+
+            auto GetHandle() const -> alpm_pkg_t*;
+            auto ToPackage() const -> Package;
+
+        private:
+            alpm_pkg_t *m_alpmPkg;
+    };
 }
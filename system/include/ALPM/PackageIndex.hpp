@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Package.hpp"
+
+namespace ALPM {
+    class Database;
+
+    // Open-addressing hash map from package names and provided names to the
+    // sync packages that satisfy them, in repository priority order. Keys are
+    // hashed with the same sdbm hash libalpm stores in `alpm_depend_t`, so
+    // provides are indexed with `Dependency::GetNameHash` without rehashing.
+    class PackageIndex {
+        public:
+            explicit PackageIndex(const std::vector<Database> &databases, uint64_t generation = 0);
+
+            // Returns the index for the current handle's sync databases,
+            // rebuilding it the first time it's used after the databases change.
+            static auto Get() -> std::shared_ptr<const PackageIndex>;
+
+            static auto Hash(std::string_view name) -> unsigned long;
+
+            // Every package named `name` or providing `name`, in the order they
+            // were found in the repositories.
+            auto Find(std::string_view name) const -> std::span<const PackageView>;
+
+            // Resolves a name the same way libalpm does: a package with that
+            // exact name in any repository wins over a provider, and earlier
+            // repositories win over later ones.
+            auto Resolve(std::string_view name) const -> std::optional<Package>;
+            auto Resolve(const std::vector<std::string> &names) const -> std::vector<std::optional<Package>>;
+
+            auto GetGeneration() const -> uint64_t;
+
+        private:
+            struct Slot {
+                unsigned long Hash{0};
+                std::string_view Name{};
+                uint32_t First{0};
+                uint32_t Count{0};
+            };
+
+            auto FindSlot(unsigned long hash, std::string_view name) const -> std::size_t;
+
+            inline static std::mutex s_mutex{};
+            inline static std::map<uint64_t, std::shared_ptr<const PackageIndex>> s_instances{};
+
+            std::vector<Slot> m_slots;
+            std::vector<PackageView> m_candidates;
+            uint64_t m_generation;
+    };
+}  // namespace ALPM
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Checkpoint.hpp"
+#include "ContentCache.hpp"
+#include "Package.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+namespace ALPM {
+    class Handle;
+
+    // Gets the packages of a transaction ready for the libalpm commit. Instead
+    // of downloading everything, then verifying everything, each package goes
+    // through the stages on its own: it's verified as soon as its download
+    // finishes and decompressed once verification passes.
+    //
+    // libalpm can't be handed the decompressed files, and it checks every
+    // package again during the commit. The decompress stage makes sure the
+    // whole archive can be read before the commit starts changing the system,
+    // and by then every file is in the cache and in memory.
+    class Pipeline {
+        public:
+            enum class Stage {
+                Fetch,
+                Verify,
+                Decompress
+            };
+
+            struct StageTiming {
+                std::chrono::steady_clock::time_point Start;
+                std::chrono::steady_clock::time_point End;
+                // Summed over every package, so it can exceed `End - Start`.
+                std::chrono::steady_clock::duration Busy{};
+                std::size_t Count{0};
+            };
+
+            struct Failure {
+                std::string Filename;
+                std::string Error;
+            };
+
+            // At most `verifyLimit` packages are waiting for or going through
+            // verification at once, and finished downloads wait for a free slot.
+            // 0 uses the size of the shared thread pool.
+            explicit Pipeline(std::size_t verifyLimit = 0);
+
+            // Files the checkpoint has already seen verified skip verification,
+            // and newly verified files are recorded in it.
+            auto SetCheckpoint(std::shared_ptr<Checkpoint> checkpoint) -> void;
+
+            // Packages in the shared cache are linked into the cache directory
+            // instead of downloaded, and verified blobs aren't verified again.
+            // Packages verified here are added to it.
+            auto SetContentCache(std::shared_ptr<ContentCache> cache) -> void;
+
+            // Once `stop` is requested, downloads are aborted and packages that
+            // haven't started verifying fail as cancelled.
+            auto SetStopToken(std::stop_token stop) -> void;
+
+            // Downloads the sync packages that aren't in the cache yet and runs
+            // every package through the later stages. Returns the packages that
+            // didn't make it.
+            auto Run(const std::vector<Package> &packages) -> std::vector<Failure>;
+
+            auto GetTiming(Stage stage) const -> StageTiming;
+            auto GetElapsed() const -> std::chrono::steady_clock::duration;
+
+            // How much of the stages' combined time was spent running at the same
+            // time as another stage.
+            auto GetOverlap() const -> std::chrono::steady_clock::duration;
+
+            // The files in each decompressed package, by package name, relative
+            // to the root like libalpm's file lists.
+            auto GetFiles() const -> std::map<std::string, std::vector<std::string>>;
+
+        private:
+            static auto GetTaskName(Stage stage) -> std::string;
+
+            static auto Verify(const Package &package, const std::filesystem::path &path) -> std::optional<std::string>;
+            static auto Decompress(const std::filesystem::path &path, std::vector<std::string> &files) -> std::optional<std::string>;
+
+            // Makes sure a detached signature sits next to the package, from the
+            // database if it has one and from the mirror otherwise.
+            static auto FetchSignature(const Package &package, const std::filesystem::path &path) -> bool;
+
+            auto Record(Stage stage, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end, std::size_t total) -> void;
+
+            std::size_t m_verifyLimit;
+            Handle *m_handle{nullptr};
+            std::shared_ptr<Checkpoint> m_checkpoint;
+            std::shared_ptr<ContentCache> m_contentCache;
+            std::stop_token m_stopToken;
+
+            mutable std::mutex m_mutex;
+            std::array<StageTiming, 3> m_timings{};
+            std::chrono::steady_clock::duration m_elapsed{};
+            std::map<std::string, std::vector<std::string>> m_files;
+    };
+}  // namespace ALPM
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <bitset>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "Package.hpp"
+#include "SyncIndex.hpp"
+
+namespace ALPM {
+    // Searches the package caches of every registered sync database at once.
+    // Terms are compiled into matchers a single time, each database is split
+    // into chunks that are matched on the shared thread pool, and the results
+    // are deduplicated by package name in repository order.
+    //
+    // Packages are read from the `SyncIndex` when the fields being searched are
+    // in it, so searching doesn't load libalpm's package caches at all.
+    class SearchEngine {
+        public:
+            enum class Field {
+                Name,
+                Description,
+                Provides,
+                Groups
+            };
+
+            // Points into the engine's index or libalpm's package caches, so it's
+            // only valid while the engine is.
+            struct Result {
+                std::string_view Name;
+                std::string_view Version;
+                std::string_view Description;
+                std::string_view Database;
+                std::size_t DatabaseIndex;
+                int Score;
+            };
+
+            // Like pacman, every term has to match for a package to be a result.
+            explicit SearchEngine(const std::vector<std::string> &terms);
+
+            template <typename ...Args>
+            inline auto SetFields(Field field, Args... fields) -> void {
+                m_fields.reset();
+                m_fields.set(static_cast<std::size_t>(field));
+                (m_fields.set(static_cast<std::size_t>(fields)), ...);
+            }
+
+            // Returns the best `limit` results ordered by score, or every result
+            // when `limit` is 0.
+            auto Search(std::size_t limit = 0) const -> std::vector<Result>;
+
+            // Streams results in repository order as soon as each chunk of the
+            // package caches has been matched. The callback is always invoked on
+            // the calling thread.
+            auto Search(const std::function<void(const Result&)> &callback) const -> void;
+
+        private:
+            struct Matcher {
+                std::string Term;
+                std::optional<std::regex> Expression;
+
+                auto Matches(std::string_view text) const -> bool;
+            };
+
+            // Either a run of rows in the index or packages from libalpm's caches.
+            struct Chunk {
+                std::size_t DatabaseIndex;
+                std::string_view Database;
+                std::vector<alpm_pkg_t*> Packages;
+                uint32_t FirstRow{0};
+                uint32_t RowCount{0};
+            };
+
+            auto UsesIndex() const -> bool;
+            auto CollectChunks() const -> std::vector<Chunk>;
+            auto CollectIndexChunks() const -> std::vector<Chunk>;
+            auto MatchChunk(const Chunk &chunk) const -> std::vector<Result>;
+
+            template <typename T>
+            auto Score(const T &package) const -> std::optional<int>;
+
+            std::vector<Matcher> m_matchers;
+            std::bitset<4> m_fields;
+            std::shared_ptr<const SyncIndex> m_index;
+    };
+}  // namespace ALPM
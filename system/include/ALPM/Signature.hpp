@@ -1,11 +1,22 @@
 #pragma once
 
+#include <bitset>
 #include <chrono>
-#include <string>
+#include <cstdint>
 #include <expected>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
 
 struct _alpm_pgpkey_t;
 typedef _alpm_pgpkey_t alpm_pgpkey_t;
+struct _alpm_siglist_t;
+typedef _alpm_siglist_t alpm_siglist_t;
 
 namespace ALPM {
     class Package;
@@ -28,15 +39,9 @@ namespace ALPM {
                 Unknown
             };
 
-            PGPKey(alpm_pgpkey_t key, Status status, Validity validity);
-
-            PGPKey(const PGPKey &other);
-            PGPKey(PGPKey &&other);
-
-            auto operator=(const PGPKey &other) -> PGPKey&;
-            auto operator=(PGPKey &&other) -> PGPKey&;
-
-            ~PGPKey();
+            // Keys share ownership of the signature list they came from, which
+            // owns the strings and key data they point to.
+            PGPKey(std::shared_ptr<alpm_siglist_t> siglist, std::size_t index, Status status, Validity validity);
 
             auto GetCreatedTime() const -> std::chrono::system_clock::time_point;
             auto GetData() const -> void*;
@@ -52,7 +57,8 @@ namespace ALPM {
             auto GetValidity() const -> Validity;
 
         private:
-            std::unique_ptr<alpm_pgpkey_t> m_alpmPGPKey;
+            std::shared_ptr<alpm_siglist_t> m_siglist;
+            const alpm_pgpkey_t *m_alpmPGPKey;
 
             Status m_status = Status::KeyUnknown;
             Validity m_validity = Validity::Unknown;
@@ -60,24 +66,48 @@ namespace ALPM {
 
     class Signature {
         public:
-            // Can be safely casted to libalpm type, has same values
+            // The bit each flag of libalpm's `alpm_siglevel_t` is in, so a
+            // bitset of them can be casted to it.
             enum class Level {
-                PackageRequires = 1,
-                PackageOptional = 2,
-                PackageMarginalOk = 3,
-                PackageUnknownOk = 4,
-                DatabaseRequires = 11,
-                DatabaseOptional = 12,
-                DatabaseMarginalOk = 13,
-                DatabaseUnknownOk = 14,
-                UseDefault = 31
+                PackageRequires = 0,
+                PackageOptional = 1,
+                PackageMarginalOk = 2,
+                PackageUnknownOk = 3,
+                DatabaseRequires = 10,
+                DatabaseOptional = 11,
+                DatabaseMarginalOk = 12,
+                DatabaseUnknownOk = 13,
+                UseDefault = 30
             };
 
+            // What pacman checks when pacman.conf sets no SigLevel: signatures of
+            // both packages and databases, if they have one.
+            static constexpr std::bitset<32> DEFAULT_LEVEL{
+                (1ul << std::to_underlying(Level::PackageRequires)) | (1ul << std::to_underlying(Level::PackageOptional))
+                | (1ul << std::to_underlying(Level::DatabaseRequires)) | (1ul << std::to_underlying(Level::DatabaseOptional))
+            };
+
+            using Result = std::expected<std::vector<PGPKey>, std::pair<std::string, int>>;
+
             friend auto operator|(const Level &lhs, const Level &rhs) -> Level;
 
-            static auto CheckSignature(const Package &package) -> std::expected<std::vector<PGPKey>, std::pair<std::string, int>>;
-            static auto CheckSignature(const Database &database) -> std::expected<std::vector<PGPKey>, std::pair<std::string, int>>;
+            static auto CheckSignature(const Package &package) -> Result;
+            static auto CheckSignature(const Database &database) -> Result;
+
+            // Checks the detached signature of a package file, with the keyring
+            // of the current handle. The pipeline's verify stage calls it from
+            // several pool threads at once.
+            static auto CheckSignature(const std::filesystem::path &file) -> Result;
 
         private:
+            static auto ToKeys(std::shared_ptr<alpm_siglist_t> siglist) -> std::vector<PGPKey>;
+
+            static auto Verify(const std::filesystem::path &file) -> Result;
+
+            // libalpm sets up gpgme during the first verification on a handle,
+            // which isn't safe to race, so that one always runs alone. Keyed by
+            // `Handle::GetId()`.
+            inline static std::mutex s_mutex{};
+            inline static std::map<uint64_t, std::once_flag> s_primed{};
     };
 }  // namespace ALPM
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <string_view>
+#include <vector>
+
+#include "Dependency.hpp"
+
+namespace ALPM {
+    class Database;
+
+    // A persisted, memory-mapped columnar index over the package caches of
+    // every registered sync database. Rows are stored in repository order,
+    // every column is a fixed-width array and all strings are interned into
+    // a single arena, so scanning the index never walks an `alpm_list_t` or
+    // allocates.
+    class SyncIndex {
+            struct Private { inline explicit Private() {} };
+        public:
+            struct Header;
+
+            struct DatabaseRecord {
+                uint32_t Name;
+                uint32_t Path;
+                int64_t ModifiedTime;
+                int64_t Size;
+                uint64_t Inode;
+            };
+
+            struct DependencyRecord {
+                uint32_t Name;
+                uint32_t Version;
+                uint32_t Mode;
+                uint32_t Reserved;
+                uint64_t NameHash;
+            };
+
+            class DependencyEntry {
+                public:
+                    DependencyEntry(const SyncIndex *index, const DependencyRecord *record);
+
+                    auto GetName() const -> std::string_view;
+                    auto GetVersion() const -> std::string_view;
+                    auto GetMatchMode() const -> Dependency::MatchMode;
+                    auto GetNameHash() const -> unsigned long;
+
+                private:
+                    const SyncIndex *m_index;
+                    const DependencyRecord *m_record;
+            };
+
+            class DependencyRange : public std::ranges::view_interface<DependencyRange> {
+                public:
+                    class Iterator {
+                        public:
+                            using value_type = DependencyEntry;
+                            using difference_type = std::ptrdiff_t;
+
+                            Iterator() = default;
+                            inline Iterator(const SyncIndex *index, const DependencyRecord *record) : m_index(index), m_record(record) {}
+
+                            inline auto operator*() const -> DependencyEntry { return DependencyEntry(m_index, m_record); }
+                            inline auto operator++() -> Iterator& { m_record++; return *this; }
+                            inline auto operator++(int) -> Iterator { Iterator it = *this; m_record++; return it; }
+                            inline auto operator==(const Iterator &other) const -> bool { return m_record == other.m_record; }
+
+                        private:
+                            const SyncIndex *m_index{nullptr};
+                            const DependencyRecord *m_record{nullptr};
+                    };
+
+                    DependencyRange() = default;
+                    inline DependencyRange(const SyncIndex *index, const DependencyRecord *begin, const DependencyRecord *end) : m_begin(index, begin), m_end(index, end) {}
+
+                    inline auto begin() const -> Iterator { return m_begin; }
+                    inline auto end() const -> Iterator { return m_end; }
+
+                private:
+                    Iterator m_begin;
+                    Iterator m_end;
+            };
+
+            class Entry {
+                public:
+                    Entry(const SyncIndex *index, uint32_t row);
+
+                    auto GetName() const -> std::string_view;
+                    auto GetVersion() const -> std::string_view;
+                    auto GetDescription() const -> std::string_view;
+                    auto GetFilename() const -> std::string_view;
+                    auto GetDatabaseName() const -> std::string_view;
+                    auto GetSize() const -> off_t;
+                    auto GetInstallSize() const -> off_t;
+                    auto GetDepends() const -> DependencyRange;
+                    auto GetProvides() const -> DependencyRange;
+
+                    // Where the package's database is in `GetDatabaseNames()`.
+                    auto GetDatabaseIndex() const -> uint32_t;
+                    auto GetRow() const -> uint32_t;
+
+                private:
+                    const SyncIndex *m_index;
+                    uint32_t m_row;
+            };
+
+            SyncIndex(Private, void *mapping, std::size_t size);
+            SyncIndex(const SyncIndex&) = delete;
+            auto operator=(const SyncIndex&) -> SyncIndex& = delete;
+            ~SyncIndex();
+
+            // Writes a fresh index for `databases` to `path`. The file is written
+            // to a temporary path and renamed into place so readers never see a
+            // partially written index.
+            static auto Build(const std::vector<Database> &databases, const std::filesystem::path &path = GetDefaultPath()) -> bool;
+
+            // Maps the index at `path`. Returns nullptr if the index is missing,
+            // malformed or older than any of the database files it was built from.
+            static auto Open(const std::filesystem::path &path = GetDefaultPath()) -> std::shared_ptr<const SyncIndex>;
+
+            // The index of the current handle's sync databases, built again first
+            // if it's missing or out of date. Returns nullptr if it can't be built,
+            // usually because a database hasn't been downloaded yet.
+            static auto Get() -> std::shared_ptr<const SyncIndex>;
+
+            static auto GetDefaultPath() -> std::filesystem::path;
+
+            auto IsStale() const -> bool;
+
+            auto GetPackageCount() const -> std::size_t;
+            auto GetPackage(std::size_t row) const -> Entry;
+            auto FindPackage(std::string_view name) const -> std::optional<Entry>;
+            auto GetDatabaseNames() const -> std::vector<std::string_view>;
+
+            auto GetString(uint32_t offset) const -> std::string_view;
+
+        private:
+            template <typename T>
+            auto GetColumn(std::size_t column) const -> const T*;
+
+            auto IsValid() const -> bool;
+
+            void *m_mapping;
+            std::size_t m_size;
+            const Header *m_header;
+    };
+}  // namespace ALPM
@@ -2,13 +2,28 @@
 
 #include "Package.hpp"
 #include "Database.hpp"
+#include "Dependency.hpp"
 
 #include <vector>
 #include <bitset>
 #include <queue>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+
+#include <sys/types.h>
 
 namespace ALPM {
-    class Transaction {
+    class Checkpoint;
+    class ContentCache;
+    class Handle;
+    class HookQueue;
+
+    class Transaction : public std::enable_shared_from_this<Transaction> {
             struct Private {inline explicit Private() {}};
         public:
             enum class PackageOperation {
@@ -43,11 +58,88 @@ namespace ALPM {
                 NoLock = 17,
 
                 /* Wrapper flags */
-                ForceDatabase
+                ForceDatabase,
+                // Refresh databases from their mirror's manifest when possible, see `DeltaRefresh`.
+                DeltaDatabase
+            };
+
+            enum class ExecutionMode {
+                // libalpm downloads, verifies and installs every package in turn.
+                Serial,
+                // Packages are downloaded, verified and decompressed in an
+                // overlapping `Pipeline` before libalpm commits them.
+                Pipelined
+            };
+
+            struct MountUsage {
+                std::filesystem::path MountPoint;
+                // Net bytes the transaction needs, negative when it frees space.
+                off_t Required{0};
+                off_t Available{0};
+            };
+
+            // What applying the transaction would do, worked out by libalpm
+            // without downloading or changing anything.
+            struct ExecutionPlan {
+                std::vector<Package> Additions;
+                std::vector<Package> Removals;
+                off_t DownloadSize{0};
+                std::vector<MountUsage> Mounts;
+
+                // Set when libalpm couldn't resolve the transaction.
+                std::optional<std::string> Error;
+                std::vector<MissingDependency> MissingDependencies;
+                std::vector<Conflict> Conflicts;
+
+                // Owns the libalpm data `MissingDependencies` and `Conflicts`
+                // point to.
+                std::shared_ptr<alpm_list_t> Problems;
+
+                auto IsResolvable() const -> bool;
+                auto Fits() const -> bool;
+            };
+
+            // A package operation of a merged transaction, with the queued
+            // transactions that asked for it.
+            struct MergedOperation {
+                Package Target;
+                PackageOperation Operation;
+                std::vector<std::shared_ptr<Transaction>> Requests;
             };
 
+            // One libalpm transaction applied by `ApplyQueued`.
+            struct MergeReport {
+                std::vector<std::shared_ptr<Transaction>> Requests;
+                std::vector<MergedOperation> Operations;
+                // Operations a later request undid, e.g. an install followed by
+                // the removal of a package that isn't installed.
+                std::vector<MergedOperation> Cancelled;
+                std::optional<std::string> Error;
+            };
+
+            // The transaction belongs to the current handle and is applied to
+            // its root, whichever thread applies it.
             static auto Create() -> std::shared_ptr<Transaction>;
 
+            // Rebuilds the transaction an interrupted `Apply` left a checkpoint
+            // for. Phases it completed are skipped, and so is verifying the files
+            // it already verified. Returns nullptr when there is nothing to
+            // resume.
+            static auto Resume() -> std::shared_ptr<Transaction>;
+
+            // Queues a transaction for `ApplyQueued`. Safe to call from any thread.
+            static auto Enqueue(std::shared_ptr<Transaction> transaction) -> void;
+
+            // Applies every queued transaction in order. Compatible neighbours are
+            // merged into one libalpm transaction, so dependency resolution,
+            // conflict checks and hooks only run once for all of them. A merged
+            // transaction that fails doesn't stop the ones after it.
+            static auto ApplyQueued() -> std::vector<MergeReport>;
+
+            // Combines the operations of every transaction, in order. The last
+            // operation on a package wins, and flags are OR-ed.
+            static auto Merge(const std::vector<std::shared_ptr<Transaction>> &transactions) -> std::pair<std::shared_ptr<Transaction>, MergeReport>;
+
             Transaction(Private);
             ~Transaction();
 
@@ -56,6 +148,17 @@ namespace ALPM {
                 m_transactionFlags.set(static_cast<size_t>(flag));
                 (m_transactionFlags.set(static_cast<size_t>(flags)), ...);
             }
+            auto SetExecutionMode(ExecutionMode mode) -> void;
+
+            // Packages are taken from the shared cache when it has them, and
+            // every package installed is added to it and referenced by
+            // `revision`.
+            auto SetContentCache(std::shared_ptr<ContentCache> cache, std::string revision) -> void;
+
+            // Commits without libalpm's hooks and adds the post-transaction hooks
+            // the transaction triggers to `queue` instead, for a build that
+            // runs them once after its last transaction.
+            auto SetHookQueue(std::shared_ptr<HookQueue> queue) -> void;
             auto AddPackageOperation(const Package &package, PackageOperation operation) -> void;
             auto AddDatabaseOperation(const Database &database, DatabaseOperation operation) -> void;
             auto AddSystemUpgradeOperation() -> void;
@@ -65,15 +168,56 @@ namespace ALPM {
 
             auto GetDatabaseUpdates() const -> std::vector<Database>;
 
-            auto Apply() const -> void;
+            // Transactions can be merged when they belong to the same handle and
+            // agree on every flag that changes what an operation means, like
+            // DatabaseOnly or Recursive.
+            auto IsCompatible(const Transaction &other) const -> bool;
+
+            // Resolves the transaction like `Apply` does, without applying it.
+            // Database updates aren't performed.
+            auto Plan() const -> ExecutionPlan;
+
+            // Throws before anything is downloaded if the plan can't be resolved
+            // or doesn't fit on disk. Progress is checkpointed until the commit
+            // succeeds, see `Resume`.
+            //
+            // Once `stop` is requested the transaction throws at the next point
+            // it can stop at, which during the commit is after the package that
+            // is being installed. The checkpoint is kept for a later resume.
+            auto Apply(std::stop_token stop = {}) const -> void;
+
+            // Applies the transaction on its own thread. Progress is reported
+            // through `TransactionProgressEvent` and the other ALPM events, and
+            // the future rethrows whatever `Apply` threw. The future waits for the
+            // transaction when it's destroyed.
+            //
+            // The transaction's handle is busy until the future is ready, so
+            // anything running meanwhile should stick to the indexes or to other
+            // handles.
+            auto ApplyAsync(std::stop_token stop = {}) const -> std::future<void>;
             auto Interrupt() const -> void;
 
         private:
             bool m_valid{true};
+            Handle *m_handle;
             inline static std::queue<std::shared_ptr<Transaction>> s_transactions{};
+            inline static std::mutex s_queueMutex{};
             static auto CheckPackageOperation(std::pair<Package, PackageOperation> package, PackageOperation operation) -> bool;
 
+            // Initializes the libalpm transaction with `operations`, returning
+            // false if there is nothing to do.
+            auto Initialize(const std::vector<std::pair<Package, PackageOperation>> &operations) const -> bool;
+            auto Prepare() const -> ExecutionPlan;
+            // Whether libalpm will look anything up in the sync databases.
+            auto NeedsSyncDatabases() const -> bool;
+            auto StartCheckpoint() const -> std::shared_ptr<Checkpoint>;
+
             std::bitset<32> m_transactionFlags;
+            ExecutionMode m_executionMode{ExecutionMode::Serial};
+            std::shared_ptr<Checkpoint> m_checkpoint;
+            std::shared_ptr<ContentCache> m_contentCache;
+            std::string m_revision;
+            std::shared_ptr<HookQueue> m_hookQueue;
 
             std::vector<std::pair<Package, PackageOperation>> m_packageOperations;
             std::vector<std::pair<Database, DatabaseOperation>> m_databaseOperations;
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <compare>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ALPM {
+    // A package version split once into the segments `alpm_pkg_vercmp` compares,
+    // so comparing two versions doesn't parse either string again. Numeric
+    // segments are stored as integers and alphabetic segments keep their first
+    // eight characters packed into an integer, so most segments compare with a
+    // single integer comparison. Ordering is identical to `alpm_pkg_vercmp`.
+    class VersionKey {
+        public:
+            explicit VersionKey(std::string_view version);
+
+            // Same result as `alpm_pkg_vercmp`: -1, 0 or 1.
+            auto Compare(const VersionKey &other) const -> int;
+
+            auto GetVersion() const -> std::string_view;
+
+            friend auto operator<=>(const VersionKey &lhs, const VersionKey &rhs) -> std::strong_ordering;
+            friend auto operator==(const VersionKey &lhs, const VersionKey &rhs) -> bool;
+
+        private:
+            enum class Kind : uint8_t {
+                Numeric,
+                Alpha
+            };
+
+            // Numeric segments are stored without leading zeros. Anything that
+            // doesn't fit in `Value` is compared from the original string.
+            struct Segment {
+                uint64_t Value;
+                uint32_t Offset;
+                uint16_t Length;
+                uint16_t Separators;
+                Kind Type;
+            };
+
+            // The epoch, version and release are compared independently.
+            struct Component {
+                uint16_t First{0};
+                uint16_t Count{0};
+                uint16_t TrailingSeparators{0};
+            };
+
+            auto Tokenize(std::size_t begin, std::size_t end) -> Component;
+            auto CompareSegments(const Segment &lhs, const VersionKey &other, const Segment &rhs) const -> int;
+            auto CompareComponents(const Component &lhs, const VersionKey &other, const Component &rhs) const -> int;
+
+            std::string m_version;
+            std::vector<Segment> m_segments;
+
+            Component m_epoch;
+            Component m_pkgver;
+            std::optional<Component> m_pkgrel;
+    };
+}  // namespace ALPM
@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <functional>
 #include <map>
+#include <mutex>
 #include <random>
 #include <typeindex>
 #include <set>
@@ -18,6 +19,7 @@ namespace Event {
             template <class Event, typename Callable>
             requires std::is_invocable_v<Callable, Event>
             static inline auto RegisterCallback(Callable &&callable) -> CallbackId_t {
+                std::lock_guard lock(s_mutex);
                 CallbackId_t id = GenerateCallbackId();
                 
                 s_callbacks[id] = [callable](std::any args) -> void {
@@ -30,6 +32,7 @@ namespace Event {
             }
 
             static inline auto UnregisterCallback(CallbackId_t callbackId) -> void {
+                std::lock_guard lock(s_mutex);
                 for (auto &[event, callbacks] : s_events) {
                     std::erase_if(callbacks, [callbackId](const auto &id) -> bool {
                         return id == callbackId;
@@ -41,22 +44,34 @@ namespace Event {
                 });
             }
 
+            // Events can be emitted from any thread. Callbacks run on the emitting
+            // thread, and may register, unregister or emit themselves.
             template <class Event>
             static inline auto Emit(Event &&event = {}) -> void {
-                decltype(s_events)::iterator it = std::find_if(std::begin(s_events), std::end(s_events), [](const auto &pair) -> bool {
-                    return pair.first == typeid(Event);
-                });
+                std::vector<std::function<void(std::any)>> callbacks;
+                {
+                    std::lock_guard lock(s_mutex);
+                    decltype(s_events)::iterator it = std::find_if(std::begin(s_events), std::end(s_events), [](const auto &pair) -> bool {
+                        return pair.first == typeid(Event);
+                    });
 
-                if (it == std::end(s_events)) {
-                    return;
-                }
+                    if (it == std::end(s_events)) {
+                        return;
+                    }
 
-                for (const CallbackId_t &id : it->second) {
-                    // Make sure the container contains the callback ID before attempting to call it.
-                    if (s_callbacks.contains(id)) {
-                        s_callbacks[id](std::make_any<Event>(std::forward<Event>(event)));
+                    for (const CallbackId_t &id : it->second) {
+                        // Make sure the container contains the callback ID before attempting to call it.
+                        if (s_callbacks.contains(id)) {
+                            callbacks.push_back(s_callbacks[id]);
+                        }
                     }
                 }
+
+                // Every callback gets its own copy, a moved from event would be
+                // empty for all but the first.
+                for (const std::function<void(std::any)> &callback : callbacks) {
+                    callback(std::make_any<Event>(event));
+                }
             }
 
         private:
@@ -71,5 +86,6 @@ namespace Event {
 
             inline static std::map<CallbackId_t, std::function<void(std::any)>> s_callbacks{};
             inline static std::map<std::type_index, std::set<CallbackId_t>> s_events;
+            inline static std::mutex s_mutex{};
     };
 }  // namespace Event
@@ -1,7 +1,14 @@
 #pragma once
 
+#include "Event.hpp"
+
+#include <atomic>
+#include <stop_token>
+
 namespace POSIXSignals {
     struct Signal {
+        // The handler only wakes a watcher thread, which emits the signal's
+        // event and then exits the process unless an `Interruption` is alive.
         static auto InitHandlers() -> void;
         inline Signal(int code) : Code(code) {};
         int Code{};
@@ -10,4 +17,26 @@ namespace POSIXSignals {
     struct SigInt : public Signal {
         inline SigInt() : Signal(2) {}
     };
+
+    // While one is alive, an interrupt requests a stop on it instead of exiting
+    // the process, for work that winds itself down. A second interrupt exits
+    // anyway.
+    class Interruption {
+        public:
+            Interruption();
+            ~Interruption();
+
+            Interruption(const Interruption&) = delete;
+            auto operator=(const Interruption&) -> Interruption& = delete;
+
+            auto GetToken() const -> std::stop_token;
+
+            static auto IsAlive() -> bool;
+
+        private:
+            std::stop_source m_source;
+            Event::Event::CallbackId_t m_callback{};
+
+            inline static std::atomic<std::size_t> s_alive{0};
+    };
 }  // namespace POSIXSignals
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class ThreadPool {
+    public:
+        explicit ThreadPool(std::size_t threadCount = std::thread::hardware_concurrency());
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        auto operator=(const ThreadPool&) -> ThreadPool& = delete;
+
+        // Process wide pool sized to the number of hardware threads, for work
+        // that doesn't need its own concurrency limit.
+        static auto GetShared() -> ThreadPool&;
+
+        template <typename Callable>
+        requires std::is_invocable_v<Callable>
+        inline auto Submit(Callable &&callable) -> std::future<std::invoke_result_t<Callable>> {
+            // `std::function` has to be copyable, so the task is kept behind a shared_ptr.
+            auto task = std::make_shared<std::packaged_task<std::invoke_result_t<Callable>()>>(std::forward<Callable>(callable));
+            std::future<std::invoke_result_t<Callable>> future = task->get_future();
+
+            Enqueue([task]() -> void {
+                (*task)();
+            });
+
+            return future;
+        }
+
+        auto GetThreadCount() const -> std::size_t;
+
+    private:
+        auto Enqueue(std::function<void()> job) -> void;
+        auto Run() -> void;
+
+        std::vector<std::thread> m_threads;
+        std::queue<std::function<void()>> m_jobs;
+
+        std::mutex m_mutex;
+        std::condition_variable m_condition;
+        bool m_stopping{false};
+};
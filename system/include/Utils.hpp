@@ -2,10 +2,14 @@
 
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <cmath>
 #include <vector>
 #include <string>
 #include <cstring>
+#include <iterator>
+#include <ranges>
+#include <span>
 #include <sys/utsname.h>
 
 #include <alpm.h>
@@ -41,6 +45,133 @@ namespace Utils {
         };
     };
 
+    // Lazily walks an `alpm_list_t` once, constructing the C++ wrapper (or a
+    // `std::string_view` for string lists) for each element as it is reached.
+    // The view doesn't own the list, so it must not outlive it.
+    //
+    // The element type is only checked on dereference so that headers can
+    // declare views over types that are still incomplete at that point.
+    template <typename T>
+    class ALPMListView : public std::ranges::view_interface<ALPMListView<T>> {
+        public:
+            class Iterator {
+                public:
+                    using iterator_concept = std::forward_iterator_tag;
+                    using value_type = T;
+                    using difference_type = std::ptrdiff_t;
+
+                    Iterator() = default;
+                    inline explicit Iterator(const alpm_list_t *node) : m_node(node) {}
+
+                    inline auto operator*() const -> T {
+                        static_assert(ALPMListConvertible<T> || std::same_as<T, std::string_view>);
+
+                        if constexpr (std::same_as<T, std::string_view>) {
+                            return std::string_view(static_cast<const char*>(m_node->data));
+                        } else {
+                            return T(static_cast<T::UnderlyingType*>(m_node->data));
+                        }
+                    }
+
+                    inline auto operator++() -> Iterator& {
+                        m_node = m_node->next;
+                        return *this;
+                    }
+
+                    inline auto operator++(int) -> Iterator {
+                        Iterator it = *this;
+                        m_node = m_node->next;
+                        return it;
+                    }
+
+                    inline auto operator==(const Iterator &other) const -> bool {
+                        return m_node == other.m_node;
+                    }
+
+                private:
+                    const alpm_list_t *m_node{nullptr};
+            };
+
+            ALPMListView() = default;
+            inline explicit ALPMListView(const alpm_list_t *list) : m_list(list) {}
+
+            inline auto begin() const -> Iterator {
+                return Iterator(m_list);
+            }
+
+            inline auto end() const -> Iterator {
+                return Iterator();
+            }
+
+        private:
+            const alpm_list_t *m_list{nullptr};
+    };
+
+    // The same idea as `ALPMListView`, but for the plain C arrays libalpm uses
+    // for things like file lists.
+    template <typename T, typename U>
+    class ALPMArrayView : public std::ranges::view_interface<ALPMArrayView<T, U>> {
+        public:
+            class Iterator {
+                public:
+                    using iterator_concept = std::forward_iterator_tag;
+                    using value_type = T;
+                    using difference_type = std::ptrdiff_t;
+
+                    Iterator() = default;
+                    inline explicit Iterator(U *element) : m_element(element) {}
+
+                    inline auto operator*() const -> T {
+                        return T(m_element);
+                    }
+
+                    inline auto operator++() -> Iterator& {
+                        m_element++;
+                        return *this;
+                    }
+
+                    inline auto operator++(int) -> Iterator {
+                        Iterator it = *this;
+                        m_element++;
+                        return it;
+                    }
+
+                    inline auto operator==(const Iterator &other) const -> bool {
+                        return m_element == other.m_element;
+                    }
+
+                private:
+                    U *m_element{nullptr};
+            };
+
+            ALPMArrayView() = default;
+            inline explicit ALPMArrayView(std::span<U> elements) : m_elements(elements) {}
+
+            inline auto begin() const -> Iterator {
+                return Iterator(m_elements.data());
+            }
+
+            inline auto end() const -> Iterator {
+                return Iterator(m_elements.data() + m_elements.size());
+            }
+
+            inline auto size() const -> std::size_t {
+                return m_elements.size();
+            }
+
+            inline auto GetSpan() const -> std::span<U> {
+                return m_elements;
+            }
+
+        private:
+            std::span<U> m_elements;
+    };
+
+    // libalpm returns NULL for fields a package doesn't have.
+    inline auto ToStringView(const char *string) -> std::string_view {
+        return string ? std::string_view(string) : std::string_view();
+    }
+
     template <typename T>
     requires ALPMListConvertible<T>
     auto ALPMListToVector(const alpm_list_t *list) -> std::vector<T> {
@@ -77,9 +208,7 @@ namespace Utils {
     auto VectorToALPMList(const std::vector<T> &vector) -> alpm_list_t* {
         alpm_list_t *list = nullptr;
         for (const std::string &element : vector) {
-            char *data = new char[element.size()];
-            std::strcpy(data, element.c_str());
-            list = alpm_list_add(list, data);
+            list = alpm_list_add(list, strdup(element.c_str()));
         }
 
         return list;
@@ -107,3 +236,13 @@ namespace Utils {
         return machine;
     }
 }  // namespace Utils
+
+namespace std::ranges {
+    // Iterators point into the libalpm list rather than the view, so they
+    // stay valid after the view itself is gone.
+    template <typename T>
+    inline constexpr bool enable_borrowed_range<Utils::ALPMListView<T>> = true;
+
+    template <typename T, typename U>
+    inline constexpr bool enable_borrowed_range<Utils::ALPMArrayView<T, U>> = true;
+}  // namespace std::ranges
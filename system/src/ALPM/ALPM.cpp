@@ -1,99 +1,68 @@
 #include "ALPM.hpp"
 
-#include "Events.hpp"
-#include "Event.hpp"
-#include "PosixSignals.hpp"
+#include "Utils.hpp"
 
 #include <alpm.h>
 
-#include <stdexcept>
-#include <format>
+#include <utility>
 
-alpm_handle_t *ALPM::ALPM::s_alpmHandle = nullptr;
-std::shared_ptr<ALPM::Transaction> ALPM::ALPM::s_currentTransaction = {};
-ALPM::Config ALPM::ALPM::s_config = Config();
+std::mutex ALPM::ALPM::s_mutex{};
+ALPM::Handle *ALPM::ALPM::s_defaultHandle = nullptr;
 
 auto ALPM::ALPM::Initialize(const std::filesystem::path &root) -> bool {
-    if (s_alpmHandle) {
+    std::lock_guard lock(s_mutex);
+    if (s_defaultHandle) {
         return false;
     }
 
-    Event::Event::RegisterCallback<POSIXSignals::SigInt>([](const POSIXSignals::SigInt &signal) -> void {
-        if (s_currentTransaction) {
-            s_currentTransaction->Interrupt();
-            alpm_trans_release(s_alpmHandle);
-        }
-
-        alpm_release(s_alpmHandle);
-    });
-
-    alpm_errno_t err;
-
-    std::filesystem::path dbPath = root / "var/lib/pacman";
-    std::filesystem::path configPath = root / "etc/pacman.conf";
-
-    s_alpmHandle = alpm_initialize(root.c_str(), dbPath.c_str(), &err);
-
-    if (!s_alpmHandle) {
-        throw std::runtime_error(std::format("Failed to allocate libalpm handle: {}", alpm_strerror(err)));
-    }
-
-    // Register C++ libalpm events
-    Events::RegisterEvents();
+    s_defaultHandle = new Handle(root);
 
-    // Load global configuration file
-    s_config.LoadFile(configPath);
+    return true;
+}
 
-    if (s_config.GetSection("options").HasOption("ParallelDownloads")) {
-        alpm_option_set_parallel_downloads(s_alpmHandle, s_config.GetSection("options").GetOption("ParallelDownloads").As<int>());
+auto ALPM::ALPM::GetCurrentHandle() -> Handle& {
+    if (Handle *handle = Handle::GetCurrent()) {
+        return *handle;
     }
 
-    // Initializing database results in libalpm_register_syncdb being called
-    // for all of the databases defined in pacman.conf
-    Database::Initialize();
-
-    return true;
+    Initialize();
+    return *s_defaultHandle;
 }
 
 auto ALPM::ALPM::GetCurrentTransaction() -> std::shared_ptr<Transaction> {
-    Initialize();
-    if (!s_currentTransaction) {
-        s_currentTransaction = ::ALPM::Transaction::Create();
-    }
-
-    return s_currentTransaction;
+    return GetCurrentHandle().GetCurrentTransaction();
 }
 
 auto ALPM::ALPM::SetCurrentTransaction(std::shared_ptr<Transaction> transaction) -> void {
-    Initialize();
-    s_currentTransaction = transaction;
+    GetCurrentHandle().SetCurrentTransaction(std::move(transaction));
 }
 
 auto ALPM::ALPM::ApplyCurrentTransaction() -> void {
-    Initialize();
+    Handle &handle = GetCurrentHandle();
+    std::shared_ptr<Transaction> transaction = handle.GetCurrentTransaction();
     alpm_list_t *list = new alpm_list_t;
 
     /* Databse Updates */
-    if (!s_currentTransaction->GetDatabaseUpdates().empty()) {
+    if (!transaction->GetDatabaseUpdates().empty()) {
         alpm_list_t *dbList = list;
         
         // Set up first value
         dbList->prev = dbList;
         dbList->next = nullptr;
-        dbList->data = s_currentTransaction->GetDatabaseUpdates().at(0).GetHandle();
+        dbList->data = transaction->GetDatabaseUpdates().at(0).GetHandle();
 
-        for (int i = 1; i < s_currentTransaction->GetDatabaseUpdates().size(); i++) {
+        for (int i = 1; i < transaction->GetDatabaseUpdates().size(); i++) {
             // Sets up new list element for this current iteration
             dbList->next->prev = dbList;
             dbList->next = new alpm_list_t;
-            Database database = s_currentTransaction->GetDatabaseUpdates().at(i);
+            Database database = transaction->GetDatabaseUpdates().at(i);
 
             dbList->next->data = database.GetHandle();
             
             dbList = dbList->next;
         }
 
-        alpm_db_update(s_alpmHandle, list, false);
+        alpm_db_update(handle.GetHandle(), list, false);
         alpm_list_free(list);
     }
 
@@ -101,32 +70,24 @@ auto ALPM::ALPM::ApplyCurrentTransaction() -> void {
 }
 
 auto ALPM::ALPM::GetError() -> std::string {
-    Initialize();
-    return alpm_strerror(alpm_errno(s_alpmHandle));
+    return GetCurrentHandle().GetError();
 }
 
 auto ALPM::ALPM::GetLocalDatabase() -> Database {
-    Initialize();
-    return Database(alpm_get_localdb(s_alpmHandle));
+    return GetCurrentHandle().GetLocalDatabase();
 }
 
 auto ALPM::ALPM::GetSyncDatabases() -> std::vector<Database> {
-    Initialize();
-    alpm_list_t *list = alpm_get_syncdbs(s_alpmHandle);
-    std::vector<Database> databases;
-    for (size_t i = 0; i < alpm_list_count(list); i++) {
-        databases.emplace_back(static_cast<alpm_db_t*>(alpm_list_nth(list, i)->data));
-    }
+    return GetCurrentHandle().GetSyncDatabases();
+}
 
-    return databases;
+auto ALPM::ALPM::GetSyncDatabasesView() -> Utils::ALPMListView<Database> {
+    return GetCurrentHandle().GetSyncDatabasesView();
 }
 
 auto ALPM::ALPM::GetSyncDatabase(const std::string &name) -> std::optional<Database> {
-    Initialize();
-    alpm_list_t *list = alpm_get_syncdbs(s_alpmHandle);
-    for (size_t i = 0; i < alpm_list_count(list); i++) {
-        Database db = Database(static_cast<alpm_db_t*>(alpm_list_nth(list, i)->data));
-        if (db.GetName() == name) {
+    for (const Database &db : GetSyncDatabasesView()) {
+        if (alpm_db_get_name(db.GetHandle()) == name) {
             return db;
         }
     }
@@ -134,12 +95,18 @@ auto ALPM::ALPM::GetSyncDatabase(const std::string &name) -> std::optional<Datab
     return {};
 }
 
-auto ALPM::ALPM::GetConfig() -> Config {
-    Initialize();
-    return s_config;
+auto ALPM::ALPM::GetConfig() -> std::shared_ptr<const Config> {
+    return GetCurrentHandle().GetConfig();
+}
+
+auto ALPM::ALPM::GetDatabaseGeneration() -> uint64_t {
+    return GetCurrentHandle().GetDatabaseGeneration();
+}
+
+auto ALPM::ALPM::InvalidateDatabases() -> void {
+    GetCurrentHandle().InvalidateDatabases();
 }
 
 auto ALPM::ALPM::GetHandle() -> alpm_handle_t* {
-    Initialize();
-    return s_alpmHandle;
+    return GetCurrentHandle().GetHandle();
 }
@@ -0,0 +1,254 @@
+#include "Checkpoint.hpp"
+#include "ALPM.hpp"
+
+#include <alpm.h>
+
+#include <algorithm>
+#include <array>
+#include <format>
+#include <sstream>
+
+using namespace ALPM;
+
+namespace {
+    auto GetPhaseName(Checkpoint::Phase phase) -> std::string_view {
+        switch (phase) {
+            case Checkpoint::Phase::Databases:
+                return "databases";
+            case Checkpoint::Phase::Downloads:
+                return "downloads";
+        }
+
+        return {};
+    }
+
+    // The journal keyword of each package operation.
+    constexpr std::array<std::pair<Transaction::PackageOperation, std::string_view>, 5> OPERATION_NAMES{{
+        {Transaction::PackageOperation::Install, "install"},
+        {Transaction::PackageOperation::Upgrade, "upgrade"},
+        {Transaction::PackageOperation::Reinstall, "reinstall"},
+        {Transaction::PackageOperation::Downgrade, "downgrade"},
+        {Transaction::PackageOperation::Uninstall, "remove"}
+    }};
+
+    auto GetOperationName(Transaction::PackageOperation operation) -> std::string_view {
+        return std::ranges::find(OPERATION_NAMES, operation, &std::pair<Transaction::PackageOperation, std::string_view>::first)->second;
+    }
+}  // namespace
+
+auto Checkpoint::Begin(unsigned long flags, bool systemUpgrade, bool pipelined, const std::vector<Target> &targets, const std::vector<std::string> &databases) -> std::shared_ptr<Checkpoint> {
+    std::filesystem::path path = GetPath();
+    std::filesystem::create_directories(path.parent_path());
+
+    auto checkpoint = std::make_shared<Checkpoint>();
+    checkpoint->m_flags = flags;
+    checkpoint->m_systemUpgrade = systemUpgrade;
+    checkpoint->m_pipelined = pipelined;
+    checkpoint->m_targets = targets;
+    checkpoint->m_databases = databases;
+
+    checkpoint->m_journal.open(path, std::ios::trunc);
+    if (!checkpoint->m_journal) {
+        throw std::runtime_error(std::format("Failed to create transaction checkpoint {}", path.string()));
+    }
+
+    checkpoint->Append(std::string(HEADER));
+    checkpoint->Append(std::format("flags {}", flags));
+    checkpoint->Append(std::format("sysupgrade {}", systemUpgrade ? 1 : 0));
+    checkpoint->Append(std::format("pipelined {}", pipelined ? 1 : 0));
+    for (const Target &target : targets) {
+        if (target.Operation == Transaction::PackageOperation::Uninstall) {
+            checkpoint->Append(std::format("remove {}", target.Name));
+        } else {
+            checkpoint->Append(std::format("{} {} {}", GetOperationName(target.Operation), target.Database, target.Name));
+        }
+    }
+    for (const std::string &database : databases) {
+        checkpoint->Append(std::format("database {}", database));
+    }
+
+    return checkpoint;
+}
+
+auto Checkpoint::Load() -> std::shared_ptr<Checkpoint> {
+    std::filesystem::path path = GetPath();
+
+    std::ifstream journal(path);
+    std::string line;
+    if (!journal || !std::getline(journal, line) || line != HEADER) {
+        return {};
+    }
+
+    auto checkpoint = std::make_shared<Checkpoint>();
+    while (std::getline(journal, line)) {
+        // The last line may have been cut off by the interruption.
+        if (journal.eof()) {
+            break;
+        }
+
+        if (!checkpoint->Replay(line)) {
+            return {};
+        }
+    }
+
+    journal.close();
+
+    checkpoint->m_journal.open(path, std::ios::app);
+    if (!checkpoint->m_journal) {
+        return {};
+    }
+
+    return checkpoint;
+}
+
+auto Checkpoint::Discard() -> void {
+    std::error_code error;
+    std::filesystem::remove(GetPath(), error);
+}
+
+auto Checkpoint::GetPath() -> std::filesystem::path {
+    return std::filesystem::path(alpm_option_get_root(ALPM::GetHandle())) / "var/lib/system/checkpoint";
+}
+
+auto Checkpoint::GetFlags() const -> unsigned long {
+    return m_flags;
+}
+
+auto Checkpoint::IsSystemUpgrade() const -> bool {
+    return m_systemUpgrade;
+}
+
+auto Checkpoint::IsPipelined() const -> bool {
+    return m_pipelined;
+}
+
+auto Checkpoint::GetTargets() const -> const std::vector<Target>& {
+    return m_targets;
+}
+
+auto Checkpoint::GetDatabases() const -> const std::vector<std::string>& {
+    return m_databases;
+}
+
+auto Checkpoint::Complete(Phase phase) -> void {
+    std::lock_guard lock(m_mutex);
+    if (m_phases.insert(phase).second) {
+        Append(std::format("phase {}", GetPhaseName(phase)));
+    }
+}
+
+auto Checkpoint::IsComplete(Phase phase) const -> bool {
+    std::lock_guard lock(m_mutex);
+    return m_phases.contains(phase);
+}
+
+auto Checkpoint::SetPlan(const std::vector<std::string> &filenames) -> void {
+    std::lock_guard lock(m_mutex);
+    if (filenames == m_plan) {
+        return;
+    }
+
+    m_plan = filenames;
+    m_phases.erase(Phase::Downloads);
+
+    Append("plan-begin");
+    for (const std::string &filename : m_plan) {
+        Append(std::format("plan {}", filename));
+    }
+}
+
+auto Checkpoint::GetPlan() const -> std::vector<std::string> {
+    std::lock_guard lock(m_mutex);
+    return m_plan;
+}
+
+auto Checkpoint::MarkVerified(const std::filesystem::path &file) -> void {
+    std::optional<FileState> state = GetFileState(file);
+    if (!state) {
+        return;
+    }
+
+    std::lock_guard lock(m_mutex);
+    m_verified[file.string()] = *state;
+    Append(std::format("verified {} {} {}", state->Size, state->ModificationTime, file.string()));
+}
+
+auto Checkpoint::IsVerified(const std::filesystem::path &file) const -> bool {
+    std::optional<FileState> state = GetFileState(file);
+
+    std::lock_guard lock(m_mutex);
+    auto verified = m_verified.find(file.string());
+    return state && verified != m_verified.end() && verified->second == *state;
+}
+
+auto Checkpoint::GetFileState(const std::filesystem::path &file) -> std::optional<FileState> {
+    std::error_code error;
+    std::uintmax_t size = std::filesystem::file_size(file, error);
+    if (error) {
+        return {};
+    }
+
+    std::filesystem::file_time_type modified = std::filesystem::last_write_time(file, error);
+    if (error) {
+        return {};
+    }
+
+    return FileState{.Size = size, .ModificationTime = static_cast<int64_t>(modified.time_since_epoch().count())};
+}
+
+auto Checkpoint::Replay(const std::string &line) -> bool {
+    std::istringstream fields(line);
+    std::string key;
+    fields >> key;
+
+    if (key == "flags") {
+        fields >> m_flags;
+    } else if (key == "sysupgrade") {
+        fields >> m_systemUpgrade;
+    } else if (key == "pipelined") {
+        fields >> m_pipelined;
+    } else if (key == "remove") {
+        Target target{.Operation = Transaction::PackageOperation::Uninstall};
+        fields >> target.Name;
+        m_targets.push_back(std::move(target));
+    } else if (auto operation = std::ranges::find(OPERATION_NAMES, key, &std::pair<Transaction::PackageOperation, std::string_view>::second); operation != OPERATION_NAMES.end()) {
+        Target target{.Operation = operation->first};
+        fields >> target.Database >> target.Name;
+        m_targets.push_back(std::move(target));
+    } else if (key == "database") {
+        std::string name;
+        fields >> name;
+        m_databases.push_back(std::move(name));
+    } else if (key == "phase") {
+        std::string name;
+        fields >> name;
+        for (Phase phase : {Phase::Databases, Phase::Downloads}) {
+            if (name == GetPhaseName(phase)) {
+                m_phases.insert(phase);
+            }
+        }
+    } else if (key == "plan-begin") {
+        m_plan.clear();
+        m_phases.erase(Phase::Downloads);
+    } else if (key == "plan") {
+        std::string filename;
+        fields >> filename;
+        m_plan.push_back(std::move(filename));
+    } else if (key == "verified") {
+        FileState state;
+        fields >> state.Size >> state.ModificationTime;
+
+        // The path is the rest of the line, spaces and all.
+        std::string path;
+        std::getline(fields >> std::ws, path);
+        m_verified[path] = state;
+    } else {
+        return false;
+    }
+
+    return !fields.fail();
+}
+
+auto Checkpoint::Append(const std::string &line) -> void {
+    m_journal << line << std::endl;
+}
@@ -0,0 +1,423 @@
+#include "CompiledConfig.hpp"
+#include "Config.hpp"
+#include "Signature.hpp"
+#include "Utils.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <unordered_map>
+
+using namespace ALPM;
+
+namespace {
+    constexpr std::array<char, 8> CONFIG_MAGIC{'L', 'I', 'T', 'H', 'C', 'F', 'G', '\0'};
+    constexpr uint32_t CONFIG_VERSION = 2;
+
+    enum Column : std::size_t {
+        Files,
+        Options,
+        Repositories,
+        Servers,
+        Strings,
+        ColumnCount
+    };
+
+    struct Section {
+        uint64_t Offset;
+        uint64_t Size;
+    };
+
+    // Interns every string into one arena. Offset 0 is always the empty string
+    // so missing fields don't need a separate "null" marker.
+    class StringArena {
+        public:
+            StringArena() {
+                m_data.push_back('\0');
+                m_offsets.emplace("", 0);
+            }
+
+            auto Intern(std::string_view string) -> uint32_t {
+                auto [it, inserted] = m_offsets.try_emplace(std::string(string), static_cast<uint32_t>(m_data.size()));
+                if (inserted) {
+                    m_data.append(string);
+                    m_data.push_back('\0');
+                }
+
+                return it->second;
+            }
+
+            auto GetData() const -> const std::string& {
+                return m_data;
+            }
+
+        private:
+            std::string m_data;
+            std::unordered_map<std::string, uint32_t> m_offsets;
+    };
+
+    auto StatFile(const std::filesystem::path &path, CompiledConfig::FileRecord &record) -> bool {
+        struct stat buffer{};
+        if (stat(path.c_str(), &buffer) != 0) {
+            return false;
+        }
+
+        record.ModifiedTime = static_cast<int64_t>(buffer.st_mtim.tv_sec) * 1'000'000'000 + buffer.st_mtim.tv_nsec;
+        record.Size = buffer.st_size;
+        record.Inode = buffer.st_ino;
+
+        return true;
+    }
+
+    auto ReplaceAll(std::string &text, std::string_view from, std::string_view to) -> void {
+        for (std::size_t position = text.find(from); position != text.npos; position = text.find(from, position + to.size())) {
+            text.replace(position, from.size(), to);
+        }
+    }
+}  // namespace
+
+struct CompiledConfig::Header {
+    std::array<char, 8> Magic;
+    uint32_t Version;
+    uint32_t FileCount;
+    uint32_t OptionCount;
+    uint32_t RepositoryCount;
+    uint32_t ServerCount;
+    uint32_t ConfigFile;
+    uint32_t Architecture;
+    uint32_t Reserved;
+    std::array<Section, ColumnCount> Columns;
+};
+
+template <typename T>
+auto CompiledConfig::GetColumn(std::size_t column) const -> const T* {
+    return reinterpret_cast<const T*>(reinterpret_cast<const std::byte*>(m_header) + m_header->Columns[column].Offset);
+}
+
+CompiledConfig::Repository::Repository(const CompiledConfig *config, const RepositoryRecord *record) :
+    m_config(config), m_record(record) {}
+
+auto CompiledConfig::Repository::GetName() const -> std::string_view {
+    return m_config->GetString(m_record->Name);
+}
+
+auto CompiledConfig::Repository::GetSigLevel() const -> std::bitset<32> {
+    return std::bitset<32>(m_record->SigLevel);
+}
+
+auto CompiledConfig::Repository::GetServers() const -> std::vector<std::string> {
+    const uint32_t *servers = m_config->GetColumn<uint32_t>(Servers) + m_record->FirstServer;
+
+    std::vector<std::string> urls;
+    urls.reserve(m_record->ServerCount);
+    for (uint32_t i = 0; i < m_record->ServerCount; i++) {
+        urls.emplace_back(m_config->GetString(servers[i]));
+    }
+
+    return urls;
+}
+
+CompiledConfig::CompiledConfig(Private, void *mapping, std::size_t size) :
+    m_mapping(mapping), m_size(size), m_header(static_cast<const Header*>(mapping)) {}
+
+CompiledConfig::CompiledConfig(Private, std::string buffer) :
+    m_buffer(std::move(buffer)), m_size(m_buffer.size()), m_header(reinterpret_cast<const Header*>(m_buffer.data())) {}
+
+CompiledConfig::~CompiledConfig() {
+    if (m_mapping != nullptr) {
+        munmap(m_mapping, m_size);
+    }
+}
+
+auto CompiledConfig::Load(const std::filesystem::path &configFile, const std::filesystem::path &path) -> std::shared_ptr<const CompiledConfig> {
+    if (std::shared_ptr<const CompiledConfig> config = Open(configFile, path)) {
+        return config;
+    }
+
+    return Compile(configFile, path);
+}
+
+auto CompiledConfig::Compile(const std::filesystem::path &configFile, const std::filesystem::path &path) -> std::shared_ptr<const CompiledConfig> {
+    int64_t startTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+    const Config config(configFile);
+    StringArena strings;
+
+    std::string architecture = Utils::GetSystemArchitecture();
+
+    // Timestamps come from a clock that can lag behind by a tick, so a file
+    // changed around the time it was read might not look newer than the
+    // compiled config. Those are left to be compiled again next time.
+    bool cacheable = true;
+    std::vector<FileRecord> files;
+    for (const std::filesystem::path &file : config.GetFiles()) {
+        FileRecord record{.Path = strings.Intern(file.native())};
+        record.Exists = StatFile(file, record);
+        if (record.Exists && record.ModifiedTime > startTime - 1'000'000'000) {
+            cacheable = false;
+        }
+        files.push_back(record);
+    }
+
+    std::vector<OptionRecord> options;
+    std::bitset<32> defaultSigLevel = Signature::DEFAULT_LEVEL;
+    if (const Config::Section *section = config.GetSection("options")) {
+        for (const auto &[key, values] : section->GetOptions()) {
+            for (const Config::Section::Value &value : values) {
+                options.push_back(OptionRecord{.Key = strings.Intern(key), .Value = strings.Intern(value.As<std::string_view>())});
+            }
+        }
+
+        if (section->HasOption("SigLevel")) {
+            defaultSigLevel = section->GetOption("SigLevel")->As<Signature::Level>(defaultSigLevel);
+        }
+    }
+
+    std::vector<RepositoryRecord> repositories;
+    std::vector<uint32_t> servers;
+    for (const Config::Section &section : config.GetSections()) {
+        if (section.GetName() == "options") {
+            continue;
+        }
+
+        std::bitset<32> sigLevel = section.HasOption("SigLevel") ? section.GetOption("SigLevel")->As<Signature::Level>(defaultSigLevel) : defaultSigLevel;
+        RepositoryRecord record{
+            .Name = strings.Intern(section.GetName()),
+            .SigLevel = static_cast<uint32_t>(sigLevel.to_ulong()),
+            .FirstServer = static_cast<uint32_t>(servers.size()),
+            .ServerCount = 0
+        };
+
+        for (const Config::Section::Value &server : section.GetOptions("Server")) {
+            std::string url = server.As<std::string>();
+            ReplaceAll(url, "$repo", section.GetName());
+            ReplaceAll(url, "$arch", architecture);
+            servers.push_back(strings.Intern(url));
+        }
+        record.ServerCount = static_cast<uint32_t>(servers.size()) - record.FirstServer;
+
+        repositories.push_back(record);
+    }
+
+    Header header{};
+    header.Magic = CONFIG_MAGIC;
+    header.Version = CONFIG_VERSION;
+    header.FileCount = static_cast<uint32_t>(files.size());
+    header.OptionCount = static_cast<uint32_t>(options.size());
+    header.RepositoryCount = static_cast<uint32_t>(repositories.size());
+    header.ServerCount = static_cast<uint32_t>(servers.size());
+    header.ConfigFile = strings.Intern(configFile.native());
+    header.Architecture = strings.Intern(architecture);
+
+    const std::string &arena = strings.GetData();
+
+    std::array<std::pair<const void*, std::size_t>, ColumnCount> columns;
+    columns[Files] = {files.data(), files.size() * sizeof(FileRecord)};
+    columns[Options] = {options.data(), options.size() * sizeof(OptionRecord)};
+    columns[Repositories] = {repositories.data(), repositories.size() * sizeof(RepositoryRecord)};
+    columns[Servers] = {servers.data(), servers.size() * sizeof(uint32_t)};
+    columns[Strings] = {arena.data(), arena.size()};
+
+    // Every column starts on an 8 byte boundary so it can be read in place.
+    uint64_t offset = sizeof(Header);
+    for (std::size_t column = 0; column < ColumnCount; column++) {
+        offset = (offset + 7) & ~uint64_t{7};
+        header.Columns[column] = Section{.Offset = offset, .Size = columns[column].second};
+        offset += columns[column].second;
+    }
+
+    std::string buffer(offset, '\0');
+    std::memcpy(buffer.data(), &header, sizeof(Header));
+    for (std::size_t column = 0; column < ColumnCount; column++) {
+        if (columns[column].second != 0) {
+            std::memcpy(buffer.data() + header.Columns[column].Offset, columns[column].first, columns[column].second);
+        }
+    }
+
+    if (cacheable) {
+        std::filesystem::path temporaryPath = path;
+        temporaryPath += ".tmp";
+
+        std::error_code ec;
+        std::filesystem::create_directories(path.parent_path(), ec);
+
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (file) {
+            file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            file.close();
+
+            if (file) {
+                std::filesystem::rename(temporaryPath, path, ec);
+            } else {
+                std::filesystem::remove(temporaryPath, ec);
+            }
+        }
+    }
+
+    return std::make_shared<const CompiledConfig>(Private(), std::move(buffer));
+}
+
+auto CompiledConfig::Open(const std::filesystem::path &configFile, const std::filesystem::path &path) -> std::shared_ptr<const CompiledConfig> {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat buffer{};
+    if (fstat(fd, &buffer) != 0 || static_cast<std::size_t>(buffer.st_size) < sizeof(Header)) {
+        close(fd);
+        return nullptr;
+    }
+
+    std::size_t size = static_cast<std::size_t>(buffer.st_size);
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        return nullptr;
+    }
+
+    std::shared_ptr<const CompiledConfig> config = std::make_shared<const CompiledConfig>(Private(), mapping, size);
+    if (!config->IsValid()) {
+        return nullptr;
+    }
+
+    if (config->GetString(config->m_header->ConfigFile) != configFile.native() || config->GetString(config->m_header->Architecture) != Utils::GetSystemArchitecture()) {
+        return nullptr;
+    }
+
+    if (config->IsStale()) {
+        return nullptr;
+    }
+
+    return config;
+}
+
+auto CompiledConfig::GetDefaultPath(const std::filesystem::path &root) -> std::filesystem::path {
+    return root / "var/cache/system/pacman.conf.bin";
+}
+
+auto CompiledConfig::IsStale() const -> bool {
+    std::span<const FileRecord> files(GetColumn<FileRecord>(Files), m_header->FileCount);
+    for (const FileRecord &record : files) {
+        FileRecord current{};
+        bool exists = StatFile(GetString(record.Path), current);
+        if (exists != static_cast<bool>(record.Exists)) {
+            return true;
+        }
+
+        if (exists && (current.ModifiedTime != record.ModifiedTime || current.Size != record.Size || current.Inode != record.Inode)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+auto CompiledConfig::GetOption(std::string_view key) const -> std::optional<std::string_view> {
+    std::span<const OptionRecord> options(GetColumn<OptionRecord>(Options), m_header->OptionCount);
+    for (const OptionRecord &option : options) {
+        if (GetString(option.Key) == key) {
+            return GetString(option.Value);
+        }
+    }
+
+    return {};
+}
+
+auto CompiledConfig::GetOptions(std::string_view key) const -> std::vector<std::string_view> {
+    std::span<const OptionRecord> options(GetColumn<OptionRecord>(Options), m_header->OptionCount);
+
+    std::vector<std::string_view> values;
+    for (const OptionRecord &option : options) {
+        if (GetString(option.Key) == key) {
+            values.push_back(GetString(option.Value));
+        }
+    }
+
+    return values;
+}
+
+auto CompiledConfig::GetRepositories() const -> std::vector<Repository> {
+    const RepositoryRecord *records = GetColumn<RepositoryRecord>(Repositories);
+
+    std::vector<Repository> repositories;
+    repositories.reserve(m_header->RepositoryCount);
+    for (uint32_t i = 0; i < m_header->RepositoryCount; i++) {
+        repositories.emplace_back(this, records + i);
+    }
+
+    return repositories;
+}
+
+auto CompiledConfig::GetString(uint32_t offset) const -> std::string_view {
+    return std::string_view(GetColumn<char>(Strings) + offset);
+}
+
+auto CompiledConfig::IsValid() const -> bool {
+    if (m_header->Magic != CONFIG_MAGIC || m_header->Version != CONFIG_VERSION) {
+        return false;
+    }
+
+    std::array<std::size_t, ColumnCount> sizes{
+        m_header->FileCount * sizeof(FileRecord),
+        m_header->OptionCount * sizeof(OptionRecord),
+        m_header->RepositoryCount * sizeof(RepositoryRecord),
+        m_header->ServerCount * sizeof(uint32_t),
+        m_header->Columns[Strings].Size
+    };
+
+    for (std::size_t column = 0; column < ColumnCount; column++) {
+        const Section &section = m_header->Columns[column];
+        if (section.Offset % 8 != 0 || section.Offset > m_size || section.Size > m_size - section.Offset || section.Size != sizes[column]) {
+            return false;
+        }
+    }
+
+    // Every string has to end inside the arena.
+    uint64_t stringsSize = m_header->Columns[Strings].Size;
+    if (stringsSize == 0 || GetColumn<char>(Strings)[stringsSize - 1] != '\0') {
+        return false;
+    }
+
+    auto inArena = [stringsSize](uint32_t offset) -> bool {
+        return offset < stringsSize;
+    };
+
+    if (!inArena(m_header->ConfigFile) || !inArena(m_header->Architecture)) {
+        return false;
+    }
+
+    for (const FileRecord &record : std::span(GetColumn<FileRecord>(Files), m_header->FileCount)) {
+        if (!inArena(record.Path)) {
+            return false;
+        }
+    }
+
+    for (const OptionRecord &record : std::span(GetColumn<OptionRecord>(Options), m_header->OptionCount)) {
+        if (!inArena(record.Key) || !inArena(record.Value)) {
+            return false;
+        }
+    }
+
+    for (const RepositoryRecord &record : std::span(GetColumn<RepositoryRecord>(Repositories), m_header->RepositoryCount)) {
+        if (!inArena(record.Name) || record.FirstServer > m_header->ServerCount || record.ServerCount > m_header->ServerCount - record.FirstServer) {
+            return false;
+        }
+    }
+
+    for (uint32_t server : std::span(GetColumn<uint32_t>(Servers), m_header->ServerCount)) {
+        if (!inArena(server)) {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -1,71 +1,148 @@
 #include "Config.hpp"
 
-#include <memory>
 #include <fstream>
+#include <stdexcept>
 
 using namespace ALPM;
 
-Config::Section::Section(const std::string &name) :
-    m_name(name) {}
+namespace {
+    constexpr std::string_view WHITESPACE = " \t\r";
 
-auto Config::Section::operator[](const std::string &option) const -> std::optional<const Value> {
-    return GetOption(option);
+    auto Trim(std::string_view text) -> std::string_view {
+        std::size_t begin = text.find_first_not_of(WHITESPACE);
+        if (begin == text.npos) {
+            return {};
+        }
+
+        return text.substr(begin, text.find_last_not_of(WHITESPACE) - begin + 1);
+    }
+}  // namespace
+
+auto Config::Section::Value::GetWords() const -> std::vector<std::string_view> {
+    std::vector<std::string_view> words;
+
+    std::size_t begin = m_value.find_first_not_of(" \t");
+    while (begin != m_value.npos) {
+        std::size_t end = m_value.find_first_of(" \t", begin);
+        words.push_back(m_value.substr(begin, end == m_value.npos ? m_value.npos : end - begin));
+        begin = m_value.find_first_not_of(" \t", end);
+    }
+
+    return words;
 }
 
-auto Config::Section::operator[](const std::string &option) -> Value& {
+auto Config::Section::Value::ParseSignatureLevel(std::string_view value, std::bitset<32> base) -> std::bitset<32> {
+    std::bitset<32> flags = base;
+
+    auto apply = [&flags](std::string_view word, Signature::Level required, Signature::Level optional, Signature::Level marginalOk, Signature::Level unknownOk) -> bool {
+        if (word == "Never") {
+            flags.reset(std::to_underlying(required));
+        } else if (word == "Optional") {
+            flags.set(std::to_underlying(required));
+            flags.set(std::to_underlying(optional));
+        } else if (word == "Required") {
+            flags.set(std::to_underlying(required));
+            flags.reset(std::to_underlying(optional));
+        } else if (word == "TrustedOnly") {
+            flags.reset(std::to_underlying(marginalOk));
+            flags.reset(std::to_underlying(unknownOk));
+        } else if (word == "TrustAll") {
+            flags.set(std::to_underlying(marginalOk));
+            flags.set(std::to_underlying(unknownOk));
+        } else {
+            return false;
+        }
+
+        return true;
+    };
+
+    Value level(value);
+    for (std::string_view word : level.GetWords()) {
+        // Without a Package or Database prefix, a word applies to both.
+        bool package = !word.starts_with("Database");
+        bool database = !word.starts_with("Package");
+        if (!package) {
+            word.remove_prefix(std::string_view("Database").size());
+        } else if (!database) {
+            word.remove_prefix(std::string_view("Package").size());
+        }
+
+        if ((package && !apply(word, Signature::Level::PackageRequires, Signature::Level::PackageOptional, Signature::Level::PackageMarginalOk, Signature::Level::PackageUnknownOk))
+            || (database && !apply(word, Signature::Level::DatabaseRequires, Signature::Level::DatabaseOptional, Signature::Level::DatabaseMarginalOk, Signature::Level::DatabaseUnknownOk))) {
+            throw std::runtime_error(std::format("Unknown configuration entry: {}", word));
+        }
+    }
+
+    return flags;
+}
+
+Config::Section::Section(std::string_view name) :
+    m_name(Intern(name)) {}
+
+auto Config::Section::operator[](std::string_view option) const -> const Value* {
     return GetOption(option);
 }
 
-auto Config::Section::GetName() const -> std::string {
-    return m_name;
+auto Config::Section::operator[](std::string_view option) -> Value& {
+    return GetOption(option);
 }
 
-auto Config::Section::GetOptions() const -> std::multimap<std::string, Value> {
-    return m_options;
+auto Config::Section::GetName() const -> std::string_view {
+    return m_name;
 }
 
-auto Config::Section::GetOptions() -> std::multimap<std::string, Value>& {
+auto Config::Section::GetOptions() const -> const std::unordered_map<std::string_view, std::vector<Value>>& {
     return m_options;
 }
 
-auto Config::Section::GetOptions(const std::string &option) -> std::vector<std::reference_wrapper<Value>> {
-    std::vector<std::reference_wrapper<Value>> options{};
-    for (auto [it, end] = m_options.equal_range(option); it != end; it++) {
-        options.emplace_back(it->second);
+auto Config::Section::GetOptions(std::string_view option) -> std::span<Value> {
+    auto it = m_options.find(option);
+    if (it == m_options.end()) {
+        return {};
     }
 
-    return options;
+    return it->second;
 }
 
-auto Config::Section::GetOptions(const std::string &option) const -> std::vector<Value> {
-    std::vector<Value> options;
-    for (auto [it, end] = m_options.equal_range(option); it != end; it++) {
-        options.push_back(it->second);
+auto Config::Section::GetOptions(std::string_view option) const -> std::span<const Value> {
+    auto it = m_options.find(option);
+    if (it == m_options.end()) {
+        return {};
     }
 
-    return options;
+    return it->second;
 }
 
-auto Config::Section::GetOption(const std::string &name) const -> std::optional<const Value> {
-    if (m_options.contains(name)) {
-        return std::make_optional<const Value>(m_options.find(name)->second);
+auto Config::Section::GetOption(std::string_view option) const -> const Value* {
+    auto it = m_options.find(option);
+    if (it == m_options.end()) {
+        return nullptr;
     }
-    return {};
+
+    return &it->second.front();
 }
 
-auto Config::Section::GetOption(const std::string &name) -> Value& {
-    if (m_options.contains(name)) {
-        return m_options.find(name)->second;
+auto Config::Section::GetOption(std::string_view option) -> Value& {
+    std::vector<Value> &values = m_options[Intern(option)];
+    if (values.empty()) {
+        values.emplace_back(std::string_view());
     }
 
-    m_options.emplace(name, Value(name));
-    return m_options.find(name)->second;
+    return values.front();
 }
 
-auto Config::Section::HasOption(const std::string &option) const -> bool {
+auto Config::Section::HasOption(std::string_view option) const -> bool {
     return m_options.contains(option);
 }
 
+auto Config::Section::AddOption(std::string_view key, std::string_view value, const std::shared_ptr<const std::string> &buffer) -> void {
+    if (m_buffers.empty() || m_buffers.back() != buffer) {
+        m_buffers.push_back(buffer);
+    }
+
+    m_options[key].emplace_back(value);
+}
+
 Config::Config(const std::filesystem::path &configFile) :
     m_sections()
 {
@@ -74,93 +151,141 @@ Config::Config(const std::filesystem::path &configFile) :
 
 auto Config::LoadFile(const std::filesystem::path &configFile) -> void {
     if (!std::filesystem::exists(configFile)) {
-        throw std::filesystem::filesystem_error("Failed to parse configuration file", std::make_error_code(std::errc::no_such_file_or_directory));
+        throw std::filesystem::filesystem_error("Failed to parse configuration file", configFile, std::make_error_code(std::errc::no_such_file_or_directory));
     }
 
-    std::fstream file(configFile, std::fstream::in);
+    m_files.push_back(configFile);
+
+    std::optional<std::size_t> current;
+    Parse(ReadFile(configFile), current);
+}
+
+auto Config::Parse(const std::shared_ptr<const std::string> &buffer, std::optional<std::size_t> &current) -> void {
+    std::string_view text = *buffer;
+
+    // Mirrorlists repeat the same key thousands of times.
+    std::string_view lastKey;
+    std::string_view lastInterned;
 
-    std::string line;
+    while (!text.empty()) {
+        std::size_t end = text.find('\n');
+        std::string_view line = text.substr(0, end);
+        text.remove_prefix(end == text.npos ? text.size() : end + 1);
 
-    std::unique_ptr<Section> currentSection;
-    while (std::getline(file, line)) {
-        // Makes sure there are no spaces in front of the string
-        line = line.substr(line.find_first_not_of(' ') == line.npos ? 0 : line.find_first_not_of(' '));
-        if (line.starts_with('#')) {
-            // Skip comments
+        // SomeKey = SomeValue # Some comment
+        line = Trim(line.substr(0, line.find('#')));
+        if (line.empty()) {
             continue;
         }
 
         if (line.starts_with('[')) {
-            std::string sectionName = line.substr(1).substr(0, line.substr(1).find_first_of(']'));
-            if (currentSection.get()) {
-                m_sections.push_back(*currentSection);
-                currentSection = std::make_unique<Section>(sectionName);
-            } else {
-                currentSection = std::make_unique<Section>(sectionName);
-            }
+            std::string_view name = line.substr(1, line.find(']') == line.npos ? line.npos : line.find(']') - 1);
+            current = AddSection(name);
+            continue;
+        }
 
+        // Options outside of a section don't belong anywhere.
+        if (!current) {
             continue;
-        } else if (line.contains('=')) {
-            // SomeKey = SomeValue # Some comment
-            std::string key = line.substr(0, line.find_first_of('='));
-            key = key.substr(0, key.find_last_not_of(' ') + 1);
-
-            std::string value = line.substr(line.find_first_of('=') + 1);
-            value = value.substr(value.find_first_not_of(' ') == value.npos ? 0 : value.find_first_not_of(' '));
-
-            // Handle an include in the config
-            if (key == "Include") {
-                std::fstream include(value, std::fstream::in);
-                std::string includeLine{};
-                while (std::getline(include, includeLine)) {
-                    std::string includeKey = includeLine.substr(0, includeLine.find_first_of('='));
-                    includeKey = includeKey.substr(0, includeKey.find_last_not_of(' ') + 1);
-
-                    std::string includeValue = includeLine.substr(includeLine.find_first_of('=') + 1);
-                    includeValue = includeValue.substr(includeValue.find_first_not_of(' ') == includeValue.npos ? 0 : includeValue.find_first_not_of(' '));
-
-                    currentSection->m_options.insert(std::make_pair(includeKey, Section::Value(includeValue)));
-                }
-            } else {
-                currentSection->m_options.insert(std::make_pair(key, Section::Value(value)));
+        }
+
+        // Options without a value, like `Color` or a hook's `NeedsTargets`,
+        // have an empty one.
+        std::size_t equals = line.find('=');
+        std::string_view key = Trim(line.substr(0, equals));
+        std::string_view value = equals == line.npos ? std::string_view() : Trim(line.substr(equals + 1));
+
+        // Handle an include in the config
+        if (key == "Include") {
+            std::filesystem::path include(value);
+            m_files.push_back(include);
+
+            std::error_code error;
+            if (std::filesystem::exists(include, error)) {
+                Parse(ReadFile(include), current);
             }
+            continue;
         }
+
+        if (key != lastKey) {
+            lastKey = key;
+            lastInterned = Intern(key);
+        }
+
+        m_sections[*current].AddOption(lastInterned, value, buffer);
     }
 }
 
-auto Config::operator[](const std::string &sectionName) const -> std::optional<const Section> {
-    return GetSection(sectionName);
+auto Config::AddSection(std::string_view name) -> std::size_t {
+    m_sections.emplace_back(name);
+
+    std::size_t position = m_sections.size() - 1;
+    m_index.try_emplace(m_sections.back().GetName(), position);
+
+    return position;
+}
+
+auto Config::ReadFile(const std::filesystem::path &file) -> std::shared_ptr<const std::string> {
+    std::ifstream stream(file, std::ios::binary);
+    if (!stream) {
+        throw std::filesystem::filesystem_error("Failed to read configuration file", file, std::make_error_code(std::errc::io_error));
+    }
+
+    std::string buffer;
+    std::error_code error;
+    std::uintmax_t size = std::filesystem::file_size(file, error);
+    if (!error) {
+        buffer.resize(size);
+        stream.read(buffer.data(), static_cast<std::streamsize>(size));
+        buffer.resize(static_cast<std::size_t>(stream.gcount()));
+    } else {
+        buffer.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    }
+
+    return std::make_shared<const std::string>(std::move(buffer));
 }
 
-auto Config::operator[](const std::string &sectionName) -> Section {
+auto Config::operator[](std::string_view sectionName) const -> const Section* {
     return GetSection(sectionName);
 }
 
-auto Config::GetSections() const -> std::vector<Section> {
-    return m_sections;
+auto Config::operator[](std::string_view sectionName) -> Section& {
+    return GetSection(sectionName);
 }
 
-auto Config::GetSections() -> std::vector<Section>& {
+auto Config::GetSections() const -> const std::vector<Section>& {
     return m_sections;
 }
 
-auto Config::GetSection(const std::string &sectionName) const -> std::optional<const Section> {
-    for (const Section &section : m_sections) {
-        if (section.GetName() == sectionName) {
-            return section;
-        }
+auto Config::GetSection(std::string_view sectionName) const -> const Section* {
+    auto it = m_index.find(sectionName);
+    if (it == m_index.end()) {
+        return nullptr;
     }
 
-    return {};
+    return &m_sections[it->second];
 }
 
-auto Config::GetSection(const std::string &sectionName) -> Section& {
-    for (Section &section : m_sections) {
-        if (section.GetName() == sectionName) {
-            return section;
-        }
+auto Config::GetSection(std::string_view sectionName) -> Section& {
+    auto it = m_index.find(sectionName);
+    if (it != m_index.end()) {
+        return m_sections[it->second];
     }
 
-    return m_sections.emplace_back(sectionName);
+    return m_sections[AddSection(sectionName)];
+}
+
+auto Config::GetFiles() const -> const std::vector<std::filesystem::path>& {
+    return m_files;
 }
 
+auto Config::Intern(std::string_view name) -> std::string_view {
+    std::lock_guard lock(s_mutex);
+
+    auto it = s_names.find(name);
+    if (it == s_names.end()) {
+        it = s_names.emplace(name).first;
+    }
+
+    return *it;
+}
@@ -0,0 +1,312 @@
+#include "ContentCache.hpp"
+#include "Package.hpp"
+
+#include <alpm.h>
+
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+using namespace ALPM;
+
+namespace {
+    // Unique per thread, so importing the same blob twice at once can't mix
+    // up the two staging files.
+    auto GetStagingPath(const std::filesystem::path &path) -> std::filesystem::path {
+        std::filesystem::path staging = path;
+        staging += std::format(".{}.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()));
+        return staging;
+    }
+
+    auto Reflink(const std::filesystem::path &source, const std::filesystem::path &destination) -> bool {
+        int input = open(source.c_str(), O_RDONLY | O_CLOEXEC);
+        if (input < 0) {
+            return false;
+        }
+
+        int output = open(destination.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (output < 0) {
+            close(input);
+            return false;
+        }
+
+        bool cloned = ioctl(output, FICLONE, input) == 0;
+        close(input);
+        close(output);
+
+        if (!cloned) {
+            unlink(destination.c_str());
+        }
+
+        return cloned;
+    }
+
+    // Holds a flock on the cache's lock file while it lives. Collecting takes
+    // it exclusively and adding or releasing references shares it, so other
+    // processes using the cache can't add a reference between the collector
+    // reading `refs/` and deleting the blobs it found unreferenced.
+    class CacheLock {
+        public:
+            CacheLock(const std::filesystem::path &directory, int operation) {
+                std::error_code error;
+                std::filesystem::create_directories(directory, error);
+
+                m_fd = open((directory / "lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+                if (m_fd >= 0 && flock(m_fd, operation) != 0) {
+                    close(m_fd);
+                    m_fd = -1;
+                }
+            }
+
+            ~CacheLock() {
+                if (m_fd >= 0) {
+                    close(m_fd);
+                }
+            }
+
+            CacheLock(const CacheLock&) = delete;
+            auto operator=(const CacheLock&) -> CacheLock& = delete;
+
+            auto IsLocked() const -> bool {
+                return m_fd >= 0;
+            }
+
+        private:
+            int m_fd{-1};
+    };
+}  // namespace
+
+ContentCache::ContentCache(std::filesystem::path directory) :
+    m_directory(std::move(directory)),
+    m_references(ReadReferences(m_directory)) {}
+
+auto ContentCache::Contains(const std::string &sha256) const -> bool {
+    std::error_code error;
+    return IsValidHash(sha256) && std::filesystem::is_regular_file(GetBlobPath(sha256), error);
+}
+
+auto ContentCache::GetBlobPath(const std::string &sha256) const -> std::filesystem::path {
+    return m_directory / "blobs" / sha256.substr(0, 2) / sha256;
+}
+
+auto ContentCache::Import(const std::filesystem::path &file, const std::string &sha256, bool verified) -> bool {
+    if (!IsValidHash(sha256)) {
+        return false;
+    }
+
+    if (!verified) {
+        char *actual = alpm_compute_sha256sum(file.c_str());
+        bool matches = actual != nullptr && sha256 == actual;
+        std::free(actual);
+
+        if (!matches) {
+            return false;
+        }
+    }
+
+    if (!Contains(sha256)) {
+        std::filesystem::path blob = GetBlobPath(sha256);
+        std::filesystem::path staging = GetStagingPath(blob);
+
+        std::error_code error;
+        std::filesystem::create_directories(blob.parent_path(), error);
+        if (!Link(file, staging)) {
+            return false;
+        }
+
+        std::filesystem::rename(staging, blob, error);
+        if (error) {
+            std::filesystem::remove(staging, error);
+            return false;
+        }
+    }
+
+    if (verified) {
+        MarkVerified(sha256);
+    }
+
+    return true;
+}
+
+auto ContentCache::Import(const Package &package, const std::filesystem::path &file, bool verified) -> bool {
+    return Import(file, package.GetSHA256Sum(), verified);
+}
+
+auto ContentCache::Materialize(const std::string &sha256, const std::filesystem::path &destination) const -> bool {
+    if (!Contains(sha256)) {
+        return false;
+    }
+
+    std::filesystem::path blob = GetBlobPath(sha256);
+
+    std::error_code error;
+    if (std::filesystem::equivalent(blob, destination, error)) {
+        return true;
+    }
+
+    std::filesystem::create_directories(destination.parent_path(), error);
+
+    std::filesystem::path staging = GetStagingPath(destination);
+    if (!Link(blob, staging)) {
+        return false;
+    }
+
+    std::filesystem::rename(staging, destination, error);
+    if (error) {
+        std::filesystem::remove(staging, error);
+        return false;
+    }
+
+    return true;
+}
+
+auto ContentCache::Materialize(const Package &package, const std::filesystem::path &directory) const -> bool {
+    return Materialize(package.GetSHA256Sum(), directory / package.GetFilename());
+}
+
+auto ContentCache::IsVerified(const std::string &sha256) const -> bool {
+    std::error_code error;
+    return IsValidHash(sha256) && std::filesystem::exists(m_directory / "verified" / sha256, error);
+}
+
+auto ContentCache::MarkVerified(const std::string &sha256) -> void {
+    if (!IsValidHash(sha256)) {
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(m_directory / "verified", error);
+    std::ofstream(m_directory / "verified" / sha256);
+}
+
+auto ContentCache::Reference(const std::string &revision, const std::string &sha256) -> void {
+    if (!IsValidRevision(revision) || !IsValidHash(sha256)) {
+        return;
+    }
+
+    // Taken before the mutex, in the same order as `Collect`.
+    CacheLock cacheLock(m_directory, LOCK_SH);
+    std::lock_guard lock(m_mutex);
+    if (!m_references[revision].insert(sha256).second) {
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(m_directory / "refs", error);
+    std::ofstream(m_directory / "refs" / revision, std::ios::app) << sha256 << '\n';
+}
+
+auto ContentCache::Release(const std::string &revision) -> void {
+    if (!IsValidRevision(revision)) {
+        return;
+    }
+
+    CacheLock cacheLock(m_directory, LOCK_SH);
+    std::lock_guard lock(m_mutex);
+    m_references.erase(revision);
+
+    std::error_code error;
+    std::filesystem::remove(m_directory / "refs" / revision, error);
+}
+
+auto ContentCache::GetReferenceCount(const std::string &sha256) const -> std::size_t {
+    std::lock_guard lock(m_mutex);
+    return static_cast<std::size_t>(std::ranges::count_if(m_references, [&sha256](const auto &revision) -> bool {
+        return revision.second.contains(sha256);
+    }));
+}
+
+auto ContentCache::Collect() -> std::size_t {
+    // Without the lock another process could be referencing a blob right now.
+    CacheLock cacheLock(m_directory, LOCK_EX);
+    if (!cacheLock.IsLocked()) {
+        return 0;
+    }
+
+    // Other processes may have added references since this one last read them.
+    std::set<std::string> referenced;
+    {
+        std::lock_guard lock(m_mutex);
+        m_references = ReadReferences(m_directory);
+        for (const auto &[revision, blobs] : m_references) {
+            referenced.insert(blobs.begin(), blobs.end());
+        }
+    }
+
+    std::size_t removed = 0;
+    std::error_code error;
+    for (const std::filesystem::directory_entry &entry : std::filesystem::recursive_directory_iterator(m_directory / "blobs", error)) {
+        std::string sha256 = entry.path().filename().string();
+        if (!entry.is_regular_file(error) || !IsValidHash(sha256) || referenced.contains(sha256)) {
+            continue;
+        }
+
+        // Materialized hardlinks keep the data alive for as long as a root's
+        // cache still has them.
+        if (std::filesystem::remove(entry.path(), error)) {
+            std::filesystem::remove(m_directory / "verified" / sha256, error);
+            removed++;
+        }
+    }
+
+    return removed;
+}
+
+auto ContentCache::ReadReferences(const std::filesystem::path &directory) -> std::map<std::string, std::set<std::string>> {
+    std::map<std::string, std::set<std::string>> references;
+
+    std::error_code error;
+    for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(directory / "refs", error)) {
+        std::string revision = entry.path().filename().string();
+        if (!IsValidRevision(revision)) {
+            continue;
+        }
+
+        std::ifstream file(entry.path());
+        std::string sha256;
+        while (std::getline(file, sha256)) {
+            if (IsValidHash(sha256)) {
+                references[revision].insert(sha256);
+            }
+        }
+    }
+
+    return references;
+}
+
+auto ContentCache::IsValidHash(std::string_view sha256) -> bool {
+    return sha256.size() == 64 && std::ranges::all_of(sha256, [](char c) -> bool {
+        return std::isxdigit(static_cast<unsigned char>(c)) != 0 && !std::isupper(static_cast<unsigned char>(c));
+    });
+}
+
+auto ContentCache::IsValidRevision(std::string_view revision) -> bool {
+    // Revisions are used as file names.
+    return !revision.empty() && revision.front() != '.' && revision.find('/') == std::string_view::npos;
+}
+
+auto ContentCache::Link(const std::filesystem::path &source, const std::filesystem::path &destination) -> bool {
+    std::error_code error;
+    std::filesystem::create_hard_link(source, destination, error);
+    if (!error) {
+        return true;
+    }
+
+    // Hardlinks can't cross filesystems, or btrfs subvolumes, but reflinks
+    // between subvolumes of the same filesystem still share the data.
+    if (Reflink(source, destination)) {
+        return true;
+    }
+
+    return std::filesystem::copy_file(source, destination, error);
+}
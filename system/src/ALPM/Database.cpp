@@ -1,5 +1,8 @@
 #include "Database.hpp"
 #include "ALPM.hpp"
+#include "CompiledConfig.hpp"
+#include "Handle.hpp"
+#include "MirrorRanking.hpp"
 #include "Package.hpp"
 #include "Utils.hpp"
 
@@ -7,7 +10,6 @@
 
 #include <cstring>
 #include <format>
-#include <regex>
 
 using namespace ALPM;
 
@@ -15,28 +17,17 @@ Database::Database(alpm_db_t *db) :
     m_alpmdb(db) {}
 
 auto Database::Initialize() -> void {
-    Config config = ALPM::GetConfig();
-    std::bitset<32> defaultSigLevel = config.GetSection("options").GetOption("SigLevel").As<Signature::Level>();
-
-    for (const Config::Section &section : config.GetSections()) {
-        if (section.GetName() == "options") {
-            continue;
-        }
-        std::vector<std::string> servers;
-        if (section.HasOption("Server")) {
-            for (const Config::Section::Value &server : section.GetOptions("Server")) {
-                std::string serverString = server.As<std::string>();
-                serverString = std::regex_replace(serverString, std::regex("\\$repo"), section.GetName());
-                serverString = std::regex_replace(serverString, std::regex("\\$arch"), Utils::GetSystemArchitecture());
-                servers.push_back(serverString);
-            }
-        }
-        
-        if (!RegisterSyncDatabase(section.GetName(), (section.HasOption("SigLevel") ? section.GetOption("SigLevel")->As<Signature::Level>() : defaultSigLevel), servers)) {
-            throw std::runtime_error(std::format("Failed to register sync database {}: {}", section.GetName(), ALPM::GetError()));
+    std::shared_ptr<const CompiledConfig> config = ALPM::GetCurrentHandle().GetCompiledConfig();
+    std::shared_ptr<MirrorRanking> ranking = MirrorRanking::Get();
 
+    for (const CompiledConfig::Repository &repository : config->GetRepositories()) {
+        std::string name(repository.GetName());
+        if (!RegisterSyncDatabase(name, repository.GetSigLevel(), ranking->Rank(repository.GetServers()))) {
+            throw std::runtime_error(std::format("Failed to register sync database {}: {}", name, ALPM::GetError()));
         }
     }
+
+    ALPM::InvalidateDatabases();
 }
 
 auto Database::RegisterSyncDatabase(const std::string &treename, const std::bitset<32> &siglevelFlags, const std::vector<std::string> &servers) -> bool {
@@ -48,9 +39,7 @@ auto Database::RegisterSyncDatabase(const std::string &treename, const std::bits
         return false;
     }
 
-    db.SetServers(servers);
-
-    return true;
+    return db.SetServers(servers);
 }
 
 auto Database::GetName() const -> std::string {
@@ -63,7 +52,7 @@ auto Database::GetSigLevel() const -> int {
 
 auto Database::IsValid() const -> std::optional<std::string> {
     if (alpm_db_get_valid(m_alpmdb) != 0) {
-        return ALPM::GetError();
+        return GetOwner().GetError();
     }
 
     return {};
@@ -74,20 +63,15 @@ auto Database::GetPackage(const std::string &name) const -> Package {
 }
 
 auto Database::Search(const std::string &expression) const -> std::vector<Package> {
-    alpm_list_t *term = new alpm_list_t;
-    term->prev = term;
-    term->next = nullptr;
-    term->data = new char[expression.size()];
-    
-    std::strcpy(static_cast<char*>(term->data), expression.c_str());
+    // libalpm only reads the needles, so the expression doesn't need to be copied.
+    alpm_list_t *term = alpm_list_add(nullptr, const_cast<char*>(expression.c_str()));
 
     alpm_list_t *list = nullptr;
     alpm_db_search(m_alpmdb, term, &list);
+    alpm_list_free(term);
 
-    std::vector<Package> results;
-    for (size_t i = 0; i < alpm_list_count(list); i++) {
-        results.emplace_back(static_cast<alpm_pkg_t*>(alpm_list_nth(list, i)->data));
-    }
+    std::vector<Package> results = Utils::ALPMListToVector<Package>(list);
+    alpm_list_free(list);
 
     return results;
 }
@@ -97,14 +81,25 @@ auto Database::GetPackageCache() const -> std::vector<Package> {
     return Utils::ALPMListToVector<Package>(pkgCache);
 }
 
+auto Database::GetPackageCacheView() const -> Utils::ALPMListView<Package> {
+    return Utils::ALPMListView<Package>(alpm_db_get_pkgcache(m_alpmdb));
+}
+
 auto Database::GetServers() const -> std::vector<std::string> {
     return Utils::ALPMListToVector<std::string>(alpm_db_get_servers(m_alpmdb));
 }
 
+auto Database::GetServersView() const -> Utils::ALPMListView<std::string_view> {
+    return Utils::ALPMListView<std::string_view>(alpm_db_get_servers(m_alpmdb));
+}
+
 auto Database::SetServers(const std::vector<std::string> &urls) -> bool {
+    // libalpm copies every server, the list is still ours.
     alpm_list_t *list = Utils::VectorToALPMList(urls);
-    return alpm_db_set_servers(m_alpmdb, list);
+    bool set = alpm_db_set_servers(m_alpmdb, list) == 0;
     FREELIST(list);
+
+    return set;
 }
 
 auto Database::AddServer(const std::string &url) -> bool {
@@ -119,6 +114,11 @@ auto Database::GetHandle() const -> alpm_db_t* {
     return m_alpmdb;
 }
 
+auto Database::GetOwner() const -> Handle& {
+    Handle *owner = Handle::Find(alpm_db_get_handle(m_alpmdb));
+    return owner ? *owner : ALPM::GetCurrentHandle();
+}
+
 auto Database::MarkUpdate() const -> void {
-    ALPM::GetCurrentTransaction()->AddDatabaseOperation(*this, Transaction::DatabaseOperation::Update);
+    GetOwner().GetCurrentTransaction()->AddDatabaseOperation(*this, Transaction::DatabaseOperation::Update);
 }
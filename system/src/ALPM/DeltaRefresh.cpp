@@ -0,0 +1,349 @@
+#include "DeltaRefresh.hpp"
+#include "ALPM.hpp"
+#include "Downloader.hpp"
+
+#include <alpm.h>
+#include <archive.h>
+#include <archive_entry.h>
+
+#include <algorithm>
+#include <array>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace ALPM;
+
+namespace {
+    constexpr std::size_t BLOCK_SIZE = 10240;
+
+    // The top level directory of a database entry, e.g. `bash-5.2.026-2` for
+    // `bash-5.2.026-2/desc`.
+    auto GetEntryName(std::string_view path) -> std::string {
+        return std::string(path.substr(0, path.find('/')));
+    }
+
+    auto CopyData(archive *reader, archive *writer) -> bool {
+        const void *buffer = nullptr;
+        std::size_t size = 0;
+        int64_t offset = 0;
+
+        int result = ARCHIVE_OK;
+        while ((result = archive_read_data_block(reader, &buffer, &size, &offset)) == ARCHIVE_OK) {
+            if (archive_write_data(writer, buffer, size) < 0) {
+                return false;
+            }
+        }
+
+        return result == ARCHIVE_EOF;
+    }
+
+    auto WriteFile(archive *writer, const std::string &path, const std::string &contents) -> bool {
+        archive_entry *entry = archive_entry_new();
+        archive_entry_set_pathname(entry, path.c_str());
+        archive_entry_set_filetype(entry, AE_IFREG);
+        archive_entry_set_perm(entry, 0644);
+        archive_entry_set_size(entry, static_cast<int64_t>(contents.size()));
+
+        bool written = archive_write_header(writer, entry) == ARCHIVE_OK && archive_write_data(writer, contents.data(), contents.size()) >= 0;
+        archive_entry_free(entry);
+
+        return written;
+    }
+
+    auto WriteDirectory(archive *writer, const std::string &path) -> bool {
+        archive_entry *entry = archive_entry_new();
+        archive_entry_set_pathname(entry, std::format("{}/", path).c_str());
+        archive_entry_set_filetype(entry, AE_IFDIR);
+        archive_entry_set_perm(entry, 0755);
+
+        bool written = archive_write_header(writer, entry) == ARCHIVE_OK;
+        archive_entry_free(entry);
+
+        return written;
+    }
+}  // namespace
+
+DeltaRefresh::DeltaRefresh(const Database &database) :
+    m_database(database.GetHandle()),
+    m_name(database.GetName()),
+    m_path(std::filesystem::path(alpm_option_get_dbpath(ALPM::GetHandle())) / "sync" / std::format("{}.db", m_name)) {}
+
+auto DeltaRefresh::Apply() -> bool {
+    int sigLevel = alpm_db_get_siglevel(m_database.GetHandle());
+    if (sigLevel & ALPM_SIG_USE_DEFAULT) {
+        sigLevel = alpm_option_get_default_siglevel(ALPM::GetHandle());
+    }
+
+    if ((sigLevel & ALPM_SIG_DATABASE) && !(sigLevel & ALPM_SIG_DATABASE_OPTIONAL)) {
+        return false;
+    }
+
+    std::vector<std::string> servers = m_database.GetServers();
+    if (servers.empty()) {
+        return false;
+    }
+
+    std::optional<std::set<std::string>> local = ReadEntries(m_path);
+    if (!local) {
+        return false;
+    }
+
+    // Running out of space or permissions fails the refresh like anything
+    // else, leaving the full download to try.
+    std::error_code error;
+    std::filesystem::path staging = m_path.parent_path() / std::format(".{}.delta", m_name);
+    std::filesystem::remove_all(staging, error);
+    if (!error) {
+        std::filesystem::create_directories(staging, error);
+    }
+    if (error) {
+        return false;
+    }
+
+    // Whatever happens, the staging directory shouldn't outlive the refresh.
+    auto finish = [&staging](bool result) -> bool {
+        std::error_code error;
+        std::filesystem::remove_all(staging, error);
+        return result;
+    };
+
+    Downloader manifestDownloader;
+    manifestDownloader.Add(Downloader::Job{.Filename = std::format("{}.manifest", m_name), .Servers = servers, .Directory = staging, .ShowProgress = false});
+
+    Downloader::Result manifestResult = manifestDownloader.Run().front();
+    if (manifestResult.Error) {
+        return finish(false);
+    }
+
+    std::optional<std::set<std::string>> remote = ReadManifest(manifestResult.Path);
+    if (!remote) {
+        return finish(false);
+    }
+
+    m_added.clear();
+    m_removed.clear();
+    std::ranges::set_difference(*remote, *local, std::back_inserter(m_added));
+    std::ranges::set_difference(*local, *remote, std::back_inserter(m_removed));
+
+    if (m_added.empty() && m_removed.empty()) {
+        return finish(true);
+    }
+
+    if (static_cast<double>(m_added.size()) > static_cast<double>(remote->size()) * MAX_CHANGED_FRACTION) {
+        return finish(false);
+    }
+
+    std::filesystem::path entries = staging / "entries";
+
+    Downloader entryDownloader;
+    for (const std::string &entry : m_added) {
+        Downloader::Job job{.Filename = "desc", .Directory = entries / entry, .ShowProgress = false};
+        for (const std::string &server : servers) {
+            job.Servers.push_back(std::format("{}/{}.db.d/{}", server, m_name, entry));
+        }
+
+        entryDownloader.Add(std::move(job));
+    }
+
+    if (std::ranges::any_of(entryDownloader.Run(), [](const Downloader::Result &result) -> bool {return result.Error.has_value();})) {
+        return finish(false);
+    }
+
+    std::filesystem::path rewritten = staging / std::format("{}.db", m_name);
+    if (!Rewrite(entries, rewritten)) {
+        return finish(false);
+    }
+
+    std::filesystem::rename(rewritten, m_path, error);
+    if (error) {
+        return finish(false);
+    }
+
+    // An optional signature no longer matches the rewritten file, and libalpm
+    // would reject the database if it found one. The full download replaces
+    // both if it can't be removed.
+    std::filesystem::path signature = m_path;
+    signature += ".sig";
+    std::filesystem::remove(signature, error);
+
+    return finish(!error);
+}
+
+auto DeltaRefresh::GetAdded() const -> const std::vector<std::string>& {
+    return m_added;
+}
+
+auto DeltaRefresh::GetRemoved() const -> const std::vector<std::string>& {
+    return m_removed;
+}
+
+auto DeltaRefresh::Publish(const std::filesystem::path &database, const std::filesystem::path &directory) -> void {
+    std::string name = database.stem().string();
+    std::filesystem::path entries = directory / std::format("{}.db.d", name);
+
+    std::error_code error;
+    std::filesystem::create_directories(entries, error);
+    if (error) {
+        throw std::runtime_error(std::format("Failed to publish {}: {}", database.string(), error.message()));
+    }
+
+    archive *reader = archive_read_new();
+    archive_read_support_filter_all(reader);
+    archive_read_support_format_all(reader);
+    if (archive_read_open_filename(reader, database.c_str(), BLOCK_SIZE) != ARCHIVE_OK) {
+        const char *message = archive_error_string(reader);
+        std::string reason = message != nullptr ? message : "Could not open the database";
+        archive_read_free(reader);
+
+        throw std::runtime_error(std::format("Failed to publish {}: {}", database.string(), reason));
+    }
+
+    std::set<std::string> names;
+    archive_entry *entry = nullptr;
+    while (archive_read_next_header(reader, &entry) == ARCHIVE_OK) {
+        std::string path = archive_entry_pathname(entry);
+        names.insert(GetEntryName(path));
+
+        if (archive_entry_filetype(entry) != AE_IFREG) {
+            continue;
+        }
+
+        std::filesystem::path output = entries / path;
+        std::filesystem::create_directories(output.parent_path(), error);
+        if (error) {
+            archive_read_free(reader);
+            throw std::runtime_error(std::format("Failed to publish {}: {}", database.string(), error.message()));
+        }
+
+        std::ofstream file(output, std::ios::binary);
+        std::array<char, BLOCK_SIZE> buffer{};
+        ssize_t length = 0;
+        while ((length = archive_read_data(reader, buffer.data(), buffer.size())) > 0) {
+            file.write(buffer.data(), length);
+        }
+    }
+
+    archive_read_free(reader);
+
+    std::ofstream manifest(directory / std::format("{}.manifest", name), std::ios::trunc);
+    for (const std::string &entryName : names) {
+        manifest << entryName << '\n';
+    }
+}
+
+auto DeltaRefresh::ReadEntries(const std::filesystem::path &database) -> std::optional<std::set<std::string>> {
+    archive *reader = archive_read_new();
+    archive_read_support_filter_all(reader);
+    archive_read_support_format_all(reader);
+    if (archive_read_open_filename(reader, database.c_str(), BLOCK_SIZE) != ARCHIVE_OK) {
+        archive_read_free(reader);
+        return {};
+    }
+
+    std::set<std::string> entries;
+    archive_entry *entry = nullptr;
+    int result = ARCHIVE_OK;
+    while ((result = archive_read_next_header(reader, &entry)) == ARCHIVE_OK) {
+        entries.insert(GetEntryName(archive_entry_pathname(entry)));
+        archive_read_data_skip(reader);
+    }
+
+    archive_read_free(reader);
+
+    // A database that can't be read completely gets replaced entirely.
+    if (result != ARCHIVE_EOF || entries.empty()) {
+        return {};
+    }
+
+    return entries;
+}
+
+auto DeltaRefresh::IsValidEntry(const std::string &entry) -> bool {
+    // Entries become paths, both on the mirror and in the archive.
+    return !entry.empty() && entry.front() != '.' && entry.find('/') == std::string::npos;
+}
+
+auto DeltaRefresh::ReadManifest(const std::filesystem::path &manifest) const -> std::optional<std::set<std::string>> {
+    std::ifstream file(manifest);
+    if (!file) {
+        return {};
+    }
+
+    std::set<std::string> entries;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line.front() == '#') {
+            continue;
+        }
+
+        if (!IsValidEntry(line)) {
+            return {};
+        }
+
+        entries.insert(line);
+    }
+
+    if (entries.empty()) {
+        return {};
+    }
+
+    return entries;
+}
+
+auto DeltaRefresh::Rewrite(const std::filesystem::path &entries, const std::filesystem::path &output) const -> bool {
+    archive *reader = archive_read_new();
+    archive_read_support_filter_all(reader);
+    archive_read_support_format_all(reader);
+
+    archive *writer = archive_write_new();
+    archive_write_set_format_pax_restricted(writer);
+    archive_write_add_filter_gzip(writer);
+
+    auto cleanup = [reader, writer](bool result) -> bool {
+        archive_read_free(reader);
+        bool closed = archive_write_close(writer) == ARCHIVE_OK;
+        archive_write_free(writer);
+        return result && closed;
+    };
+
+    if (archive_read_open_filename(reader, m_path.c_str(), BLOCK_SIZE) != ARCHIVE_OK || archive_write_open_filename(writer, output.c_str()) != ARCHIVE_OK) {
+        return cleanup(false);
+    }
+
+    // Copy every entry that's still in the repository as is.
+    std::set<std::string> removed(m_removed.begin(), m_removed.end());
+    archive_entry *entry = nullptr;
+    int result = ARCHIVE_OK;
+    while ((result = archive_read_next_header(reader, &entry)) == ARCHIVE_OK) {
+        if (removed.contains(GetEntryName(archive_entry_pathname(entry)))) {
+            archive_read_data_skip(reader);
+            continue;
+        }
+
+        if (archive_write_header(writer, entry) != ARCHIVE_OK || !CopyData(reader, writer)) {
+            return cleanup(false);
+        }
+    }
+
+    if (result != ARCHIVE_EOF) {
+        return cleanup(false);
+    }
+
+    for (const std::string &added : m_added) {
+        std::ifstream file(entries / added / "desc", std::ios::binary);
+        if (!file) {
+            return cleanup(false);
+        }
+
+        std::ostringstream contents;
+        contents << file.rdbuf();
+
+        if (!WriteDirectory(writer, added) || !WriteFile(writer, std::format("{}/desc", added), contents.str())) {
+            return cleanup(false);
+        }
+    }
+
+    return cleanup(true);
+}
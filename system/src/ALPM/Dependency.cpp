@@ -1,5 +1,6 @@
 #include "Dependency.hpp"
 #include "Package.hpp"
+#include "Utils.hpp"
 
 #include "alpm.h"
 
@@ -15,6 +16,34 @@ auto Dependency::GetDescription() const -> std::string {
 }
 
 auto Dependency::GetMatchMode() const -> MatchMode {
+    return DependencyView(m_alpmDepend).GetMatchMode();
+}
+
+auto Dependency::GetName() const -> std::string {
+    return m_alpmDepend->name;
+}
+
+auto Dependency::GetNameHash() const -> unsigned long {
+    return m_alpmDepend->name_hash;
+}
+
+auto Dependency::GetVersion() const -> std::string {
+    return m_alpmDepend->version;
+}
+
+auto Dependency::GetHandle() const -> Dependency::UnderlyingType* {
+    return m_alpmDepend;
+}
+
+DependencyView::DependencyView(alpm_depend_t *depend) :
+    m_alpmDepend(depend) {}
+
+auto DependencyView::GetDescription() const -> std::string_view {
+    return Utils::ToStringView(m_alpmDepend->desc);
+}
+
+auto DependencyView::GetMatchMode() const -> Dependency::MatchMode {
+    using MatchMode = Dependency::MatchMode;
     switch (m_alpmDepend->mod) {
         case ALPM_DEP_MOD_ANY:
             return MatchMode::Any;
@@ -33,19 +62,19 @@ auto Dependency::GetMatchMode() const -> MatchMode {
     }
 }
 
-auto Dependency::GetName() const -> std::string {
-    return m_alpmDepend->name;
+auto DependencyView::GetName() const -> std::string_view {
+    return Utils::ToStringView(m_alpmDepend->name);
 }
 
-auto Dependency::GetNameHash() const -> unsigned long {
+auto DependencyView::GetNameHash() const -> unsigned long {
     return m_alpmDepend->name_hash;
 }
 
-auto Dependency::GetVersion() const -> std::string {
-    return m_alpmDepend->version;
+auto DependencyView::GetVersion() const -> std::string_view {
+    return Utils::ToStringView(m_alpmDepend->version);
 }
 
-auto Dependency::GetHandle() const -> Dependency::UnderlyingType* {
+auto DependencyView::GetHandle() const -> DependencyView::UnderlyingType* {
     return m_alpmDepend;
 }
 
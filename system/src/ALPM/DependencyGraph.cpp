@@ -0,0 +1,428 @@
+#include "DependencyGraph.hpp"
+#include "ALPM.hpp"
+#include "Database.hpp"
+#include "Events.hpp"
+#include "PackageIndex.hpp"
+
+#include "Event.hpp"
+
+#include <alpm.h>
+
+#include <algorithm>
+#include <queue>
+#include <unordered_set>
+
+using namespace ALPM;
+
+namespace {
+    auto VersionSatisfies(const char *version, const alpm_depend_t *dependency) -> bool {
+        if (dependency->mod == ALPM_DEP_MOD_ANY) {
+            return true;
+        }
+
+        if (version == nullptr || dependency->version == nullptr) {
+            return false;
+        }
+
+        int result = alpm_pkg_vercmp(version, dependency->version);
+        switch (dependency->mod) {
+            case ALPM_DEP_MOD_EQ:
+                return result == 0;
+            case ALPM_DEP_MOD_GE:
+                return result >= 0;
+            case ALPM_DEP_MOD_LE:
+                return result <= 0;
+            case ALPM_DEP_MOD_GT:
+                return result > 0;
+            case ALPM_DEP_MOD_LT:
+                return result < 0;
+            default:
+                return false;
+        }
+    }
+
+    // Mirrors libalpm's _alpm_depcmp(): the package itself can satisfy the
+    // dependency, otherwise one of its provides can, but an unversioned
+    // provide never satisfies a versioned dependency.
+    auto Satisfies(alpm_pkg_t *pkg, const alpm_depend_t *dependency) -> bool {
+        if (std::string_view(alpm_pkg_get_name(pkg)) == dependency->name && VersionSatisfies(alpm_pkg_get_version(pkg), dependency)) {
+            return true;
+        }
+
+        for (const alpm_list_t *i = alpm_pkg_get_provides(pkg); i != nullptr; i = i->next) {
+            const alpm_depend_t *provide = static_cast<const alpm_depend_t*>(i->data);
+            if (provide->name_hash != dependency->name_hash || std::string_view(provide->name) != dependency->name) {
+                continue;
+            }
+
+            if (dependency->mod == ALPM_DEP_MOD_ANY || (provide->mod == ALPM_DEP_MOD_EQ && VersionSatisfies(provide->version, dependency))) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    auto Compress(const std::vector<std::vector<DependencyGraph::Node>> &lists) -> std::pair<std::vector<uint32_t>, std::vector<DependencyGraph::Node>> {
+        std::vector<uint32_t> offsets;
+        offsets.reserve(lists.size() + 1);
+        offsets.push_back(0);
+
+        std::vector<DependencyGraph::Node> edges;
+        for (const std::vector<DependencyGraph::Node> &list : lists) {
+            edges.insert(edges.end(), list.begin(), list.end());
+            offsets.push_back(static_cast<uint32_t>(edges.size()));
+        }
+
+        return {std::move(offsets), std::move(edges)};
+    }
+}  // namespace
+
+auto DependencyGraph::Adjacency::Get(Node node) const -> std::span<const Node> {
+    return std::span<const Node>(Edges).subspan(Offsets[node], Offsets[node + 1] - Offsets[node]);
+}
+
+DependencyGraph::DependencyGraph(const std::vector<Database> &databases) :
+    m_databases(databases)
+{
+    std::vector<alpm_pkg_t*> packages = Load();
+
+    std::vector<std::vector<Node>> dependencies(packages.size());
+    std::vector<std::vector<Node>> optionalDependencies(packages.size());
+    for (Node node = 0; node < packages.size(); node++) {
+        dependencies[node] = Resolve(packages, node, false);
+        optionalDependencies[node] = Resolve(packages, node, true);
+    }
+
+    std::tie(m_dependencies.Offsets, m_dependencies.Edges) = Compress(dependencies);
+    std::tie(m_optionalDependencies.Offsets, m_optionalDependencies.Edges) = Compress(optionalDependencies);
+    Link();
+}
+
+auto DependencyGraph::Get() -> std::shared_ptr<const DependencyGraph> {
+    uint64_t handle = ALPM::GetCurrentHandle().GetId();
+    std::lock_guard lock(s_mutex);
+
+    std::shared_ptr<const DependencyGraph> &instance = s_instances[handle];
+    if (!instance) {
+        instance = std::make_shared<const DependencyGraph>(Local());
+
+        static std::once_flag registered;
+        std::call_once(registered, []() -> void {
+            // Transactions complete with their handle bound.
+            Event::Event::RegisterCallback<TransactionCompletedEvent>([](const TransactionCompletedEvent &event) -> void {
+                uint64_t handle = ALPM::GetCurrentHandle().GetId();
+                std::lock_guard lock(s_mutex);
+                auto it = s_instances.find(handle);
+                if (it == s_instances.end()) {
+                    return;
+                }
+
+                // Readers may still hold the old graph, so update a copy.
+                DependencyGraph graph(*it->second);
+                graph.Update(event.Removed, event.Added);
+                it->second = std::make_shared<const DependencyGraph>(std::move(graph));
+            });
+
+            Event::Event::RegisterCallback<HandleReleasedEvent>([](const HandleReleasedEvent &event) -> void {
+                std::lock_guard lock(s_mutex);
+                s_instances.erase(event.Handle);
+            });
+        });
+    }
+
+    return instance;
+}
+
+auto DependencyGraph::Local() -> DependencyGraph {
+    return DependencyGraph({ALPM::GetLocalDatabase()});
+}
+
+auto DependencyGraph::Sync() -> DependencyGraph {
+    return DependencyGraph(ALPM::GetSyncDatabases());
+}
+
+auto DependencyGraph::GetNodeCount() const -> std::size_t {
+    return m_names.size();
+}
+
+auto DependencyGraph::GetName(Node node) const -> std::string_view {
+    return m_names[node];
+}
+
+auto DependencyGraph::GetVersion(Node node) const -> std::string_view {
+    return m_versions[node];
+}
+
+auto DependencyGraph::Find(std::string_view name) const -> std::optional<Node> {
+    auto it = m_nameIndex.find(std::string(name));
+    if (it == m_nameIndex.end()) {
+        return {};
+    }
+
+    return it->second;
+}
+
+auto DependencyGraph::GetDependencies(Node node) const -> std::span<const Node> {
+    return m_dependencies.Get(node);
+}
+
+auto DependencyGraph::GetDependents(Node node) const -> std::span<const Node> {
+    return m_dependents.Get(node);
+}
+
+auto DependencyGraph::GetOptionalDependencies(Node node) const -> std::span<const Node> {
+    return m_optionalDependencies.Get(node);
+}
+
+auto DependencyGraph::GetOptionalDependents(Node node) const -> std::span<const Node> {
+    return m_optionalDependents.Get(node);
+}
+
+auto DependencyGraph::GetOrphans() const -> std::vector<Node> {
+    std::vector<Node> orphans;
+    for (Node node = 0; node < m_names.size(); node++) {
+        if (m_installedAsDependency[node] && m_dependents.Get(node).empty()) {
+            orphans.push_back(node);
+        }
+    }
+
+    return orphans;
+}
+
+auto DependencyGraph::GetClosure(Node node, Direction direction, bool optional) const -> std::vector<Node> {
+    const Adjacency &required = direction == Direction::Dependencies ? m_dependencies : m_dependents;
+    const Adjacency &optionals = direction == Direction::Dependencies ? m_optionalDependencies : m_optionalDependents;
+
+    std::vector<bool> visited(m_names.size());
+    visited[node] = true;
+
+    std::vector<Node> closure;
+    std::queue<Node> queue;
+    queue.push(node);
+
+    auto visit = [&](std::span<const Node> edges) -> void {
+        for (Node edge : edges) {
+            if (!visited[edge]) {
+                visited[edge] = true;
+                closure.push_back(edge);
+                queue.push(edge);
+            }
+        }
+    };
+
+    while (!queue.empty()) {
+        Node current = queue.front();
+        queue.pop();
+
+        visit(required.Get(current));
+        if (optional) {
+            visit(optionals.Get(current));
+        }
+    }
+
+    return closure;
+}
+
+auto DependencyGraph::Update(const std::vector<std::string> &removed, const std::vector<std::string> &added) -> void {
+    DependencyGraph previous = std::move(*this);
+    *this = DependencyGraph();
+    m_databases = previous.m_databases;
+    std::vector<alpm_pkg_t*> packages = Load();
+
+    std::unordered_set<std::string_view> changed(removed.begin(), removed.end());
+    changed.insert(added.begin(), added.end());
+
+    // A package has to be resolved again if something it depended on changed,
+    // if one of its dependencies wasn't satisfied before, or if a new package
+    // shares a name or provide with something it depended on, or optionally
+    // depended on without having it.
+    std::vector<bool> affected(previous.m_names.size());
+    auto affectDependents = [&previous, &affected](Node node) -> void {
+        for (Node dependent : previous.m_dependents.Get(node)) {
+            affected[dependent] = true;
+        }
+
+        for (Node dependent : previous.m_optionalDependents.Get(node)) {
+            affected[dependent] = true;
+        }
+    };
+
+    for (Node node = 0; node < previous.m_names.size(); node++) {
+        if (changed.contains(previous.m_names[node])) {
+            affectDependents(node);
+        }
+    }
+
+    for (Node node : previous.m_unresolved) {
+        affected[node] = true;
+    }
+
+    for (Node node = 0; node < packages.size(); node++) {
+        if (!changed.contains(m_names[node])) {
+            continue;
+        }
+
+        auto affectProviders = [&previous, &affected, &affectDependents](unsigned long hash) -> void {
+            if (auto it = previous.m_providers.find(hash); it != previous.m_providers.end()) {
+                std::ranges::for_each(it->second, affectDependents);
+            }
+
+            if (auto it = previous.m_missingOptional.find(hash); it != previous.m_missingOptional.end()) {
+                for (Node dependent : it->second) {
+                    affected[dependent] = true;
+                }
+            }
+        };
+
+        affectProviders(PackageIndex::Hash(m_names[node]));
+        for (const alpm_list_t *i = alpm_pkg_get_provides(packages[node]); i != nullptr; i = i->next) {
+            affectProviders(static_cast<const alpm_depend_t*>(i->data)->name_hash);
+        }
+    }
+
+    // Everything else keeps its edges, translated to the new node numbers.
+    auto translate = [this, &previous](std::span<const Node> edges) -> std::optional<std::vector<Node>> {
+        std::vector<Node> translated;
+        translated.reserve(edges.size());
+        for (Node edge : edges) {
+            auto it = m_nameIndex.find(previous.m_names[edge]);
+            if (it == m_nameIndex.end()) {
+                return {};
+            }
+
+            translated.push_back(it->second);
+        }
+
+        return translated;
+    };
+
+    std::vector<std::vector<Node>> dependencies(packages.size());
+    std::vector<std::vector<Node>> optionalDependencies(packages.size());
+    std::unordered_map<Node, Node> reusedNodes;
+    for (Node node = 0; node < packages.size(); node++) {
+        auto it = previous.m_nameIndex.find(m_names[node]);
+        bool reusable = it != previous.m_nameIndex.end() && !changed.contains(m_names[node]) && !affected[it->second] && m_nameIndex.at(m_names[node]) == node;
+
+        std::optional<std::vector<Node>> reused;
+        std::optional<std::vector<Node>> reusedOptional;
+        if (reusable) {
+            reused = translate(previous.m_dependencies.Get(it->second));
+            reusedOptional = translate(previous.m_optionalDependencies.Get(it->second));
+        }
+
+        if (reused && reusedOptional) {
+            dependencies[node] = std::move(*reused);
+            optionalDependencies[node] = std::move(*reusedOptional);
+            reusedNodes.emplace(it->second, node);
+        } else {
+            dependencies[node] = Resolve(packages, node, false);
+            optionalDependencies[node] = Resolve(packages, node, true);
+        }
+    }
+
+    // Reused packages still miss the optional dependencies they missed before.
+    for (const auto &[hash, nodes] : previous.m_missingOptional) {
+        for (Node node : nodes) {
+            if (auto it = reusedNodes.find(node); it != reusedNodes.end()) {
+                m_missingOptional[hash].push_back(it->second);
+            }
+        }
+    }
+
+    std::tie(m_dependencies.Offsets, m_dependencies.Edges) = Compress(dependencies);
+    std::tie(m_optionalDependencies.Offsets, m_optionalDependencies.Edges) = Compress(optionalDependencies);
+    Link();
+}
+
+auto DependencyGraph::Load() -> std::vector<alpm_pkg_t*> {
+    std::vector<alpm_pkg_t*> packages;
+    for (const Database &database : m_databases) {
+        for (const alpm_list_t *i = alpm_db_get_pkgcache(database.GetHandle()); i != nullptr; i = i->next) {
+            alpm_pkg_t *pkg = static_cast<alpm_pkg_t*>(i->data);
+            Node node = static_cast<Node>(packages.size());
+
+            packages.push_back(pkg);
+            m_names.emplace_back(alpm_pkg_get_name(pkg));
+            m_versions.emplace_back(alpm_pkg_get_version(pkg));
+            m_installedAsDependency.push_back(alpm_pkg_get_reason(pkg) == ALPM_PKG_REASON_DEPEND);
+            m_nameIndex.emplace(m_names.back(), node);
+
+            m_providers[PackageIndex::Hash(m_names.back())].push_back(node);
+            for (const alpm_list_t *j = alpm_pkg_get_provides(pkg); j != nullptr; j = j->next) {
+                m_providers[static_cast<const alpm_depend_t*>(j->data)->name_hash].push_back(node);
+            }
+        }
+    }
+
+    return packages;
+}
+
+auto DependencyGraph::Resolve(std::span<alpm_pkg_t* const> packages, Node node, bool optional) -> std::vector<Node> {
+    const alpm_list_t *list = optional ? alpm_pkg_get_optdepends(packages[node]) : alpm_pkg_get_depends(packages[node]);
+
+    std::vector<Node> edges;
+    bool unresolved = false;
+    for (const alpm_list_t *i = list; i != nullptr; i = i->next) {
+        const alpm_depend_t *dependency = static_cast<const alpm_depend_t*>(i->data);
+
+        bool satisfied = false;
+        if (auto it = m_providers.find(dependency->name_hash); it != m_providers.end()) {
+            for (Node provider : it->second) {
+                if (provider != node && Satisfies(packages[provider], dependency)) {
+                    edges.push_back(provider);
+                    satisfied = true;
+                }
+            }
+        }
+
+        // A package providing its own dependency still counts as satisfied.
+        if (satisfied || Satisfies(packages[node], dependency)) {
+            continue;
+        }
+
+        if (optional) {
+            m_missingOptional[dependency->name_hash].push_back(node);
+        } else {
+            unresolved = true;
+        }
+    }
+
+    if (unresolved) {
+        m_unresolved.push_back(node);
+    }
+
+    std::ranges::sort(edges);
+    auto [first, last] = std::ranges::unique(edges);
+    edges.erase(first, last);
+
+    return edges;
+}
+
+auto DependencyGraph::Link() -> void {
+    m_dependents = Invert(m_dependencies, m_names.size());
+    m_optionalDependents = Invert(m_optionalDependencies, m_names.size());
+}
+
+auto DependencyGraph::Invert(const Adjacency &adjacency, std::size_t nodeCount) -> Adjacency {
+    Adjacency inverted;
+    inverted.Offsets.assign(nodeCount + 1, 0);
+    inverted.Edges.resize(adjacency.Edges.size());
+
+    for (Node edge : adjacency.Edges) {
+        inverted.Offsets[edge + 1]++;
+    }
+
+    for (std::size_t i = 0; i < nodeCount; i++) {
+        inverted.Offsets[i + 1] += inverted.Offsets[i];
+    }
+
+    std::vector<uint32_t> position(inverted.Offsets.begin(), inverted.Offsets.end() - 1);
+    for (Node node = 0; node < nodeCount; node++) {
+        for (Node edge : adjacency.Get(node)) {
+            inverted.Edges[position[edge]++] = node;
+        }
+    }
+
+    return inverted;
+}
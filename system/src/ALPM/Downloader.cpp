@@ -0,0 +1,381 @@
+#include "Downloader.hpp"
+#include "ALPM.hpp"
+#include "Metrics.hpp"
+#include "MirrorRanking.hpp"
+#include "Package.hpp"
+
+#include "Status.hpp"
+#include "Task.hpp"
+
+#include <alpm.h>
+#include <curl/curl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <format>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <unordered_map>
+
+using namespace ALPM;
+
+namespace {
+    // Task and Status aren't thread safe, and every transfer reports progress
+    // from its own worker thread.
+    std::mutex s_taskMutex;
+
+    struct ProgressContext {
+        std::shared_ptr<Task> Progress;
+        float LastProgress{-1.0f};
+        // Bytes already on disk from an earlier, interrupted attempt.
+        curl_off_t Offset{0};
+        std::stop_token Stop;
+    };
+
+    auto OnProgress(void *data, curl_off_t total, curl_off_t downloaded, curl_off_t, curl_off_t) -> int {
+        ProgressContext *context = static_cast<ProgressContext*>(data);
+
+        // Aborts the transfer, which keeps the partial file for a later resume.
+        if (context->Stop.stop_requested()) {
+            return 1;
+        }
+
+        if (total <= 0 || !context->Progress) {
+            return 0;
+        }
+
+        // Only touch the progress bar when the percentage actually changes.
+        float progress = static_cast<float>(context->Offset + downloaded) / static_cast<float>(context->Offset + total) * 100.0f;
+        if (static_cast<int>(progress) != static_cast<int>(context->LastProgress)) {
+            context->LastProgress = progress;
+
+            std::lock_guard lock(s_taskMutex);
+            context->Progress->SetProgress(progress);
+        }
+
+        return 0;
+    }
+
+    auto WriteFile(char *data, std::size_t size, std::size_t count, void *file) -> std::size_t {
+        return std::fwrite(data, size, count, static_cast<std::FILE*>(file));
+    }
+}  // namespace
+
+Downloader::Downloader(std::size_t parallelDownloads, std::size_t mirrorLimit) :
+    m_parallelDownloads(parallelDownloads),
+    m_mirrorLimit(std::max<std::size_t>(mirrorLimit, 1))
+{
+    if (m_parallelDownloads == 0) {
+        m_parallelDownloads = static_cast<std::size_t>(std::max(alpm_option_get_parallel_downloads(ALPM::GetHandle()), 1));
+    }
+}
+
+auto Downloader::GetCacheDirectory() -> std::filesystem::path {
+    // The same one libalpm downloads to: the first that's writable, or the
+    // first if none is.
+    std::optional<std::filesystem::path> first;
+    for (std::string_view cacheDirectory : Utils::ALPMListView<std::string_view>(alpm_option_get_cachedirs(ALPM::GetHandle()))) {
+        std::filesystem::path path(cacheDirectory);
+        std::error_code error;
+        std::filesystem::create_directories(path, error);
+        if (access(path.c_str(), W_OK) == 0) {
+            return path;
+        }
+
+        if (!first) {
+            first = std::move(path);
+        }
+    }
+
+    if (first) {
+        return *first;
+    }
+
+    return std::filesystem::path(alpm_option_get_root(ALPM::GetHandle())) / "var/cache/pacman/pkg";
+}
+
+auto Downloader::GetTaskMutex() -> std::mutex& {
+    return s_taskMutex;
+}
+
+auto Downloader::SetStopToken(std::stop_token stop) -> void {
+    m_stopToken = std::move(stop);
+}
+
+auto Downloader::SetCompletionCallback(std::function<void(const Result&)> callback) -> void {
+    m_completionCallback = std::move(callback);
+}
+
+auto Downloader::Add(Job job) -> void {
+    m_jobs.push_back(std::move(job));
+}
+
+auto Downloader::Add(const Package &package) -> void {
+    Job job{.Filename = package.GetFilename(), .Directory = GetCacheDirectory(), .Size = package.GetSize()};
+
+    if (alpm_db_t *db = alpm_pkg_get_db(package.GetHandle())) {
+        for (std::string_view server : Utils::ALPMListView<std::string_view>(alpm_db_get_servers(db))) {
+            job.Servers.emplace_back(server);
+        }
+    }
+
+    Add(std::move(job));
+}
+
+auto Downloader::Run() -> std::vector<Result> {
+    static std::once_flag curlInitialized;
+    std::call_once(curlInitialized, []() -> void {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+    });
+
+    // Workers don't have the handle bound until they bind it themselves.
+    m_handle = &ALPM::GetCurrentHandle();
+    m_ranking = MirrorRanking::Get();
+
+    std::vector<State> states;
+    states.reserve(m_jobs.size());
+    for (Job &job : m_jobs) {
+        states.push_back(State{.Entry = std::move(job)});
+    }
+    m_jobs.clear();
+
+    std::ranges::stable_sort(states, std::ranges::greater(), [](const State &state) -> off_t {
+        return state.Entry.Size;
+    });
+
+    std::vector<Result> results;
+    results.reserve(states.size());
+    for (State &state : states) {
+        results.push_back(Result{.Filename = state.Entry.Filename, .Path = state.Entry.Directory / state.Entry.Filename, .Optional = state.Entry.Optional});
+
+        if (state.Entry.Servers.empty()) {
+            results.back().Error = "No servers configured";
+            state.Done = true;
+        } else if (state.Entry.ShowProgress) {
+            std::lock_guard lock(s_taskMutex);
+            Status::Status::GetOrCreate()->AddTask(Task::GetOrCreate(state.Entry.Filename));
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::unordered_map<std::string, std::size_t> activePerMirror;
+
+    // Picks the largest waiting job whose next mirror has room for it.
+    auto next = [&]() -> std::optional<std::size_t> {
+        for (std::size_t i = 0; i < states.size(); i++) {
+            const State &state = states[i];
+            if (!state.Done && !state.Active && activePerMirror[MirrorRanking::GetMirror(state.Entry.Servers[state.Server])] < m_mirrorLimit) {
+                return i;
+            }
+        }
+
+        return {};
+    };
+
+    auto finished = [&states]() -> bool {
+        return std::ranges::all_of(states, &State::Done);
+    };
+
+    // Jobs that haven't started when the downloads are cancelled fail without
+    // being tried.
+    auto cancel = [&]() -> void {
+        for (std::size_t i = 0; i < states.size(); i++) {
+            State &state = states[i];
+            if (!state.Done && !state.Active) {
+                state.Done = true;
+                results[i].Error = "Cancelled";
+
+                if (state.Entry.ShowProgress) {
+                    std::lock_guard taskLock(s_taskMutex);
+                    Task::GetOrCreate(state.Entry.Filename)->SetDescription("(Cancelled)")->Finish();
+                }
+            }
+        }
+    };
+
+    auto work = [&]() -> void {
+        std::unique_lock lock(mutex);
+        while (true) {
+            std::optional<std::size_t> index;
+            condition.wait(lock, [&]() -> bool {
+                return m_stopToken.stop_requested() || finished() || (index = next()).has_value();
+            });
+
+            if (m_stopToken.stop_requested()) {
+                cancel();
+                return;
+            }
+
+            if (!index) {
+                return;
+            }
+
+            State &state = states[*index];
+            const std::string &server = state.Entry.Servers[state.Server];
+            std::string mirror = MirrorRanking::GetMirror(server);
+
+            state.Active = true;
+            activePerMirror[mirror]++;
+
+            lock.unlock();
+            std::optional<std::string> error = Transfer(state.Entry, server);
+            lock.lock();
+
+            state.Active = false;
+            activePerMirror[mirror]--;
+
+            Result &result = results[*index];
+            if (!error) {
+                result.Server = server;
+                result.Error.reset();
+                state.Done = true;
+            } else {
+                result.Error = std::format("{}: {}", server, *error);
+
+                // Fall back to the next mirror, or give up once all have failed.
+                if (++state.Server == state.Entry.Servers.size() || m_stopToken.stop_requested()) {
+                    state.Done = true;
+                }
+            }
+
+            if (state.Done) {
+                if (state.Entry.ShowProgress) {
+                    std::lock_guard taskLock(s_taskMutex);
+                    Task::GetOrCreate(state.Entry.Filename)->SetDescription(error ? "(Failed)" : "")->Finish();
+                }
+
+                if (m_completionCallback) {
+                    Result completed = result;
+                    lock.unlock();
+                    m_completionCallback(completed);
+                    lock.lock();
+                }
+            } else if (state.Entry.ShowProgress) {
+                std::lock_guard taskLock(s_taskMutex);
+                Task::GetOrCreate(state.Entry.Filename)->SetDescription("(Retrying)");
+            }
+
+            condition.notify_all();
+        }
+    };
+
+    std::stop_callback wake(m_stopToken, [&]() -> void {
+        std::lock_guard lock(mutex);
+        condition.notify_all();
+    });
+
+    std::vector<std::jthread> workers;
+    for (std::size_t i = 0; i < std::min(m_parallelDownloads, states.size()); i++) {
+        workers.emplace_back([this, &work]() -> void {
+            Handle::Scope scope(*m_handle);
+            work();
+        });
+    }
+
+    workers.clear();
+
+    m_ranking->Save();
+
+    return results;
+}
+
+auto Downloader::Transfer(const Job &job, const std::string &server) -> std::optional<std::string> {
+    std::error_code error;
+    std::filesystem::create_directories(job.Directory, error);
+
+    // Partial downloads never replace a good file in the cache.
+    std::filesystem::path destination = job.Directory / job.Filename;
+    std::filesystem::path partial = destination;
+    partial += ".part";
+
+    // A partial file left by an interrupted run is continued where it stopped,
+    // the same way libalpm does it.
+    std::uintmax_t existing = std::filesystem::exists(partial, error) ? std::filesystem::file_size(partial, error) : 0;
+    if (error) {
+        existing = 0;
+    }
+
+    std::FILE *file = std::fopen(partial.c_str(), existing != 0 ? "ab" : "wb");
+    if (file == nullptr) {
+        return std::format("Couldn't open {} for writing", partial.string());
+    }
+
+    std::string url = std::format("{}/{}", server, job.Filename);
+
+    ProgressContext progress{.Offset = static_cast<curl_off_t>(existing), .Stop = m_stopToken};
+    if (job.ShowProgress) {
+        std::lock_guard lock(s_taskMutex);
+        progress.Progress = Task::GetOrCreate(job.Filename);
+    }
+    char errorBuffer[CURL_ERROR_SIZE] = {};
+
+    CURL *curl = curl_easy_init();
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteFile);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, file);
+    curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, errorBuffer);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, OnProgress);
+    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &progress);
+    curl_easy_setopt(curl, CURLOPT_RESUME_FROM_LARGE, static_cast<curl_off_t>(existing));
+
+    // Same stall detection as pacman: give up on a mirror that sends less than
+    // a byte per second for ten seconds.
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 10L);
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 10L);
+
+    CURLcode result = curl_easy_perform(curl);
+
+    curl_off_t received = 0;
+    if (curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &received) == CURLE_OK) {
+        Metrics::Add(Metrics::Counter::Bytes, static_cast<uint64_t>(received));
+    }
+
+    curl_off_t firstByte = 0;
+    curl_off_t total = 0;
+    long response = 0;
+    curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &firstByte);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response);
+    curl_easy_cleanup(curl);
+
+    if (result == CURLE_OK) {
+        m_ranking->Record(server, std::chrono::microseconds(firstByte), static_cast<uint64_t>(received), std::chrono::microseconds(total - firstByte));
+    } else if (result != CURLE_ABORTED_BY_CALLBACK && !job.Optional && (result != CURLE_HTTP_RETURNED_ERROR || response >= 500)) {
+        // Cancelled downloads and files that just aren't there, like a delta
+        // manifest on a mirror that doesn't publish them, say nothing about the
+        // mirror.
+        m_ranking->RecordFailure(server);
+    }
+
+    bool written = std::fclose(file) == 0;
+
+    if (result != CURLE_OK || !written) {
+        // A partial file that couldn't be continued, e.g. because the mirror
+        // doesn't support ranges, starts over on the next attempt. Anything
+        // else is kept for the next mirror to continue.
+        if ((existing != 0 && result != CURLE_ABORTED_BY_CALLBACK) || !written) {
+            std::filesystem::remove(partial, error);
+        }
+        if (!written) {
+            return std::format("Couldn't write {}", partial.string());
+        }
+
+        return errorBuffer[0] != '\0' ? std::string(errorBuffer) : std::string(curl_easy_strerror(result));
+    }
+
+    std::filesystem::rename(partial, destination, error);
+    if (error) {
+        return std::format("Couldn't move {} into place: {}", destination.string(), error.message());
+    }
+
+    return {};
+}
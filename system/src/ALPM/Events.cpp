@@ -3,6 +3,8 @@
 #include "Event.hpp"
 #include "Status.hpp"
 #include "ALPM.hpp"
+#include "Handle.hpp"
+#include "Metrics.hpp"
 #include "Utils.hpp"
 
 #include <alpm.h>
@@ -12,50 +14,9 @@
 
 using namespace ALPM;
 
-// This associates the archaic C-style events with our C++-based event system.
-auto Events::RegisterEvents() -> void {
-    // Download event
-    Event::Event::RegisterCallback<DownloadEvent>([](const DownloadEvent &event) -> void {
-        switch (event.Type) {
-            case DownloadEvent::DownloadType::Init: {
-                // TODO: Add the package download task to the progress system
-                auto task = Task::GetOrCreate(event.Filename);
-                alpm_download_event_init_t *init = static_cast<alpm_download_event_init_t*>(event.Context);
-                if (init) {
-                    task->SetContext(static_cast<bool>(init->optional));
-                }
-                Status::Status::GetOrCreate()->AddTask(task);
-                
-            }
-            break;
-            case DownloadEvent::DownloadType::Progress: {
-                // Don't get this Progress event confused with alpm_cb_progress, this
-                // is for specifically download progress.
-                float progress{};
-                alpm_download_event_progress_t *prog = static_cast<alpm_download_event_progress_t*>(event.Data);
-                progress = ((float)prog->downloaded / (float)prog->total) * 100.0f;
-                Task::GetOrCreate(event.Filename)->SetProgress(progress);
-
-            }
-            break;
-            case DownloadEvent::DownloadType::Retry: {
-                Task::GetOrCreate(event.Filename)->SetDescription("(Retrying)");
-            }
-            break;
-            case DownloadEvent::DownloadType::Completed: {
-                auto task = Task::GetOrCreate(event.Filename)->Finish();
-                alpm_download_event_completed_t *comp = static_cast<alpm_download_event_completed_t*>(event.Data);
-                // If the download is set to optional (stored in the context) then it shouldn't error out
-                if (comp->result == -1 && !(task->GetContext<bool>().value_or(false))) {
-                    // TODO: Error system
-                    throw std::runtime_error(std::format("Failed to download file {}.", event.Filename));
-                }
-            }
-            break;
-        }
-    });
-
-    Event::Event::RegisterCallback<GenericQuestionEvent*>([](const GenericQuestionEvent *event) -> void {
+namespace {
+    // Asks the user on the terminal, blocking until they answer.
+    auto AskOnConsole(const GenericQuestionEvent *event) -> void {
         switch (event->Question) {
             case GenericQuestionEvent::QuestionType::InstallIgnorePackage: {
                 const InstallIgnorePackageQuestion *question = static_cast<const InstallIgnorePackageQuestion*>(event);
@@ -231,13 +192,145 @@ auto Events::RegisterEvents() -> void {
             }
             break;
         };
+    }
+}  // namespace
+
+// This associates the archaic C-style events with our C++-based event system.
+auto Events::RegisterEvents(Handle &handle) -> void {
+    // The C++ side is shared by every handle.
+    static std::once_flag registered;
+    std::call_once(registered, []() -> void {
+        // Download event
+        Event::Event::RegisterCallback<DownloadEvent>([](const DownloadEvent &event) -> void {
+            switch (event.Type) {
+                case DownloadEvent::DownloadType::Init: {
+                    // TODO: Add the package download task to the progress system
+                    auto task = Task::GetOrCreate(event.Filename);
+                    alpm_download_event_init_t *init = static_cast<alpm_download_event_init_t*>(event.Data);
+                    if (init) {
+                        task->SetContext(static_cast<bool>(init->optional));
+                    }
+                    Status::Status::GetOrCreate()->AddTask(task);
+                
+                }
+                break;
+                case DownloadEvent::DownloadType::Progress: {
+                    // Don't get this Progress event confused with alpm_cb_progress, this
+                    // is for specifically download progress.
+                    float progress{};
+                    alpm_download_event_progress_t *prog = static_cast<alpm_download_event_progress_t*>(event.Data);
+                    progress = ((float)prog->downloaded / (float)prog->total) * 100.0f;
+                    Task::GetOrCreate(event.Filename)->SetProgress(progress);
+
+                }
+                break;
+                case DownloadEvent::DownloadType::Retry: {
+                    Task::GetOrCreate(event.Filename)->SetDescription("(Retrying)");
+                }
+                break;
+                case DownloadEvent::DownloadType::Completed: {
+                    auto task = Task::GetOrCreate(event.Filename)->Finish();
+                    alpm_download_event_completed_t *comp = static_cast<alpm_download_event_completed_t*>(event.Data);
+                    if (comp->result == 0) {
+                        Metrics::Add(Metrics::Counter::Bytes, static_cast<uint64_t>(comp->total));
+                    }
+                    // If the download is set to optional (stored in the context) then it shouldn't error out
+                    if (comp->result == -1 && !(task->GetContext<bool>().value_or(false))) {
+                        // TODO: Error system
+                        throw std::runtime_error(std::format("Failed to download file {}.", event.Filename));
+                    }
+                }
+                break;
+            }
+        });
+
+        SetInteractive(true);
     });
-    
-    alpm_option_set_dlcb(ALPM::GetHandle(), [](void *ctx, const char *filename, alpm_download_event_type_t event, void *data) -> void {
-            Event::Event::Emit<DownloadEvent>({.Context = ctx, .Filename = filename, .Type = static_cast<DownloadEvent::DownloadType>(std::to_underlying(event)), .Data = data});
-    }, nullptr);
 
-    alpm_option_set_questioncb(ALPM::GetHandle(), [](void *ctx, alpm_question_t *question) -> void {
+    // Callbacks run with the handle they came from bound, so whatever handles
+    // an event works on the root it happened in.
+    alpm_option_set_dlcb(handle.GetHandle(), [](void *ctx, const char *filename, alpm_download_event_type_t event, void *data) -> void {
+        Handle::Scope scope(*static_cast<Handle*>(ctx));
+        Event::Event::Emit<DownloadEvent>({.Context = ctx, .Filename = filename, .Type = static_cast<DownloadEvent::DownloadType>(std::to_underlying(event)), .Data = data});
+    }, &handle);
+
+    alpm_option_set_eventcb(handle.GetHandle(), [](void *ctx, alpm_event_t *event) -> void {
+        Handle::Scope scope(*static_cast<Handle*>(ctx));
+        switch (event->type) {
+            case ALPM_EVENT_CHECKDEPS_START:
+            case ALPM_EVENT_RESOLVEDEPS_START:
+            case ALPM_EVENT_INTERCONFLICTS_START:
+            case ALPM_EVENT_FILECONFLICTS_START:
+                Metrics::Begin(Metrics::Phase::Resolve);
+                break;
+            case ALPM_EVENT_CHECKDEPS_DONE:
+            case ALPM_EVENT_RESOLVEDEPS_DONE:
+            case ALPM_EVENT_INTERCONFLICTS_DONE:
+            case ALPM_EVENT_FILECONFLICTS_DONE:
+                Metrics::End(Metrics::Phase::Resolve);
+                break;
+            case ALPM_EVENT_DB_RETRIEVE_START:
+                Metrics::Begin(Metrics::Phase::Refresh);
+                break;
+            case ALPM_EVENT_DB_RETRIEVE_DONE:
+            case ALPM_EVENT_DB_RETRIEVE_FAILED:
+                Metrics::End(Metrics::Phase::Refresh);
+                break;
+            case ALPM_EVENT_PKG_RETRIEVE_START:
+                Metrics::Begin(Metrics::Phase::Download);
+                Event::Event::Emit<PackageRetrieveEvent>({.TotalPackages = event->pkg_retrieve.num, .TotalSize = event->pkg_retrieve.total_size});
+                break;
+            case ALPM_EVENT_PKG_RETRIEVE_DONE:
+            case ALPM_EVENT_PKG_RETRIEVE_FAILED:
+                Metrics::End(Metrics::Phase::Download);
+                break;
+            case ALPM_EVENT_INTEGRITY_START:
+            case ALPM_EVENT_KEYRING_START:
+            case ALPM_EVENT_KEY_DOWNLOAD_START:
+                Metrics::Begin(Metrics::Phase::Verify);
+                break;
+            case ALPM_EVENT_INTEGRITY_DONE:
+            case ALPM_EVENT_KEYRING_DONE:
+            case ALPM_EVENT_KEY_DOWNLOAD_DONE:
+                Metrics::End(Metrics::Phase::Verify);
+                break;
+            case ALPM_EVENT_LOAD_START:
+                Metrics::Begin(Metrics::Phase::Decompress);
+                break;
+            case ALPM_EVENT_LOAD_DONE:
+                Metrics::End(Metrics::Phase::Decompress);
+                break;
+            case ALPM_EVENT_TRANSACTION_START:
+                Metrics::Begin(Metrics::Phase::Extract);
+                break;
+            case ALPM_EVENT_TRANSACTION_DONE:
+                Metrics::End(Metrics::Phase::Extract);
+                break;
+            case ALPM_EVENT_PACKAGE_OPERATION_DONE:
+                Metrics::Add(Metrics::Counter::Packages);
+                break;
+            case ALPM_EVENT_HOOK_START:
+                Metrics::Begin(Metrics::Phase::Hooks);
+                break;
+            case ALPM_EVENT_HOOK_DONE:
+                Metrics::End(Metrics::Phase::Hooks);
+                break;
+            case ALPM_EVENT_HOOK_RUN_START:
+                Metrics::Add(Metrics::Counter::Hooks);
+                Event::Event::Emit<HookRunEvent>({.Name = event->hook_run.name, .Description = std::string(Utils::ToStringView(event->hook_run.desc)), .Position = event->hook_run.position, .Total = event->hook_run.total});
+                break;
+            default:
+                break;
+        }
+    }, &handle);
+
+    alpm_option_set_progresscb(handle.GetHandle(), [](void *ctx, alpm_progress_t progress, const char *package, int percent, std::size_t howmany, std::size_t current) -> void {
+        Handle::Scope scope(*static_cast<Handle*>(ctx));
+        Event::Event::Emit<TransactionProgressEvent>({.Type = static_cast<TransactionProgressEvent::ProgressType>(std::to_underlying(progress)), .Package = std::string(Utils::ToStringView(package)), .Percent = percent, .Current = current, .Total = howmany});
+    }, &handle);
+
+    alpm_option_set_questioncb(handle.GetHandle(), [](void *ctx, alpm_question_t *question) -> void {
+        Handle::Scope scope(*static_cast<Handle*>(ctx));
         switch (question->type) {
             case ALPM_QUESTION_INSTALL_IGNOREPKG: {
                 alpm_question_install_ignorepkg_t *qst = reinterpret_cast<alpm_question_install_ignorepkg_t*>(question);
@@ -296,5 +389,15 @@ auto Events::RegisterEvents() -> void {
             }
             break;
         }
-    }, nullptr);
+    }, &handle);
+}
+
+auto Events::SetInteractive(bool interactive) -> void {
+    std::lock_guard lock(s_mutex);
+    if (interactive && !s_consoleQuestions) {
+        s_consoleQuestions = Event::Event::RegisterCallback<GenericQuestionEvent*>(AskOnConsole);
+    } else if (!interactive && s_consoleQuestions) {
+        Event::Event::UnregisterCallback(*s_consoleQuestions);
+        s_consoleQuestions.reset();
+    }
 }
@@ -1,4 +1,5 @@
 #include "File.hpp"
+#include "Utils.hpp"
 
 #include "alpm.h"
 
@@ -19,6 +20,25 @@ auto File::GetSize() const -> off_t {
     return m_alpmFile->size;
 }
 
+FileView::FileView(alpm_file_t *file) :
+    m_alpmFile(file) {}
+
+auto FileView::GetMode() const -> mode_t {
+    return m_alpmFile->mode;
+}
+
+auto FileView::GetName() const -> std::string_view {
+    return Utils::ToStringView(m_alpmFile->name);
+}
+
+auto FileView::GetSize() const -> off_t {
+    return m_alpmFile->size;
+}
+
+auto FileView::GetHandle() const -> FileView::UnderlyingType* {
+    return m_alpmFile;
+}
+
 Backup::Backup(alpm_backup_t *backup) :
     m_alpmBackup(backup) {}
 
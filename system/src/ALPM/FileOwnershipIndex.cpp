@@ -0,0 +1,545 @@
+#include "FileOwnershipIndex.hpp"
+#include "ALPM.hpp"
+#include "Events.hpp"
+
+#include "Event.hpp"
+
+#include <alpm.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <string>
+#include <utility>
+
+using namespace ALPM;
+
+namespace {
+    constexpr std::array<char, 8> INDEX_MAGIC{'L', 'I', 'T', 'H', 'F', 'I', 'D', 'X'};
+    constexpr uint32_t INDEX_VERSION = 1;
+
+    enum Column : std::size_t {
+        // Offset of the first entry of every block into `Entries`.
+        Blocks,
+        Entries,
+        // Offset of every owner's name into `Strings`.
+        Owners,
+        Strings,
+        ColumnCount
+    };
+
+    struct Section {
+        uint64_t Offset;
+        uint64_t Size;
+    };
+
+    using FileList = std::vector<std::pair<std::string, std::string>>;
+
+    auto WriteVarint(std::string &output, uint64_t value) -> void {
+        while (value >= 0x80) {
+            output.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+
+        output.push_back(static_cast<char>(value));
+    }
+
+    // Returns false instead of reading past `end` or beyond 64 bits.
+    auto ReadVarint(const unsigned char *&data, const unsigned char *end, uint64_t &value) -> bool {
+        value = 0;
+        for (unsigned int shift = 0; shift < 64 && data < end; shift += 7) {
+            unsigned char byte = *data++;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    auto Normalize(std::string_view path) -> std::string_view {
+        while (path.starts_with('/')) {
+            path.remove_prefix(1);
+        }
+
+        return path;
+    }
+
+    // libalpm adds and removes a directory in the local database for every
+    // package it installs or removes, which is all an index needs to notice.
+    auto StatLocalDatabase(int64_t &modifiedTime, uint64_t &inode) -> bool {
+        std::filesystem::path local = std::filesystem::path(alpm_option_get_dbpath(ALPM::ALPM::GetHandle())) / "local";
+
+        struct stat buffer{};
+        if (stat(local.c_str(), &buffer) != 0) {
+            return false;
+        }
+
+        modifiedTime = static_cast<int64_t>(buffer.st_mtim.tv_sec) * 1'000'000'000 + buffer.st_mtim.tv_nsec;
+        inode = buffer.st_ino;
+
+        return true;
+    }
+
+    auto ReadFiles(alpm_pkg_t *pkg, FileList &files) -> void {
+        const alpm_filelist_t *fileList = alpm_pkg_get_files(pkg);
+        if (fileList == nullptr) {
+            return;
+        }
+
+        for (std::size_t i = 0; i < fileList->count; i++) {
+            std::string_view name = fileList->files[i].name;
+            if (!name.ends_with('/')) {
+                files.emplace_back(name, alpm_pkg_get_name(pkg));
+            }
+        }
+    }
+}  // namespace
+
+struct FileOwnershipIndex::Header {
+    std::array<char, 8> Magic;
+    uint32_t Version;
+    uint32_t FileCount;
+    uint32_t BlockCount;
+    uint32_t OwnerCount;
+    int64_t LocalModifiedTime;
+    uint64_t LocalInode;
+    std::array<Section, ColumnCount> Columns;
+};
+
+namespace {
+    auto Write(FileList files, const std::filesystem::path &path) -> bool {
+        std::ranges::sort(files);
+        files.erase(std::unique(files.begin(), files.end()), files.end());
+
+        std::vector<std::string> ownerNames;
+        for (const auto &[file, owner] : files) {
+            ownerNames.push_back(owner);
+        }
+        std::ranges::sort(ownerNames);
+        ownerNames.erase(std::unique(ownerNames.begin(), ownerNames.end()), ownerNames.end());
+
+        std::string strings;
+        std::vector<uint32_t> owners;
+        for (const std::string &owner : ownerNames) {
+            owners.push_back(static_cast<uint32_t>(strings.size()));
+            strings.append(owner);
+            strings.push_back('\0');
+        }
+
+        std::string entries;
+        std::vector<uint64_t> blocks;
+        std::string_view previous;
+        for (std::size_t i = 0; i < files.size(); i++) {
+            std::string_view file = files[i].first;
+
+            std::size_t shared = 0;
+            if (i % FileOwnershipIndex::BLOCK_SIZE == 0) {
+                blocks.push_back(entries.size());
+            } else {
+                auto [fileEnd, previousEnd] = std::ranges::mismatch(file, previous);
+                shared = static_cast<std::size_t>(fileEnd - file.begin());
+            }
+
+            auto owner = std::ranges::lower_bound(ownerNames, files[i].second);
+
+            WriteVarint(entries, shared);
+            WriteVarint(entries, file.size() - shared);
+            entries.append(file.substr(shared));
+            WriteVarint(entries, static_cast<uint64_t>(owner - ownerNames.begin()));
+
+            previous = file;
+        }
+
+        FileOwnershipIndex::Header header{};
+        header.Magic = INDEX_MAGIC;
+        header.Version = INDEX_VERSION;
+        header.FileCount = static_cast<uint32_t>(files.size());
+        header.BlockCount = static_cast<uint32_t>(blocks.size());
+        header.OwnerCount = static_cast<uint32_t>(owners.size());
+        if (!StatLocalDatabase(header.LocalModifiedTime, header.LocalInode)) {
+            return false;
+        }
+
+        std::array<std::pair<const void*, std::size_t>, ColumnCount> columns;
+        columns[Blocks] = {blocks.data(), blocks.size() * sizeof(uint64_t)};
+        columns[Entries] = {entries.data(), entries.size()};
+        columns[Owners] = {owners.data(), owners.size() * sizeof(uint32_t)};
+        columns[Strings] = {strings.data(), strings.size()};
+
+        // Every column starts on an 8 byte boundary so it can be read in place.
+        uint64_t offset = sizeof(FileOwnershipIndex::Header);
+        for (std::size_t column = 0; column < ColumnCount; column++) {
+            offset = (offset + 7) & ~uint64_t{7};
+            header.Columns[column] = Section{.Offset = offset, .Size = columns[column].second};
+            offset += columns[column].second;
+        }
+
+        std::filesystem::path temporaryPath = path;
+        temporaryPath += ".tmp";
+
+        std::error_code ec;
+        std::filesystem::create_directories(path.parent_path(), ec);
+
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            if (!file) {
+                return false;
+            }
+
+            file.write(reinterpret_cast<const char*>(&header), sizeof(FileOwnershipIndex::Header));
+            uint64_t written = sizeof(FileOwnershipIndex::Header);
+            for (std::size_t column = 0; column < ColumnCount; column++) {
+                static constexpr std::array<char, 8> padding{};
+                file.write(padding.data(), static_cast<std::streamsize>(header.Columns[column].Offset - written));
+                file.write(static_cast<const char*>(columns[column].first), static_cast<std::streamsize>(columns[column].second));
+                written = header.Columns[column].Offset + header.Columns[column].Size;
+            }
+
+            if (!file) {
+                std::filesystem::remove(temporaryPath, ec);
+                return false;
+            }
+        }
+
+        std::filesystem::rename(temporaryPath, path, ec);
+
+        return !ec;
+    }
+}  // namespace
+
+FileOwnershipIndex::FileOwnershipIndex(Private, void *mapping, std::size_t size) :
+    m_mapping(mapping), m_size(size), m_header(static_cast<const Header*>(mapping)) {}
+
+FileOwnershipIndex::~FileOwnershipIndex() {
+    munmap(m_mapping, m_size);
+}
+
+template <typename Callback>
+auto FileOwnershipIndex::ForEach(std::size_t block, Callback &&callback) const -> void {
+    const uint64_t *blocks = reinterpret_cast<const uint64_t*>(static_cast<const std::byte*>(m_mapping) + m_header->Columns[Blocks].Offset);
+    const unsigned char *entries = static_cast<const unsigned char*>(m_mapping) + m_header->Columns[Entries].Offset;
+    const unsigned char *end = entries + m_header->Columns[Entries].Size;
+
+    std::string path;
+    const unsigned char *data = entries + blocks[block];
+    while (data < end) {
+        uint64_t shared = 0;
+        uint64_t length = 0;
+        uint64_t owner = 0;
+        if (!ReadVarint(data, end, shared) || !ReadVarint(data, end, length) || length > static_cast<uint64_t>(end - data)) {
+            return;
+        }
+
+        path.resize(shared);
+        path.append(reinterpret_cast<const char*>(data), length);
+        data += length;
+
+        if (!ReadVarint(data, end, owner) || !callback(std::string_view(path), static_cast<uint32_t>(owner))) {
+            return;
+        }
+    }
+}
+
+auto FileOwnershipIndex::Get() -> std::shared_ptr<const FileOwnershipIndex> {
+    std::lock_guard lock(s_mutex);
+
+    // Every root has its own index, next to its local database.
+    std::shared_ptr<const FileOwnershipIndex> &instance = s_instances[GetDefaultPath()];
+
+    // Whatever changed the local database since, like pacman itself, didn't
+    // update the index. Readers keep the old mapping until they let go of it.
+    if (instance && instance->IsStale()) {
+        instance.reset();
+    }
+
+    if (!instance) {
+        instance = Open();
+        if (!instance && Build()) {
+            instance = Open();
+        }
+
+        static std::once_flag registered;
+        std::call_once(registered, []() -> void {
+            // Transactions complete with their handle bound.
+            Event::Event::RegisterCallback<TransactionCompletedEvent>([](const TransactionCompletedEvent &event) -> void {
+                std::lock_guard lock(s_mutex);
+                auto it = s_instances.find(GetDefaultPath());
+                if (it == s_instances.end() || !it->second) {
+                    return;
+                }
+
+                // Upgraded packages are in `Added`, and their old files go too.
+                std::vector<std::string> changed = event.Added;
+                changed.insert(changed.end(), event.Removed.begin(), event.Removed.end());
+
+                // Readers may still hold the old mapping, which stays valid after
+                // the file is replaced.
+                if (it->second->Update(changed) || Build()) {
+                    it->second = Open();
+                } else {
+                    it->second.reset();
+                }
+            });
+        });
+    }
+
+    return instance;
+}
+
+auto FileOwnershipIndex::Build(const std::filesystem::path &path) -> bool {
+    FileList files;
+    for (const alpm_list_t *i = alpm_db_get_pkgcache(alpm_get_localdb(ALPM::GetHandle())); i != nullptr; i = i->next) {
+        ReadFiles(static_cast<alpm_pkg_t*>(i->data), files);
+    }
+
+    return Write(std::move(files), path);
+}
+
+auto FileOwnershipIndex::Open(const std::filesystem::path &path) -> std::shared_ptr<const FileOwnershipIndex> {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat buffer{};
+    if (fstat(fd, &buffer) != 0 || static_cast<std::size_t>(buffer.st_size) < sizeof(Header)) {
+        close(fd);
+        return nullptr;
+    }
+
+    std::size_t size = static_cast<std::size_t>(buffer.st_size);
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        return nullptr;
+    }
+
+    std::shared_ptr<const FileOwnershipIndex> index = std::make_shared<const FileOwnershipIndex>(Private(), mapping, size);
+    if (!index->IsValid() || index->IsStale()) {
+        return nullptr;
+    }
+
+    return index;
+}
+
+auto FileOwnershipIndex::GetDefaultPath() -> std::filesystem::path {
+    return std::filesystem::path(alpm_option_get_dbpath(ALPM::GetHandle())) / "system-files.idx";
+}
+
+auto FileOwnershipIndex::Update(const std::vector<std::string> &changed, const std::filesystem::path &path) const -> bool {
+    std::set<std::string_view> skipped(changed.begin(), changed.end());
+
+    FileList files;
+    files.reserve(GetFileCount());
+    if (GetBlockCount() != 0) {
+        ForEach(0, [this, &files, &skipped](std::string_view file, uint32_t owner) -> bool {
+            std::string_view name = GetOwner(owner);
+            if (!skipped.contains(name)) {
+                files.emplace_back(file, name);
+            }
+
+            return true;
+        });
+    }
+
+    alpm_db_t *localDatabase = alpm_get_localdb(ALPM::GetHandle());
+    for (const std::string &name : changed) {
+        if (alpm_pkg_t *pkg = alpm_db_get_pkg(localDatabase, name.c_str())) {
+            ReadFiles(pkg, files);
+        }
+    }
+
+    return Write(std::move(files), path);
+}
+
+auto FileOwnershipIndex::IsStale() const -> bool {
+    int64_t modifiedTime = 0;
+    uint64_t inode = 0;
+    if (!StatLocalDatabase(modifiedTime, inode)) {
+        return true;
+    }
+
+    return modifiedTime != m_header->LocalModifiedTime || inode != m_header->LocalInode;
+}
+
+auto FileOwnershipIndex::GetFileCount() const -> std::size_t {
+    return m_header->FileCount;
+}
+
+auto FileOwnershipIndex::FindOwners(std::string_view path) const -> std::vector<std::string_view> {
+    std::string_view target = Normalize(path);
+    std::vector<std::string_view> owners;
+
+    std::size_t blockCount = GetBlockCount();
+    if (blockCount == 0) {
+        return owners;
+    }
+
+    const uint64_t *blocks = reinterpret_cast<const uint64_t*>(static_cast<const std::byte*>(m_mapping) + m_header->Columns[Blocks].Offset);
+    const unsigned char *entries = static_cast<const unsigned char*>(m_mapping) + m_header->Columns[Entries].Offset;
+    const unsigned char *end = entries + m_header->Columns[Entries].Size;
+
+    // The first path of every block is stored whole, so blocks can be binary
+    // searched without decoding them.
+    auto firstPath = [blocks, entries, end](std::size_t block) -> std::string_view {
+        const unsigned char *data = entries + blocks[block];
+        uint64_t shared = 0;
+        uint64_t length = 0;
+        if (!ReadVarint(data, end, shared) || !ReadVarint(data, end, length) || length > static_cast<uint64_t>(end - data)) {
+            return {};
+        }
+
+        return std::string_view(reinterpret_cast<const char*>(data), length);
+    };
+
+    std::size_t low = 0;
+    std::size_t high = blockCount;
+    while (low < high) {
+        std::size_t middle = low + (high - low) / 2;
+        if (firstPath(middle) < target) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    // The block before the first one starting at or after `target` may end with
+    // it, when several packages own the same file.
+    ForEach(low == 0 ? 0 : low - 1, [this, &owners, target](std::string_view file, uint32_t owner) -> bool {
+        if (file < target) {
+            return true;
+        }
+
+        if (file > target) {
+            return false;
+        }
+
+        owners.push_back(GetOwner(owner));
+        return true;
+    });
+
+    return owners;
+}
+
+auto FileOwnershipIndex::FindConflicts(const std::map<std::string, std::vector<std::string>> &files, const std::set<std::string> &replaced) const -> std::vector<Conflict> {
+    std::filesystem::path root = alpm_option_get_root(ALPM::GetHandle());
+
+    std::vector<Conflict> conflicts;
+    std::map<std::string_view, std::string_view> incoming;
+    for (const auto &[package, paths] : files) {
+        for (const std::string &path : paths) {
+            std::string_view file = Normalize(path);
+            if (file.empty() || file.ends_with('/')) {
+                continue;
+            }
+
+            auto [other, inserted] = incoming.emplace(file, package);
+            if (!inserted && other->second != package) {
+                conflicts.push_back(Conflict{.Path = std::string(file), .Package = package, .Owner = std::string(other->second)});
+            }
+
+            std::vector<std::string_view> owners = FindOwners(file);
+            for (std::string_view owner : owners) {
+                if (owner != package && !replaced.contains(std::string(owner))) {
+                    conflicts.push_back(Conflict{.Path = std::string(file), .Package = package, .Owner = std::string(owner)});
+                }
+            }
+
+            // Same as libalpm, a file nobody owns is only a conflict if something
+            // other than a directory is already there.
+            if (owners.empty()) {
+                std::error_code error;
+                std::filesystem::file_status status = std::filesystem::symlink_status(root / file, error);
+                if (!error && std::filesystem::exists(status) && !std::filesystem::is_directory(status)) {
+                    conflicts.push_back(Conflict{.Path = std::string(file), .Package = package});
+                }
+            }
+        }
+    }
+
+    return conflicts;
+}
+
+auto FileOwnershipIndex::IsValid() const -> bool {
+    if (m_header->Magic != INDEX_MAGIC || m_header->Version != INDEX_VERSION) {
+        return false;
+    }
+
+    std::array<uint64_t, ColumnCount> expectedSizes{
+        uint64_t{m_header->BlockCount} * sizeof(uint64_t),
+        m_header->Columns[Entries].Size,
+        uint64_t{m_header->OwnerCount} * sizeof(uint32_t),
+        m_header->Columns[Strings].Size
+    };
+    for (std::size_t column = 0; column < ColumnCount; column++) {
+        const Section &section = m_header->Columns[column];
+        if (section.Offset % 8 != 0 || section.Offset > m_size || section.Size > m_size - section.Offset || section.Size != expectedSizes[column]) {
+            return false;
+        }
+    }
+
+    if (m_header->BlockCount != (uint64_t{m_header->FileCount} + BLOCK_SIZE - 1) / BLOCK_SIZE) {
+        return false;
+    }
+
+    const char *strings = static_cast<const char*>(m_mapping) + m_header->Columns[Strings].Offset;
+    uint64_t stringsSize = m_header->Columns[Strings].Size;
+    if (m_header->OwnerCount != 0 && (stringsSize == 0 || strings[stringsSize - 1] != '\0')) {
+        return false;
+    }
+
+    const uint32_t *owners = reinterpret_cast<const uint32_t*>(static_cast<const std::byte*>(m_mapping) + m_header->Columns[Owners].Offset);
+    if (!std::all_of(owners, owners + m_header->OwnerCount, [stringsSize](uint32_t owner) -> bool {return owner < stringsSize;})) {
+        return false;
+    }
+
+    // Every entry is walked once, so lookups can trust the block offsets, the
+    // prefix lengths and the owner ids without checking them again.
+    const uint64_t *blocks = reinterpret_cast<const uint64_t*>(static_cast<const std::byte*>(m_mapping) + m_header->Columns[Blocks].Offset);
+    const unsigned char *entries = static_cast<const unsigned char*>(m_mapping) + m_header->Columns[Entries].Offset;
+    const unsigned char *end = entries + m_header->Columns[Entries].Size;
+
+    const unsigned char *data = entries;
+    uint64_t previousLength = 0;
+    for (std::size_t i = 0; i < m_header->FileCount; i++) {
+        bool blockStart = i % BLOCK_SIZE == 0;
+        if (blockStart && blocks[i / BLOCK_SIZE] != static_cast<uint64_t>(data - entries)) {
+            return false;
+        }
+
+        uint64_t shared = 0;
+        uint64_t length = 0;
+        uint64_t owner = 0;
+        if (!ReadVarint(data, end, shared) || !ReadVarint(data, end, length) || length > static_cast<uint64_t>(end - data)) {
+            return false;
+        }
+        data += length;
+
+        if ((blockStart && shared != 0) || shared > previousLength || !ReadVarint(data, end, owner) || owner >= m_header->OwnerCount) {
+            return false;
+        }
+
+        previousLength = shared + length;
+    }
+
+    return data == end;
+}
+
+auto FileOwnershipIndex::GetBlockCount() const -> std::size_t {
+    return m_header->BlockCount;
+}
+
+auto FileOwnershipIndex::GetOwner(uint32_t owner) const -> std::string_view {
+    const uint32_t *owners = reinterpret_cast<const uint32_t*>(static_cast<const std::byte*>(m_mapping) + m_header->Columns[Owners].Offset);
+    const char *strings = static_cast<const char*>(m_mapping) + m_header->Columns[Strings].Offset;
+
+    return std::string_view(strings + owners[owner]);
+}
@@ -0,0 +1,198 @@
+#include "Handle.hpp"
+#include "Events.hpp"
+#include "PosixSignals.hpp"
+#include "Transaction.hpp"
+
+#include <alpm.h>
+
+#include <format>
+#include <stdexcept>
+#include <utility>
+
+using namespace ALPM;
+
+Handle::Scope::Scope(Handle &handle) :
+    m_previous(std::exchange(s_current, &handle)) {}
+
+Handle::Scope::~Scope() {
+    s_current = m_previous;
+}
+
+Handle::Handle(const std::filesystem::path &root) :
+    m_id(++s_lastId),
+    m_root(root)
+{
+    alpm_errno_t err;
+
+    std::filesystem::path dbPath = GetDatabasePath();
+    std::filesystem::path configPath = root / "etc/pacman.conf";
+
+    m_alpmHandle = alpm_initialize(root.c_str(), dbPath.c_str(), &err);
+
+    if (!m_alpmHandle) {
+        throw std::runtime_error(std::format("Failed to allocate libalpm handle for {}: {}", root.string(), alpm_strerror(err)));
+    }
+
+    {
+        std::lock_guard lock(s_mutex);
+        s_handles.emplace(m_alpmHandle, this);
+    }
+
+    // Another thread may be committing, so this only asks libalpm to stop. The
+    // thread applying the transaction releases it.
+    m_interruptCallback = Event::Event::RegisterCallback<POSIXSignals::SigInt>([this](const POSIXSignals::SigInt &signal) -> void {
+        if (std::shared_ptr<Transaction> transaction = m_currentTransaction.load()) {
+            transaction->Interrupt();
+        }
+    });
+
+    // Register C++ libalpm events
+    Events::RegisterEvents(*this);
+
+    try {
+        // Load global configuration file
+        m_compiledConfig = CompiledConfig::Load(configPath, CompiledConfig::GetDefaultPath(root));
+
+        if (std::optional<std::string_view> parallelDownloads = m_compiledConfig->GetOption("ParallelDownloads")) {
+            alpm_option_set_parallel_downloads(m_alpmHandle, Config::Section::Value(*parallelDownloads).As<int>());
+        }
+
+        // libalpm only looks for packages in the cache directories it's given,
+        // so anything downloaded before the commit has to go to one of them.
+        // Like the rest of the config, they're relative to the root.
+        std::vector<std::string_view> cacheDirectories = m_compiledConfig->GetOptions("CacheDir");
+        if (cacheDirectories.empty()) {
+            cacheDirectories.push_back("/var/cache/pacman/pkg/");
+        }
+        for (std::string_view cacheDirectory : cacheDirectories) {
+            std::filesystem::path path = root / std::filesystem::path(cacheDirectory).relative_path();
+            alpm_option_add_cachedir(m_alpmHandle, path.c_str());
+        }
+
+        // libalpm only knows its own hook directory. pacman adds the ones from
+        // HookDir after it, so they override it, or /etc/pacman.d/hooks.
+        std::vector<std::string_view> hookDirectories = m_compiledConfig->GetOptions("HookDir");
+        if (hookDirectories.empty()) {
+            hookDirectories.push_back("/etc/pacman.d/hooks/");
+        }
+        for (std::string_view hookDirectory : hookDirectories) {
+            std::filesystem::path path = root / std::filesystem::path(hookDirectory).relative_path();
+            alpm_option_add_hookdir(m_alpmHandle, path.c_str());
+        }
+    } catch (...) {
+        Event::Event::UnregisterCallback(m_interruptCallback);
+        {
+            std::lock_guard lock(s_mutex);
+            s_handles.erase(m_alpmHandle);
+        }
+        alpm_release(m_alpmHandle);
+        throw;
+    }
+}
+
+Handle::~Handle() {
+    Event::Event::UnregisterCallback(m_interruptCallback);
+    Event::Event::Emit<HandleReleasedEvent>({.Handle = m_id});
+
+    // Transactions release themselves through their handle.
+    m_currentTransaction.store(nullptr);
+
+    {
+        std::lock_guard lock(s_mutex);
+        s_handles.erase(m_alpmHandle);
+    }
+
+    alpm_release(m_alpmHandle);
+}
+
+auto Handle::GetCurrent() -> Handle* {
+    return s_current;
+}
+
+auto Handle::Find(alpm_handle_t *handle) -> Handle* {
+    std::lock_guard lock(s_mutex);
+    auto it = s_handles.find(handle);
+    return it == s_handles.end() ? nullptr : it->second;
+}
+
+auto Handle::GetId() const -> uint64_t {
+    return m_id;
+}
+
+auto Handle::GetRoot() const -> std::filesystem::path {
+    return m_root;
+}
+
+auto Handle::GetDatabasePath() const -> std::filesystem::path {
+    return m_root / "var/lib/pacman";
+}
+
+auto Handle::GetConfig() const -> std::shared_ptr<const Config> {
+    std::call_once(m_configOnce, [this]() -> void {
+        m_config = std::make_shared<const Config>(m_root / "etc/pacman.conf");
+    });
+
+    return m_config;
+}
+
+auto Handle::GetCompiledConfig() const -> std::shared_ptr<const CompiledConfig> {
+    return m_compiledConfig;
+}
+
+auto Handle::GetCurrentTransaction() -> std::shared_ptr<Transaction> {
+    std::lock_guard lock(m_mutex);
+    std::shared_ptr<Transaction> transaction = m_currentTransaction.load();
+    if (!transaction) {
+        Scope scope(*this);
+        transaction = Transaction::Create();
+        m_currentTransaction.store(transaction);
+    }
+
+    return transaction;
+}
+
+auto Handle::SetCurrentTransaction(std::shared_ptr<Transaction> transaction) -> void {
+    std::lock_guard lock(m_mutex);
+    m_currentTransaction.store(std::move(transaction));
+}
+
+auto Handle::GetError() const -> std::string {
+    return alpm_strerror(alpm_errno(m_alpmHandle));
+}
+
+auto Handle::GetLocalDatabase() const -> Database {
+    return Database(alpm_get_localdb(m_alpmHandle));
+}
+
+auto Handle::GetSyncDatabases() -> std::vector<Database> {
+    RegisterSyncDatabases();
+    return Utils::ALPMListToVector<Database>(alpm_get_syncdbs(m_alpmHandle));
+}
+
+auto Handle::GetSyncDatabasesView() -> Utils::ALPMListView<Database> {
+    RegisterSyncDatabases();
+    return Utils::ALPMListView<Database>(alpm_get_syncdbs(m_alpmHandle));
+}
+
+auto Handle::RegisterSyncDatabases() -> void {
+    std::call_once(m_syncDatabasesOnce, [this]() -> void {
+        // Sync databases are registered on whichever handle is current.
+        Scope scope(*this);
+
+        // Initializing database results in libalpm_register_syncdb being called
+        // for all of the databases defined in pacman.conf
+        Database::Initialize();
+    });
+}
+
+auto Handle::GetDatabaseGeneration() const -> uint64_t {
+    return m_databaseGeneration.load();
+}
+
+auto Handle::InvalidateDatabases() -> void {
+    m_databaseGeneration++;
+}
+
+auto Handle::GetHandle() const -> alpm_handle_t* {
+    return m_alpmHandle;
+}
@@ -0,0 +1,325 @@
+#include "Hook.hpp"
+#include "ALPM.hpp"
+#include "Config.hpp"
+#include "Utils.hpp"
+
+#include <alpm.h>
+
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <format>
+
+using namespace ALPM;
+
+namespace {
+    // Same quoting rules as libalpm's wordsplit: whitespace separates words,
+    // quotes group them and a backslash escapes the next character.
+    auto SplitWords(const std::string &command) -> std::optional<std::vector<std::string>> {
+        std::vector<std::string> words;
+        std::optional<std::string> word;
+        char quote = '\0';
+
+        for (std::size_t i = 0; i < command.size(); i++) {
+            char c = command[i];
+            if (c == '\\' && quote != '\'') {
+                if (++i == command.size()) {
+                    return {};
+                }
+                word = word.value_or("") + command[i];
+            } else if (quote != '\0') {
+                if (c == quote) {
+                    quote = '\0';
+                } else {
+                    *word += c;
+                }
+            } else if (c == '\'' || c == '"') {
+                quote = c;
+                word = word.value_or("");
+            } else if (c == ' ' || c == '\t') {
+                if (word) {
+                    words.push_back(std::move(*word));
+                    word.reset();
+                }
+            } else {
+                word = word.value_or("") + c;
+            }
+        }
+
+        if (quote != '\0') {
+            return {};
+        }
+        if (word) {
+            words.push_back(std::move(*word));
+        }
+
+        return words;
+    }
+
+    auto ParseOperation(const std::string &operation) -> std::optional<Hook::Operation> {
+        if (operation == "Install") {
+            return Hook::Operation::Install;
+        }
+        if (operation == "Upgrade") {
+            return Hook::Operation::Upgrade;
+        }
+        if (operation == "Remove") {
+            return Hook::Operation::Remove;
+        }
+
+        return {};
+    }
+}  // namespace
+
+auto Hook::FromFile(const std::filesystem::path &path) -> std::optional<Hook> {
+    Config config;
+    try {
+        config.LoadFile(path);
+    } catch (const std::exception&) {
+        return {};
+    }
+
+    Hook hook;
+    hook.m_name = path.stem().string();
+
+    bool hasAction = false;
+    for (const Config::Section &section : config.GetSections()) {
+        if (section.GetName() == "Trigger") {
+            Trigger trigger;
+            for (const Config::Section::Value &value : section.GetOptions("Operation")) {
+                std::optional<Operation> operation = ParseOperation(value.As<std::string>());
+                if (!operation) {
+                    return {};
+                }
+                trigger.Operations.insert(*operation);
+            }
+
+            const Config::Section::Value *type = section.GetOption("Type");
+            if (!type) {
+                return {};
+            }
+
+            // File is the old name for Path.
+            std::string typeName = type->As<std::string>();
+            if (typeName == "Package") {
+                trigger.Package = true;
+            } else if (typeName != "Path" && typeName != "File") {
+                return {};
+            }
+
+            for (const Config::Section::Value &value : section.GetOptions("Target")) {
+                trigger.Targets.push_back(value.As<std::string>());
+            }
+
+            if (trigger.Operations.empty() || trigger.Targets.empty()) {
+                return {};
+            }
+            hook.m_triggers.push_back(std::move(trigger));
+        } else if (section.GetName() == "Action") {
+            if (hasAction) {
+                return {};
+            }
+            hasAction = true;
+
+            if (const Config::Section::Value *description = section.GetOption("Description")) {
+                hook.m_description = description->As<std::string>();
+            }
+
+            const Config::Section::Value *when = section.GetOption("When");
+            if (!when || (when->As<std::string>() != "PreTransaction" && when->As<std::string>() != "PostTransaction")) {
+                return {};
+            }
+            hook.m_when = when->As<std::string>() == "PreTransaction" ? When::PreTransaction : When::PostTransaction;
+
+            const Config::Section::Value *exec = section.GetOption("Exec");
+            if (!exec) {
+                return {};
+            }
+
+            std::optional<std::vector<std::string>> words = SplitWords(exec->As<std::string>());
+            if (!words || words->empty()) {
+                return {};
+            }
+            hook.m_exec = std::move(*words);
+
+            for (const Config::Section::Value &value : section.GetOptions("Depends")) {
+                hook.m_depends.push_back(value.As<std::string>());
+            }
+
+            hook.m_abortOnFail = section.HasOption("AbortOnFail");
+            hook.m_needsTargets = section.HasOption("NeedsTargets");
+        }
+    }
+
+    if (!hasAction || hook.m_triggers.empty()) {
+        return {};
+    }
+
+    return hook;
+}
+
+auto Hook::LoadAll() -> std::vector<Hook> {
+    std::map<std::string, std::filesystem::path> paths;
+    for (std::string_view directory : Utils::ALPMListView<std::string_view>(alpm_option_get_hookdirs(ALPM::GetHandle()))) {
+        std::error_code error;
+        for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(directory, error)) {
+            if (entry.path().extension() != ".hook") {
+                continue;
+            }
+
+            paths[entry.path().stem().string()] = entry.path();
+        }
+    }
+
+    std::vector<Hook> hooks;
+    for (const auto &[name, path] : paths) {
+        std::error_code error;
+        if (std::filesystem::is_symlink(path, error) && std::filesystem::read_symlink(path, error) == "/dev/null") {
+            continue;
+        }
+
+        if (std::optional<Hook> hook = FromFile(path)) {
+            hooks.push_back(std::move(*hook));
+        }
+    }
+
+    return hooks;
+}
+
+auto Hook::GetName() const -> std::string {
+    return m_name;
+}
+
+auto Hook::GetDescription() const -> std::string {
+    return m_description;
+}
+
+auto Hook::GetWhen() const -> When {
+    return m_when;
+}
+
+auto Hook::GetExec() const -> std::vector<std::string> {
+    return m_exec;
+}
+
+auto Hook::GetDepends() const -> std::vector<std::string> {
+    return m_depends;
+}
+
+auto Hook::IsAbortOnFail() const -> bool {
+    return m_abortOnFail;
+}
+
+auto Hook::NeedsTargets() const -> bool {
+    return m_needsTargets;
+}
+
+auto Hook::Match(const Changes &changes) const -> std::optional<std::set<std::string>> {
+    std::set<std::string> matched;
+    bool triggered = false;
+
+    for (const Trigger &trigger : m_triggers) {
+        const std::map<std::string, Operation> &targets = trigger.Package ? changes.Packages : changes.Files;
+        for (const auto &[target, operation] : targets) {
+            if (trigger.Operations.contains(operation) && MatchTargets(trigger.Targets, target)) {
+                matched.insert(target);
+                triggered = true;
+            }
+        }
+    }
+
+    if (!triggered) {
+        return {};
+    }
+
+    return matched;
+}
+
+auto Hook::Run(const std::set<std::string> &targets) const -> bool {
+    std::string root = alpm_option_get_root(ALPM::GetHandle());
+
+    // Nothing but async-signal-safe calls can happen after forking, so the
+    // arguments are prepared beforehand.
+    std::vector<char*> arguments;
+    for (const std::string &argument : m_exec) {
+        arguments.push_back(const_cast<char*>(argument.c_str()));
+    }
+    arguments.push_back(nullptr);
+
+    int input[2];
+    if (pipe2(input, O_CLOEXEC) != 0) {
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(input[0]);
+        close(input[1]);
+        return false;
+    }
+
+    if (pid == 0) {
+        dup2(input[0], STDIN_FILENO);
+        if ((root != "/" && chroot(root.c_str()) != 0) || chdir("/") != 0) {
+            _exit(1);
+        }
+
+        execv(arguments.front(), arguments.data());
+        _exit(1);
+    }
+
+    close(input[0]);
+    if (m_needsTargets) {
+        // A hook that exits without reading its targets mustn't take the whole
+        // process down with a SIGPIPE.
+        sigset_t pipeSignal;
+        sigset_t previous;
+        sigemptyset(&pipeSignal);
+        sigaddset(&pipeSignal, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &pipeSignal, &previous);
+
+        for (const std::string &target : targets) {
+            std::string line = target + '\n';
+            if (write(input[1], line.data(), line.size()) != static_cast<ssize_t>(line.size())) {
+                break;
+            }
+        }
+
+        timespec immediately{};
+        sigtimedwait(&pipeSignal, nullptr, &immediately);
+        pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+    }
+    close(input[1]);
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+auto Hook::MatchTargets(const std::vector<std::string> &patterns, const std::string &target) -> bool {
+    // The last pattern that matches decides, like _alpm_fnmatch_patterns.
+    for (auto it = patterns.rbegin(); it != patterns.rend(); it++) {
+        std::string_view pattern = *it;
+        bool inverted = pattern.starts_with('!');
+        if (inverted || pattern.starts_with('\\')) {
+            pattern.remove_prefix(1);
+        }
+
+        if (fnmatch(std::string(pattern).c_str(), target.c_str(), 0) == 0) {
+            return !inverted;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,169 @@
+#include "HookQueue.hpp"
+#include "ALPM.hpp"
+#include "Metrics.hpp"
+
+#include "ThreadPool.hpp"
+
+#include <alpm.h>
+
+#include <format>
+#include <future>
+#include <iostream>
+#include <utility>
+
+using namespace ALPM;
+
+auto HookQueue::Collect(const Hook::Changes &changes) -> void {
+    // Earlier transactions in the build may have installed new hooks.
+    std::vector<Hook> hooks = Hook::LoadAll();
+
+    std::lock_guard lock(m_mutex);
+    m_handle = &ALPM::GetCurrentHandle();
+    for (const Hook &hook : hooks) {
+        if (hook.GetWhen() != Hook::When::PostTransaction) {
+            continue;
+        }
+
+        std::optional<std::set<std::string>> targets = hook.Match(changes);
+        if (!targets) {
+            continue;
+        }
+
+        auto [it, inserted] = m_pending.try_emplace(hook.GetName(), Pending{.Action = hook, .Targets = {}});
+        if (!inserted) {
+            it->second.Action = hook;
+        }
+        it->second.Targets.insert(targets->begin(), targets->end());
+    }
+}
+
+auto HookQueue::MarkIndependent(const std::string &name) -> void {
+    std::lock_guard lock(m_mutex);
+    m_independent.insert(name);
+}
+
+auto HookQueue::RunPreTransaction(const Hook::Changes &changes) -> std::optional<std::string> {
+    for (const Hook &hook : Hook::LoadAll()) {
+        if (hook.GetWhen() != Hook::When::PreTransaction) {
+            continue;
+        }
+
+        std::optional<std::set<std::string>> targets = hook.Match(changes);
+        if (targets && !RunHook(hook, *targets) && hook.IsAbortOnFail()) {
+            return hook.GetName();
+        }
+    }
+
+    return {};
+}
+
+auto HookQueue::Run() -> std::vector<std::string> {
+    Handle *handle = nullptr;
+    std::map<std::string, Pending> pending;
+    std::set<std::string> independent;
+    {
+        std::lock_guard lock(m_mutex);
+        handle = m_handle;
+        pending = std::exchange(m_pending, {});
+        independent = m_independent;
+    }
+
+    if (pending.empty()) {
+        return {};
+    }
+
+    // The hooks belong to the root they were collected for, whichever thread
+    // runs them.
+    Handle::Scope scope(*handle);
+    Metrics::Scope span(Metrics::Phase::Hooks);
+
+    std::vector<std::string> failed;
+    auto it = pending.begin();
+    while (it != pending.end()) {
+        if (!independent.contains(it->first)) {
+            if (!RunHook(it->second.Action, it->second.Targets)) {
+                failed.push_back(it->first);
+            }
+            it++;
+            continue;
+        }
+
+        // Runs the independent hooks up to the next one that isn't side by
+        // side, on threads that don't have the handle bound yet. libalpm isn't
+        // thread safe, so only the commands run there, after each hook has
+        // been checked here.
+        std::vector<std::pair<std::string, std::future<bool>>> running;
+        for (; it != pending.end() && independent.contains(it->first); it++) {
+            const Pending &hook = it->second;
+            if (!Start(hook.Action)) {
+                failed.push_back(it->first);
+                continue;
+            }
+
+            running.emplace_back(it->first, ThreadPool::GetShared().Submit([handle, &hook]() -> bool {
+                Handle::Scope scope(*handle);
+                return Exec(hook.Action, hook.Targets);
+            }));
+        }
+
+        for (auto &[name, result] : running) {
+            if (!result.get()) {
+                failed.push_back(name);
+            }
+        }
+    }
+
+    return failed;
+}
+
+auto HookQueue::GetPending() const -> std::vector<std::string> {
+    std::lock_guard lock(m_mutex);
+
+    std::vector<std::string> names;
+    for (const auto &[name, pending] : m_pending) {
+        names.push_back(name);
+    }
+
+    return names;
+}
+
+auto HookQueue::IsEmpty() const -> bool {
+    std::lock_guard lock(m_mutex);
+    return m_pending.empty();
+}
+
+auto HookQueue::CanRun(const Hook &hook) -> bool {
+    alpm_list_t *installed = alpm_db_get_pkgcache(alpm_get_localdb(ALPM::GetHandle()));
+    for (const std::string &dependency : hook.GetDepends()) {
+        if (alpm_find_satisfier(installed, dependency.c_str()) == nullptr) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+auto HookQueue::Start(const Hook &hook) -> bool {
+    if (!CanRun(hook)) {
+        std::cerr << std::format("Skipping hook {}: unsatisfied dependencies", hook.GetName()) << std::endl;
+        return false;
+    }
+
+    std::cout << std::format(":: {}", hook.GetDescription().empty() ? hook.GetName() : hook.GetDescription()) << std::endl;
+    Metrics::Add(Metrics::Counter::Hooks);
+
+    return true;
+}
+
+auto HookQueue::Exec(const Hook &hook, const std::set<std::string> &targets) -> bool {
+    bool succeeded = hook.Run(targets);
+    if (!succeeded) {
+        std::cerr << std::format("Hook {} failed", hook.GetName()) << std::endl;
+    }
+
+    return succeeded;
+}
+
+auto HookQueue::RunHook(const Hook &hook, const std::set<std::string> &targets) -> bool {
+    return Start(hook) && Exec(hook, targets);
+}
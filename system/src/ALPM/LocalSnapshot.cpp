@@ -0,0 +1,310 @@
+#include "LocalSnapshot.hpp"
+#include "ALPM.hpp"
+#include "Events.hpp"
+
+#include "Event.hpp"
+
+#include <alpm.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <charconv>
+#include <format>
+#include <fstream>
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace ALPM;
+
+namespace {
+    // libalpm adds and removes a directory in the local database for every
+    // package it installs or removes, so the directory changes with them.
+    auto StatDatabase(const std::filesystem::path &local, int64_t &modifiedTime, uint64_t &inode) -> bool {
+        struct stat buffer{};
+        if (stat(local.c_str(), &buffer) != 0) {
+            return false;
+        }
+
+        modifiedTime = static_cast<int64_t>(buffer.st_mtim.tv_sec) * 1'000'000'000 + buffer.st_mtim.tv_nsec;
+        inode = buffer.st_ino;
+
+        return true;
+    }
+}  // namespace
+
+LocalSnapshot::LocalSnapshot(Private) {}
+
+auto LocalSnapshot::Get() -> std::shared_ptr<const LocalSnapshot> {
+    Handle &handle = ALPM::GetCurrentHandle();
+    std::shared_ptr<const LocalSnapshot> snapshot;
+    {
+        std::lock_guard lock(s_mutex);
+        if (auto it = s_instances.find(handle.GetId()); it != s_instances.end()) {
+            snapshot = it->second;
+        }
+    }
+
+    if (!snapshot) {
+        return Capture();
+    }
+
+    // A transaction, ours or another process's, holds the lock while it writes
+    // the local database, so until it's done the last snapshot is the one that
+    // makes sense.
+    std::error_code error;
+    if (!snapshot->IsStale() || std::filesystem::exists(alpm_option_get_lockfile(handle.GetHandle()), error)) {
+        return snapshot;
+    }
+
+    return Refresh(*snapshot);
+}
+
+auto LocalSnapshot::Capture() -> std::shared_ptr<const LocalSnapshot> {
+    Handle &handle = ALPM::GetCurrentHandle();
+    {
+        std::lock_guard lock(s_mutex);
+        if (auto it = s_instances.find(handle.GetId()); it != s_instances.end() && !it->second->IsStale()) {
+            return it->second;
+        }
+    }
+
+    // Stat before reading, so a change made while reading leaves the snapshot
+    // stale instead of hiding it.
+    std::filesystem::path local = handle.GetDatabasePath() / "local";
+    int64_t modifiedTime = 0;
+    uint64_t inode = 0;
+    StatDatabase(local, modifiedTime, inode);
+
+    std::vector<Record> records;
+    for (const alpm_list_t *i = alpm_db_get_pkgcache(alpm_get_localdb(handle.GetHandle())); i != nullptr; i = i->next) {
+        records.push_back(Read(static_cast<alpm_pkg_t*>(i->data)));
+    }
+
+    std::shared_ptr<LocalSnapshot> snapshot = Build(std::move(records));
+    snapshot->m_database = local;
+    snapshot->m_modifiedTime = modifiedTime;
+    snapshot->m_inode = inode;
+
+    return Publish(std::move(snapshot));
+}
+
+auto LocalSnapshot::Update(const std::vector<std::string> &changed) -> std::shared_ptr<const LocalSnapshot> {
+    Handle &handle = ALPM::GetCurrentHandle();
+    std::shared_ptr<const LocalSnapshot> previous;
+    {
+        std::lock_guard lock(s_mutex);
+        if (auto it = s_instances.find(handle.GetId()); it != s_instances.end()) {
+            previous = it->second;
+        }
+    }
+
+    if (!previous) {
+        return Capture();
+    }
+
+    std::filesystem::path local = handle.GetDatabasePath() / "local";
+    int64_t modifiedTime = 0;
+    uint64_t inode = 0;
+    StatDatabase(local, modifiedTime, inode);
+
+    std::set<std::string_view> names(changed.begin(), changed.end());
+
+    std::vector<Record> records;
+    records.reserve(previous->m_entries.size() + changed.size());
+    for (const Entry &entry : previous->m_entries) {
+        if (!names.contains(entry.Name)) {
+            records.push_back(Record{.Name = std::string(entry.Name), .Version = std::string(entry.Version), .Reason = entry.Reason, .InstallSize = entry.InstallSize});
+        }
+    }
+
+    // Removed packages aren't in the local database anymore.
+    alpm_db_t *localDatabase = alpm_get_localdb(handle.GetHandle());
+    for (std::string_view name : names) {
+        if (alpm_pkg_t *pkg = alpm_db_get_pkg(localDatabase, std::string(name).c_str())) {
+            records.push_back(Read(pkg));
+        }
+    }
+
+    std::shared_ptr<LocalSnapshot> snapshot = Build(std::move(records));
+    snapshot->m_database = local;
+    snapshot->m_modifiedTime = modifiedTime;
+    snapshot->m_inode = inode;
+
+    return Publish(std::move(snapshot));
+}
+
+auto LocalSnapshot::GetEntries() const -> std::span<const Entry> {
+    return m_entries;
+}
+
+auto LocalSnapshot::Find(std::string_view name) const -> std::optional<Entry> {
+    auto it = std::ranges::lower_bound(m_entries, name, {}, &Entry::Name);
+    if (it == m_entries.end() || it->Name != name) {
+        return {};
+    }
+
+    return *it;
+}
+
+auto LocalSnapshot::GetPackageCount() const -> std::size_t {
+    return m_entries.size();
+}
+
+auto LocalSnapshot::GetCapturedAt() const -> std::chrono::system_clock::time_point {
+    return m_capturedAt;
+}
+
+auto LocalSnapshot::IsStale() const -> bool {
+    int64_t modifiedTime = 0;
+    uint64_t inode = 0;
+    if (!StatDatabase(m_database, modifiedTime, inode)) {
+        return true;
+    }
+
+    return modifiedTime != m_modifiedTime || inode != m_inode;
+}
+
+auto LocalSnapshot::Read(alpm_pkg_t *pkg) -> Record {
+    PackageView package(pkg);
+
+    return Record{
+        .Name = std::string(package.GetName()),
+        .Version = std::string(package.GetVersion()),
+        .Reason = package.GetReason(),
+        .InstallSize = package.GetInstallSize()
+    };
+}
+
+auto LocalSnapshot::Load(const std::filesystem::path &description) -> std::optional<Record> {
+    std::ifstream file(description);
+    if (!file) {
+        return {};
+    }
+
+    // Fields are a `%NAME%` line followed by one value per line up to an empty
+    // line. libalpm leaves the reason out for explicitly installed packages.
+    Record record{.Reason = Package::Reason::Explicit, .InstallSize = 0};
+    std::string field;
+    for (std::string line; std::getline(file, line);) {
+        if (line.empty()) {
+            field.clear();
+        } else if (field.empty()) {
+            field = line;
+        } else if (field == "%NAME%") {
+            record.Name = line;
+        } else if (field == "%VERSION%") {
+            record.Version = line;
+        } else if (field == "%REASON%") {
+            record.Reason = line == "1" ? Package::Reason::Depend : Package::Reason::Explicit;
+        } else if (field == "%SIZE%") {
+            std::from_chars(line.data(), line.data() + line.size(), record.InstallSize);
+        }
+    }
+
+    if (record.Name.empty() || record.Version.empty()) {
+        return {};
+    }
+
+    return record;
+}
+
+auto LocalSnapshot::Refresh(const LocalSnapshot &previous) -> std::shared_ptr<const LocalSnapshot> {
+    // libalpm reads the local database once per handle, so it never sees what
+    // another process changed. The directories are read instead: each one is
+    // named after the name and version of its package, so only new ones have
+    // to be parsed.
+    int64_t modifiedTime = 0;
+    uint64_t inode = 0;
+    StatDatabase(previous.m_database, modifiedTime, inode);
+
+    std::unordered_map<std::string, const Entry*> known;
+    for (const Entry &entry : previous.m_entries) {
+        known.emplace(std::format("{}-{}", entry.Name, entry.Version), &entry);
+    }
+
+    std::vector<Record> records;
+    records.reserve(previous.m_entries.size());
+
+    std::error_code error;
+    for (std::filesystem::directory_iterator it(previous.m_database, error), end; !error && it != end; it.increment(error)) {
+        if (!it->is_directory(error)) {
+            continue;
+        }
+
+        if (auto entry = known.find(it->path().filename().string()); entry != known.end()) {
+            const Entry &carried = *entry->second;
+            records.push_back(Record{.Name = std::string(carried.Name), .Version = std::string(carried.Version), .Reason = carried.Reason, .InstallSize = carried.InstallSize});
+        } else if (std::optional<Record> record = Load(it->path() / "desc")) {
+            records.push_back(std::move(*record));
+        }
+    }
+
+    if (error) {
+        throw std::runtime_error(std::format("Could not read {}: {}", previous.m_database.string(), error.message()));
+    }
+
+    std::shared_ptr<LocalSnapshot> snapshot = Build(std::move(records));
+    snapshot->m_database = previous.m_database;
+    snapshot->m_modifiedTime = modifiedTime;
+    snapshot->m_inode = inode;
+
+    return Publish(std::move(snapshot));
+}
+
+auto LocalSnapshot::Build(std::vector<Record> records) -> std::shared_ptr<LocalSnapshot> {
+    std::ranges::sort(records, {}, &Record::Name);
+
+    std::shared_ptr<LocalSnapshot> snapshot = std::make_shared<LocalSnapshot>(Private());
+    snapshot->m_capturedAt = std::chrono::system_clock::now();
+
+    std::size_t length = 0;
+    for (const Record &record : records) {
+        length += record.Name.size() + record.Version.size();
+    }
+
+    snapshot->m_strings.reserve(length);
+    std::vector<std::pair<std::size_t, std::size_t>> offsets;
+    offsets.reserve(records.size());
+    for (const Record &record : records) {
+        offsets.emplace_back(snapshot->m_strings.size(), snapshot->m_strings.size() + record.Name.size());
+        snapshot->m_strings += record.Name;
+        snapshot->m_strings += record.Version;
+    }
+
+    // The strings are complete, so views into them stay valid from here on.
+    std::string_view strings = snapshot->m_strings;
+    snapshot->m_entries.reserve(records.size());
+    for (std::size_t i = 0; i < records.size(); i++) {
+        const Record &record = records[i];
+        auto [name, version] = offsets[i];
+        snapshot->m_entries.push_back(Entry{
+            .Name = strings.substr(name, record.Name.size()),
+            .Version = strings.substr(version, record.Version.size()),
+            .Reason = record.Reason,
+            .InstallSize = record.InstallSize
+        });
+    }
+
+    return snapshot;
+}
+
+auto LocalSnapshot::Publish(std::shared_ptr<LocalSnapshot> snapshot) -> std::shared_ptr<const LocalSnapshot> {
+    uint64_t handle = ALPM::GetCurrentHandle().GetId();
+    std::lock_guard lock(s_mutex);
+
+    // Readers keep the snapshot they already have.
+    std::shared_ptr<const LocalSnapshot> &instance = s_instances[handle];
+    instance = std::move(snapshot);
+
+    static std::once_flag registered;
+    std::call_once(registered, []() -> void {
+        Event::Event::RegisterCallback<HandleReleasedEvent>([](const HandleReleasedEvent &event) -> void {
+            std::lock_guard lock(s_mutex);
+            s_instances.erase(event.Handle);
+        });
+    });
+
+    return instance;
+}
@@ -0,0 +1,271 @@
+#include "Metrics.hpp"
+#include "ALPM.hpp"
+#include "Events.hpp"
+
+#include "Event.hpp"
+
+#include <alpm.h>
+
+#include <algorithm>
+#include <exception>
+#include <format>
+#include <fstream>
+#include <utility>
+
+using namespace ALPM;
+
+namespace {
+    auto ToSeconds(Metrics::Clock::duration duration) -> double {
+        return std::chrono::duration<double>(duration).count();
+    }
+}  // namespace
+
+Metrics::Scope::Scope(Phase phase) :
+    m_state(GetState()),
+    m_phase(phase),
+    m_start(Clock::now())
+{}
+
+Metrics::Scope::~Scope() {
+    End();
+}
+
+auto Metrics::Scope::End() -> void {
+    if (m_ended) {
+        return;
+    }
+
+    m_ended = true;
+    Record(*m_state, m_phase, m_start, Clock::now());
+}
+
+Metrics::Run::Run(std::filesystem::path path) :
+    m_state(GetState()),
+    m_path(std::move(path)),
+    m_exceptions(std::uncaught_exceptions())
+{
+    Reset(*m_state);
+}
+
+Metrics::Run::~Run() {
+    Write(*m_state, m_path, std::uncaught_exceptions() == m_exceptions);
+}
+
+auto Metrics::Begin(Phase phase) -> void {
+    std::shared_ptr<State> state = GetState();
+    std::lock_guard lock(state->Mutex);
+
+    std::optional<Clock::time_point> &open = state->Open[std::to_underlying(phase)];
+    if (!open) {
+        open = Clock::now();
+    }
+}
+
+auto Metrics::End(Phase phase) -> void {
+    std::shared_ptr<State> state = GetState();
+    std::lock_guard lock(state->Mutex);
+
+    std::optional<Clock::time_point> &open = state->Open[std::to_underlying(phase)];
+    if (open) {
+        state->Spans.push_back(Span{.Kind = phase, .Start = *open, .End = Clock::now()});
+        open.reset();
+    }
+}
+
+auto Metrics::Record(Phase phase, Clock::time_point start, Clock::time_point end) -> void {
+    Record(*GetState(), phase, start, end);
+}
+
+auto Metrics::Add(Counter counter, uint64_t amount) -> void {
+    std::shared_ptr<State> state = GetState();
+    std::lock_guard lock(state->Mutex);
+    state->Counters[std::to_underlying(counter)] += amount;
+}
+
+auto Metrics::GetDuration(Phase phase) -> Clock::duration {
+    std::shared_ptr<State> state = GetState();
+    std::lock_guard lock(state->Mutex);
+    return GetDurationLocked(*state, phase);
+}
+
+auto Metrics::GetCount(Counter counter) -> uint64_t {
+    std::shared_ptr<State> state = GetState();
+    std::lock_guard lock(state->Mutex);
+    return state->Counters[std::to_underlying(counter)];
+}
+
+auto Metrics::GetSpans() -> std::vector<Span> {
+    std::shared_ptr<State> state = GetState();
+    std::lock_guard lock(state->Mutex);
+    return state->Spans;
+}
+
+auto Metrics::GetElapsed() -> Clock::duration {
+    std::shared_ptr<State> state = GetState();
+    std::lock_guard lock(state->Mutex);
+    return Clock::now() - state->Start;
+}
+
+auto Metrics::Reset() -> void {
+    Reset(*GetState());
+}
+
+auto Metrics::ToJSON(bool succeeded) -> std::string {
+    std::shared_ptr<State> state = GetState();
+    std::lock_guard lock(state->Mutex);
+    return ToJSONLocked(*state, succeeded);
+}
+
+auto Metrics::Write(const std::filesystem::path &path, bool succeeded) -> bool {
+    return Write(*GetState(), path, succeeded);
+}
+
+auto Metrics::GetDefaultPath() -> std::filesystem::path {
+    return std::filesystem::path(alpm_option_get_root(ALPM::GetHandle())) / "var/log/system/metrics.jsonl";
+}
+
+auto Metrics::GetName(Phase phase) -> std::string_view {
+    switch (phase) {
+        case Phase::Refresh:
+            return "refresh";
+        case Phase::Resolve:
+            return "resolve";
+        case Phase::Download:
+            return "download";
+        case Phase::Verify:
+            return "verify";
+        case Phase::Decompress:
+            return "decompress";
+        case Phase::Extract:
+            return "extract";
+        case Phase::Hooks:
+            return "hooks";
+    }
+
+    return {};
+}
+
+auto Metrics::GetName(Counter counter) -> std::string_view {
+    switch (counter) {
+        case Counter::Databases:
+            return "databases";
+        case Counter::Bytes:
+            return "bytes";
+        case Counter::Packages:
+            return "packages";
+        case Counter::Files:
+            return "files";
+        case Counter::Hooks:
+            return "hooks";
+    }
+
+    return {};
+}
+
+auto Metrics::GetState() -> std::shared_ptr<State> {
+    uint64_t handle = ALPM::GetCurrentHandle().GetId();
+
+    std::lock_guard lock(s_mutex);
+    std::shared_ptr<State> &state = s_states[handle];
+    if (!state) {
+        state = std::make_shared<State>();
+    }
+
+    static std::once_flag registered;
+    std::call_once(registered, []() -> void {
+        Event::Event::RegisterCallback<HandleReleasedEvent>([](const HandleReleasedEvent &event) -> void {
+            std::lock_guard lock(s_mutex);
+            s_states.erase(event.Handle);
+        });
+    });
+
+    return state;
+}
+
+auto Metrics::Record(State &state, Phase phase, Clock::time_point start, Clock::time_point end) -> void {
+    std::lock_guard lock(state.Mutex);
+    state.Spans.push_back(Span{.Kind = phase, .Start = start, .End = end});
+}
+
+auto Metrics::Reset(State &state) -> void {
+    std::lock_guard lock(state.Mutex);
+    state.Start = Clock::now();
+    state.Started = std::chrono::system_clock::now();
+    state.Spans.clear();
+    state.Open.fill(std::nullopt);
+    state.Counters.fill(0);
+}
+
+auto Metrics::Write(State &state, const std::filesystem::path &path, bool succeeded) -> bool {
+    std::string json;
+    {
+        std::lock_guard lock(state.Mutex);
+        json = ToJSONLocked(state, succeeded);
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+
+    std::ofstream file(path, std::ios::app);
+    if (!file) {
+        return false;
+    }
+
+    file << json << '\n';
+    return static_cast<bool>(file.flush());
+}
+
+auto Metrics::ToJSONLocked(const State &state, bool succeeded) -> std::string {
+    std::string json = std::format(R"({{"started":{},"succeeded":{},"elapsed":{:.6f})", std::chrono::duration_cast<std::chrono::seconds>(state.Started.time_since_epoch()).count(), succeeded, ToSeconds(Clock::now() - state.Start));
+
+    json += R"(,"phases":{)";
+    for (std::size_t i = 0; i < PHASE_COUNT; i++) {
+        Phase phase = static_cast<Phase>(i);
+        json += std::format(R"({}"{}":{:.6f})", i == 0 ? "" : ",", GetName(phase), ToSeconds(GetDurationLocked(state, phase)));
+    }
+
+    json += R"(},"counters":{)";
+    for (std::size_t i = 0; i < COUNTER_COUNT; i++) {
+        json += std::format(R"({}"{}":{})", i == 0 ? "" : ",", GetName(static_cast<Counter>(i)), state.Counters[i]);
+    }
+
+    json += R"(},"spans":[)";
+    for (std::size_t i = 0; i < state.Spans.size(); i++) {
+        const Span &span = state.Spans[i];
+        json += std::format(R"({}{{"phase":"{}","start":{:.6f},"end":{:.6f}}})", i == 0 ? "" : ",", GetName(span.Kind), ToSeconds(span.Start - state.Start), ToSeconds(span.End - state.Start));
+    }
+    json += "]}";
+
+    return json;
+}
+
+auto Metrics::GetDurationLocked(const State &state, Phase phase) -> Clock::duration {
+    std::vector<std::pair<Clock::time_point, Clock::time_point>> spans;
+    for (const Span &span : state.Spans) {
+        if (span.Kind == phase) {
+            spans.emplace_back(span.Start, span.End);
+        }
+    }
+    std::ranges::sort(spans);
+
+    // Same as Pipeline::GetOverlap, only the union of the spans counts.
+    Clock::duration covered{};
+    std::optional<std::pair<Clock::time_point, Clock::time_point>> current;
+    for (const auto &span : spans) {
+        if (current && span.first <= current->second) {
+            current->second = std::max(current->second, span.second);
+            continue;
+        }
+
+        if (current) {
+            covered += current->second - current->first;
+        }
+        current = span;
+    }
+
+    if (current) {
+        covered += current->second - current->first;
+    }
+
+    return covered;
+}
@@ -0,0 +1,278 @@
+#include "MirrorRanking.hpp"
+#include "ALPM.hpp"
+
+#include <alpm.h>
+#include <curl/curl.h>
+
+#include <algorithm>
+#include <atomic>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+using namespace ALPM;
+
+namespace {
+    constexpr std::string_view HEADER = "system-mirrors 1";
+
+    // How much a new measurement moves the average.
+    constexpr double WEIGHT = 0.3;
+
+    // Smaller transfers are over before throughput means anything.
+    constexpr uint64_t MIN_THROUGHPUT_BYTES = 64 * 1024;
+
+    // Mirrors are compared by how long they'd take to send a file about the
+    // size of a typical package.
+    constexpr double REFERENCE_SIZE = 4.0 * 1024 * 1024;
+
+    constexpr std::chrono::seconds BASE_DEMOTION{5 * 60};
+    constexpr std::chrono::seconds MAX_DEMOTION{24 * 60 * 60};
+
+    constexpr std::size_t PROBE_THREADS = 8;
+
+    auto Blend(double average, double sample, bool first) -> double {
+        return first ? sample : average + WEIGHT * (sample - average);
+    }
+
+    auto Now() -> int64_t {
+        return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    struct ProbeContext {
+        uint64_t Bytes{0};
+    };
+
+    auto DiscardProbe(char *, std::size_t size, std::size_t count, void *data) -> std::size_t {
+        ProbeContext *context = static_cast<ProbeContext*>(data);
+        context->Bytes += size * count;
+
+        // Stops mirrors that ignore the range from sending the whole file.
+        return context->Bytes > MirrorRanking::PROBE_SIZE ? 0 : size * count;
+    }
+}  // namespace
+
+MirrorRanking::MirrorRanking(std::filesystem::path path) :
+    m_path(std::move(path))
+{
+    Load();
+}
+
+auto MirrorRanking::Get() -> std::shared_ptr<MirrorRanking> {
+    uint64_t handle = ALPM::GetCurrentHandle().GetId();
+    std::lock_guard lock(s_mutex);
+
+    std::shared_ptr<MirrorRanking> &instance = s_instances[handle];
+    if (!instance) {
+        instance = std::make_shared<MirrorRanking>(GetDefaultPath());
+    }
+
+    return instance;
+}
+
+auto MirrorRanking::GetDefaultPath() -> std::filesystem::path {
+    return std::filesystem::path(alpm_option_get_root(ALPM::GetHandle())) / "var/lib/system/mirrors";
+}
+
+auto MirrorRanking::GetMirror(std::string_view url) -> std::string {
+    std::size_t scheme = url.find("://");
+    if (scheme == std::string_view::npos) {
+        return std::string(url);
+    }
+
+    std::size_t host = url.find('/', scheme + 3);
+    return std::string(url.substr(0, host));
+}
+
+auto MirrorRanking::Record(std::string_view server, std::chrono::duration<double> timeToFirstByte, uint64_t bytes, std::chrono::duration<double> transferTime) -> void {
+    std::lock_guard lock(m_mutex);
+    Score &score = m_scores[GetMirror(server)];
+
+    score.TimeToFirstByte = Blend(score.TimeToFirstByte, timeToFirstByte.count(), score.Samples == 0);
+    if (bytes >= MIN_THROUGHPUT_BYTES && transferTime.count() > 0.0) {
+        score.Throughput = Blend(score.Throughput, static_cast<double>(bytes) / transferTime.count(), score.Throughput == 0.0);
+    }
+
+    score.Samples++;
+    score.Failures = 0;
+    score.DemotedUntil = 0;
+    m_changed = true;
+}
+
+auto MirrorRanking::RecordFailure(std::string_view server) -> void {
+    std::lock_guard lock(m_mutex);
+    Score &score = m_scores[GetMirror(server)];
+
+    // Every download from a mirror that went down fails at about the same
+    // time, which is still only one outage.
+    int64_t now = Now();
+    if (score.DemotedUntil > now) {
+        return;
+    }
+
+    score.Failures++;
+    std::chrono::seconds demotion = std::min(BASE_DEMOTION * (int64_t{1} << std::min<uint32_t>(score.Failures - 1, 16)), MAX_DEMOTION);
+    score.DemotedUntil = now + demotion.count();
+    m_changed = true;
+}
+
+auto MirrorRanking::Probe(const std::vector<std::string> &servers, std::string_view filename) -> void {
+    static std::once_flag curlInitialized;
+    std::call_once(curlInitialized, []() -> void {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+    });
+
+    std::atomic<std::size_t> next{0};
+    auto work = [&]() -> void {
+        for (std::size_t i = next++; i < servers.size(); i = next++) {
+            const std::string &server = servers[i];
+            std::string url = std::format("{}/{}", server, filename);
+            std::string range = std::format("0-{}", PROBE_SIZE - 1);
+
+            ProbeContext context;
+            CURL *curl = curl_easy_init();
+            curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+            curl_easy_setopt(curl, CURLOPT_RANGE, range.c_str());
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, DiscardProbe);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &context);
+            curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+            curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+            curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+            curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 10L);
+            curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, 30'000L);
+
+            CURLcode result = curl_easy_perform(curl);
+
+            curl_off_t firstByte = 0;
+            curl_off_t total = 0;
+            long response = 0;
+            curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &firstByte);
+            curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response);
+            curl_easy_cleanup(curl);
+
+            if (result == CURLE_OK || (result == CURLE_WRITE_ERROR && context.Bytes > PROBE_SIZE)) {
+                Record(server, std::chrono::microseconds(firstByte), context.Bytes, std::chrono::microseconds(total - firstByte));
+            } else if (result != CURLE_HTTP_RETURNED_ERROR || response >= 500) {
+                // A missing file says nothing about the mirror.
+                RecordFailure(server);
+            }
+        }
+    };
+
+    std::vector<std::jthread> workers;
+    for (std::size_t i = 0; i < std::min(PROBE_THREADS, servers.size()); i++) {
+        workers.emplace_back(work);
+    }
+}
+
+auto MirrorRanking::Rank(std::vector<std::string> servers) const -> std::vector<std::string> {
+    std::lock_guard lock(m_mutex);
+    int64_t now = Now();
+
+    auto key = [this, now](const std::string &server) -> std::pair<int, double> {
+        auto it = m_scores.find(GetMirror(server));
+        if (it == m_scores.end()) {
+            return {1, 0.0};
+        }
+
+        const Score &score = it->second;
+        if (score.DemotedUntil > now) {
+            return {2, static_cast<double>(score.DemotedUntil)};
+        }
+        if (score.Samples == 0) {
+            return {1, 0.0};
+        }
+
+        // Mirrors only measured on small files are ranked on their latency alone.
+        return {0, score.TimeToFirstByte + (score.Throughput > 0.0 ? REFERENCE_SIZE / score.Throughput : 0.0)};
+    };
+
+    std::vector<std::pair<std::pair<int, double>, std::string>> keyed;
+    keyed.reserve(servers.size());
+    for (std::string &server : servers) {
+        keyed.emplace_back(key(server), std::move(server));
+    }
+
+    std::ranges::stable_sort(keyed, {}, [](const auto &entry) -> const std::pair<int, double>& {
+        return entry.first;
+    });
+
+    for (std::size_t i = 0; i < keyed.size(); i++) {
+        servers[i] = std::move(keyed[i].second);
+    }
+
+    return servers;
+}
+
+auto MirrorRanking::GetScore(std::string_view server) const -> std::optional<Score> {
+    std::lock_guard lock(m_mutex);
+    auto it = m_scores.find(GetMirror(server));
+    if (it == m_scores.end()) {
+        return {};
+    }
+
+    return it->second;
+}
+
+auto MirrorRanking::IsDemoted(std::string_view server) const -> bool {
+    std::optional<Score> score = GetScore(server);
+    return score && score->DemotedUntil > Now();
+}
+
+auto MirrorRanking::Save() -> bool {
+    std::lock_guard lock(m_mutex);
+    if (!m_changed) {
+        return true;
+    }
+
+    std::filesystem::path temporaryPath = m_path;
+    temporaryPath += ".tmp";
+
+    std::error_code error;
+    std::filesystem::create_directories(m_path.parent_path(), error);
+
+    {
+        std::ofstream file(temporaryPath, std::ios::trunc);
+        if (!file) {
+            return false;
+        }
+
+        file << HEADER << '\n';
+        for (const auto &[mirror, score] : m_scores) {
+            file << std::format("{} {} {} {} {} {}\n", mirror, score.TimeToFirstByte, score.Throughput, score.Samples, score.Failures, score.DemotedUntil);
+        }
+
+        if (!file.flush()) {
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+    }
+
+    // Only one process ranks mirrors at a time in practice, so the last one to
+    // save simply wins.
+    std::filesystem::rename(temporaryPath, m_path, error);
+    if (error) {
+        return false;
+    }
+
+    m_changed = false;
+    return true;
+}
+
+auto MirrorRanking::Load() -> void {
+    std::ifstream file(m_path);
+    std::string line;
+    if (!file || !std::getline(file, line) || line != HEADER) {
+        return;
+    }
+
+    while (std::getline(file, line)) {
+        std::istringstream stream(line);
+        std::string mirror;
+        Score score;
+        if (stream >> mirror >> score.TimeToFirstByte >> score.Throughput >> score.Samples >> score.Failures >> score.DemotedUntil) {
+            m_scores.insert_or_assign(std::move(mirror), score);
+        }
+    }
+}
@@ -1,9 +1,15 @@
 #include "Package.hpp"
 #include "ALPM.hpp"
+#include "Handle.hpp"
+#include "Downloader.hpp"
 #include "alpm.h"
+#include <algorithm>
 #include <format>
 #include <stdexcept>
 #include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 
 using namespace ALPM;
 
@@ -14,28 +20,71 @@ Package::~Package() {
     Free();
 }
 
-auto operator<(const Package &lhs, const Package &rhs) -> bool {
-    return alpm_pkg_vercmp(lhs.GetVersion().c_str(), rhs.GetVersion().c_str()) < 0;
-}
+namespace ALPM {
+    auto operator<(const Package &lhs, const Package &rhs) -> bool {
+        return alpm_pkg_vercmp(alpm_pkg_get_version(lhs.m_alpmPkg), alpm_pkg_get_version(rhs.m_alpmPkg)) < 0;
+    }
 
-auto operator>(const Package &lhs, const Package &rhs) -> bool {
-    return alpm_pkg_vercmp(lhs.GetVersion().c_str(), rhs.GetVersion().c_str()) > 0;
-}
+    auto operator>(const Package &lhs, const Package &rhs) -> bool {
+        return alpm_pkg_vercmp(alpm_pkg_get_version(lhs.m_alpmPkg), alpm_pkg_get_version(rhs.m_alpmPkg)) > 0;
+    }
 
-auto operator<=(const Package &lhs, const Package &rhs) -> bool {
-    return alpm_pkg_vercmp(lhs.GetVersion().c_str(), rhs.GetVersion().c_str()) <= 0;
-}
+    auto operator<=(const Package &lhs, const Package &rhs) -> bool {
+        return alpm_pkg_vercmp(alpm_pkg_get_version(lhs.m_alpmPkg), alpm_pkg_get_version(rhs.m_alpmPkg)) <= 0;
+    }
 
-auto operator>=(const Package &lhs, const Package &rhs) -> bool {
-    return alpm_pkg_vercmp(lhs.GetVersion().c_str(), rhs.GetVersion().c_str()) >= 0;
-}
+    auto operator>=(const Package &lhs, const Package &rhs) -> bool {
+        return alpm_pkg_vercmp(alpm_pkg_get_version(lhs.m_alpmPkg), alpm_pkg_get_version(rhs.m_alpmPkg)) >= 0;
+    }
 
-auto operator==(const Package &lhs, const Package &rhs) -> bool {
-    return alpm_pkg_vercmp(lhs.GetVersion().c_str(), rhs.GetVersion().c_str()) == 0;
+    auto operator==(const Package &lhs, const Package &rhs) -> bool {
+        return alpm_pkg_vercmp(alpm_pkg_get_version(lhs.m_alpmPkg), alpm_pkg_get_version(rhs.m_alpmPkg)) == 0;
+    }
+
+    auto operator!=(const Package &lhs, const Package &rhs) -> bool {
+        return alpm_pkg_vercmp(alpm_pkg_get_version(lhs.m_alpmPkg), alpm_pkg_get_version(rhs.m_alpmPkg)) != 0;
+    }
+}  // namespace ALPM
+
+auto Package::NameVersionLess::operator()(const Package &lhs, const Package &rhs) const -> bool {
+    if (int result = std::strcmp(alpm_pkg_get_name(lhs.m_alpmPkg), alpm_pkg_get_name(rhs.m_alpmPkg)); result != 0) {
+        return result < 0;
+    }
+
+    return alpm_pkg_vercmp(alpm_pkg_get_version(lhs.m_alpmPkg), alpm_pkg_get_version(rhs.m_alpmPkg)) < 0;
 }
 
-auto operator!=(const Package &lhs, const Package &rhs) -> bool {
-    return alpm_pkg_vercmp(lhs.GetVersion().c_str(), rhs.GetVersion().c_str()) != 0;
+auto Package::SortByNameVersion(std::vector<Package> &packages) -> void {
+    struct Key {
+        std::string_view Name;
+        VersionKey Version;
+        std::size_t Index;
+    };
+
+    std::vector<Key> keys;
+    keys.reserve(packages.size());
+    for (std::size_t i = 0; i < packages.size(); i++) {
+        keys.push_back(Key{.Name = alpm_pkg_get_name(packages[i].m_alpmPkg), .Version = VersionKey(alpm_pkg_get_version(packages[i].m_alpmPkg)), .Index = i});
+    }
+
+    std::ranges::sort(keys, [](const Key &lhs, const Key &rhs) -> bool {
+        if (lhs.Name != rhs.Name) {
+            return lhs.Name < rhs.Name;
+        }
+
+        return lhs.Version < rhs.Version;
+    });
+
+    // Packages loaded from files own their libalpm package, so ownership moves
+    // to the sorted copy instead of being freed with the old one.
+    std::vector<Package> sorted;
+    sorted.reserve(packages.size());
+    for (const Key &key : keys) {
+        Package &package = packages[key.Index];
+        sorted.emplace_back(package.m_alpmPkg, std::exchange(package.m_canFree, false));
+    }
+
+    packages = std::move(sorted);
 }
 
 auto Package::Free() -> void {
@@ -56,50 +105,51 @@ auto Package::FromFile(const std::filesystem::path &file, int verificationLevel)
 }
 
 auto Package::Download(const std::vector<Package> &packages) -> std::vector<std::filesystem::path> {
-    alpm_list_t *list;
-
-    for (const Package &package : packages) {
-        char *url = new char[package.GetURL().size()];
-        std::strcpy(url, package.GetURL().c_str());
-        alpm_list_add(list, url);
+    Downloader downloader;
+
+    // The downloader hands its results back largest first, so they're put back
+    // at the index of their package afterwards.
+    std::vector<std::filesystem::path> paths(packages.size());
+    std::unordered_set<std::string> queued;
+    for (std::size_t i = 0; i < packages.size(); ++i) {
+        const Package &package = packages[i];
+
+        // libalpm reports a download size of 0 for packages already in the cache.
+        if (package.GetDownloadSize() == 0) {
+            paths[i] = Downloader::GetCacheDirectory() / package.GetFilename();
+            continue;
+        }
+
+        if (queued.insert(package.GetFilename()).second) {
+            downloader.Add(package);
+        }
     }
 
-    alpm_list_t *fetched = nullptr;
-    alpm_fetch_pkgurl(ALPM::GetHandle(), list, &fetched);
+    std::unordered_map<std::string, std::filesystem::path> downloaded;
+    for (Downloader::Result &result : downloader.Run()) {
+        if (result.Error) {
+            throw std::runtime_error(std::format("Failed to download {}: {}", result.Filename, *result.Error));
+        }
 
-    std::vector<std::filesystem::path> paths;
-    for (size_t i = 0; i < alpm_list_count(fetched); i++) {
-        paths.push_back(static_cast<char*>(alpm_list_nth(fetched, 0)->data));
+        downloaded.emplace(std::move(result.Filename), std::move(result.Path));
     }
 
-    FREELIST(list);
-    FREELIST(fetched);
+    for (std::size_t i = 0; i < packages.size(); ++i) {
+        if (paths[i].empty()) {
+            paths[i] = downloaded.at(packages[i].GetFilename());
+        }
+    }
 
     return paths;
 }
 
 auto Package::Download() const -> std::filesystem::path {
-    alpm_list_t *list = new alpm_list_t;
-    list->prev = list;
-    list->next = nullptr;
-    std::string url = GetURL();
-    list->data = new char[url.size()];
-    std::strcpy(static_cast<char*>(list->data), url.data());
-
-    alpm_list_t *fetched = nullptr;
-    alpm_fetch_pkgurl(ALPM::GetHandle(), list, &fetched);
-
-    std::filesystem::path path = static_cast<char*>(fetched->data);
-
-    FREELIST(list);
-    FREELIST(fetched);
-
-    return path;
+    return Download({Package(m_alpmPkg)}).front();
 }
 
 auto Package::CheckMD5Sum() const -> std::optional<std::string> {
     if (alpm_pkg_checkmd5sum(m_alpmPkg) != 0) {
-        return ALPM::GetError();
+        return GetOwner().GetError();
     }
 
     return {};
@@ -110,7 +160,8 @@ auto Package::GetMD5Sum() const -> std::string {
 }
 
 auto Package::GetSHA256Sum() const -> std::string {
-    return alpm_pkg_get_sha256sum(m_alpmPkg);
+    // Local packages don't have one.
+    return std::string(Utils::ToStringView(alpm_pkg_get_sha256sum(m_alpmPkg)));
 }
 
 auto Package::GetSignature() const -> std::vector<unsigned char> {
@@ -129,10 +180,7 @@ auto Package::GetSignature() const -> std::vector<unsigned char> {
 auto Package::ComputeOptionalFor() const -> std::vector<std::string> {
     alpm_list_t *optionalFor = alpm_pkg_compute_optionalfor(m_alpmPkg);
 
-    std::vector<std::string> packages;
-    for (size_t i = 0; i < alpm_list_count(optionalFor); i++) {
-        packages.emplace_back(static_cast<char*>(alpm_list_nth(optionalFor, i)->data));
-    }
+    std::vector<std::string> packages = Utils::ALPMListToVector<std::string>(optionalFor);
 
     FREELIST(optionalFor);
 
@@ -142,10 +190,7 @@ auto Package::ComputeOptionalFor() const -> std::vector<std::string> {
 auto Package::ComputeRequiredBy() const -> std::vector<std::string> {
     alpm_list_t *requiredBy = alpm_pkg_compute_requiredby(m_alpmPkg);
 
-    std::vector<std::string> packages;
-    for (size_t i = 0; alpm_list_count(requiredBy); i++) {
-        packages.emplace_back(static_cast<char*>(alpm_list_nth(requiredBy, i)->data));
-    }
+    std::vector<std::string> packages = Utils::ALPMListToVector<std::string>(requiredBy);
 
     FREELIST(requiredBy);
 
@@ -178,44 +223,35 @@ auto Package::GetBuildDate() const -> std::chrono::system_clock::time_point {
 }
 
 auto Package::GetCheckDepends() const -> std::vector<Dependency> {
-    std::vector<Dependency> depends;
-
-    alpm_list_t *checkDepends = alpm_pkg_get_checkdepends(m_alpmPkg);
-    for (size_t i = 0; i < alpm_list_count(checkDepends); i++) {
-        depends.emplace_back(static_cast<alpm_depend_t*>(alpm_list_nth(checkDepends, i)->data));
-    }
+    return Utils::ALPMListToVector<Dependency>(alpm_pkg_get_checkdepends(m_alpmPkg));
+}
 
-    return depends;
+auto Package::GetCheckDependsView() const -> Utils::ALPMListView<Dependency> {
+    return Utils::ALPMListView<Dependency>(alpm_pkg_get_checkdepends(m_alpmPkg));
 }
 
 auto Package::GetMakeDepends() const -> std::vector<Dependency> {
-    std::vector<Dependency> depends;
-    alpm_list_t *list = alpm_pkg_get_makedepends(m_alpmPkg);
-    for (size_t i = 0; i < alpm_list_count(list); i++) {
-        depends.emplace_back(static_cast<alpm_depend_t*>(alpm_list_nth(list, i)->data));
-    }
-    return depends;
+    return Utils::ALPMListToVector<Dependency>(alpm_pkg_get_makedepends(m_alpmPkg));
+}
+
+auto Package::GetMakeDependsView() const -> Utils::ALPMListView<Dependency> {
+    return Utils::ALPMListView<Dependency>(alpm_pkg_get_makedepends(m_alpmPkg));
 }
 
 auto Package::GetOptionalDepends() const -> std::vector<Dependency> {
-    std::vector<Dependency> depends;
-    alpm_list_t *list = alpm_pkg_get_optdepends(m_alpmPkg);
-    for (size_t i = 0; i < alpm_list_count(list); i++) {
-        depends.emplace_back(static_cast<alpm_depend_t*>(alpm_list_nth(list, i)->data));
-    }
+    return Utils::ALPMListToVector<Dependency>(alpm_pkg_get_optdepends(m_alpmPkg));
+}
 
-    return depends;
+auto Package::GetOptionalDependsView() const -> Utils::ALPMListView<Dependency> {
+    return Utils::ALPMListView<Dependency>(alpm_pkg_get_optdepends(m_alpmPkg));
 }
 
 auto Package::GetConflicts() const -> std::vector<Dependency> {
-    std::vector<Dependency> conflicts;
-
-    alpm_list_t *confs = alpm_pkg_get_conflicts(m_alpmPkg);
-    for (size_t i = 0; i < alpm_list_count(confs); i++) {
-        conflicts.emplace_back(static_cast<alpm_depend_t*>(alpm_list_nth(confs, i)->data));
-    }
+    return Utils::ALPMListToVector<Dependency>(alpm_pkg_get_conflicts(m_alpmPkg));
+}
 
-    return conflicts;
+auto Package::GetConflictsView() const -> Utils::ALPMListView<Dependency> {
+    return Utils::ALPMListView<Dependency>(alpm_pkg_get_conflicts(m_alpmPkg));
 }
 
 auto Package::GetDatabase() const -> std::optional<Database> {
@@ -228,14 +264,11 @@ auto Package::GetDatabase() const -> std::optional<Database> {
 }
 
 auto Package::GetDepends() const -> std::vector<Dependency> {
-    std::vector<Dependency> depends;
-
-    alpm_list_t *list = alpm_pkg_get_depends(m_alpmPkg);
-    for (size_t i = 0; i < alpm_list_count(list); i++) {
-        depends.emplace_back(static_cast<alpm_depend_t*>(alpm_list_nth(list, i)->data));
-    }
+    return Utils::ALPMListToVector<Dependency>(alpm_pkg_get_depends(m_alpmPkg));
+}
 
-    return depends;
+auto Package::GetDependsView() const -> Utils::ALPMListView<Dependency> {
+    return Utils::ALPMListView<Dependency>(alpm_pkg_get_depends(m_alpmPkg));
 }
 
 auto Package::GetDescription() const -> std::string {
@@ -249,21 +282,24 @@ auto Package::GetFilename() const -> std::string {
 auto Package::GetFiles() const -> std::vector<File> {
     std::vector<File> files;
     alpm_filelist_t *fileList = alpm_pkg_get_files(m_alpmPkg);
+    if (!fileList) {
+        return files;
+    }
+
+    files.reserve(fileList->count);
     for (size_t i = 0; i < fileList->count; i++) {
-        File file(&fileList->files[i]);
+        files.emplace_back(&fileList->files[i]);
     }
 
     return files;
 }
 
 auto Package::GetGroups() const -> std::vector<std::string> {
-    std::vector<std::string> groups;
-    alpm_list_t *list = alpm_pkg_get_groups(m_alpmPkg);
-    for (size_t i = 0; i < alpm_list_count(list); i++) {
-        groups.push_back(static_cast<char*>(alpm_list_nth(list, i)->data));
-    }
+    return Utils::ALPMListToVector<std::string>(alpm_pkg_get_groups(m_alpmPkg));
+}
 
-    return groups;
+auto Package::GetGroupsView() const -> Utils::ALPMListView<std::string_view> {
+    return Utils::ALPMListView<std::string_view>(alpm_pkg_get_groups(m_alpmPkg));
 }
 
 auto Package::GetInstallDate() const -> std::chrono::system_clock::time_point {
@@ -277,13 +313,11 @@ auto Package::GetInstallSize() const -> off_t {
 }
 
 auto Package::GetLicenses() const -> std::vector<std::string> {
-    std::vector<std::string> licenses;
-    alpm_list_t *list = alpm_pkg_get_licenses(m_alpmPkg);
-    for (size_t i = 0; i < alpm_list_count(list); i++) {
-        licenses.emplace_back(static_cast<char*>(alpm_list_nth(list, i)->data));
-    }
+    return Utils::ALPMListToVector<std::string>(alpm_pkg_get_licenses(m_alpmPkg));
+}
 
-    return licenses;
+auto Package::GetLicensesView() const -> Utils::ALPMListView<std::string_view> {
+    return Utils::ALPMListView<std::string_view>(alpm_pkg_get_licenses(m_alpmPkg));
 }
 
 auto Package::GetName() const -> std::string {
@@ -308,12 +342,11 @@ auto Package::GetPackager() const -> std::string {
 }
 
 auto Package::GetProvides() const -> std::vector<Dependency> {
-    std::vector<Dependency> provides;
-    alpm_list_t *list = alpm_pkg_get_provides(m_alpmPkg);
-    for (size_t i = 0; i < alpm_list_count(list); i++) {
-        provides.emplace_back(static_cast<alpm_depend_t*>(alpm_list_nth(list, i)->data));
-    }
-    return provides;
+    return Utils::ALPMListToVector<Dependency>(alpm_pkg_get_provides(m_alpmPkg));
+}
+
+auto Package::GetProvidesView() const -> Utils::ALPMListView<Dependency> {
+    return Utils::ALPMListView<Dependency>(alpm_pkg_get_provides(m_alpmPkg));
 }
 
 auto Package::GetReason() const -> Reason {
@@ -330,13 +363,11 @@ auto Package::GetReason() const -> Reason {
 }
 
 auto Package::GetReplaces() const -> std::vector<Dependency> {
-    std::vector<Dependency> replaces;
-    alpm_list_t *list = alpm_pkg_get_replaces(m_alpmPkg);
-    for (size_t i = 0; i < alpm_list_count(list); i++) {
-        replaces.emplace_back(static_cast<alpm_depend_t*>(alpm_list_nth(list, i)->data));
-    }
+    return Utils::ALPMListToVector<Dependency>(alpm_pkg_get_replaces(m_alpmPkg));
+}
 
-    return replaces;
+auto Package::GetReplacesView() const -> Utils::ALPMListView<Dependency> {
+    return Utils::ALPMListView<Dependency>(alpm_pkg_get_replaces(m_alpmPkg));
 }
 
 auto Package::GetURL() const -> std::string {
@@ -360,6 +391,10 @@ auto Package::GetValidation() const -> Validation {
     }
 }
 
+auto Package::GetVersionKey() const -> VersionKey {
+    return VersionKey(alpm_pkg_get_version(m_alpmPkg));
+}
+
 auto Package::GetVersion() const -> std::string {
     return alpm_pkg_get_version(m_alpmPkg);
 }
@@ -385,22 +420,159 @@ auto Package::SetReason(Reason reason) -> void {
     }
 
     if (ret != 0) {
-        throw std::runtime_error(std::format("Failed to set package install reason: {}", ALPM::GetError()));
+        throw std::runtime_error(std::format("Failed to set package install reason: {}", GetOwner().GetError()));
     }
 }
 
 auto Package::ShouldIgnore() const -> bool {
-    return alpm_pkg_should_ignore(ALPM::GetHandle(), m_alpmPkg) == 1 ? false : true;
+    return alpm_pkg_should_ignore(alpm_pkg_get_handle(m_alpmPkg), m_alpmPkg) == 1 ? false : true;
 }
 
 auto Package::GetHandle() const -> alpm_pkg_t* {
     return m_alpmPkg;
 }
 
+auto Package::GetOwner() const -> Handle& {
+    Handle *owner = Handle::Find(alpm_pkg_get_handle(m_alpmPkg));
+    return owner ? *owner : ALPM::GetCurrentHandle();
+}
+
+auto Package::GetView() const -> PackageView {
+    return PackageView(m_alpmPkg);
+}
+
 auto Package::MarkInstall() const -> void {
-    ALPM::GetCurrentTransaction()->AddPackageOperation(*this, Transaction::PackageOperation::Install);
+    GetOwner().GetCurrentTransaction()->AddPackageOperation(*this, Transaction::PackageOperation::Install);
 }
 
 auto Package::MarkUninstall() const -> void {
-    ALPM::GetCurrentTransaction()->AddPackageOperation(*this, Transaction::PackageOperation::Uninstall);
+    GetOwner().GetCurrentTransaction()->AddPackageOperation(*this, Transaction::PackageOperation::Uninstall);
+}
+
+PackageView::PackageView(alpm_pkg_t *pkg) :
+    m_alpmPkg(pkg) {}
+
+auto PackageView::GetArch() const -> std::string_view {
+    return Utils::ToStringView(alpm_pkg_get_arch(m_alpmPkg));
+}
+
+auto PackageView::GetBaseName() const -> std::string_view {
+    return Utils::ToStringView(alpm_pkg_get_base(m_alpmPkg));
+}
+
+auto PackageView::GetBase64Signature() const -> std::string_view {
+    return Utils::ToStringView(alpm_pkg_get_base64_sig(m_alpmPkg));
+}
+
+auto PackageView::GetDescription() const -> std::string_view {
+    return Utils::ToStringView(alpm_pkg_get_desc(m_alpmPkg));
+}
+
+auto PackageView::GetFilename() const -> std::string_view {
+    return Utils::ToStringView(alpm_pkg_get_filename(m_alpmPkg));
+}
+
+auto PackageView::GetMD5Sum() const -> std::string_view {
+    return Utils::ToStringView(alpm_pkg_get_md5sum(m_alpmPkg));
+}
+
+auto PackageView::GetName() const -> std::string_view {
+    return Utils::ToStringView(alpm_pkg_get_name(m_alpmPkg));
+}
+
+auto PackageView::GetPackager() const -> std::string_view {
+    return Utils::ToStringView(alpm_pkg_get_packager(m_alpmPkg));
+}
+
+auto PackageView::GetSHA256Sum() const -> std::string_view {
+    return Utils::ToStringView(alpm_pkg_get_sha256sum(m_alpmPkg));
+}
+
+auto PackageView::GetURL() const -> std::string_view {
+    return Utils::ToStringView(alpm_pkg_get_url(m_alpmPkg));
+}
+
+auto PackageView::GetVersion() const -> std::string_view {
+    return Utils::ToStringView(alpm_pkg_get_version(m_alpmPkg));
+}
+
+auto PackageView::GetBuildDate() const -> std::chrono::system_clock::time_point {
+    return std::chrono::system_clock::time_point(std::chrono::seconds(alpm_pkg_get_builddate(m_alpmPkg)));
+}
+
+auto PackageView::GetInstallDate() const -> std::chrono::system_clock::time_point {
+    return std::chrono::system_clock::time_point(std::chrono::seconds(alpm_pkg_get_installdate(m_alpmPkg)));
+}
+
+auto PackageView::GetDownloadSize() const -> off_t {
+    return alpm_pkg_download_size(m_alpmPkg);
+}
+
+auto PackageView::GetInstallSize() const -> off_t {
+    return alpm_pkg_get_isize(m_alpmPkg);
+}
+
+auto PackageView::GetSize() const -> off_t {
+    return alpm_pkg_get_size(m_alpmPkg);
+}
+
+auto PackageView::GetCheckDepends() const -> Utils::ALPMListView<DependencyView> {
+    return Utils::ALPMListView<DependencyView>(alpm_pkg_get_checkdepends(m_alpmPkg));
+}
+
+auto PackageView::GetConflicts() const -> Utils::ALPMListView<DependencyView> {
+    return Utils::ALPMListView<DependencyView>(alpm_pkg_get_conflicts(m_alpmPkg));
+}
+
+auto PackageView::GetDepends() const -> Utils::ALPMListView<DependencyView> {
+    return Utils::ALPMListView<DependencyView>(alpm_pkg_get_depends(m_alpmPkg));
+}
+
+auto PackageView::GetMakeDepends() const -> Utils::ALPMListView<DependencyView> {
+    return Utils::ALPMListView<DependencyView>(alpm_pkg_get_makedepends(m_alpmPkg));
+}
+
+auto PackageView::GetOptionalDepends() const -> Utils::ALPMListView<DependencyView> {
+    return Utils::ALPMListView<DependencyView>(alpm_pkg_get_optdepends(m_alpmPkg));
+}
+
+auto PackageView::GetProvides() const -> Utils::ALPMListView<DependencyView> {
+    return Utils::ALPMListView<DependencyView>(alpm_pkg_get_provides(m_alpmPkg));
+}
+
+auto PackageView::GetReplaces() const -> Utils::ALPMListView<DependencyView> {
+    return Utils::ALPMListView<DependencyView>(alpm_pkg_get_replaces(m_alpmPkg));
+}
+
+auto PackageView::GetGroups() const -> Utils::ALPMListView<std::string_view> {
+    return Utils::ALPMListView<std::string_view>(alpm_pkg_get_groups(m_alpmPkg));
+}
+
+auto PackageView::GetLicenses() const -> Utils::ALPMListView<std::string_view> {
+    return Utils::ALPMListView<std::string_view>(alpm_pkg_get_licenses(m_alpmPkg));
+}
+
+auto PackageView::GetFiles() const -> Utils::ALPMArrayView<FileView, alpm_file_t> {
+    alpm_filelist_t *fileList = alpm_pkg_get_files(m_alpmPkg);
+    if (!fileList) {
+        return {};
+    }
+
+    return Utils::ALPMArrayView<FileView, alpm_file_t>(std::span<alpm_file_t>(fileList->files, fileList->count));
+}
+
+auto PackageView::GetOrigin() const -> Package::From {
+    return Package(m_alpmPkg).GetOrigin();
+}
+
+auto PackageView::GetReason() const -> Package::Reason {
+    return Package(m_alpmPkg).GetReason();
+}
+
+auto PackageView::GetHandle() const -> alpm_pkg_t* {
+    return m_alpmPkg;
+}
+
+auto PackageView::ToPackage() const -> Package {
+    return Package(m_alpmPkg);
 }
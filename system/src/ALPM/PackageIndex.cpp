@@ -0,0 +1,150 @@
+#include "PackageIndex.hpp"
+#include "ALPM.hpp"
+#include "Database.hpp"
+#include "Events.hpp"
+
+#include "Event.hpp"
+
+#include <alpm.h>
+
+#include <algorithm>
+#include <bit>
+
+using namespace ALPM;
+
+namespace {
+    struct Key {
+        unsigned long Hash;
+        std::string_view Name;
+        alpm_pkg_t *Package;
+    };
+}  // namespace
+
+PackageIndex::PackageIndex(const std::vector<Database> &databases, uint64_t generation) :
+    m_generation(generation)
+{
+    std::vector<Key> keys;
+    for (const Database &database : databases) {
+        for (const alpm_list_t *i = alpm_db_get_pkgcache(database.GetHandle()); i != nullptr; i = i->next) {
+            alpm_pkg_t *pkg = static_cast<alpm_pkg_t*>(i->data);
+            std::string_view name = alpm_pkg_get_name(pkg);
+            keys.push_back(Key{.Hash = Hash(name), .Name = name, .Package = pkg});
+
+            for (const alpm_list_t *j = alpm_pkg_get_provides(pkg); j != nullptr; j = j->next) {
+                const alpm_depend_t *provide = static_cast<const alpm_depend_t*>(j->data);
+                keys.push_back(Key{.Hash = provide->name_hash, .Name = provide->name, .Package = pkg});
+            }
+        }
+    }
+
+    // Keep the load factor at or below one half so probe sequences stay short.
+    m_slots.resize(std::bit_ceil(std::max<std::size_t>(keys.size() * 2, 16)));
+
+    // First pass counts the candidates per key, the second lays them out
+    // contiguously so every lookup returns a single span.
+    std::vector<std::size_t> keySlots;
+    keySlots.reserve(keys.size());
+    for (const Key &key : keys) {
+        std::size_t slot = FindSlot(key.Hash, key.Name);
+        if (m_slots[slot].Name.data() == nullptr) {
+            m_slots[slot].Hash = key.Hash;
+            m_slots[slot].Name = key.Name;
+        }
+
+        m_slots[slot].Count++;
+        keySlots.push_back(slot);
+    }
+
+    uint32_t first = 0;
+    for (Slot &slot : m_slots) {
+        slot.First = first;
+        first += slot.Count;
+        slot.Count = 0;
+    }
+
+    m_candidates.resize(keys.size(), PackageView(nullptr));
+    for (std::size_t i = 0; i < keys.size(); i++) {
+        Slot &slot = m_slots[keySlots[i]];
+        m_candidates[slot.First + slot.Count] = PackageView(keys[i].Package);
+        slot.Count++;
+    }
+}
+
+auto PackageIndex::Get() -> std::shared_ptr<const PackageIndex> {
+    Handle &handle = ALPM::GetCurrentHandle();
+    std::lock_guard lock(s_mutex);
+
+    uint64_t generation = handle.GetDatabaseGeneration();
+    std::shared_ptr<const PackageIndex> &instance = s_instances[handle.GetId()];
+    if (!instance || instance->GetGeneration() != generation) {
+        instance = std::make_shared<const PackageIndex>(handle.GetSyncDatabases(), generation);
+
+        // The index points into the handle's databases.
+        static std::once_flag registered;
+        std::call_once(registered, []() -> void {
+            Event::Event::RegisterCallback<HandleReleasedEvent>([](const HandleReleasedEvent &event) -> void {
+                std::lock_guard lock(s_mutex);
+                s_instances.erase(event.Handle);
+            });
+        });
+    }
+
+    return instance;
+}
+
+auto PackageIndex::Hash(std::string_view name) -> unsigned long {
+    // sdbm, matching libalpm's _alpm_hash_sdbm() bit for bit.
+    unsigned long hash = 0;
+    for (char c : name) {
+        hash = static_cast<unsigned long>(c) + (hash << 6) + (hash << 16) - hash;
+    }
+
+    return hash;
+}
+
+auto PackageIndex::Find(std::string_view name) const -> std::span<const PackageView> {
+    const Slot &slot = m_slots[FindSlot(Hash(name), name)];
+    if (slot.Name.data() == nullptr) {
+        return {};
+    }
+
+    return std::span<const PackageView>(m_candidates).subspan(slot.First, slot.Count);
+}
+
+auto PackageIndex::Resolve(std::string_view name) const -> std::optional<Package> {
+    std::span<const PackageView> candidates = Find(name);
+    if (candidates.empty()) {
+        return {};
+    }
+
+    for (const PackageView &candidate : candidates) {
+        if (candidate.GetName() == name) {
+            return candidate.ToPackage();
+        }
+    }
+
+    return candidates.front().ToPackage();
+}
+
+auto PackageIndex::Resolve(const std::vector<std::string> &names) const -> std::vector<std::optional<Package>> {
+    std::vector<std::optional<Package>> packages;
+    packages.reserve(names.size());
+    for (const std::string &name : names) {
+        packages.push_back(Resolve(name));
+    }
+
+    return packages;
+}
+
+auto PackageIndex::GetGeneration() const -> uint64_t {
+    return m_generation;
+}
+
+auto PackageIndex::FindSlot(unsigned long hash, std::string_view name) const -> std::size_t {
+    std::size_t mask = m_slots.size() - 1;
+    for (std::size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        if (m_slots[slot].Name.data() == nullptr || (m_slots[slot].Hash == hash && m_slots[slot].Name == name)) {
+            return slot;
+        }
+    }
+}
@@ -0,0 +1,450 @@
+#include "Pipeline.hpp"
+#include "ALPM.hpp"
+#include "Downloader.hpp"
+#include "Metrics.hpp"
+#include "Signature.hpp"
+#include "Utils.hpp"
+
+#include "Status.hpp"
+#include "Task.hpp"
+#include "ThreadPool.hpp"
+
+#include <alpm.h>
+#include <archive.h>
+#include <archive_entry.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <future>
+#include <semaphore>
+#include <set>
+#include <thread>
+#include <unordered_map>
+
+using namespace ALPM;
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    constexpr std::size_t BLOCK_SIZE = 10240;
+
+    auto GetSignatureLevel(alpm_pkg_t *pkg) -> int {
+        int level = ALPM_SIG_USE_DEFAULT;
+        if (alpm_db_t *db = alpm_pkg_get_db(pkg)) {
+            level = alpm_db_get_siglevel(db);
+        }
+
+        if (level & ALPM_SIG_USE_DEFAULT) {
+            level = alpm_option_get_default_siglevel(ALPM::ALPM::GetHandle());
+        }
+
+        return level;
+    }
+}  // namespace
+
+Pipeline::Pipeline(std::size_t verifyLimit) :
+    m_verifyLimit(verifyLimit)
+{
+    if (m_verifyLimit == 0) {
+        m_verifyLimit = std::max<std::size_t>(ThreadPool::GetShared().GetThreadCount(), 1);
+    }
+}
+
+auto Pipeline::SetCheckpoint(std::shared_ptr<Checkpoint> checkpoint) -> void {
+    m_checkpoint = std::move(checkpoint);
+}
+
+auto Pipeline::SetContentCache(std::shared_ptr<ContentCache> cache) -> void {
+    m_contentCache = std::move(cache);
+}
+
+auto Pipeline::SetStopToken(std::stop_token stop) -> void {
+    m_stopToken = std::move(stop);
+}
+
+auto Pipeline::Run(const std::vector<Package> &packages) -> std::vector<Failure> {
+    {
+        std::lock_guard lock(m_mutex);
+        m_timings = {};
+    }
+
+    // The packages belong to the handle of the thread that runs the pipeline,
+    // and neither the pool threads nor the fetching thread have one bound.
+    m_handle = &ALPM::GetCurrentHandle();
+
+    Clock::time_point begin = Clock::now();
+    std::filesystem::path cacheDirectory = Downloader::GetCacheDirectory();
+
+    Downloader downloader;
+    downloader.SetStopToken(m_stopToken);
+    std::unordered_map<std::string, const Package*> downloads;
+    std::vector<const Package*> cached;
+    std::set<const Package*> linked;
+    for (const Package &package : packages) {
+        if (alpm_pkg_get_origin(package.GetHandle()) != ALPM_PKG_FROM_SYNCDB) {
+            continue;
+        }
+
+        // libalpm reports a download size of 0 for packages already in the cache.
+        if (package.GetDownloadSize() == 0) {
+            cached.push_back(&package);
+        } else if (m_contentCache && m_contentCache->Materialize(package, cacheDirectory)) {
+            cached.push_back(&package);
+            linked.insert(&package);
+        } else {
+            downloader.Add(package);
+            downloads.emplace(package.GetFilename(), &package);
+        }
+    }
+
+    std::size_t total = downloads.size() + cached.size();
+    if (total == 0) {
+        return {};
+    }
+
+    {
+        std::lock_guard lock(Downloader::GetTaskMutex());
+        for (Stage stage : {Stage::Fetch, Stage::Verify, Stage::Decompress}) {
+            if (stage != Stage::Fetch || !downloads.empty()) {
+                Status::Status::GetOrCreate()->AddTask(Task::GetOrCreate(GetTaskName(stage)));
+            }
+        }
+    }
+
+    std::mutex mutex;
+    std::vector<Failure> failures;
+    std::vector<std::future<void>> pending;
+
+    // Bounds how far downloads can run ahead of verification.
+    std::counting_semaphore<> slots(static_cast<std::ptrdiff_t>(m_verifyLimit));
+
+    auto process = [&](const Package &package, const std::filesystem::path &path) -> void {
+        slots.acquire();
+
+        if (m_stopToken.stop_requested()) {
+            slots.release();
+
+            std::lock_guard lock(mutex);
+            failures.push_back(Failure{.Filename = package.GetFilename(), .Error = "Cancelled"});
+            return;
+        }
+
+        std::future<void> result = ThreadPool::GetShared().Submit([&, path]() -> void {
+            Handle::Scope scope(*m_handle);
+            std::optional<std::string> error;
+
+            Clock::time_point start = Clock::now();
+            bool trusted = (m_checkpoint && m_checkpoint->IsVerified(path)) || (m_contentCache && linked.contains(&package) && m_contentCache->IsVerified(package.GetSHA256Sum()));
+            if (!trusted) {
+                try {
+                    error = Verify(package, path);
+                } catch (const std::exception &exception) {
+                    error = exception.what();
+                }
+
+                if (!error && m_checkpoint) {
+                    m_checkpoint->MarkVerified(path);
+                }
+            }
+
+            if (!error && m_contentCache) {
+                m_contentCache->Import(package, path, true);
+            }
+            Clock::time_point verified = Clock::now();
+
+            Record(Stage::Verify, start, verified, total);
+            slots.release();
+
+            if (!error) {
+                std::vector<std::string> files;
+                error = Decompress(path, files);
+                Record(Stage::Decompress, verified, Clock::now(), total);
+
+                std::lock_guard lock(m_mutex);
+                m_files[package.GetName()] = std::move(files);
+            }
+
+            if (error) {
+                std::lock_guard lock(mutex);
+                failures.push_back(Failure{.Filename = package.GetFilename(), .Error = *error});
+            }
+        });
+
+        std::lock_guard lock(mutex);
+        pending.push_back(std::move(result));
+    };
+
+    downloader.SetCompletionCallback([&](const Downloader::Result &result) -> void {
+        Record(Stage::Fetch, begin, Clock::now(), downloads.size());
+
+        if (result.Error) {
+            std::lock_guard lock(mutex);
+            failures.push_back(Failure{.Filename = result.Filename, .Error = *result.Error});
+            return;
+        }
+
+        process(*downloads.at(result.Filename), result.Path);
+    });
+
+    // Packages that are already in the cache start verifying while the rest
+    // download.
+    std::jthread fetching;
+    if (!downloads.empty()) {
+        fetching = std::jthread([this, &downloader]() -> void {
+            Handle::Scope scope(*m_handle);
+            downloader.Run();
+        });
+    }
+
+    for (const Package *package : cached) {
+        process(*package, cacheDirectory / package->GetFilename());
+    }
+
+    if (fetching.joinable()) {
+        fetching.join();
+    }
+
+    // Nothing is submitted anymore once the downloads are done.
+    for (std::future<void> &result : pending) {
+        result.get();
+    }
+
+    {
+        std::lock_guard lock(m_mutex);
+        m_elapsed = Clock::now() - begin;
+
+        // Downloads run side by side, so only the span of the stage means anything.
+        StageTiming &fetch = m_timings[std::to_underlying(Stage::Fetch)];
+        fetch.Busy = fetch.End - fetch.Start;
+    }
+
+    std::lock_guard lock(Downloader::GetTaskMutex());
+    for (Stage stage : {Stage::Fetch, Stage::Verify, Stage::Decompress}) {
+        if (stage == Stage::Fetch && downloads.empty()) {
+            continue;
+        }
+
+        StageTiming timing = GetTiming(stage);
+        double seconds = std::chrono::duration<double>(timing.End - timing.Start).count();
+        Task::GetOrCreate(GetTaskName(stage))->SetDescription(std::format("({:.1f}s)", seconds))->Finish();
+    }
+
+    return failures;
+}
+
+auto Pipeline::GetTiming(Stage stage) const -> StageTiming {
+    std::lock_guard lock(m_mutex);
+    return m_timings[std::to_underlying(stage)];
+}
+
+auto Pipeline::GetElapsed() const -> std::chrono::steady_clock::duration {
+    std::lock_guard lock(m_mutex);
+    return m_elapsed;
+}
+
+auto Pipeline::GetOverlap() const -> std::chrono::steady_clock::duration {
+    std::lock_guard lock(m_mutex);
+
+    std::vector<std::pair<Clock::time_point, Clock::time_point>> spans;
+    Clock::duration combined{};
+    for (const StageTiming &timing : m_timings) {
+        if (timing.Count != 0) {
+            spans.emplace_back(timing.Start, timing.End);
+            combined += timing.End - timing.Start;
+        }
+    }
+
+    // Whatever the union of the spans doesn't cover was counted twice.
+    std::ranges::sort(spans);
+    Clock::duration covered{};
+    std::optional<std::pair<Clock::time_point, Clock::time_point>> current;
+    for (const auto &span : spans) {
+        if (current && span.first <= current->second) {
+            current->second = std::max(current->second, span.second);
+            continue;
+        }
+
+        if (current) {
+            covered += current->second - current->first;
+        }
+        current = span;
+    }
+
+    if (current) {
+        covered += current->second - current->first;
+    }
+
+    return combined - covered;
+}
+
+auto Pipeline::GetFiles() const -> std::map<std::string, std::vector<std::string>> {
+    std::lock_guard lock(m_mutex);
+    return m_files;
+}
+
+auto Pipeline::GetTaskName(Stage stage) -> std::string {
+    switch (stage) {
+        case Stage::Fetch:
+            return "Downloading packages";
+        case Stage::Verify:
+            return "Verifying packages";
+        case Stage::Decompress:
+            return "Decompressing packages";
+    }
+
+    return {};
+}
+
+auto Pipeline::Verify(const Package &package, const std::filesystem::path &path) -> std::optional<std::string> {
+    alpm_pkg_t *pkg = package.GetHandle();
+
+    if (const char *expected = alpm_pkg_get_sha256sum(pkg)) {
+        char *actual = alpm_compute_sha256sum(path.c_str());
+        bool matches = actual != nullptr && std::string_view(actual) == expected;
+        std::free(actual);
+
+        if (!matches) {
+            return "Checksum doesn't match the database";
+        }
+    }
+
+    int level = GetSignatureLevel(pkg);
+    if (!(level & ALPM_SIG_PACKAGE)) {
+        return {};
+    }
+
+    if (!FetchSignature(package, path)) {
+        if (level & ALPM_SIG_PACKAGE_OPTIONAL) {
+            return {};
+        }
+
+        return "Missing required signature";
+    }
+
+    Signature::Result result = Signature::CheckSignature(path);
+    if (!result) {
+        return result.error().first;
+    }
+
+    // Same rules libalpm applies during the commit.
+    for (const PGPKey &key : *result) {
+        if (key.GetStatus() != PGPKey::Status::Valid) {
+            return std::format("Invalid signature from {}", key.GetUID());
+        }
+
+        switch (key.GetValidity()) {
+            case PGPKey::Validity::Trusted:
+                break;
+            case PGPKey::Validity::Marginal:
+                if (!(level & ALPM_SIG_PACKAGE_MARGINAL_OK)) {
+                    return std::format("Signature from {} is marginal trust", key.GetUID());
+                }
+                break;
+            case PGPKey::Validity::Unknown:
+                if (!(level & ALPM_SIG_PACKAGE_UNKNOWN_OK)) {
+                    return std::format("Signature from {} is unknown trust", key.GetUID());
+                }
+                break;
+            case PGPKey::Validity::Untrusted:
+                return std::format("Signature from {} is never trusted", key.GetUID());
+        }
+    }
+
+    return {};
+}
+
+auto Pipeline::Decompress(const std::filesystem::path &path, std::vector<std::string> &files) -> std::optional<std::string> {
+    archive *reader = archive_read_new();
+    archive_read_support_filter_all(reader);
+    archive_read_support_format_all(reader);
+
+    int result = archive_read_open_filename(reader, path.c_str(), BLOCK_SIZE);
+
+    // Skipping the data of a compressed entry still has to decompress it.
+    archive_entry *entry = nullptr;
+    while (result == ARCHIVE_OK && (result = archive_read_next_header(reader, &entry)) == ARCHIVE_OK) {
+        // Metadata like .PKGINFO and .MTREE is never installed.
+        const char *name = archive_entry_pathname(entry);
+        if (name != nullptr && name[0] != '.' && archive_entry_filetype(entry) != AE_IFDIR) {
+            files.emplace_back(name);
+        }
+
+        result = archive_read_data_skip(reader);
+    }
+
+    std::optional<std::string> error;
+    if (result != ARCHIVE_EOF) {
+        const char *message = archive_error_string(reader);
+        error = message != nullptr ? message : "Archive is truncated";
+    }
+
+    archive_read_free(reader);
+
+    return error;
+}
+
+auto Pipeline::FetchSignature(const Package &package, const std::filesystem::path &path) -> bool {
+    std::filesystem::path signature = path;
+    signature += ".sig";
+
+    std::error_code error;
+    if (std::filesystem::exists(signature, error)) {
+        return true;
+    }
+
+    if (const char *base64 = alpm_pkg_get_base64_sig(package.GetHandle())) {
+        unsigned char *data = nullptr;
+        std::size_t length = 0;
+        if (alpm_decode_signature(base64, &data, &length) == 0) {
+            std::ofstream file(signature, std::ios::binary);
+            file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(length));
+            file.close();
+            std::free(data);
+
+            return !file.fail();
+        }
+    }
+
+    Downloader::Job job{.Filename = std::format("{}.sig", package.GetFilename()), .Directory = path.parent_path(), .ShowProgress = false};
+    if (alpm_db_t *db = alpm_pkg_get_db(package.GetHandle())) {
+        for (std::string_view server : Utils::ALPMListView<std::string_view>(alpm_db_get_servers(db))) {
+            job.Servers.emplace_back(server);
+        }
+    }
+
+    Downloader downloader(1);
+    downloader.Add(std::move(job));
+
+    return !downloader.Run().front().Error;
+}
+
+auto Pipeline::Record(Stage stage, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end, std::size_t total) -> void {
+    std::size_t count = 0;
+    {
+        std::lock_guard lock(m_mutex);
+        StageTiming &timing = m_timings[std::to_underlying(stage)];
+        if (timing.Count == 0 || start < timing.Start) {
+            timing.Start = start;
+        }
+        timing.End = std::max(timing.End, end);
+        timing.Busy += end - start;
+        count = ++timing.Count;
+    }
+
+    switch (stage) {
+        case Stage::Fetch:
+            Metrics::Record(Metrics::Phase::Download, start, end);
+            break;
+        case Stage::Verify:
+            Metrics::Record(Metrics::Phase::Verify, start, end);
+            break;
+        case Stage::Decompress:
+            Metrics::Record(Metrics::Phase::Decompress, start, end);
+            break;
+    }
+
+    std::lock_guard lock(Downloader::GetTaskMutex());
+    Task::GetOrCreate(GetTaskName(stage))->SetProgress(static_cast<float>(count) / static_cast<float>(total) * 100.0f);
+}
@@ -0,0 +1,256 @@
+#include "SearchEngine.hpp"
+#include "ALPM.hpp"
+#include "ThreadPool.hpp"
+
+#include <alpm.h>
+
+#include <algorithm>
+#include <cctype>
+#include <future>
+#include <type_traits>
+#include <unordered_set>
+
+using namespace ALPM;
+
+namespace {
+    // Packages are matched in chunks so one large repository (extra) doesn't
+    // end up on a single worker while the others sit idle.
+    constexpr std::size_t CHUNK_SIZE = 1024;
+
+    constexpr int EXACT_NAME_SCORE = 100;
+    constexpr int NAME_PREFIX_SCORE = 75;
+    constexpr int NAME_SCORE = 50;
+    constexpr int PROVIDES_SCORE = 30;
+    constexpr int GROUPS_SCORE = 20;
+    constexpr int DESCRIPTION_SCORE = 10;
+
+    auto EqualsIgnoreCase(char lhs, char rhs) -> bool {
+        return std::tolower(static_cast<unsigned char>(lhs)) == std::tolower(static_cast<unsigned char>(rhs));
+    }
+
+    auto ContainsRegexSyntax(std::string_view term) -> bool {
+        return term.find_first_of("^$.*+?()[]{}|\\") != std::string_view::npos;
+    }
+}  // namespace
+
+auto SearchEngine::Matcher::Matches(std::string_view text) const -> bool {
+    if (Expression) {
+        return std::regex_search(text.begin(), text.end(), *Expression);
+    }
+
+    return !std::ranges::search(text, Term, EqualsIgnoreCase).empty();
+}
+
+SearchEngine::SearchEngine(const std::vector<std::string> &terms) {
+    SetFields(Field::Name, Field::Description);
+
+    for (const std::string &term : terms) {
+        Matcher matcher{.Term = term};
+        std::ranges::for_each(matcher.Term, [](char &c) -> void {c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));});
+
+        // libalpm treats every needle as a regular expression and falls back to
+        // a plain substring search when it doesn't compile, so do the same here,
+        // but skip the regex engine entirely for terms that are plain text.
+        if (ContainsRegexSyntax(term)) {
+            try {
+                matcher.Expression = std::regex(term, std::regex::extended | std::regex::icase | std::regex::nosubs | std::regex::optimize);
+            } catch (const std::regex_error&) {
+                matcher.Expression.reset();
+            }
+        }
+
+        m_matchers.push_back(std::move(matcher));
+    }
+
+    m_index = SyncIndex::Get();
+}
+
+auto SearchEngine::Search(std::size_t limit) const -> std::vector<Result> {
+    std::vector<Result> results;
+    Search([&results](const Result &result) -> void {
+        results.push_back(result);
+    });
+
+    auto byScore = [](const Result &lhs, const Result &rhs) -> bool {
+        if (lhs.Score != rhs.Score) {
+            return lhs.Score > rhs.Score;
+        }
+
+        if (lhs.DatabaseIndex != rhs.DatabaseIndex) {
+            return lhs.DatabaseIndex < rhs.DatabaseIndex;
+        }
+
+        return lhs.Name < rhs.Name;
+    };
+
+    if (limit != 0 && limit < results.size()) {
+        std::partial_sort(results.begin(), results.begin() + static_cast<std::ptrdiff_t>(limit), results.end(), byScore);
+        results.erase(results.begin() + static_cast<std::ptrdiff_t>(limit), results.end());
+    } else {
+        std::ranges::sort(results, byScore);
+    }
+
+    return results;
+}
+
+auto SearchEngine::Search(const std::function<void(const Result&)> &callback) const -> void {
+    std::vector<Chunk> chunks = UsesIndex() ? CollectIndexChunks() : CollectChunks();
+
+    std::vector<std::future<std::vector<Result>>> futures;
+
+    // The workers read `chunks` and this engine, so they have to be done before
+    // anything unwinds past them, e.g. a callback that throws.
+    struct WaitForAll {
+        std::vector<std::future<std::vector<Result>>> &Futures;
+
+        ~WaitForAll() {
+            for (std::future<std::vector<Result>> &future : Futures) {
+                if (future.valid()) {
+                    future.wait();
+                }
+            }
+        }
+    } waitForAll{futures};
+
+    futures.reserve(chunks.size());
+    for (const Chunk &chunk : chunks) {
+        futures.push_back(ThreadPool::GetShared().Submit([this, &chunk]() -> std::vector<Result> {
+            return MatchChunk(chunk);
+        }));
+    }
+
+    // Chunks are consumed in repository order, so the first repository that
+    // has a package name always wins, the same as libalpm's own resolution.
+    std::unordered_set<std::string_view> seen;
+    for (std::future<std::vector<Result>> &future : futures) {
+        for (const Result &result : future.get()) {
+            if (seen.insert(result.Name).second) {
+                callback(result);
+            }
+        }
+    }
+}
+
+auto SearchEngine::UsesIndex() const -> bool {
+    // Groups aren't in the index.
+    return m_index != nullptr && !m_fields.test(std::to_underlying(Field::Groups));
+}
+
+auto SearchEngine::CollectChunks() const -> std::vector<Chunk> {
+    // libalpm loads package caches lazily and isn't safe to do that from several
+    // threads, so the caches are loaded and split up here. Once loaded, reading
+    // sync package fields doesn't touch any shared state.
+    std::vector<Chunk> chunks;
+    std::size_t databaseIndex = 0;
+    for (const Database &database : ALPM::GetSyncDatabasesView()) {
+        std::string_view name = alpm_db_get_name(database.GetHandle());
+
+        for (const alpm_list_t *i = alpm_db_get_pkgcache(database.GetHandle()); i != nullptr; i = i->next) {
+            if (chunks.empty() || chunks.back().DatabaseIndex != databaseIndex || chunks.back().Packages.size() == CHUNK_SIZE) {
+                chunks.push_back(Chunk{.DatabaseIndex = databaseIndex, .Database = name});
+                chunks.back().Packages.reserve(CHUNK_SIZE);
+            }
+
+            chunks.back().Packages.push_back(static_cast<alpm_pkg_t*>(i->data));
+        }
+
+        databaseIndex++;
+    }
+
+    return chunks;
+}
+
+auto SearchEngine::CollectIndexChunks() const -> std::vector<Chunk> {
+    std::vector<std::string_view> databases = m_index->GetDatabaseNames();
+
+    // Rows are already in repository order.
+    std::vector<Chunk> chunks;
+    for (uint32_t row = 0; row < m_index->GetPackageCount(); row++) {
+        uint32_t databaseIndex = m_index->GetPackage(row).GetDatabaseIndex();
+        if (chunks.empty() || chunks.back().DatabaseIndex != databaseIndex || chunks.back().RowCount == CHUNK_SIZE) {
+            chunks.push_back(Chunk{.DatabaseIndex = databaseIndex, .Database = databases[databaseIndex], .FirstRow = row});
+        }
+
+        chunks.back().RowCount++;
+    }
+
+    return chunks;
+}
+
+auto SearchEngine::MatchChunk(const Chunk &chunk) const -> std::vector<Result> {
+    std::vector<Result> results;
+    auto match = [this, &chunk, &results](const auto &package) -> void {
+        if (std::optional<int> score = Score(package)) {
+            results.push_back(Result{
+                .Name = package.GetName(),
+                .Version = package.GetVersion(),
+                .Description = package.GetDescription(),
+                .Database = chunk.Database,
+                .DatabaseIndex = chunk.DatabaseIndex,
+                .Score = *score
+            });
+        }
+    };
+
+    for (uint32_t row = chunk.FirstRow; row < chunk.FirstRow + chunk.RowCount; row++) {
+        match(m_index->GetPackage(row));
+    }
+
+    for (alpm_pkg_t *pkg : chunk.Packages) {
+        match(PackageView(pkg));
+    }
+
+    return results;
+}
+
+template <typename T>
+auto SearchEngine::Score(const T &package) const -> std::optional<int> {
+    int total = 0;
+    std::string_view name = package.GetName();
+
+    for (const Matcher &matcher : m_matchers) {
+        int best = 0;
+
+        if (m_fields.test(std::to_underlying(Field::Name)) && matcher.Matches(name)) {
+            if (!matcher.Expression && std::ranges::equal(name, matcher.Term, EqualsIgnoreCase)) {
+                best = EXACT_NAME_SCORE;
+            } else if (!matcher.Expression && name.size() >= matcher.Term.size() && std::ranges::equal(name.substr(0, matcher.Term.size()), matcher.Term, EqualsIgnoreCase)) {
+                best = NAME_PREFIX_SCORE;
+            } else {
+                best = NAME_SCORE;
+            }
+        }
+
+        if (best < PROVIDES_SCORE && m_fields.test(std::to_underlying(Field::Provides))) {
+            for (const auto &provide : package.GetProvides()) {
+                if (matcher.Matches(provide.GetName())) {
+                    best = PROVIDES_SCORE;
+                    break;
+                }
+            }
+        }
+
+        if constexpr (std::is_same_v<T, PackageView>) {
+            if (best < GROUPS_SCORE && m_fields.test(std::to_underlying(Field::Groups))) {
+                for (std::string_view group : package.GetGroups()) {
+                    if (matcher.Matches(group)) {
+                        best = GROUPS_SCORE;
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (best < DESCRIPTION_SCORE && m_fields.test(std::to_underlying(Field::Description)) && matcher.Matches(package.GetDescription())) {
+            best = DESCRIPTION_SCORE;
+        }
+
+        if (best == 0) {
+            return {};
+        }
+
+        total += best;
+    }
+
+    return total;
+}
@@ -2,24 +2,21 @@
 #include "ALPM.hpp"
 #include "Package.hpp"
 #include "Database.hpp"
+#include "Events.hpp"
+#include "Utils.hpp"
+
+#include "Event.hpp"
 
 #include "alpm.h"
 
 using namespace ALPM;
 
-PGPKey::PGPKey(alpm_pgpkey_t key, Status status, Validity validity) :
-    m_alpmPGPKey(std::make_unique<alpm_pgpkey_t>(key)), 
+PGPKey::PGPKey(std::shared_ptr<alpm_siglist_t> siglist, std::size_t index, Status status, Validity validity) :
+    m_siglist(std::move(siglist)),
+    m_alpmPGPKey(&m_siglist->results[index].key),
     m_status(status),
     m_validity(validity) {}
 
-PGPKey::~PGPKey() {
-    delete m_alpmPGPKey->name;
-    delete m_alpmPGPKey->fingerprint;
-    delete m_alpmPGPKey->email;
-    free(m_alpmPGPKey->data); // Have to use C free() here as type is void*.
-    delete m_alpmPGPKey->uid;
-}
-
 auto PGPKey::GetCreatedTime() const -> std::chrono::system_clock::time_point {
     return std::chrono::system_clock::time_point(std::chrono::seconds(m_alpmPGPKey->created));
 }
@@ -29,7 +26,7 @@ auto PGPKey::GetData() const -> void* {
 }
 
 auto PGPKey::GetEmail() const -> std::string {
-    return m_alpmPGPKey->email;
+    return std::string(Utils::ToStringView(m_alpmPGPKey->email));
 }
 
 auto PGPKey::GetExpiresTime() const -> std::chrono::system_clock::time_point {
@@ -37,7 +34,7 @@ auto PGPKey::GetExpiresTime() const -> std::chrono::system_clock::time_point {
 }
 
 auto PGPKey::GetFingerprint() const -> std::string {
-    return m_alpmPGPKey->fingerprint;
+    return std::string(Utils::ToStringView(m_alpmPGPKey->fingerprint));
 }
 
 auto PGPKey::GetDataLength() const -> uint32_t {
@@ -45,7 +42,7 @@ auto PGPKey::GetDataLength() const -> uint32_t {
 }
 
 auto PGPKey::GetOwnerName() const -> std::string {
-    return m_alpmPGPKey->name;
+    return std::string(Utils::ToStringView(m_alpmPGPKey->name));
 }
 
 auto PGPKey::IsRevoked() const -> bool {
@@ -53,7 +50,7 @@ auto PGPKey::IsRevoked() const -> bool {
 }
 
 auto PGPKey::GetUID() const -> std::string {
-    return m_alpmPGPKey->uid;
+    return std::string(Utils::ToStringView(m_alpmPGPKey->uid));
 }
 
 auto PGPKey::GetStatus() const -> PGPKey::Status {
@@ -64,76 +61,83 @@ auto PGPKey::GetValidity() const -> PGPKey::Validity {
     return m_validity;
 }
 
-auto operator|(const Signature::Level &lhs, const Signature::Level &rhs) -> Signature::Level {
-    return static_cast<Signature::Level>(std::to_underlying(lhs) | std::to_underlying(rhs));
-}
+namespace ALPM {
+    auto operator|(const Signature::Level &lhs, const Signature::Level &rhs) -> Signature::Level {
+        return static_cast<Signature::Level>(std::to_underlying(lhs) | std::to_underlying(rhs));
+    }
+}  // namespace ALPM
 
-auto Signature::CheckSignature(const Package &package) -> std::expected<std::vector<PGPKey>, std::pair<std::string, int>> {
-    alpm_siglist_t siglist;
-    std::vector<PGPKey> keyResults;
-    int rc = alpm_pkg_check_pgp_signature(package.GetHandle(), &siglist);
+auto Signature::CheckSignature(const Package &package) -> Result {
+    auto siglist = std::shared_ptr<alpm_siglist_t>(new alpm_siglist_t{}, [](alpm_siglist_t *list) -> void {
+        alpm_siglist_cleanup(list);
+        delete list;
+    });
 
-    if (rc != 0) {
-        return std::unexpected(std::make_pair(ALPM::GetError(), alpm_errno(ALPM::GetHandle())));
+    if (alpm_pkg_check_pgp_signature(package.GetHandle(), siglist.get()) != 0) {
+        Handle &owner = package.GetOwner();
+        return std::unexpected(std::make_pair(owner.GetError(), alpm_errno(owner.GetHandle())));
     }
 
-    for (size_t i = 0; i < siglist.count; i++) {
-        alpm_sigresult_t &result = siglist.results[i];
-        PGPKey::Status status;
-        PGPKey::Validity validity;
-        switch (result.status) {
-            case ALPM_SIGSTATUS_VALID:
-                status = PGPKey::Status::Valid;
-                break;
-            case ALPM_SIGSTATUS_KEY_EXPIRED:
-                status = PGPKey::Status::KeyExpired;
-                break;
-            case ALPM_SIGSTATUS_SIG_EXPIRED:
-                status = PGPKey::Status::SignatureExpired;
-                break;
-            case ALPM_SIGSTATUS_KEY_UNKNOWN:
-                status = PGPKey::Status::KeyUnknown;
-                break;
-            case ALPM_SIGSTATUS_KEY_DISABLED:
-                status = PGPKey::Status::KeyDisabled;
-                break;
-            case ALPM_SIGSTATUS_INVALID:
-                status = PGPKey::Status::Invalid;
-            default:
-                throw std::runtime_error("Invalid PGP Key Status caught.");
-        }
-        switch (result.validity) {
-            case ALPM_SIGVALIDITY_FULL:
-                validity = PGPKey::Validity::Trusted;
-                break;
-            case ALPM_SIGVALIDITY_MARGINAL:
-                validity = PGPKey::Validity::Marginal;
-                break;
-            case ALPM_SIGVALIDITY_NEVER:
-                validity = PGPKey::Validity::Untrusted;
-                break;
-            case ALPM_SIGVALIDITY_UNKNOWN:
-                validity = PGPKey::Validity::Unknown;
-                break;
-        }
+    return ToKeys(std::move(siglist));
+}
+
+auto Signature::CheckSignature(const Database &database) -> Result {
+    auto siglist = std::shared_ptr<alpm_siglist_t>(new alpm_siglist_t{}, [](alpm_siglist_t *list) -> void {
+        alpm_siglist_cleanup(list);
+        delete list;
+    });
 
-        keyResults.emplace_back(result.key, status, validity);
+    if (alpm_db_check_pgp_signature(database.GetHandle(), siglist.get()) != 0) {
+        Handle &owner = database.GetOwner();
+        return std::unexpected(std::make_pair(owner.GetError(), alpm_errno(owner.GetHandle())));
     }
 
-    return keyResults;
+    return ToKeys(std::move(siglist));
 }
 
-auto Signature::CheckSignature(const Database &database) -> std::expected<std::vector<PGPKey>, std::pair<std::string, int>> {
-    alpm_siglist_t siglist;
-    std::vector<PGPKey> keyResults;
-    int rc = alpm_db_check_pgp_signature(database.GetHandle(), &siglist);
+auto Signature::CheckSignature(const std::filesystem::path &file) -> Result {
+    std::once_flag *primed = nullptr;
+    {
+        uint64_t handle = ALPM::GetCurrentHandle().GetId();
+        std::lock_guard lock(s_mutex);
+        primed = &s_primed[handle];
+
+        static std::once_flag registered;
+        std::call_once(registered, []() -> void {
+            Event::Event::RegisterCallback<HandleReleasedEvent>([](const HandleReleasedEvent &event) -> void {
+                std::lock_guard lock(s_mutex);
+                s_primed.erase(event.Handle);
+            });
+        });
+    }
+
+    std::optional<Result> first;
+    std::call_once(*primed, [&first, &file]() -> void {
+        first = Verify(file);
+    });
+
+    if (first) {
+        return *std::move(first);
+    }
+
+    return Verify(file);
+}
 
-    if (rc != 0) {
+auto Signature::Verify(const std::filesystem::path &file) -> Result {
+    // The package is only loaded to give libalpm something to check, so skip
+    // reading the file list and let the check below do the verifying.
+    alpm_pkg_t *pkg = nullptr;
+    if (alpm_pkg_load(ALPM::GetHandle(), file.c_str(), 0, 0, &pkg) != 0) {
         return std::unexpected(std::make_pair(ALPM::GetError(), alpm_errno(ALPM::GetHandle())));
     }
 
-    for (size_t i = 0; i < siglist.count; i++) {
-        alpm_sigresult_t &result = siglist.results[i];
+    return CheckSignature(Package(pkg, true));
+}
+
+auto Signature::ToKeys(std::shared_ptr<alpm_siglist_t> siglist) -> std::vector<PGPKey> {
+    std::vector<PGPKey> keyResults;
+    for (std::size_t i = 0; i < siglist->count; i++) {
+        alpm_sigresult_t &result = siglist->results[i];
         PGPKey::Status status;
         PGPKey::Validity validity;
         switch (result.status) {
@@ -154,6 +158,7 @@ auto Signature::CheckSignature(const Database &database) -> std::expected<std::v
                 break;
             case ALPM_SIGSTATUS_INVALID:
                 status = PGPKey::Status::Invalid;
+                break;
             default:
                 throw std::runtime_error("Invalid PGP Key Status caught.");
         }
@@ -172,7 +177,7 @@ auto Signature::CheckSignature(const Database &database) -> std::expected<std::v
                 break;
         }
 
-        keyResults.emplace_back(result.key, status, validity);
+        keyResults.emplace_back(siglist, i, status, validity);
     }
 
     return keyResults;
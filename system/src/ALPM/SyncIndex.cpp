@@ -0,0 +1,512 @@
+#include "SyncIndex.hpp"
+#include "ALPM.hpp"
+#include "Database.hpp"
+
+#include <alpm.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <string>
+#include <unordered_map>
+
+using namespace ALPM;
+
+namespace {
+    constexpr std::array<char, 8> INDEX_MAGIC{'L', 'I', 'T', 'H', 'I', 'D', 'X', '\0'};
+    constexpr uint32_t INDEX_VERSION = 1;
+
+    enum Column : std::size_t {
+        Names,
+        Versions,
+        Descriptions,
+        Filenames,
+        DatabaseIndices,
+        Sizes,
+        InstallSizes,
+        DependsRanges,
+        ProvidesRanges,
+        Dependencies,
+        Provides,
+        SortedNames,
+        Databases,
+        Strings,
+        ColumnCount
+    };
+
+    struct Section {
+        uint64_t Offset;
+        uint64_t Size;
+    };
+
+    // Interns every string into one arena. Offset 0 is always the empty string
+    // so missing fields don't need a separate "null" marker.
+    class StringArena {
+        public:
+            StringArena() {
+                m_data.push_back('\0');
+                m_offsets.emplace("", 0);
+            }
+
+            auto Intern(const char *string) -> uint32_t {
+                if (string == nullptr) {
+                    return 0;
+                }
+
+                auto [it, inserted] = m_offsets.try_emplace(string, static_cast<uint32_t>(m_data.size()));
+                if (inserted) {
+                    m_data.append(string);
+                    m_data.push_back('\0');
+                }
+
+                return it->second;
+            }
+
+            auto GetData() const -> const std::string& {
+                return m_data;
+            }
+
+        private:
+            std::string m_data;
+            std::unordered_map<std::string, uint32_t> m_offsets;
+    };
+
+    auto StatDatabaseFile(const std::filesystem::path &path, SyncIndex::DatabaseRecord &record) -> bool {
+        struct stat buffer{};
+        if (stat(path.c_str(), &buffer) != 0) {
+            return false;
+        }
+
+        record.ModifiedTime = static_cast<int64_t>(buffer.st_mtim.tv_sec) * 1'000'000'000 + buffer.st_mtim.tv_nsec;
+        record.Size = buffer.st_size;
+        record.Inode = buffer.st_ino;
+
+        return true;
+    }
+
+    auto ToRecord(StringArena &strings, const alpm_depend_t *depend) -> SyncIndex::DependencyRecord {
+        return SyncIndex::DependencyRecord{
+            .Name = strings.Intern(depend->name),
+            .Version = strings.Intern(depend->version),
+            .Mode = static_cast<uint32_t>(depend->mod),
+            .Reserved = 0,
+            .NameHash = depend->name_hash
+        };
+    }
+}  // namespace
+
+struct SyncIndex::Header {
+    std::array<char, 8> Magic;
+    uint32_t Version;
+    uint32_t PackageCount;
+    uint32_t DatabaseCount;
+    uint32_t Reserved;
+    std::array<Section, ColumnCount> Columns;
+};
+
+template <typename T>
+auto SyncIndex::GetColumn(std::size_t column) const -> const T* {
+    return reinterpret_cast<const T*>(static_cast<const std::byte*>(m_mapping) + m_header->Columns[column].Offset);
+}
+
+SyncIndex::DependencyEntry::DependencyEntry(const SyncIndex *index, const DependencyRecord *record) :
+    m_index(index), m_record(record) {}
+
+auto SyncIndex::DependencyEntry::GetName() const -> std::string_view {
+    return m_index->GetString(m_record->Name);
+}
+
+auto SyncIndex::DependencyEntry::GetVersion() const -> std::string_view {
+    return m_index->GetString(m_record->Version);
+}
+
+auto SyncIndex::DependencyEntry::GetMatchMode() const -> Dependency::MatchMode {
+    switch (static_cast<alpm_depmod_t>(m_record->Mode)) {
+        case ALPM_DEP_MOD_ANY:
+            return Dependency::MatchMode::Any;
+        case ALPM_DEP_MOD_EQ:
+            return Dependency::MatchMode::Equals;
+        case ALPM_DEP_MOD_GE:
+            return Dependency::MatchMode::GreaterEquals;
+        case ALPM_DEP_MOD_LE:
+            return Dependency::MatchMode::LessEquals;
+        case ALPM_DEP_MOD_GT:
+            return Dependency::MatchMode::Greater;
+        case ALPM_DEP_MOD_LT:
+            return Dependency::MatchMode::Less;
+        default:
+            throw std::runtime_error("Unknown libalpm dependency mode.");
+    }
+}
+
+auto SyncIndex::DependencyEntry::GetNameHash() const -> unsigned long {
+    return m_record->NameHash;
+}
+
+SyncIndex::Entry::Entry(const SyncIndex *index, uint32_t row) :
+    m_index(index), m_row(row) {}
+
+auto SyncIndex::Entry::GetName() const -> std::string_view {
+    return m_index->GetString(m_index->GetColumn<uint32_t>(Names)[m_row]);
+}
+
+auto SyncIndex::Entry::GetVersion() const -> std::string_view {
+    return m_index->GetString(m_index->GetColumn<uint32_t>(Versions)[m_row]);
+}
+
+auto SyncIndex::Entry::GetDescription() const -> std::string_view {
+    return m_index->GetString(m_index->GetColumn<uint32_t>(Descriptions)[m_row]);
+}
+
+auto SyncIndex::Entry::GetFilename() const -> std::string_view {
+    return m_index->GetString(m_index->GetColumn<uint32_t>(Filenames)[m_row]);
+}
+
+auto SyncIndex::Entry::GetDatabaseName() const -> std::string_view {
+    uint32_t database = m_index->GetColumn<uint32_t>(DatabaseIndices)[m_row];
+    return m_index->GetString(m_index->GetColumn<DatabaseRecord>(Databases)[database].Name);
+}
+
+auto SyncIndex::Entry::GetSize() const -> off_t {
+    return m_index->GetColumn<int64_t>(Sizes)[m_row];
+}
+
+auto SyncIndex::Entry::GetInstallSize() const -> off_t {
+    return m_index->GetColumn<int64_t>(InstallSizes)[m_row];
+}
+
+auto SyncIndex::Entry::GetDepends() const -> DependencyRange {
+    const uint32_t *ranges = m_index->GetColumn<uint32_t>(DependsRanges);
+    const DependencyRecord *records = m_index->GetColumn<DependencyRecord>(Dependencies);
+
+    return DependencyRange(m_index, records + ranges[m_row], records + ranges[m_row + 1]);
+}
+
+auto SyncIndex::Entry::GetProvides() const -> DependencyRange {
+    const uint32_t *ranges = m_index->GetColumn<uint32_t>(ProvidesRanges);
+    const DependencyRecord *records = m_index->GetColumn<DependencyRecord>(Provides);
+
+    return DependencyRange(m_index, records + ranges[m_row], records + ranges[m_row + 1]);
+}
+
+auto SyncIndex::Entry::GetDatabaseIndex() const -> uint32_t {
+    return m_index->GetColumn<uint32_t>(DatabaseIndices)[m_row];
+}
+
+auto SyncIndex::Entry::GetRow() const -> uint32_t {
+    return m_row;
+}
+
+SyncIndex::SyncIndex(Private, void *mapping, std::size_t size) :
+    m_mapping(mapping), m_size(size), m_header(static_cast<const Header*>(mapping)) {}
+
+SyncIndex::~SyncIndex() {
+    munmap(m_mapping, m_size);
+}
+
+auto SyncIndex::Build(const std::vector<Database> &databases, const std::filesystem::path &path) -> bool {
+    StringArena strings;
+
+    std::vector<DatabaseRecord> databaseRecords;
+    std::vector<uint32_t> names, versions, descriptions, filenames, databaseIndices;
+    std::vector<int64_t> sizes, installSizes;
+    std::vector<uint32_t> dependsRanges{0}, providesRanges{0};
+    std::vector<DependencyRecord> dependencies, provides;
+
+    std::filesystem::path syncPath = std::filesystem::path(alpm_option_get_dbpath(ALPM::GetHandle())) / "sync";
+
+    for (const Database &database : databases) {
+        std::filesystem::path databaseFile = syncPath / (database.GetName() + ".db");
+
+        DatabaseRecord record{.Name = strings.Intern(database.GetName().c_str()), .Path = strings.Intern(databaseFile.c_str())};
+        if (!StatDatabaseFile(databaseFile, record)) {
+            // Databases that haven't been downloaded yet can't be indexed.
+            return false;
+        }
+
+        uint32_t databaseIndex = static_cast<uint32_t>(databaseRecords.size());
+        databaseRecords.push_back(record);
+
+        for (const alpm_list_t *i = alpm_db_get_pkgcache(database.GetHandle()); i != nullptr; i = i->next) {
+            alpm_pkg_t *pkg = static_cast<alpm_pkg_t*>(i->data);
+
+            names.push_back(strings.Intern(alpm_pkg_get_name(pkg)));
+            versions.push_back(strings.Intern(alpm_pkg_get_version(pkg)));
+            descriptions.push_back(strings.Intern(alpm_pkg_get_desc(pkg)));
+            filenames.push_back(strings.Intern(alpm_pkg_get_filename(pkg)));
+            databaseIndices.push_back(databaseIndex);
+            sizes.push_back(alpm_pkg_get_size(pkg));
+            installSizes.push_back(alpm_pkg_get_isize(pkg));
+
+            for (const alpm_list_t *j = alpm_pkg_get_depends(pkg); j != nullptr; j = j->next) {
+                dependencies.push_back(ToRecord(strings, static_cast<const alpm_depend_t*>(j->data)));
+            }
+            dependsRanges.push_back(static_cast<uint32_t>(dependencies.size()));
+
+            for (const alpm_list_t *j = alpm_pkg_get_provides(pkg); j != nullptr; j = j->next) {
+                provides.push_back(ToRecord(strings, static_cast<const alpm_depend_t*>(j->data)));
+            }
+            providesRanges.push_back(static_cast<uint32_t>(provides.size()));
+        }
+    }
+
+    // Rows stay in repository order, lookups by name go through this permutation.
+    // A stable sort keeps the first repository's package first for equal names.
+    std::vector<uint32_t> sortedNames(names.size());
+    for (uint32_t i = 0; i < sortedNames.size(); i++) {
+        sortedNames[i] = i;
+    }
+    const std::string &arena = strings.GetData();
+    std::ranges::stable_sort(sortedNames, [&arena, &names](uint32_t lhs, uint32_t rhs) -> bool {
+        return std::strcmp(arena.data() + names[lhs], arena.data() + names[rhs]) < 0;
+    });
+
+    Header header{};
+    header.Magic = INDEX_MAGIC;
+    header.Version = INDEX_VERSION;
+    header.PackageCount = static_cast<uint32_t>(names.size());
+    header.DatabaseCount = static_cast<uint32_t>(databaseRecords.size());
+
+    std::array<std::pair<const void*, std::size_t>, ColumnCount> columns;
+    columns[Names] = {names.data(), names.size() * sizeof(uint32_t)};
+    columns[Versions] = {versions.data(), versions.size() * sizeof(uint32_t)};
+    columns[Descriptions] = {descriptions.data(), descriptions.size() * sizeof(uint32_t)};
+    columns[Filenames] = {filenames.data(), filenames.size() * sizeof(uint32_t)};
+    columns[DatabaseIndices] = {databaseIndices.data(), databaseIndices.size() * sizeof(uint32_t)};
+    columns[Sizes] = {sizes.data(), sizes.size() * sizeof(int64_t)};
+    columns[InstallSizes] = {installSizes.data(), installSizes.size() * sizeof(int64_t)};
+    columns[DependsRanges] = {dependsRanges.data(), dependsRanges.size() * sizeof(uint32_t)};
+    columns[ProvidesRanges] = {providesRanges.data(), providesRanges.size() * sizeof(uint32_t)};
+    columns[Dependencies] = {dependencies.data(), dependencies.size() * sizeof(DependencyRecord)};
+    columns[Provides] = {provides.data(), provides.size() * sizeof(DependencyRecord)};
+    columns[SortedNames] = {sortedNames.data(), sortedNames.size() * sizeof(uint32_t)};
+    columns[Databases] = {databaseRecords.data(), databaseRecords.size() * sizeof(DatabaseRecord)};
+    columns[Strings] = {arena.data(), arena.size()};
+
+    // Every column starts on an 8 byte boundary so it can be read in place.
+    uint64_t offset = sizeof(Header);
+    for (std::size_t column = 0; column < ColumnCount; column++) {
+        offset = (offset + 7) & ~uint64_t{7};
+        header.Columns[column] = Section{.Offset = offset, .Size = columns[column].second};
+        offset += columns[column].second;
+    }
+
+    std::filesystem::path temporaryPath = path;
+    temporaryPath += ".tmp";
+
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            return false;
+        }
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        uint64_t written = sizeof(Header);
+        for (std::size_t column = 0; column < ColumnCount; column++) {
+            static constexpr std::array<char, 8> padding{};
+            file.write(padding.data(), static_cast<std::streamsize>(header.Columns[column].Offset - written));
+            file.write(static_cast<const char*>(columns[column].first), static_cast<std::streamsize>(columns[column].second));
+            written = header.Columns[column].Offset + header.Columns[column].Size;
+        }
+
+        if (!file) {
+            std::filesystem::remove(temporaryPath, ec);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temporaryPath, path, ec);
+
+    return !ec;
+}
+
+auto SyncIndex::Open(const std::filesystem::path &path) -> std::shared_ptr<const SyncIndex> {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat buffer{};
+    if (fstat(fd, &buffer) != 0 || static_cast<std::size_t>(buffer.st_size) < sizeof(Header)) {
+        close(fd);
+        return nullptr;
+    }
+
+    std::size_t size = static_cast<std::size_t>(buffer.st_size);
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        return nullptr;
+    }
+
+    std::shared_ptr<const SyncIndex> index = std::make_shared<const SyncIndex>(Private(), mapping, size);
+    if (!index->IsValid() || index->IsStale()) {
+        return nullptr;
+    }
+
+    return index;
+}
+
+auto SyncIndex::Get() -> std::shared_ptr<const SyncIndex> {
+    if (std::shared_ptr<const SyncIndex> index = Open()) {
+        return index;
+    }
+
+    if (!Build(ALPM::GetSyncDatabases())) {
+        return nullptr;
+    }
+
+    return Open();
+}
+
+auto SyncIndex::GetDefaultPath() -> std::filesystem::path {
+    return std::filesystem::path(alpm_option_get_dbpath(ALPM::GetHandle())) / "sync" / "system.idx";
+}
+
+auto SyncIndex::IsStale() const -> bool {
+    const DatabaseRecord *records = GetColumn<DatabaseRecord>(Databases);
+    for (uint32_t i = 0; i < m_header->DatabaseCount; i++) {
+        DatabaseRecord current{};
+        if (!StatDatabaseFile(GetString(records[i].Path), current)) {
+            return true;
+        }
+
+        if (current.ModifiedTime != records[i].ModifiedTime || current.Size != records[i].Size || current.Inode != records[i].Inode) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+auto SyncIndex::GetPackageCount() const -> std::size_t {
+    return m_header->PackageCount;
+}
+
+auto SyncIndex::GetPackage(std::size_t row) const -> Entry {
+    return Entry(this, static_cast<uint32_t>(row));
+}
+
+auto SyncIndex::FindPackage(std::string_view name) const -> std::optional<Entry> {
+    const uint32_t *sorted = GetColumn<uint32_t>(SortedNames);
+    const uint32_t *names = GetColumn<uint32_t>(Names);
+
+    const uint32_t *it = std::lower_bound(sorted, sorted + m_header->PackageCount, name, [this, names](uint32_t row, std::string_view value) -> bool {
+        return GetString(names[row]) < value;
+    });
+
+    if (it == sorted + m_header->PackageCount || GetString(names[*it]) != name) {
+        return {};
+    }
+
+    return Entry(this, *it);
+}
+
+auto SyncIndex::GetDatabaseNames() const -> std::vector<std::string_view> {
+    std::vector<std::string_view> databases;
+    const DatabaseRecord *records = GetColumn<DatabaseRecord>(Databases);
+    for (uint32_t i = 0; i < m_header->DatabaseCount; i++) {
+        databases.push_back(GetString(records[i].Name));
+    }
+
+    return databases;
+}
+
+auto SyncIndex::GetString(uint32_t offset) const -> std::string_view {
+    return GetColumn<char>(Strings) + offset;
+}
+
+auto SyncIndex::IsValid() const -> bool {
+    if (m_header->Magic != INDEX_MAGIC || m_header->Version != INDEX_VERSION) {
+        return false;
+    }
+
+    std::size_t packages = m_header->PackageCount;
+    std::array<std::size_t, ColumnCount> sizes{
+        packages * sizeof(uint32_t),
+        packages * sizeof(uint32_t),
+        packages * sizeof(uint32_t),
+        packages * sizeof(uint32_t),
+        packages * sizeof(uint32_t),
+        packages * sizeof(int64_t),
+        packages * sizeof(int64_t),
+        (packages + 1) * sizeof(uint32_t),
+        (packages + 1) * sizeof(uint32_t),
+        // Only known from the column itself, but it has to hold whole records.
+        m_header->Columns[Dependencies].Size - m_header->Columns[Dependencies].Size % sizeof(DependencyRecord),
+        m_header->Columns[Provides].Size - m_header->Columns[Provides].Size % sizeof(DependencyRecord),
+        packages * sizeof(uint32_t),
+        m_header->DatabaseCount * sizeof(DatabaseRecord),
+        m_header->Columns[Strings].Size
+    };
+
+    for (std::size_t column = 0; column < ColumnCount; column++) {
+        const Section &section = m_header->Columns[column];
+        if (section.Offset % 8 != 0 || section.Offset > m_size || section.Size > m_size - section.Offset || section.Size != sizes[column]) {
+            return false;
+        }
+    }
+
+    // Every string has to end inside the arena.
+    uint64_t stringsSize = m_header->Columns[Strings].Size;
+    if (stringsSize == 0 || GetColumn<char>(Strings)[stringsSize - 1] != '\0') {
+        return false;
+    }
+
+    auto inArena = [stringsSize](uint32_t offset) -> bool {
+        return offset < stringsSize;
+    };
+
+    for (Column column : {Names, Versions, Descriptions, Filenames}) {
+        if (!std::ranges::all_of(std::span(GetColumn<uint32_t>(column), packages), inArena)) {
+            return false;
+        }
+    }
+
+    for (const DatabaseRecord &record : std::span(GetColumn<DatabaseRecord>(Databases), m_header->DatabaseCount)) {
+        if (!inArena(record.Name) || !inArena(record.Path)) {
+            return false;
+        }
+    }
+
+    for (uint32_t database : std::span(GetColumn<uint32_t>(DatabaseIndices), packages)) {
+        if (database >= m_header->DatabaseCount) {
+            return false;
+        }
+    }
+
+    for (uint32_t row : std::span(GetColumn<uint32_t>(SortedNames), packages)) {
+        if (row >= packages) {
+            return false;
+        }
+    }
+
+    // Each package's dependencies run from its range entry to the next one.
+    for (auto [ranges, records] : {std::pair{DependsRanges, Dependencies}, std::pair{ProvidesRanges, Provides}}) {
+        std::span<const uint32_t> range(GetColumn<uint32_t>(ranges), packages + 1);
+        std::span<const DependencyRecord> dependencies(GetColumn<DependencyRecord>(records), m_header->Columns[records].Size / sizeof(DependencyRecord));
+
+        if (range.front() != 0 || range.back() != dependencies.size() || !std::ranges::is_sorted(range)) {
+            return false;
+        }
+
+        for (const DependencyRecord &record : dependencies) {
+            if (!inArena(record.Name) || !inArena(record.Version) || record.Mode < ALPM_DEP_MOD_ANY || record.Mode > ALPM_DEP_MOD_LT) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
@@ -1,25 +1,382 @@
 #include "Transaction.hpp"
 #include "ALPM.hpp"
+#include "Checkpoint.hpp"
+#include "ContentCache.hpp"
+#include "DeltaRefresh.hpp"
+#include "Downloader.hpp"
+#include "Events.hpp"
+#include "FileOwnershipIndex.hpp"
+#include "Handle.hpp"
+#include "HookQueue.hpp"
+#include "LocalSnapshot.hpp"
+#include "Metrics.hpp"
+#include "Pipeline.hpp"
 #include "Utils.hpp"
 
+#include "Event.hpp"
+#include "PosixSignals.hpp"
+
 #include <alpm.h>
 
-#include <ranges>
+#include <sys/statvfs.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <exception>
 #include <format>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <ranges>
+#include <sstream>
 
 using namespace ALPM;
 
-Transaction::Transaction(Transaction::Private) {}
+namespace {
+    // Same margin pacman keeps free on every mount point it installs to.
+    constexpr off_t DISK_SPACE_CUSHION = 5 * 1024 * 1024;
+
+    // Flags whose meaning would change for the other transactions if they were
+    // OR-ed into a merged one.
+    auto GetExclusiveFlags() -> std::bitset<32> {
+        std::bitset<32> flags;
+        for (Transaction::OperationFlags flag : {
+            Transaction::OperationFlags::NoDependencyChecks,
+            Transaction::OperationFlags::NoDepVersionChecking,
+            Transaction::OperationFlags::RemoveDependingPackages,
+            Transaction::OperationFlags::Recursive,
+            Transaction::OperationFlags::RecursiveAll,
+            Transaction::OperationFlags::DatabaseOnly,
+            Transaction::OperationFlags::NoHooks,
+            Transaction::OperationFlags::AllDependencies,
+            Transaction::OperationFlags::AllExplicit,
+            Transaction::OperationFlags::DownloadOnly,
+            Transaction::OperationFlags::NoScriptlets,
+            Transaction::OperationFlags::NoConflicts,
+            Transaction::OperationFlags::OnlyRemoveUnneeded
+        }) {
+            flags.set(std::to_underlying(flag));
+        }
+
+        return flags;
+    }
+
+    auto ReadMountPoints() -> std::vector<std::filesystem::path> {
+        std::vector<std::filesystem::path> mountPoints;
+
+        std::ifstream mounts("/proc/self/mounts");
+        std::string line;
+        while (std::getline(mounts, line)) {
+            std::istringstream fields(line);
+            std::string device;
+            std::string mountPoint;
+            fields >> device >> mountPoint;
+
+            // Whitespace in mount points is escaped as octal, e.g. \040.
+            std::string unescaped;
+            for (std::size_t i = 0; i < mountPoint.size(); i++) {
+                if (mountPoint[i] == '\\' && i + 3 < mountPoint.size() && std::isdigit(static_cast<unsigned char>(mountPoint[i + 1]))) {
+                    unescaped.push_back(static_cast<char>(std::stoi(mountPoint.substr(i + 1, 3), nullptr, 8)));
+                    i += 3;
+                } else {
+                    unescaped.push_back(mountPoint[i]);
+                }
+            }
+
+            mountPoints.emplace_back(unescaped);
+        }
+
+        if (mountPoints.empty()) {
+            mountPoints.emplace_back("/");
+        }
+
+        return mountPoints;
+    }
+
+    // The mount point a path lives on is the longest mount point it starts with.
+    auto FindMountPoint(const std::vector<std::filesystem::path> &mountPoints, const std::filesystem::path &path) -> const std::filesystem::path& {
+        const std::filesystem::path *best = &mountPoints.front();
+        std::size_t bestLength = 0;
+        for (const std::filesystem::path &mountPoint : mountPoints) {
+            auto [mountEnd, pathIt] = std::mismatch(mountPoint.begin(), mountPoint.end(), path.begin(), path.end());
+            std::size_t length = static_cast<std::size_t>(std::distance(mountPoint.begin(), mountPoint.end()));
+            if ((mountEnd == mountPoint.end() || mountEnd->empty()) && length >= bestLength) {
+                best = &mountPoint;
+                bestLength = length;
+            }
+        }
+
+        return *best;
+    }
+
+    // Spreads `bytes` over mount points in proportion to where the package's
+    // files are. Sync packages don't carry a file list, so installed versions
+    // are the best guess at where an upgrade's files will go.
+    auto Distribute(std::map<std::filesystem::path, off_t> &usage, const std::vector<std::filesystem::path> &mountPoints, const std::filesystem::path &root, alpm_pkg_t *pkg, off_t bytes) -> void {
+        std::map<std::filesystem::path, std::size_t> counts;
+        std::size_t total = 0;
+
+        if (const alpm_filelist_t *files = alpm_pkg_get_files(pkg)) {
+            for (std::size_t i = 0; i < files->count; i++) {
+                std::string_view name = files->files[i].name;
+                if (name.ends_with('/')) {
+                    continue;
+                }
+
+                counts[FindMountPoint(mountPoints, root / name)]++;
+                total++;
+            }
+        }
+
+        if (total == 0) {
+            usage[FindMountPoint(mountPoints, root / "usr")] += bytes;
+            return;
+        }
+
+        for (const auto &[mountPoint, count] : counts) {
+            usage[mountPoint] += static_cast<off_t>(static_cast<double>(bytes) * static_cast<double>(count) / static_cast<double>(total));
+        }
+    }
+
+    auto EstimateDiskUsage(const std::vector<Package> &additions, const std::vector<Package> &removals, off_t downloadSize) -> std::vector<Transaction::MountUsage> {
+        std::vector<std::filesystem::path> mountPoints = ReadMountPoints();
+        std::filesystem::path root = alpm_option_get_root(ALPM::ALPM::GetHandle());
+        alpm_db_t *localDatabase = alpm_get_localdb(ALPM::ALPM::GetHandle());
+
+        std::map<std::filesystem::path, off_t> usage;
+        for (const Package &package : additions) {
+            alpm_pkg_t *installed = alpm_db_get_pkg(localDatabase, alpm_pkg_get_name(package.GetHandle()));
+            if (installed) {
+                Distribute(usage, mountPoints, root, installed, alpm_pkg_get_isize(package.GetHandle()) - alpm_pkg_get_isize(installed));
+            } else {
+                Distribute(usage, mountPoints, root, package.GetHandle(), alpm_pkg_get_isize(package.GetHandle()));
+            }
+        }
+
+        for (const Package &package : removals) {
+            Distribute(usage, mountPoints, root, package.GetHandle(), -alpm_pkg_get_isize(package.GetHandle()));
+        }
+
+        if (downloadSize > 0) {
+            usage[FindMountPoint(mountPoints, Downloader::GetCacheDirectory())] += downloadSize;
+        }
+
+        std::vector<Transaction::MountUsage> mounts;
+        for (const auto &[mountPoint, required] : usage) {
+            struct statvfs stats{};
+            off_t available = 0;
+            if (statvfs(mountPoint.c_str(), &stats) == 0) {
+                available = static_cast<off_t>(stats.f_bavail) * static_cast<off_t>(stats.f_frsize);
+            }
+
+            mounts.push_back(Transaction::MountUsage{.MountPoint = mountPoint, .Required = required, .Available = std::max<off_t>(available - DISK_SPACE_CUSHION, 0)});
+        }
+
+        return mounts;
+    }
+}  // namespace
+
+Transaction::Transaction(Transaction::Private) :
+    m_handle(&ALPM::GetCurrentHandle()) {}
 
 Transaction::~Transaction() {
-    alpm_trans_release(ALPM::GetHandle());
+    alpm_trans_release(m_handle->GetHandle());
 }
 
 auto Transaction::Create() -> std::shared_ptr<Transaction> {
     return std::make_shared<Transaction>(Private());
 }
 
+auto Transaction::Resume() -> std::shared_ptr<Transaction> {
+    std::shared_ptr<Checkpoint> checkpoint = Checkpoint::Load();
+    if (!checkpoint) {
+        return {};
+    }
+
+    std::shared_ptr<Transaction> transaction = Create();
+    transaction->m_transactionFlags = std::bitset<32>(checkpoint->GetFlags());
+    transaction->m_systemUpgrade = checkpoint->IsSystemUpgrade();
+    transaction->m_executionMode = checkpoint->IsPipelined() ? ExecutionMode::Pipelined : ExecutionMode::Serial;
+    transaction->m_checkpoint = checkpoint;
+
+    alpm_db_t *localDatabase = alpm_get_localdb(ALPM::GetHandle());
+    for (const Checkpoint::Target &target : checkpoint->GetTargets()) {
+        if (target.Operation == PackageOperation::Uninstall) {
+            // Already gone if the interruption came during the commit.
+            if (alpm_pkg_t *pkg = alpm_db_get_pkg(localDatabase, target.Name.c_str())) {
+                transaction->AddPackageOperation(Package(pkg), PackageOperation::Uninstall);
+            }
+            continue;
+        }
+
+        std::optional<Database> database = ALPM::GetSyncDatabase(target.Database);
+        alpm_pkg_t *pkg = database ? alpm_db_get_pkg(database->GetHandle(), target.Name.c_str()) : nullptr;
+        if (pkg == nullptr) {
+            Checkpoint::Discard();
+            return {};
+        }
+
+        transaction->AddPackageOperation(Package(pkg), target.Operation);
+    }
+
+    // Updates that already ran are skipped by `Apply`, but a resume before
+    // they did has to run them.
+    for (const std::string &name : checkpoint->GetDatabases()) {
+        std::optional<Database> database = ALPM::GetSyncDatabase(name);
+        if (!database) {
+            Checkpoint::Discard();
+            return {};
+        }
+
+        transaction->AddDatabaseOperation(*database, DatabaseOperation::Update);
+    }
+
+    return transaction;
+}
+
+auto Transaction::Enqueue(std::shared_ptr<Transaction> transaction) -> void {
+    std::lock_guard lock(s_queueMutex);
+    s_transactions.push(std::move(transaction));
+}
+
+auto Transaction::ApplyQueued() -> std::vector<MergeReport> {
+    std::vector<std::shared_ptr<Transaction>> queued;
+    {
+        std::lock_guard lock(s_queueMutex);
+        while (!s_transactions.empty()) {
+            queued.push_back(std::move(s_transactions.front()));
+            s_transactions.pop();
+        }
+    }
+
+    // Only neighbours are merged, so incompatible transactions still apply in
+    // the order they were queued.
+    std::vector<MergeReport> reports;
+    std::size_t begin = 0;
+    while (begin < queued.size()) {
+        std::size_t end = begin + 1;
+        while (end < queued.size() && queued[begin]->IsCompatible(*queued[end])) {
+            end++;
+        }
+
+        auto [merged, report] = Merge({queued.begin() + static_cast<std::ptrdiff_t>(begin), queued.begin() + static_cast<std::ptrdiff_t>(end)});
+        try {
+            merged->Apply();
+        } catch (const std::runtime_error &error) {
+            report.Error = error.what();
+        }
+
+        reports.push_back(std::move(report));
+        begin = end;
+    }
+
+    return reports;
+}
+
+auto Transaction::Merge(const std::vector<std::shared_ptr<Transaction>> &transactions) -> std::pair<std::shared_ptr<Transaction>, MergeReport> {
+    // The merged transaction belongs to the same root as the ones it merges.
+    std::optional<Handle::Scope> scope;
+    if (!transactions.empty()) {
+        scope.emplace(*transactions.front()->m_handle);
+    }
+
+    std::shared_ptr<Transaction> merged = Create();
+    MergeReport report{.Requests = transactions};
+
+    alpm_db_t *localDatabase = alpm_get_localdb(ALPM::GetHandle());
+
+    // Pending operations by package name, plus the order names first showed up
+    // in so the merged transaction adds packages in request order.
+    std::unordered_map<std::string, MergedOperation> pending;
+    std::vector<std::string> order;
+    std::set<std::string> databases;
+
+    for (const std::shared_ptr<Transaction> &transaction : transactions) {
+        merged->m_transactionFlags |= transaction->m_transactionFlags;
+        merged->m_systemUpgrade |= transaction->m_systemUpgrade;
+        if (transaction->m_executionMode == ExecutionMode::Pipelined) {
+            merged->m_executionMode = ExecutionMode::Pipelined;
+        }
+        if (!merged->m_contentCache) {
+            merged->m_contentCache = transaction->m_contentCache;
+            merged->m_revision = transaction->m_revision;
+        }
+        if (!merged->m_hookQueue) {
+            merged->m_hookQueue = transaction->m_hookQueue;
+        }
+
+        for (const auto &[database, operation] : transaction->m_databaseOperations) {
+            if (databases.insert(database.GetName()).second) {
+                merged->AddDatabaseOperation(database, operation);
+            }
+        }
+
+        for (const auto &[package, operation] : transaction->m_packageOperations) {
+            std::string name = package.GetName();
+            auto existing = pending.find(name);
+
+            if (existing == pending.end()) {
+                pending.emplace(name, MergedOperation{.Target = Package(package.GetHandle()), .Operation = operation, .Requests = {transaction}});
+                order.push_back(name);
+                continue;
+            }
+
+            MergedOperation &current = existing->second;
+            if (current.Operation == operation) {
+                // Asking twice is satisfied once, by the latest package asked for.
+                current.Target = Package(package.GetHandle());
+                if (std::ranges::find(current.Requests, transaction) == current.Requests.end()) {
+                    current.Requests.push_back(transaction);
+                }
+                continue;
+            }
+
+            MergedOperation replacement{.Target = Package(package.GetHandle()), .Operation = operation, .Requests = {transaction}};
+            report.Cancelled.push_back(std::move(current));
+
+            // Removing a package that only a pending install would have added
+            // leaves nothing to do at all.
+            if (operation == PackageOperation::Uninstall && alpm_db_get_pkg(localDatabase, name.c_str()) == nullptr) {
+                report.Cancelled.push_back(std::move(replacement));
+                pending.erase(existing);
+            } else {
+                current = std::move(replacement);
+            }
+        }
+    }
+
+    for (const std::string &name : order) {
+        auto operation = pending.find(name);
+        if (operation == pending.end()) {
+            continue;
+        }
+
+        merged->AddPackageOperation(operation->second.Target, operation->second.Operation);
+        report.Operations.push_back(std::move(operation->second));
+
+        // A name cancelled and then requested again is in `order` twice.
+        pending.erase(operation);
+    }
+
+    return {merged, std::move(report)};
+}
+
+auto Transaction::SetExecutionMode(ExecutionMode mode) -> void {
+    m_executionMode = mode;
+}
+
+auto Transaction::SetContentCache(std::shared_ptr<ContentCache> cache, std::string revision) -> void {
+    m_contentCache = std::move(cache);
+    m_revision = std::move(revision);
+}
+
+auto Transaction::SetHookQueue(std::shared_ptr<HookQueue> queue) -> void {
+    m_hookQueue = std::move(queue);
+}
+
 auto Transaction::AddPackageOperation(const Package &package, PackageOperation operation) -> void {
     m_packageOperations.emplace_back(Package(package.GetHandle()), operation);
 }
@@ -50,10 +407,124 @@ auto Transaction::GetDatabaseUpdates() const -> std::vector<Database> {
     return std::ranges::to<std::vector<Database>>(updates);
 }
 
-auto Transaction::Apply() const -> void {
-    if (!GetDatabaseUpdates().empty()) {
+auto Transaction::IsCompatible(const Transaction &other) const -> bool {
+    std::bitset<32> exclusive = GetExclusiveFlags();
+    return m_handle == other.m_handle && (m_transactionFlags & exclusive) == (other.m_transactionFlags & exclusive);
+}
+
+auto Transaction::Apply(std::stop_token stop) const -> void {
+    Handle::Scope scope(*m_handle);
+    Metrics::Run run;
+
+    // Lets other threads read what's installed while the commit runs. The
+    // snapshot from the last commit is reused unless something else changed
+    // the local database since.
+    LocalSnapshot::Capture();
+
+    // An interrupt stops the transaction the same way a stop request does, so
+    // it's released before the process exits.
+    POSIXSignals::Interruption interruption;
+    std::stop_source stopSource;
+    std::stop_callback forwardStop(stop, [&stopSource]() -> void {
+        stopSource.request_stop();
+    });
+    std::stop_callback forwardInterrupt(interruption.GetToken(), [&stopSource]() -> void {
+        stopSource.request_stop();
+    });
+    stop = stopSource.get_token();
+
+    auto stopIfRequested = [&stop](bool initialized) -> void {
+        if (!stop.stop_requested()) {
+            return;
+        }
+
+        if (initialized) {
+            alpm_trans_release(ALPM::GetHandle());
+        }
+        throw std::runtime_error("Failed to apply transaction: Cancelled");
+    };
+
+    std::shared_ptr<Checkpoint> checkpoint = m_checkpoint ? m_checkpoint : StartCheckpoint();
+
+    // Only an interruption leaves the checkpoint behind to resume from. Any
+    // other failure would just happen again on every resume.
+    struct DiscardOnFailure {
+        const std::stop_token &Stop;
+        int Exceptions{std::uncaught_exceptions()};
+
+        ~DiscardOnFailure() {
+            if (std::uncaught_exceptions() > Exceptions && !Stop.stop_requested()) {
+                Checkpoint::Discard();
+            }
+        }
+    } discardOnFailure{stop};
+
+    // A refresh between an interruption and its resume would change the plan
+    // and throw away the downloads.
+    std::vector<Database> databaseUpdates;
+    if (!checkpoint->IsComplete(Checkpoint::Phase::Databases)) {
+        databaseUpdates = GetDatabaseUpdates();
+    }
+
+    Metrics::Scope refresh(Metrics::Phase::Refresh);
+    Metrics::Add(Metrics::Counter::Databases, databaseUpdates.size());
+
+    // Re-registering the sync databases below frees their packages, so the
+    // ones the operations point to are looked up again by name afterwards.
+    std::vector<std::pair<Package, PackageOperation>> operations = m_packageOperations;
+
+    if (m_transactionFlags.test(std::to_underlying(OperationFlags::DeltaDatabase)) && !databaseUpdates.empty()) {
+        std::vector<std::string> fullRefreshes;
+        for (const Database &database : databaseUpdates) {
+            if (!DeltaRefresh(database).Apply()) {
+                fullRefreshes.push_back(database.GetName());
+            }
+        }
+
+        if (fullRefreshes.size() != databaseUpdates.size()) {
+            // libalpm may already have read the old database files, and the only
+            // public way to make it read them again is to register them again.
+            // That invalidates every database handle, including ours.
+            std::vector<std::pair<std::string, std::string>> targets;
+            for (const auto &[package, operation] : operations) {
+                alpm_db_t *db = alpm_pkg_get_db(package.GetHandle());
+                if (db != nullptr && db != alpm_get_localdb(ALPM::GetHandle())) {
+                    targets.emplace_back(alpm_db_get_name(db), package.GetName());
+                } else {
+                    targets.emplace_back();
+                }
+            }
+
+            alpm_unregister_all_syncdbs(ALPM::GetHandle());
+            Database::Initialize();
+
+            for (std::size_t i = 0; i < operations.size(); i++) {
+                const auto &[databaseName, packageName] = targets[i];
+                if (databaseName.empty()) {
+                    continue;
+                }
+
+                std::optional<Database> database = ALPM::GetSyncDatabase(databaseName);
+                alpm_pkg_t *pkg = database ? alpm_db_get_pkg(database->GetHandle(), packageName.c_str()) : nullptr;
+                if (pkg == nullptr) {
+                    throw std::runtime_error(std::format("Failed to apply transaction: {} is no longer in {} after refreshing it", packageName, databaseName));
+                }
+
+                operations[i].first = Package(pkg);
+            }
+
+            databaseUpdates.clear();
+            for (const std::string &name : fullRefreshes) {
+                if (std::optional<Database> database = ALPM::GetSyncDatabase(name)) {
+                    databaseUpdates.push_back(*database);
+                }
+            }
+        }
+    }
+
+    if (!databaseUpdates.empty()) {
         alpm_list_t *list = nullptr;
-        for (const Database &database : GetDatabaseUpdates()) {
+        for (const Database &database : databaseUpdates) {
             // Handle first list entry
             list = alpm_list_add(list, database.GetHandle());
         }
@@ -64,13 +535,276 @@ auto Transaction::Apply() const -> void {
 
             throw std::runtime_error(std::format("Failed to apply transaction: Could not add database updates to libalpm transaction: {}", ALPM::GetError()));
         }
+
+        alpm_list_free(list);
+        ALPM::InvalidateDatabases();
+    }
+
+    checkpoint->Complete(Checkpoint::Phase::Databases);
+    refresh.End();
+    stopIfRequested(false);
+
+    Metrics::Scope resolve(Metrics::Phase::Resolve);
+    if (!Initialize(operations)) {
+        alpm_trans_release(ALPM::GetHandle());
+        Checkpoint::Discard();
+        std::cout << "There is nothing to do." << std::endl;
+        return;
+    }
+
+    /* Handle transaction */
+
+    ExecutionPlan plan = Prepare();
+    if (!plan.IsResolvable()) {
+        alpm_trans_release(ALPM::GetHandle());
+        throw std::runtime_error(std::format("Failed to prepare transaction: {}", *plan.Error));
+    }
+    resolve.End();
+    stopIfRequested(true);
+
+    // libalpm only checks disk space after downloading every package.
+    if (!plan.Fits()) {
+        alpm_trans_release(ALPM::GetHandle());
+
+        const MountUsage &mount = *std::ranges::find_if(plan.Mounts, [](const MountUsage &usage) -> bool {return usage.Required > usage.Available;});
+        throw std::runtime_error(std::format("Failed to prepare transaction: Not enough free space on {}: {} bytes needed, {} bytes available", mount.MountPoint.string(), mount.Required, mount.Available));
+    }
+
+    std::vector<std::string> filenames;
+    for (const Package &package : plan.Additions) {
+        filenames.push_back(package.GetFilename());
+    }
+    checkpoint->SetPlan(filenames);
+
+    std::map<std::string, std::vector<std::string>> files;
+    if (m_executionMode == ExecutionMode::Pipelined && !checkpoint->IsComplete(Checkpoint::Phase::Downloads)) {
+        Pipeline pipeline;
+        pipeline.SetCheckpoint(checkpoint);
+        pipeline.SetContentCache(m_contentCache);
+        pipeline.SetStopToken(stop);
+        std::vector<Pipeline::Failure> failures = pipeline.Run(plan.Additions);
+        stopIfRequested(true);
+        if (!failures.empty()) {
+            alpm_trans_release(ALPM::GetHandle());
+            throw std::runtime_error(std::format("Failed to prepare transaction: {}: {}", failures.front().Filename, failures.front().Error));
+        }
+
+        auto seconds = [](std::chrono::steady_clock::duration duration) -> double {
+            return std::chrono::duration<double>(duration).count();
+        };
+        std::cout << std::format("Packages ready in {:.1f}s, with {:.1f}s of stage time overlapped.", seconds(pipeline.GetElapsed()), seconds(pipeline.GetOverlap())) << std::endl;
+
+        checkpoint->Complete(Checkpoint::Phase::Downloads);
+        files = pipeline.GetFiles();
+    }
+
+    // libalpm only finds file conflicts after downloading every package, and
+    // has to read the file list of every installed package to do it.
+    bool checkFiles = !m_transactionFlags.test(std::to_underlying(OperationFlags::DatabaseOnly))
+                   && !m_transactionFlags.test(std::to_underlying(OperationFlags::DownloadOnly))
+                   && !m_transactionFlags.test(std::to_underlying(OperationFlags::NoConflicts));
+    bool deferHooks = m_hookQueue && !m_transactionFlags.test(std::to_underlying(OperationFlags::NoHooks));
+
+    if (checkFiles || deferHooks) {
+        for (const Package &package : plan.Additions) {
+            // Sync packages only know their files when a files database is
+            // loaded, or once the pipeline has read their archive.
+            if (!files.contains(package.GetName())) {
+                std::vector<std::string> &packageFiles = files[package.GetName()];
+                for (const File &file : package.GetFiles()) {
+                    packageFiles.push_back(file.GetName());
+                }
+            }
+        }
     }
 
-    if (alpm_trans_init(ALPM::GetHandle(), static_cast<alpm_transflag_t>(m_transactionFlags.to_ulong() & 0b111111111111111111)) != 0) {
+    if (checkFiles) {
+        std::set<std::string> replaced;
+        for (const Package &package : plan.Additions) {
+            replaced.insert(package.GetName());
+        }
+        for (const Package &package : plan.Removals) {
+            replaced.insert(package.GetName());
+        }
+
+        if (std::shared_ptr<const FileOwnershipIndex> index = FileOwnershipIndex::Get()) {
+            std::vector<FileOwnershipIndex::Conflict> conflicts = index->FindConflicts(files, replaced);
+            if (!conflicts.empty()) {
+                alpm_trans_release(ALPM::GetHandle());
+
+                const FileOwnershipIndex::Conflict &conflict = conflicts.front();
+                throw std::runtime_error(std::format("Failed to prepare transaction: /{} from {} conflicts with {}", conflict.Path, conflict.Package, conflict.Owner.empty() ? "an unowned file" : conflict.Owner));
+            }
+        }
+    }
+
+    // Whether a package is an install or an upgrade is only known before the
+    // commit, and so are the files of removed packages.
+    alpm_db_t *localDatabase = alpm_get_localdb(ALPM::GetHandle());
+    Hook::Changes changes;
+    if (deferHooks) {
+        for (const Package &package : plan.Additions) {
+            Hook::Operation operation = alpm_db_get_pkg(localDatabase, package.GetName().c_str()) != nullptr ? Hook::Operation::Upgrade : Hook::Operation::Install;
+            changes.Packages[package.GetName()] = operation;
+            for (const std::string &file : files[package.GetName()]) {
+                changes.Files[file] = operation;
+            }
+        }
+        for (const Package &package : plan.Removals) {
+            changes.Packages[package.GetName()] = Hook::Operation::Remove;
+            for (const File &file : package.GetFiles()) {
+                changes.Files[file.GetName()] = Hook::Operation::Remove;
+            }
+        }
+
+        if (std::optional<std::string> failed = HookQueue::RunPreTransaction(changes)) {
+            alpm_trans_release(ALPM::GetHandle());
+            throw std::runtime_error(std::format("Failed to commit transaction: Hook {} failed", *failed));
+        }
+    }
+
+    // libalpm only downloads what it can't find in the cache directory, so
+    // anything linked in from the shared cache is skipped.
+    std::vector<std::pair<std::string, std::string>> blobs;
+    if (m_contentCache) {
+        std::filesystem::path cacheDirectory = Downloader::GetCacheDirectory();
+        for (const Package &package : plan.Additions) {
+            if (alpm_pkg_get_origin(package.GetHandle()) != ALPM_PKG_FROM_SYNCDB) {
+                continue;
+            }
+
+            if (m_executionMode == ExecutionMode::Serial && package.GetDownloadSize() != 0) {
+                m_contentCache->Materialize(package, cacheDirectory);
+            }
+            blobs.emplace_back(package.GetSHA256Sum(), package.GetFilename());
+        }
+    }
+
+    // The packages in the transaction are freed or replaced by the commit, so
+    // their names have to be copied out beforehand.
+    TransactionCompletedEvent completed;
+    for (const Package &package : plan.Additions) {
+        completed.Added.push_back(package.GetName());
+    }
+    for (const Package &package : plan.Removals) {
+        completed.Removed.push_back(package.GetName());
+    }
+
+    stopIfRequested(true);
+
+    // A stop requested during the commit interrupts libalpm, which stops after
+    // the package it's working on.
+    std::stop_callback interrupt(stop, [this]() -> void {
+        Interrupt();
+    });
+
+    alpm_list_t *errorList = nullptr;
+    if (alpm_trans_commit(ALPM::GetHandle(), &errorList) != 0) {
+        if (errorList) {
+            if (alpm_errno(ALPM::GetHandle()) == ALPM_ERR_FILE_CONFLICTS) {
+                alpm_list_free_inner(errorList, reinterpret_cast<alpm_list_fn_free>(alpm_fileconflict_free));
+                alpm_list_free(errorList);
+                errorList = nullptr;
+            } else {
+                FREELIST(errorList);
+            }
+        }
+
+        stopIfRequested(true);
+
+        std::string error = ALPM::GetError();
+        alpm_trans_release(ALPM::GetHandle());
+
+        // TODO: Only throw if user gives no option.
+        throw std::runtime_error(std::format("Failed to commit transaction: {}", error));
+    }
+
+    Checkpoint::Discard();
+
+    for (const std::string &name : completed.Added) {
+        alpm_pkg_t *package = alpm_db_get_pkg(localDatabase, name.c_str());
+        alpm_filelist_t *fileList = package != nullptr ? alpm_pkg_get_files(package) : nullptr;
+        if (fileList == nullptr) {
+            continue;
+        }
+
+        Metrics::Add(Metrics::Counter::Files, fileList->count);
+
+        // The installed file lists are complete even when the sync packages'
+        // weren't.
+        if (deferHooks) {
+            for (std::size_t i = 0; i < fileList->count; i++) {
+                changes.Files[fileList->files[i].name] = changes.Packages[name];
+            }
+        }
+    }
+
+    if (deferHooks) {
+        m_hookQueue->Collect(changes);
+    }
+
+    // libalpm verified every package it installed.
+    if (m_contentCache) {
+        std::filesystem::path cacheDirectory = Downloader::GetCacheDirectory();
+        for (const auto &[sha256, filename] : blobs) {
+            if (m_contentCache->Import(cacheDirectory / filename, sha256, true) && !m_revision.empty()) {
+                m_contentCache->Reference(m_revision, sha256);
+            }
+        }
+    }
+
+    std::vector<std::string> changed = completed.Added;
+    changed.insert(changed.end(), completed.Removed.begin(), completed.Removed.end());
+    LocalSnapshot::Update(changed);
+
+    Event::Event::Emit<TransactionCompletedEvent>(std::move(completed));
+}
+
+auto Transaction::ApplyAsync(std::stop_token stop) const -> std::future<void> {
+    // Apply waits on the shared thread pool itself, so it can't run on it.
+    return std::async(std::launch::async, [self = shared_from_this(), stop = std::move(stop)]() -> void {
+        self->Apply(stop);
+    });
+}
+
+auto Transaction::Plan() const -> ExecutionPlan {
+    Handle::Scope scope(*m_handle);
+    if (!Initialize(m_packageOperations)) {
+        alpm_trans_release(ALPM::GetHandle());
+        return {};
+    }
+
+    ExecutionPlan plan = Prepare();
+    alpm_trans_release(ALPM::GetHandle());
+
+    return plan;
+}
+
+auto Transaction::ExecutionPlan::IsResolvable() const -> bool {
+    return !Error.has_value();
+}
+
+auto Transaction::ExecutionPlan::Fits() const -> bool {
+    return std::ranges::all_of(Mounts, [](const MountUsage &usage) -> bool {
+        return usage.Required <= usage.Available;
+    });
+}
+
+auto Transaction::Initialize(const std::vector<std::pair<Package, PackageOperation>> &operations) const -> bool {
+    std::bitset<32> flags = m_transactionFlags;
+    if (m_hookQueue) {
+        flags.set(std::to_underlying(OperationFlags::NoHooks));
+    }
+
+    if (NeedsSyncDatabases()) {
+        m_handle->RegisterSyncDatabases();
+    }
+
+    if (alpm_trans_init(ALPM::GetHandle(), static_cast<alpm_transflag_t>(flags.to_ulong() & 0b111111111111111111)) != 0) {
         throw std::runtime_error(std::format("Failed to apply transaction: Failed to initialize libalpm transaction: {}", ALPM::GetError()));
     }
 
-    for (const auto &[package, operation] : m_packageOperations) {
+    for (const auto &[package, operation] : operations) {
         switch (operation) {
             case PackageOperation::Install:
                 if (alpm_add_pkg(ALPM::GetHandle(), package.GetHandle()) != 0) {
@@ -85,46 +819,88 @@ auto Transaction::Apply() const -> void {
         }
     }
 
-    
     if (m_systemUpgrade) {
         if (alpm_sync_sysupgrade(ALPM::GetHandle(), false) != 0) {
             throw std::runtime_error(std::format("Failed to apply transaction: Could not add packages to upgrade: {}", ALPM::GetError()));
         }
     }
 
-    // If there is nothing to do, return.
-    if (m_packageOperations.empty() && alpm_list_count(alpm_trans_get_add(ALPM::GetHandle())) == 0) {
-        std::cout << "There is nothing to do." << std::endl;
-        return;
-    }
+    return !operations.empty() || alpm_list_count(alpm_trans_get_add(ALPM::GetHandle())) != 0;
+}
 
+auto Transaction::NeedsSyncDatabases() const -> bool {
+    // libalpm looks for upgrades and for the dependencies of new packages in
+    // the sync databases by itself. Transactions that only remove packages
+    // never need them.
+    return m_systemUpgrade || std::ranges::any_of(m_packageOperations, [](const auto &operation) -> bool {
+        return operation.second == PackageOperation::Install;
+    });
+}
 
-    /* Handle transaction */
+auto Transaction::Prepare() const -> ExecutionPlan {
+    ExecutionPlan plan;
 
     alpm_list_t *errorList = nullptr;
     if (alpm_trans_prepare(ALPM::GetHandle(), &errorList) == -1) {
-        if (errorList) {
-            std::vector<MissingDependency> conflictingPackages = Utils::ALPMListToVector<MissingDependency>(errorList);
+        plan.Error = ALPM::GetError();
 
-            alpm_list_free(errorList);
-            errorList = nullptr;
+        if (errorList) {
+            switch (alpm_errno(ALPM::GetHandle())) {
+                case ALPM_ERR_UNSATISFIED_DEPS:
+                    plan.MissingDependencies = Utils::ALPMListToVector<MissingDependency>(errorList);
+                    plan.Problems = std::shared_ptr<alpm_list_t>(errorList, [](alpm_list_t *list) -> void {
+                        alpm_list_free_inner(list, reinterpret_cast<alpm_list_fn_free>(alpm_depmissing_free));
+                        alpm_list_free(list);
+                    });
+                    break;
+                case ALPM_ERR_CONFLICTING_DEPS:
+                    plan.Conflicts = Utils::ALPMListToVector<Conflict>(errorList);
+                    plan.Problems = std::shared_ptr<alpm_list_t>(errorList, [](alpm_list_t *list) -> void {
+                        alpm_list_free_inner(list, reinterpret_cast<alpm_list_fn_free>(alpm_conflict_free));
+                        alpm_list_free(list);
+                    });
+                    break;
+                default:
+                    // Everything else comes as a list of strings, e.g. the names of
+                    // packages built for another architecture.
+                    FREELIST(errorList);
+                    break;
+            }
         }
-        
-        throw std::runtime_error(std::format("Failed to prepare transaction: {}", ALPM::GetError()));
+
+        return plan;
     }
 
-    if (alpm_trans_commit(ALPM::GetHandle(), &errorList) != 0) {
-        if (errorList) {
+    plan.Additions = Utils::ALPMListToVector<Package>(alpm_trans_get_add(ALPM::GetHandle()));
+    plan.Removals = Utils::ALPMListToVector<Package>(alpm_trans_get_remove(ALPM::GetHandle()));
+
+    for (const Package &package : plan.Additions) {
+        plan.DownloadSize += package.GetDownloadSize();
+    }
 
-            alpm_list_free(errorList);
-            errorList = nullptr;
+    plan.Mounts = EstimateDiskUsage(plan.Additions, plan.Removals, plan.DownloadSize);
+
+    return plan;
+}
+
+auto Transaction::StartCheckpoint() const -> std::shared_ptr<Checkpoint> {
+    std::vector<Checkpoint::Target> targets;
+    for (const auto &[package, operation] : m_packageOperations) {
+        if (operation == PackageOperation::Uninstall) {
+            targets.push_back(Checkpoint::Target{.Name = package.GetName(), .Operation = operation});
+        } else if (alpm_db_t *db = alpm_pkg_get_db(package.GetHandle())) {
+            targets.push_back(Checkpoint::Target{.Database = alpm_db_get_name(db), .Name = package.GetName(), .Operation = operation});
         }
+    }
 
-        // TODO: Only throw if user gives no option.
-        throw std::runtime_error(std::format("Failed to commit transaction: {}", ALPM::GetError()));
+    std::vector<std::string> databases;
+    for (const Database &database : GetDatabaseUpdates()) {
+        databases.push_back(database.GetName());
     }
+
+    return Checkpoint::Begin(m_transactionFlags.to_ulong(), m_systemUpgrade, m_executionMode == ExecutionMode::Pipelined, targets, databases);
 }
 
 auto Transaction::Interrupt() const -> void {
-    alpm_trans_interrupt(ALPM::GetHandle());
+    alpm_trans_interrupt(m_handle->GetHandle());
 }
@@ -0,0 +1,247 @@
+#include "VersionKey.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+using namespace ALPM;
+
+namespace {
+    // The first character of whatever is left of a version once one side has
+    // run out of segments, which decides rpmvercmp's "final showdown".
+    enum class Remainder {
+        End,
+        Separator,
+        Digit,
+        Alpha
+    };
+
+    auto IsDigit(char c) -> bool {
+        return std::isdigit(static_cast<unsigned char>(c)) != 0;
+    }
+
+    auto IsAlpha(char c) -> bool {
+        return std::isalpha(static_cast<unsigned char>(c)) != 0;
+    }
+
+    auto IsAlnum(char c) -> bool {
+        return std::isalnum(static_cast<unsigned char>(c)) != 0;
+    }
+
+    auto Showdown(Remainder lhs, Remainder rhs) -> int {
+        if (lhs == Remainder::End && rhs == Remainder::End) {
+            return 0;
+        }
+
+        // A remaining alpha segment never beats an empty string, so 1.0a is
+        // older than 1.0, but 1.0.1 is newer.
+        if ((lhs == Remainder::End && rhs != Remainder::Alpha) || lhs == Remainder::Alpha) {
+            return -1;
+        }
+
+        return 1;
+    }
+
+    // Numbers with at most this many significant digits fit in a uint64_t.
+    constexpr std::size_t MAX_NUMERIC_DIGITS = 19;
+    constexpr std::size_t PACKED_ALPHA_LENGTH = 8;
+}  // namespace
+
+VersionKey::VersionKey(std::string_view version) :
+    m_version(version)
+{
+    // Same split as libalpm's parseEVR(): an optional all-digit epoch ending
+    // in ':', and a release after the last '-'.
+    std::size_t digits = 0;
+    while (digits < m_version.size() && IsDigit(m_version[digits])) {
+        digits++;
+    }
+
+    std::size_t versionBegin = 0;
+    if (digits < m_version.size() && m_version[digits] == ':') {
+        m_epoch = Tokenize(0, digits);
+        versionBegin = digits + 1;
+    }
+
+    // An empty or missing epoch is "0".
+    if (m_epoch.Count == 0) {
+        m_segments.push_back(Segment{.Value = 0, .Offset = 0, .Length = 0, .Separators = 0, .Type = Kind::Numeric});
+        m_epoch = Component{.First = static_cast<uint16_t>(m_segments.size() - 1), .Count = 1, .TrailingSeparators = 0};
+    }
+
+    std::size_t release = m_version.rfind('-');
+    if (release == std::string::npos || release < digits) {
+        m_pkgver = Tokenize(versionBegin, m_version.size());
+    } else {
+        m_pkgver = Tokenize(versionBegin, release);
+        m_pkgrel = Tokenize(release + 1, m_version.size());
+    }
+}
+
+auto VersionKey::Compare(const VersionKey &other) const -> int {
+    if (m_version == other.m_version) {
+        return 0;
+    }
+
+    if (int result = CompareComponents(m_epoch, other, other.m_epoch); result != 0) {
+        return result;
+    }
+
+    if (int result = CompareComponents(m_pkgver, other, other.m_pkgver); result != 0) {
+        return result;
+    }
+
+    // The release only matters when both versions have one.
+    if (m_pkgrel && other.m_pkgrel) {
+        return CompareComponents(*m_pkgrel, other, *other.m_pkgrel);
+    }
+
+    return 0;
+}
+
+auto VersionKey::GetVersion() const -> std::string_view {
+    return m_version;
+}
+
+namespace ALPM {
+    auto operator<=>(const VersionKey &lhs, const VersionKey &rhs) -> std::strong_ordering {
+        return lhs.Compare(rhs) <=> 0;
+    }
+
+    auto operator==(const VersionKey &lhs, const VersionKey &rhs) -> bool {
+        return lhs.Compare(rhs) == 0;
+    }
+}  // namespace ALPM
+
+auto VersionKey::Tokenize(std::size_t begin, std::size_t end) -> Component {
+    Component component{.First = static_cast<uint16_t>(m_segments.size())};
+
+    std::size_t position = begin;
+    while (position < end) {
+        std::size_t segmentBegin = position;
+        while (segmentBegin < end && !IsAlnum(m_version[segmentBegin])) {
+            segmentBegin++;
+        }
+
+        if (segmentBegin == end) {
+            component.TrailingSeparators = static_cast<uint16_t>(std::min<std::size_t>(end - position, UINT16_MAX));
+            break;
+        }
+
+        Segment segment{.Value = 0, .Offset = 0, .Length = 0, .Separators = static_cast<uint16_t>(std::min<std::size_t>(segmentBegin - position, UINT16_MAX)), .Type = Kind::Numeric};
+
+        std::size_t segmentEnd = segmentBegin;
+        if (IsDigit(m_version[segmentBegin])) {
+            while (segmentEnd < end && IsDigit(m_version[segmentEnd])) {
+                segmentEnd++;
+            }
+
+            std::size_t significant = segmentBegin;
+            while (significant < segmentEnd && m_version[significant] == '0') {
+                significant++;
+            }
+
+            segment.Offset = static_cast<uint32_t>(significant);
+            segment.Length = static_cast<uint16_t>(segmentEnd - significant);
+            if (segment.Length <= MAX_NUMERIC_DIGITS) {
+                for (std::size_t i = significant; i < segmentEnd; i++) {
+                    segment.Value = segment.Value * 10 + static_cast<uint64_t>(m_version[i] - '0');
+                }
+            }
+        } else {
+            while (segmentEnd < end && IsAlpha(m_version[segmentEnd])) {
+                segmentEnd++;
+            }
+
+            segment.Type = Kind::Alpha;
+            segment.Offset = static_cast<uint32_t>(segmentBegin);
+            segment.Length = static_cast<uint16_t>(segmentEnd - segmentBegin);
+
+            // Big-endian and zero padded, so comparing the packed values orders
+            // them the same as strcmp() on the first eight characters.
+            for (std::size_t i = 0; i < PACKED_ALPHA_LENGTH; i++) {
+                segment.Value <<= 8;
+                if (i < segment.Length) {
+                    segment.Value |= static_cast<unsigned char>(m_version[segmentBegin + i]);
+                }
+            }
+        }
+
+        m_segments.push_back(segment);
+        component.Count++;
+        position = segmentEnd;
+    }
+
+    return component;
+}
+
+auto VersionKey::CompareSegments(const Segment &lhs, const VersionKey &other, const Segment &rhs) const -> int {
+    if (lhs.Type == Kind::Numeric) {
+        // Without leading zeros, the longer number is the larger one.
+        if (lhs.Length != rhs.Length) {
+            return lhs.Length < rhs.Length ? -1 : 1;
+        }
+
+        if (lhs.Length <= MAX_NUMERIC_DIGITS) {
+            return lhs.Value == rhs.Value ? 0 : (lhs.Value < rhs.Value ? -1 : 1);
+        }
+    } else {
+        if (lhs.Value != rhs.Value) {
+            return lhs.Value < rhs.Value ? -1 : 1;
+        }
+
+        if (lhs.Length <= PACKED_ALPHA_LENGTH && rhs.Length <= PACKED_ALPHA_LENGTH) {
+            return 0;
+        }
+    }
+
+    int result = std::string_view(m_version).substr(lhs.Offset, lhs.Length).compare(std::string_view(other.m_version).substr(rhs.Offset, rhs.Length));
+    return result == 0 ? 0 : (result < 0 ? -1 : 1);
+}
+
+auto VersionKey::CompareComponents(const Component &lhs, const VersionKey &other, const Component &rhs) const -> int {
+    auto remainder = [](const VersionKey &key, const Component &component, std::size_t index, bool skipSeparators) -> Remainder {
+        if (index < component.Count) {
+            const Segment &segment = key.m_segments[component.First + index];
+            if (segment.Separators != 0 && !skipSeparators) {
+                return Remainder::Separator;
+            }
+
+            return segment.Type == Kind::Numeric ? Remainder::Digit : Remainder::Alpha;
+        }
+
+        return component.TrailingSeparators != 0 && !skipSeparators ? Remainder::Separator : Remainder::End;
+    };
+
+    for (std::size_t i = 0;; i++) {
+        bool lhsEmpty = i >= lhs.Count && lhs.TrailingSeparators == 0;
+        bool rhsEmpty = i >= rhs.Count && rhs.TrailingSeparators == 0;
+
+        // rpmvercmp stops before skipping separators when either side is
+        // already at the end of the string, and after skipping them when either
+        // side only had separators left.
+        if (lhsEmpty || rhsEmpty) {
+            return Showdown(remainder(*this, lhs, i, false), remainder(other, rhs, i, false));
+        }
+
+        if (i >= lhs.Count || i >= rhs.Count) {
+            return Showdown(remainder(*this, lhs, i, true), remainder(other, rhs, i, true));
+        }
+
+        const Segment &lhsSegment = m_segments[lhs.First + i];
+        const Segment &rhsSegment = other.m_segments[rhs.First + i];
+
+        // More separators in front of a segment makes it newer.
+        if (lhsSegment.Separators != rhsSegment.Separators) {
+            return lhsSegment.Separators < rhsSegment.Separators ? -1 : 1;
+        }
+
+        // Numeric segments are always newer than alpha segments.
+        if (lhsSegment.Type != rhsSegment.Type) {
+            return lhsSegment.Type == Kind::Numeric ? 1 : -1;
+        }
+
+        if (int result = CompareSegments(lhsSegment, other, rhsSegment); result != 0) {
+            return result;
+        }
+    }
+}
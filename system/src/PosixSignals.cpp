@@ -1,15 +1,91 @@
 #include "PosixSignals.hpp"
-#include "Event.hpp"
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
 #include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <format>
 #include <iostream>
+#include <stdexcept>
+#include <thread>
 
 using namespace POSIXSignals;
 
-auto Signal::InitHandlers() -> void {
-    signal(SIGINT, [](int signal) -> void {
-        Event::Event::Emit<SigInt>();
+namespace {
+    // Written to by the handler, which is all it can safely do, and read by the
+    // watcher thread.
+    int s_pipe[2]{-1, -1};
+
+    auto Handle(int signal) -> void {
+        int saved = errno;
+        char code = static_cast<char>(signal);
+        [[maybe_unused]] ssize_t written = write(s_pipe[1], &code, 1);
+        errno = saved;
+    }
+
+    auto Exit() -> void {
         std::cout << "\n\nRecieved interrupt, cleaning up..." << std::endl;
         exit(1);
-    });
+    }
+}  // namespace
+
+auto Signal::InitHandlers() -> void {
+    if (pipe2(s_pipe, O_CLOEXEC) != 0) {
+        throw std::runtime_error(std::format("Failed to create the signal pipe: {}", std::strerror(errno)));
+    }
+
+    std::thread([]() -> void {
+        bool interrupted = false;
+        char code = 0;
+        while (true) {
+            ssize_t result = read(s_pipe[0], &code, 1);
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result != 1) {
+                return;
+            }
+
+            if (interrupted || !Interruption::IsAlive()) {
+                Event::Event::Emit<SigInt>();
+                Exit();
+            }
+
+            interrupted = true;
+            std::cout << "\n\nRecieved interrupt, stopping..." << std::endl;
+            Event::Event::Emit<SigInt>();
+        }
+    }).detach();
+
+    struct sigaction action{};
+    action.sa_handler = Handle;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGINT, &action, nullptr);
+}
+
+Interruption::Interruption() :
+    // Callbacks can still run after being unregistered, so this one holds its
+    // own reference to the stop state.
+    m_callback(Event::Event::RegisterCallback<SigInt>([source = m_source](const SigInt &signal) -> void {
+        std::stop_source(source).request_stop();
+    }))
+{
+    s_alive++;
+}
+
+Interruption::~Interruption() {
+    s_alive--;
+    Event::Event::UnregisterCallback(m_callback);
+}
+
+auto Interruption::GetToken() const -> std::stop_token {
+    return m_source.get_token();
+}
+
+auto Interruption::IsAlive() -> bool {
+    return s_alive.load() != 0;
 }
@@ -0,0 +1,67 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(std::size_t threadCount) {
+    // hardware_concurrency() is allowed to return 0 when it can't tell.
+    threadCount = std::max<std::size_t>(threadCount, 1);
+
+    for (std::size_t i = 0; i < threadCount; i++) {
+        m_threads.emplace_back([this]() -> void {
+            Run();
+        });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+    }
+
+    m_condition.notify_all();
+
+    for (std::thread &thread : m_threads) {
+        thread.join();
+    }
+}
+
+auto ThreadPool::GetShared() -> ThreadPool& {
+    static ThreadPool pool;
+    return pool;
+}
+
+auto ThreadPool::GetThreadCount() const -> std::size_t {
+    return m_threads.size();
+}
+
+auto ThreadPool::Enqueue(std::function<void()> job) -> void {
+    {
+        std::lock_guard lock(m_mutex);
+        m_jobs.push(std::move(job));
+    }
+
+    m_condition.notify_one();
+}
+
+auto ThreadPool::Run() -> void {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock lock(m_mutex);
+            m_condition.wait(lock, [this]() -> bool {
+                return m_stopping || !m_jobs.empty();
+            });
+
+            // Queued jobs still run on shutdown so no future is left without a value.
+            if (m_jobs.empty()) {
+                return;
+            }
+
+            job = std::move(m_jobs.front());
+            m_jobs.pop();
+        }
+
+        job();
+    }
+}
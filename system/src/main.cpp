@@ -2,19 +2,184 @@
 #include "PosixSignals.hpp"
 
 #include "ALPM.hpp"
+#include "Checkpoint.hpp"
+#include "FileOwnershipIndex.hpp"
+#include "MirrorRanking.hpp"
+#include "SearchEngine.hpp"
+
+#include <filesystem>
+#include <format>
+#include <future>
+#include <iostream>
+#include <string>
+#include <vector>
 
 auto main(int argc, char **argv) -> int {
     argparse::ArgumentParser arguments("system", "0.1");
+
+    argparse::ArgumentParser search("search");
+    search.add_description("Search every sync database for packages matching all of the given terms.");
+    search.add_argument("terms")
+        .help("Terms (or regular expressions) to match against package names and descriptions.")
+        .nargs(argparse::nargs_pattern::at_least_one);
+
+    argparse::ArgumentParser owns("owns");
+    owns.add_description("Show which installed packages own the given files.");
+    owns.add_argument("files")
+        .help("Paths of the files, absolute or relative to the root.")
+        .nargs(argparse::nargs_pattern::at_least_one);
+
+    argparse::ArgumentParser mirrors("mirrors");
+    mirrors.add_description("Probe the mirrors of every sync database and show them in the order they'll be used.");
+
+    arguments.add_argument("--pipelined")
+        .help("Download, verify and decompress packages side by side before installing them.")
+        .flag();
+
+    arguments.add_argument("--delta")
+        .help("Refresh sync databases from their mirror's manifest, downloading only the entries that changed.")
+        .flag();
+
+    arguments.add_argument("--discard-checkpoint")
+        .help("Start a new upgrade instead of resuming an interrupted one.")
+        .flag();
+
+    arguments.add_argument("--root")
+        .help("Use the system installed in this directory instead of /. Given more than once, the roots are upgraded side by side.")
+        .append();
+
+    arguments.add_subparser(search);
+    arguments.add_subparser(owns);
+    arguments.add_subparser(mirrors);
     arguments.parse_args(argc, argv);
 
-    ALPM::ALPM::Initialize();
+    std::vector<std::string> roots;
+    if (arguments.is_used("--root")) {
+        roots = arguments.get<std::vector<std::string>>("--root");
+    }
+
+    // Queries read the one root they're given. Upgrades create a handle for
+    // each of theirs.
+    bool query = arguments.is_subcommand_used("search") || arguments.is_subcommand_used("owns") || arguments.is_subcommand_used("mirrors");
+    if (query && roots.size() > 1) {
+        std::cerr << "Queries only read a single --root." << std::endl;
+        return 1;
+    }
+
+    ALPM::ALPM::Initialize(query && !roots.empty() ? std::filesystem::path(roots.front()) : std::filesystem::path("/"));
     POSIXSignals::Signal::InitHandlers();
 
-    for (const ALPM::Database &db : ALPM::ALPM::GetSyncDatabases()) {
-        db.MarkUpdate();
+    if (arguments.is_subcommand_used("search")) {
+        ALPM::SearchEngine engine(search.get<std::vector<std::string>>("terms"));
+        engine.Search([](const ALPM::SearchEngine::Result &result) -> void {
+            std::cout << result.Database << '/' << result.Name << ' ' << result.Version << '\n'
+                      << "    " << result.Description << '\n';
+        });
+
+        return 0;
+    }
+
+    if (arguments.is_subcommand_used("owns")) {
+        std::shared_ptr<const ALPM::FileOwnershipIndex> index = ALPM::FileOwnershipIndex::Get();
+        if (!index) {
+            std::cerr << "Could not read the file ownership index." << std::endl;
+            return 1;
+        }
+
+        int result = 0;
+        for (const std::string &file : owns.get<std::vector<std::string>>("files")) {
+            std::vector<std::string_view> owners = index->FindOwners(file);
+            if (owners.empty()) {
+                std::cout << file << " is not owned by any package" << '\n';
+                result = 1;
+            }
+
+            for (std::string_view owner : owners) {
+                std::cout << file << " is owned by " << owner << '\n';
+            }
+        }
+
+        return result;
+    }
+
+    if (arguments.is_subcommand_used("mirrors")) {
+        std::shared_ptr<ALPM::MirrorRanking> ranking = ALPM::MirrorRanking::Get();
+        for (const ALPM::Database &database : ALPM::ALPM::GetSyncDatabases()) {
+            std::vector<std::string> servers = database.GetServers();
+            ranking->Probe(servers, std::format("{}.db", database.GetName()));
+
+            std::cout << database.GetName() << '\n';
+            for (const std::string &server : ranking->Rank(servers)) {
+                std::optional<ALPM::MirrorRanking::Score> score = ranking->GetScore(server);
+                if (ranking->IsDemoted(server)) {
+                    std::cout << "    " << server << " (demoted)" << '\n';
+                } else if (!score || score->Samples == 0) {
+                    std::cout << "    " << server << " (not measured)" << '\n';
+                } else {
+                    std::cout << "    " << server << std::format(" ({:.0f} ms, {:.1f} MiB/s)", score->TimeToFirstByte * 1000.0, score->Throughput / (1024.0 * 1024.0)) << '\n';
+                }
+            }
+        }
+
+        ranking->Save();
+        return 0;
+    }
+
+    // Upgrades the root of the current handle.
+    auto upgrade = [&arguments]() -> void {
+        if (arguments["--discard-checkpoint"] == true) {
+            ALPM::Checkpoint::Discard();
+        } else if (std::shared_ptr<ALPM::Transaction> resumed = ALPM::Transaction::Resume()) {
+            std::cout << "Resuming the interrupted transaction, run with --discard-checkpoint to start over instead." << std::endl;
+            ALPM::ALPM::SetCurrentTransaction(resumed);
+            resumed->Apply();
+
+            return;
+        }
+
+        for (const ALPM::Database &db : ALPM::ALPM::GetSyncDatabases()) {
+            db.MarkUpdate();
+        }
+
+        std::shared_ptr<ALPM::Transaction> transaction = ALPM::ALPM::GetCurrentTransaction();
+        transaction->SetFlags(ALPM::Transaction::OperationFlags::ForceDatabase);
+        if (arguments["--delta"] == true) {
+            transaction->SetFlags(ALPM::Transaction::OperationFlags::DeltaDatabase);
+        }
+        if (arguments["--pipelined"] == true) {
+            transaction->SetExecutionMode(ALPM::Transaction::ExecutionMode::Pipelined);
+        }
+        transaction->AddSystemUpgradeOperation();
+        transaction->Apply();
+    };
+
+    if (!roots.empty()) {
+        std::vector<std::future<void>> upgrades;
+        for (const std::string &root : roots) {
+            upgrades.push_back(std::async(std::launch::async, [root, &upgrade]() -> void {
+                ALPM::Handle handle(root);
+                ALPM::Handle::Scope scope(handle);
+                upgrade();
+            }));
+        }
+
+        int result = 0;
+        for (std::future<void> &upgraded : upgrades) {
+            try {
+                upgraded.get();
+            } catch (const std::exception &error) {
+                std::cerr << error.what() << std::endl;
+                result = 1;
+            }
+        }
+
+        return result;
     }
 
-    ALPM::ALPM::GetCurrentTransaction()->SetFlags(ALPM::Transaction::OperationFlags::ForceDatabase);
-    ALPM::ALPM::GetCurrentTransaction()->AddSystemUpgradeOperation();
-    ALPM::ALPM::GetCurrentTransaction()->Apply();
+    try {
+        upgrade();
+    } catch (const std::exception &error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
 }
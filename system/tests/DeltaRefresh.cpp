@@ -0,0 +1,145 @@
+#include "Test.hpp"
+#include "DeltaRefresh.hpp"
+#include "ALPM.hpp"
+#include "Handle.hpp"
+
+#include <archive.h>
+#include <archive_entry.h>
+
+#include <map>
+#include <set>
+
+// Mirrors are plain directories served through file:// URLs, laid out the way
+// `DeltaRefresh::Publish` lays them out.
+namespace {
+    auto Desc(const std::string &entry) -> std::string {
+        std::size_t release = entry.rfind('-');
+        std::size_t version = entry.rfind('-', release - 1);
+        return std::format("%NAME%\n{}\n\n%VERSION%\n{}\n", entry.substr(0, version), entry.substr(version + 1));
+    }
+
+    auto WriteDatabase(const std::filesystem::path &path, const std::set<std::string> &entries) -> void {
+        std::filesystem::create_directories(path.parent_path());
+
+        archive *writer = archive_write_new();
+        archive_write_set_format_pax_restricted(writer);
+        archive_write_add_filter_gzip(writer);
+        archive_write_open_filename(writer, path.c_str());
+
+        for (const std::string &name : entries) {
+            std::string desc = Desc(name);
+
+            archive_entry *entry = archive_entry_new();
+            archive_entry_set_pathname(entry, std::format("{}/desc", name).c_str());
+            archive_entry_set_filetype(entry, AE_IFREG);
+            archive_entry_set_perm(entry, 0644);
+            archive_entry_set_size(entry, static_cast<int64_t>(desc.size()));
+            archive_write_header(writer, entry);
+            archive_write_data(writer, desc.data(), desc.size());
+            archive_entry_free(entry);
+        }
+
+        archive_write_close(writer);
+        archive_write_free(writer);
+    }
+
+    // The desc file of every entry in a database.
+    auto ReadDatabase(const std::filesystem::path &path) -> std::map<std::string, std::string> {
+        archive *reader = archive_read_new();
+        archive_read_support_filter_all(reader);
+        archive_read_support_format_all(reader);
+
+        std::map<std::string, std::string> entries;
+        if (archive_read_open_filename(reader, path.c_str(), 10240) != ARCHIVE_OK) {
+            archive_read_free(reader);
+            return entries;
+        }
+
+        archive_entry *entry = nullptr;
+        while (archive_read_next_header(reader, &entry) == ARCHIVE_OK) {
+            std::string pathname = archive_entry_pathname(entry);
+            if (archive_entry_filetype(entry) != AE_IFREG) {
+                continue;
+            }
+
+            std::string contents(static_cast<std::size_t>(archive_entry_size(entry)), '\0');
+            archive_read_data(reader, contents.data(), contents.size());
+            entries.emplace(pathname.substr(0, pathname.find('/')), std::move(contents));
+        }
+
+        archive_read_free(reader);
+        return entries;
+    }
+
+    auto TestApply(const std::filesystem::path &root, const std::filesystem::path &directory) -> void {
+        std::filesystem::path local = root / "var/lib/pacman/sync/delta.db";
+        WriteDatabase(local, {"a-1.0-1", "b-1.0-1", "c-1.0-1", "d-1.0-1"});
+        Test::WriteFile(root / "var/lib/pacman/sync/delta.db.sig", "stale");
+
+        WriteDatabase(directory / "upstream/delta.db", {"a-1.0-1", "b-1.1-1", "d-1.0-1", "e-2.0-1"});
+        ALPM::DeltaRefresh::Publish(directory / "upstream/delta.db", directory / "delta");
+
+        std::optional<ALPM::Database> database = ALPM::ALPM::GetSyncDatabase("delta");
+        if (!Test::Check(database.has_value(), "the delta database should be registered")) {
+            return;
+        }
+
+        ALPM::DeltaRefresh refresh(*database);
+        Test::Check(refresh.Apply(), "the refresh should apply the manifest");
+        Test::Check(refresh.GetAdded() == std::vector<std::string>{"b-1.1-1", "e-2.0-1"}, "b-1.1-1 and e-2.0-1 should be added");
+        Test::Check(refresh.GetRemoved() == std::vector<std::string>{"b-1.0-1", "c-1.0-1"}, "b-1.0-1 and c-1.0-1 should be removed");
+
+        std::map<std::string, std::string> entries = ReadDatabase(local);
+        std::map<std::string, std::string> expected;
+        for (const std::string &entry : {"a-1.0-1", "b-1.1-1", "d-1.0-1", "e-2.0-1"}) {
+            expected.emplace(entry, Desc(entry));
+        }
+        Test::Check(entries == expected, "the local database should match the mirror's");
+
+        Test::Check(!std::filesystem::exists(root / "var/lib/pacman/sync/delta.db.sig"), "the stale signature should be removed");
+        Test::Check(!std::filesystem::exists(root / "var/lib/pacman/sync/.delta.delta"), "the staging directory should be removed");
+
+        // Nothing changed since, so a second refresh has nothing to do.
+        ALPM::DeltaRefresh again(*database);
+        Test::Check(again.Apply() && again.GetAdded().empty() && again.GetRemoved().empty(), "a second refresh should find nothing to change");
+    }
+
+    auto TestFallback(const std::filesystem::path &root, const std::filesystem::path &directory) -> void {
+        std::filesystem::path local = root / "var/lib/pacman/sync/full.db";
+        WriteDatabase(local, {"a-1.0-1", "b-1.0-1"});
+        std::string before = Test::ReadFile(local);
+
+        // A mirror that only serves the database itself.
+        WriteDatabase(directory / "full/full.db", {"a-1.0-1", "b-1.1-1"});
+
+        std::optional<ALPM::Database> database = ALPM::ALPM::GetSyncDatabase("full");
+        if (!Test::Check(database.has_value(), "the full database should be registered")) {
+            return;
+        }
+
+        ALPM::DeltaRefresh refresh(*database);
+        Test::Check(!refresh.Apply(), "the refresh should fall back without a manifest");
+        Test::Check(Test::ReadFile(local) == before, "the local database should be left for the full download");
+        Test::Check(!std::filesystem::exists(root / "var/lib/pacman/sync/.full.delta"), "the staging directory should be removed");
+    }
+}  // namespace
+
+auto main() -> int {
+    Test::TemporaryDirectory directory;
+    std::filesystem::path root = directory.GetPath() / "root";
+    std::filesystem::path mirrors = directory.GetPath() / "mirrors";
+
+    Test::CreateRoot(root, std::format(
+        "[options]\n"
+        "[delta]\nSigLevel = Never\nServer = file://{0}/delta\n"
+        "[full]\nSigLevel = Never\nServer = file://{0}/full\n",
+        mirrors.string()));
+
+    ALPM::Handle handle(root);
+    ALPM::Handle::Scope scope(handle);
+
+    TestApply(root, mirrors);
+    TestFallback(root, mirrors);
+
+    return Test::Finish();
+}
@@ -0,0 +1,151 @@
+#include "Test.hpp"
+#include "Downloader.hpp"
+#include "Handle.hpp"
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <map>
+#include <thread>
+
+// Mirrors are plain directories served through file:// URLs. libcurl treats
+// file:///path and file://localhost/path as different hosts, which gives two
+// mirrors without running a server.
+namespace {
+    auto Contents(std::size_t size, char seed) -> std::string {
+        std::string contents(size, '\0');
+        for (std::size_t i = 0; i < size; i++) {
+            contents[i] = static_cast<char>(seed + i * 31 % 251);
+        }
+
+        return contents;
+    }
+
+    auto TestDownload(const std::filesystem::path &directory) -> void {
+        std::filesystem::path mirror = directory / "mirror";
+        std::filesystem::path cache = directory / "cache";
+        Test::WriteFile(mirror / "small.pkg", Contents(1000, 'a'));
+        Test::WriteFile(mirror / "large.pkg", Contents(300'000, 'b'));
+
+        ALPM::Downloader downloader(4);
+        downloader.Add({.Filename = "small.pkg", .Servers = {"file://" + (directory / "missing").string(), "file://" + mirror.string()}, .Directory = cache, .Size = 1000, .ShowProgress = false});
+        downloader.Add({.Filename = "large.pkg", .Servers = {"file://" + mirror.string()}, .Directory = cache, .Size = 300'000, .ShowProgress = false});
+        std::vector<ALPM::Downloader::Result> results = downloader.Run();
+
+        Test::Check(results.size() == 2 && results[0].Filename == "large.pkg", "results should be largest first");
+        for (const ALPM::Downloader::Result &result : results) {
+            Test::Check(!result.Error, std::format("{} should download: {}", result.Filename, result.Error.value_or("")));
+            Test::Check(result.Server == "file://" + mirror.string(), std::format("{} should come from the mirror that has it", result.Filename));
+            Test::Check(Test::ReadFile(cache / result.Filename) == Test::ReadFile(mirror / result.Filename), std::format("{} should match the mirror", result.Filename));
+            Test::Check(!std::filesystem::exists(cache / (result.Filename + ".part")), std::format("{} shouldn't leave a partial file", result.Filename));
+        }
+    }
+
+    auto TestResume(const std::filesystem::path &directory) -> void {
+        std::filesystem::path mirror = directory / "mirror";
+        std::filesystem::path cache = directory / "cache";
+        std::string contents = Contents(500'000, 'c');
+        Test::WriteFile(mirror / "resumed.pkg", contents);
+
+        // Resuming appends to whatever is there, like libalpm does, so a partial
+        // file that doesn't match the mirror shows the prefix wasn't downloaded
+        // again.
+        std::string partial(200'000, 'x');
+        Test::WriteFile(cache / "resumed.pkg.part", partial);
+
+        ALPM::Downloader downloader(1);
+        downloader.Add({.Filename = "resumed.pkg", .Servers = {"file://" + mirror.string()}, .Directory = cache, .Size = 500'000, .ShowProgress = false});
+        std::vector<ALPM::Downloader::Result> results = downloader.Run();
+
+        Test::Check(results.size() == 1 && !results[0].Error, "the resumed download should succeed");
+        Test::Check(Test::ReadFile(cache / "resumed.pkg") == partial + contents.substr(partial.size()), "only the rest of the file should be downloaded");
+    }
+
+    // Every file is a FIFO, so a transfer stays running until the test writes
+    // to it, and the test can see which transfers are running by which FIFOs
+    // have a reader.
+    auto TestMirrorLimit(const std::filesystem::path &directory) -> void {
+        constexpr std::size_t MIRROR_LIMIT = 2;
+        constexpr std::size_t FILES_PER_MIRROR = 5;
+
+        std::filesystem::path cache = directory / "cache";
+        std::map<std::filesystem::path, std::string> fifos;
+        ALPM::Downloader downloader(8, MIRROR_LIMIT);
+        for (std::string_view host : {"", "localhost"}) {
+            std::string name = host.empty() ? "local" : std::string(host);
+            std::filesystem::path mirror = directory / name;
+            std::filesystem::create_directories(mirror);
+
+            for (std::size_t i = 0; i < FILES_PER_MIRROR; i++) {
+                std::string filename = std::format("{}-{}.pkg", name, i);
+                mkfifo((mirror / filename).c_str(), 0600);
+                fifos.emplace(mirror / filename, std::format("file://{}", host));
+                downloader.Add({.Filename = filename, .Servers = {std::format("file://{}{}", host, mirror.string())}, .Directory = cache, .ShowProgress = false});
+            }
+        }
+
+        std::future<std::vector<ALPM::Downloader::Result>> running = std::async(std::launch::async, [&downloader]() -> std::vector<ALPM::Downloader::Result> {
+            return downloader.Run();
+        });
+
+        // Opening a FIFO to write without blocking only works while something
+        // has it open to read.
+        auto readers = [&fifos]() -> std::map<std::filesystem::path, int> {
+            std::map<std::filesystem::path, int> open;
+            for (const auto &[fifo, mirror] : fifos) {
+                if (int fd = ::open(fifo.c_str(), O_WRONLY | O_NONBLOCK | O_CLOEXEC); fd >= 0) {
+                    open.emplace(fifo, fd);
+                }
+            }
+
+            return open;
+        };
+
+        std::size_t mostAtOnce = 0;
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+        while (!fifos.empty() && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            std::map<std::filesystem::path, int> open = readers();
+
+            std::map<std::string, std::size_t> perMirror;
+            for (const auto &[fifo, fd] : open) {
+                perMirror[fifos.at(fifo)]++;
+            }
+            for (const auto &[mirror, count] : perMirror) {
+                Test::Check(count <= MIRROR_LIMIT, std::format("{} served {} files at once", mirror, count));
+                mostAtOnce = std::max(mostAtOnce, count);
+            }
+
+            for (const auto &[fifo, fd] : open) {
+                std::string contents = fifo.filename().string();
+                Test::Check(write(fd, contents.data(), contents.size()) == static_cast<ssize_t>(contents.size()), std::format("writing to {}", fifo.string()));
+                close(fd);
+                fifos.erase(fifo);
+            }
+        }
+
+        std::vector<ALPM::Downloader::Result> results = running.get();
+        Test::Check(mostAtOnce == MIRROR_LIMIT, std::format("mirrors should serve up to {} files at once, not {}", MIRROR_LIMIT, mostAtOnce));
+        for (const ALPM::Downloader::Result &result : results) {
+            Test::Check(!result.Error && Test::ReadFile(result.Path) == result.Filename, std::format("{} should download: {}", result.Filename, result.Error.value_or("")));
+        }
+    }
+}  // namespace
+
+auto main() -> int {
+    Test::TemporaryDirectory directory;
+    Test::CreateRoot(directory.GetPath() / "root");
+
+    ALPM::Handle handle(directory.GetPath() / "root");
+    ALPM::Handle::Scope scope(handle);
+
+    TestDownload(directory.GetPath() / "download");
+    TestResume(directory.GetPath() / "resume");
+    TestMirrorLimit(directory.GetPath() / "limit");
+
+    return Test::Finish();
+}
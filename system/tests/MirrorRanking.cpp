@@ -0,0 +1,283 @@
+#include "Test.hpp"
+#include "MirrorRanking.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+// Rankings are constructed on a path of their own, so none of this needs a
+// handle.
+namespace {
+    using namespace std::chrono_literals;
+
+    // A mirror on localhost that waits `delay` before answering every request
+    // with `status`. Successful answers are `size` bytes, of which it only
+    // sends the requested range if `ranges` is set.
+    class StandIn {
+        public:
+            StandIn(std::chrono::milliseconds delay, int status, std::size_t size, bool ranges) :
+                m_delay(delay),
+                m_status(status),
+                m_size(size),
+                m_ranges(ranges)
+            {
+                m_socket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+                sockaddr_in address{};
+                address.sin_family = AF_INET;
+                address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                socklen_t length = sizeof(address);
+                if (m_socket < 0 || bind(m_socket, reinterpret_cast<sockaddr*>(&address), length) != 0 || listen(m_socket, 16) != 0 || getsockname(m_socket, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+                    throw std::runtime_error("Failed to start a mirror stand-in");
+                }
+                m_port = ntohs(address.sin_port);
+
+                m_thread = std::jthread([this](std::stop_token stop) -> void {
+                    Serve(stop);
+                });
+            }
+
+            ~StandIn() {
+                m_thread.request_stop();
+                m_thread.join();
+                close(m_socket);
+            }
+
+            StandIn(const StandIn&) = delete;
+            auto operator=(const StandIn&) -> StandIn& = delete;
+
+            auto GetServer() const -> std::string {
+                return std::format("http://127.0.0.1:{}/core/os/x86_64", m_port);
+            }
+
+            // Whether every request asked for just the probe.
+            auto WasRanged() const -> bool {
+                return m_requests.load() > 0 && m_ranged.load() == m_requests.load();
+            }
+
+            // Whether the client stopped reading before the end.
+            auto WasHungUpOn() const -> bool {
+                return m_hungUp.load() > 0;
+            }
+
+        private:
+            auto Serve(std::stop_token stop) -> void {
+                while (!stop.stop_requested()) {
+                    pollfd listening{.fd = m_socket, .events = POLLIN, .revents = 0};
+                    if (poll(&listening, 1, 50) <= 0) {
+                        continue;
+                    }
+
+                    int connection = accept4(m_socket, nullptr, nullptr, SOCK_CLOEXEC);
+                    if (connection < 0) {
+                        continue;
+                    }
+
+                    std::string request;
+                    char buffer[4096];
+                    while (request.find("\r\n\r\n") == std::string::npos) {
+                        ssize_t received = recv(connection, buffer, sizeof(buffer), 0);
+                        if (received <= 0) {
+                            break;
+                        }
+                        request.append(buffer, static_cast<std::size_t>(received));
+                    }
+
+                    m_requests++;
+                    bool ranged = request.find(std::format("Range: bytes=0-{}\r\n", ALPM::MirrorRanking::PROBE_SIZE - 1)) != std::string::npos;
+                    if (ranged) {
+                        m_ranged++;
+                    }
+
+                    std::this_thread::sleep_for(m_delay);
+
+                    std::size_t size = m_status >= 400 ? 0 : (m_ranges && ranged ? ALPM::MirrorRanking::PROBE_SIZE : m_size);
+                    int status = m_status == 200 && m_ranges && ranged ? 206 : m_status;
+                    std::string header = std::format("HTTP/1.1 {} Stand-in\r\nContent-Length: {}\r\nConnection: close\r\n\r\n", status, size);
+                    send(connection, header.data(), header.size(), MSG_NOSIGNAL);
+
+                    // A client that has read enough hangs up.
+                    std::string body(64 * 1024, 'x');
+                    std::size_t sent = 0;
+                    while (sent < size) {
+                        ssize_t written = send(connection, body.data(), std::min(body.size(), size - sent), MSG_NOSIGNAL);
+                        if (written <= 0) {
+                            m_hungUp++;
+                            break;
+                        }
+                        sent += static_cast<std::size_t>(written);
+                    }
+
+                    close(connection);
+                }
+            }
+
+            std::chrono::milliseconds m_delay;
+            int m_status;
+            std::size_t m_size;
+            bool m_ranges;
+
+            int m_socket{-1};
+            uint16_t m_port{0};
+            std::atomic<std::size_t> m_requests{0};
+            std::atomic<std::size_t> m_ranged{0};
+            std::atomic<std::size_t> m_hungUp{0};
+            std::jthread m_thread;
+    };
+
+    constexpr std::string_view HEADER = "system-mirrors 1";
+
+    auto Now() -> int64_t {
+        return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    auto Near(double value, double expected) -> bool {
+        return std::abs(value - expected) <= 1e-9 * std::max(1.0, std::abs(expected));
+    }
+
+    // Whether a mirror is demoted for about `length` from now.
+    auto DemotedFor(const ALPM::MirrorRanking &ranking, std::string_view server, std::chrono::seconds length) -> bool {
+        std::optional<ALPM::MirrorRanking::Score> score = ranking.GetScore(server);
+        return score && std::abs(score->DemotedUntil - (Now() + length.count())) <= 5;
+    }
+
+    auto TestRecord(const std::filesystem::path &directory) -> void {
+        ALPM::MirrorRanking ranking(directory / "record");
+
+        ranking.Record("https://a.example.org/core/os/x86_64", 100ms, 1024 * 1024, 1s);
+        std::optional<ALPM::MirrorRanking::Score> score = ranking.GetScore("https://a.example.org/extra/os/x86_64");
+        if (!Test::Check(score.has_value(), "every repository on a mirror should share its score")) {
+            return;
+        }
+        Test::Check(Near(score->TimeToFirstByte, 0.1), "the first sample should set the time to first byte");
+        Test::Check(Near(score->Throughput, 1024.0 * 1024.0), "the first big transfer should set the throughput");
+        Test::Check(score->Samples == 1, "one sample should be counted");
+
+        // Later samples move the averages 30% of the way.
+        ranking.Record("https://a.example.org/core/os/x86_64", 200ms, 2 * 1024 * 1024, 1s);
+        score = ranking.GetScore("https://a.example.org");
+        Test::Check(Near(score->TimeToFirstByte, 0.13), "the time to first byte should be blended");
+        Test::Check(Near(score->Throughput, 1.3 * 1024.0 * 1024.0), "the throughput should be blended");
+        Test::Check(score->Samples == 2, "both samples should be counted");
+
+        // Too small to say anything about throughput.
+        ranking.Record("https://a.example.org/core/os/x86_64", 100ms, 1024, 1ms);
+        Test::Check(Near(ranking.GetScore("https://a.example.org")->Throughput, 1.3 * 1024.0 * 1024.0), "small transfers should leave the throughput alone");
+    }
+
+    auto TestRecordFailure(const std::filesystem::path &directory) -> void {
+        ALPM::MirrorRanking ranking(directory / "failure");
+
+        ranking.RecordFailure("https://down.example.org/core/os/x86_64");
+        Test::Check(ranking.IsDemoted("https://down.example.org/extra/os/x86_64"), "a failed mirror should be demoted");
+        Test::Check(DemotedFor(ranking, "https://down.example.org", 5min), "the first demotion should last five minutes");
+
+        // The rest of the same outage.
+        ranking.RecordFailure("https://down.example.org/extra/os/x86_64");
+        Test::Check(ranking.GetScore("https://down.example.org")->Failures == 1, "failures while demoted should count once");
+        Test::Check(DemotedFor(ranking, "https://down.example.org", 5min), "failures while demoted should leave the demotion alone");
+
+        ranking.Record("https://down.example.org/core/os/x86_64", 100ms, 0, 0s);
+        std::optional<ALPM::MirrorRanking::Score> score = ranking.GetScore("https://down.example.org");
+        Test::Check(!ranking.IsDemoted("https://down.example.org") && score->Failures == 0, "a success should lift the demotion");
+    }
+
+    auto TestBackoff(const std::filesystem::path &directory) -> void {
+        // Demotions that have run out, as a previous run would have saved them.
+        std::filesystem::path path = directory / "backoff";
+        Test::WriteFile(path, std::format(
+            "{}\n"
+            "https://flaky.example.org 0.1 0 3 1 {}\n"
+            "https://broken.example.org 0.1 0 3 20 {}\n",
+            HEADER, Now() - 1, Now() - 1));
+
+        ALPM::MirrorRanking ranking(path);
+        Test::Check(!ranking.IsDemoted("https://flaky.example.org"), "an expired demotion should be over");
+
+        ranking.RecordFailure("https://flaky.example.org/core/os/x86_64");
+        Test::Check(ranking.GetScore("https://flaky.example.org")->Failures == 2, "a failure after a demotion ran out should count");
+        Test::Check(DemotedFor(ranking, "https://flaky.example.org", 10min), "the second demotion should last twice as long");
+
+        ranking.RecordFailure("https://broken.example.org/core/os/x86_64");
+        Test::Check(DemotedFor(ranking, "https://broken.example.org", 24h), "demotions should stop growing at a day");
+
+        // Written out and read back the same.
+        Test::Check(ranking.Save(), "the scores should be saved");
+        ALPM::MirrorRanking loaded(path);
+        Test::Check(loaded.GetScore("https://flaky.example.org")->Failures == 2 && loaded.IsDemoted("https://flaky.example.org"), "saved scores should be read back");
+    }
+
+    auto TestRank(const std::filesystem::path &directory) -> void {
+        ALPM::MirrorRanking ranking(directory / "rank");
+
+        // Latency only, then latency plus the time to send 4 MiB.
+        ranking.Record("https://near.example.org", 10ms, 0, 0s);
+        ranking.Record("https://fast.example.org", 50ms, 8 * 1024 * 1024, 1s);
+        ranking.Record("https://slow.example.org", 20ms, 1024 * 1024, 1s);
+        ranking.RecordFailure("https://down.example.org");
+        ranking.RecordFailure("https://near.example.org/later");
+
+        std::vector<std::string> ranked = ranking.Rank({
+            "https://down.example.org/core",
+            "https://unknown.example.org/core",
+            "https://slow.example.org/core",
+            "https://other.example.org/core",
+            "https://near.example.org/core",
+            "https://fast.example.org/core"
+        });
+
+        Test::Check(ranked == std::vector<std::string>{
+            "https://fast.example.org/core",
+            "https://slow.example.org/core",
+            "https://unknown.example.org/core",
+            "https://other.example.org/core",
+            "https://down.example.org/core",
+            "https://near.example.org/core"
+        }, "mirrors should be ranked fastest first, then unmeasured in their order, then demoted by when they recover");
+    }
+
+    auto TestProbe(const std::filesystem::path &directory) -> void {
+        // The fast one ignores the range, so the probe has to stop reading it,
+        // long before the socket buffers could take all of it.
+        StandIn fast(20ms, 200, 1024 * ALPM::MirrorRanking::PROBE_SIZE, false);
+        StandIn slow(400ms, 200, 4 * ALPM::MirrorRanking::PROBE_SIZE, true);
+        StandIn missing(0ms, 404, 0, true);
+        StandIn failing(0ms, 503, 0, true);
+
+        ALPM::MirrorRanking ranking(directory / "probe");
+        std::vector<std::string> servers = {failing.GetServer(), missing.GetServer(), slow.GetServer(), fast.GetServer()};
+        ranking.Probe(servers, "core.db");
+
+        Test::Check(fast.WasRanged() && slow.WasRanged(), "probes should only ask for the first PROBE_SIZE bytes");
+        Test::Check(fast.WasHungUpOn() && !slow.WasHungUpOn(), "probes should stop reading past PROBE_SIZE");
+
+        std::optional<ALPM::MirrorRanking::Score> fastScore = ranking.GetScore(fast.GetServer());
+        std::optional<ALPM::MirrorRanking::Score> slowScore = ranking.GetScore(slow.GetServer());
+        Test::Check(fastScore && fastScore->Samples == 1 && fastScore->Throughput > 0.0, "a mirror sending more than the probe should still be measured");
+        Test::Check(slowScore && slowScore->Samples == 1 && slowScore->TimeToFirstByte >= 0.4, "a ranged answer should be measured");
+        Test::Check(!ranking.GetScore(missing.GetServer()), "a missing file should say nothing about the mirror");
+        Test::Check(ranking.IsDemoted(failing.GetServer()), "a server error should demote the mirror");
+
+        Test::Check(ranking.Rank(servers) == std::vector<std::string>{fast.GetServer(), slow.GetServer(), missing.GetServer(), failing.GetServer()}, "probed mirrors should be ranked fastest first, then unmeasured, then demoted");
+    }
+}  // namespace
+
+auto main() -> int {
+    Test::TemporaryDirectory directory;
+
+    TestRecord(directory.GetPath());
+    TestRecordFailure(directory.GetPath());
+    TestBackoff(directory.GetPath());
+    TestRank(directory.GetPath());
+    TestProbe(directory.GetPath());
+
+    return Test::Finish();
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <source_location>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace Test {
+    // Checks don't stop the test, so one run reports every check that failed.
+    class Checks {
+        public:
+            static inline auto Check(bool condition, std::string_view description, std::source_location location = std::source_location::current()) -> bool {
+                if (!condition) {
+                    s_failures++;
+                    std::cerr << std::format("{}:{}: {}", location.file_name(), location.line(), description) << std::endl;
+                }
+
+                return condition;
+            }
+
+            // The exit code of the test.
+            static inline auto Finish() -> int {
+                if (s_failures != 0) {
+                    std::cerr << std::format("{} checks failed", s_failures) << std::endl;
+                    return 1;
+                }
+
+                return 0;
+            }
+
+        private:
+            inline static std::size_t s_failures{0};
+    };
+
+    inline auto Check(bool condition, std::string_view description, std::source_location location = std::source_location::current()) -> bool {
+        return Checks::Check(condition, description, location);
+    }
+
+    inline auto Finish() -> int {
+        return Checks::Finish();
+    }
+
+    // Removed with everything in it when it goes out of scope.
+    class TemporaryDirectory {
+        public:
+            inline TemporaryDirectory() {
+                std::string path = (std::filesystem::temp_directory_path() / "system-test-XXXXXX").string();
+                if (mkdtemp(path.data()) == nullptr) {
+                    throw std::runtime_error(std::format("Failed to create a temporary directory from {}", path));
+                }
+
+                m_path = path;
+            }
+
+            inline ~TemporaryDirectory() {
+                std::error_code error;
+                std::filesystem::remove_all(m_path, error);
+            }
+
+            TemporaryDirectory(const TemporaryDirectory&) = delete;
+            auto operator=(const TemporaryDirectory&) -> TemporaryDirectory& = delete;
+
+            inline auto GetPath() const -> const std::filesystem::path& {
+                return m_path;
+            }
+
+        private:
+            std::filesystem::path m_path;
+    };
+
+    inline auto WriteFile(const std::filesystem::path &path, std::string_view contents) -> void {
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+    }
+
+    inline auto ReadFile(const std::filesystem::path &path) -> std::string {
+        std::ifstream file(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    // The smallest root a handle can be created for: an empty local database
+    // and a pacman.conf with `config` in it.
+    inline auto CreateRoot(const std::filesystem::path &root, std::string_view config = "[options]\n") -> void {
+        std::filesystem::create_directories(root / "var/lib/pacman/local");
+        std::filesystem::create_directories(root / "var/lib/pacman/sync");
+        WriteFile(root / "etc/pacman.conf", config);
+    }
+}  // namespace Test
@@ -0,0 +1,102 @@
+#include "Test.hpp"
+#include "VersionKey.hpp"
+
+#include <alpm.h>
+
+#include <array>
+#include <format>
+#include <random>
+#include <string>
+#include <tuple>
+
+namespace {
+    // Mostly from pacman's own vercmp tests.
+    constexpr std::array<std::tuple<std::string_view, std::string_view, int>, 48> CASES{{
+        {"1.5.0", "1.5.0", 0},
+        {"1.5.1", "1.5.0", 1},
+        {"1.5.1", "1.5", 1},
+        {"1.5.0-1", "1.5.0-1", 0},
+        {"1.5.0-1", "1.5.0-2", -1},
+        {"1.5.0-1", "1.5.1-1", -1},
+        {"1.5.0-2", "1.5.1-1", -1},
+        {"1.5-1", "1.5.1-1", -1},
+        {"1.5-2", "1.5.1-1", -1},
+        {"1.5-2", "1.5.1-2", -1},
+        {"1.5", "1.5-1", 0},
+        {"1.5-1", "1.5", 0},
+        {"1.1-1", "1.1", 0},
+        {"1.0-1", "1.1", -1},
+        {"1.1-1", "1.0", 1},
+        {"1.5b-1", "1.5-1", -1},
+        {"1.5b", "1.5", -1},
+        {"1.5b-1", "1.5", -1},
+        {"1.5b", "1.5.1", -1},
+        {"1.0a", "1.0alpha", -1},
+        {"1.0alpha", "1.0b", -1},
+        {"1.0b", "1.0beta", -1},
+        {"1.0beta", "1.0rc", -1},
+        {"1.0rc", "1.0", -1},
+        {"1.5.a", "1.5", 1},
+        {"1.5.b", "1.5.a", 1},
+        {"1.5.1", "1.5.b", 1},
+        {"1.5.b-1", "1.5.b", 0},
+        {"1.5-1", "1.5.b", -1},
+        {"2.0", "2_0", 0},
+        {"2.0_a", "2_0.a", 0},
+        {"2.0a", "2.0.a", -1},
+        {"2___a", "2_a", 1},
+        {"1.0", "1.0.0", -1},
+        {"0:1.0", "1.0", 0},
+        {"1:1.0", "1.0", 1},
+        {"1:1.0", "2:1.0", -1},
+        {"1:1.0", "0:2.0", 1},
+        {"1:1.0-1", "1:1.0", 0},
+        {":1.0", "1.0", 0},
+        {"1.0.", "1.0", 1},
+        {"1.0", "1.0.", -1},
+        {"", "1", -1},
+        {"", "", 0},
+        {"007", "7", 0},
+        {"123456789012345678901234", "123456789012345678901235", -1},
+        {"1.abcdefghij", "1.abcdefghik", -1},
+        {"1.abcdefgh", "1.abcdefghi", -1},
+    }};
+
+    // Characters that exercise every branch of rpmvercmp: digits with leading
+    // zeros, letters, separators, the epoch colon and the release dash.
+    constexpr std::string_view ALPHABET = "0019a.b-:_~z+";
+    constexpr std::size_t RANDOM_PAIRS = 200'000;
+
+    auto Compare(std::string_view lhs, std::string_view rhs) -> int {
+        return ALPM::VersionKey(lhs).Compare(ALPM::VersionKey(rhs));
+    }
+}  // namespace
+
+auto main() -> int {
+    for (const auto &[lhs, rhs, expected] : CASES) {
+        Test::Check(Compare(lhs, rhs) == expected, std::format("'{}' vs '{}' should be {}", lhs, rhs, expected));
+        Test::Check(Compare(rhs, lhs) == -expected, std::format("'{}' vs '{}' should be {}", rhs, lhs, -expected));
+        Test::Check(alpm_pkg_vercmp(std::string(lhs).c_str(), std::string(rhs).c_str()) == expected, std::format("alpm_pkg_vercmp('{}', '{}') should be {}", lhs, rhs, expected));
+    }
+
+    // Random versions, a fixed seed so failures can be reproduced.
+    std::mt19937 generator(1);
+    auto randomVersion = [&generator]() -> std::string {
+        std::string version;
+        for (std::size_t i = generator() % 9; i > 0; i--) {
+            version += ALPHABET[generator() % ALPHABET.size()];
+        }
+
+        return version;
+    };
+
+    for (std::size_t i = 0; i < RANDOM_PAIRS; i++) {
+        std::string lhs = randomVersion();
+        std::string rhs = generator() % 3 == 0 ? lhs + ALPHABET[generator() % ALPHABET.size()] : randomVersion();
+
+        int expected = alpm_pkg_vercmp(lhs.c_str(), rhs.c_str());
+        Test::Check(Compare(lhs, rhs) == expected, std::format("'{}' vs '{}' should be {} like alpm_pkg_vercmp", lhs, rhs, expected));
+    }
+
+    return Test::Finish();
+}